@@ -0,0 +1,205 @@
+#include "TimerWheel.h"
+
+using namespace Matrix::Common;
+
+namespace
+{
+   const uint64_t LEVEL0_SIZE = 1ull << TimerWheel::LEVEL0_BITS;
+   const uint64_t LEVEL_SIZE = 1ull << TimerWheel::LEVEL_BITS;
+
+   //the number of bits of the tick below the index of level
+   int GetLevelShift(int level)
+   {
+      return level == 0 ? 0 : TimerWheel::LEVEL0_BITS + (level - 1) * TimerWheel::LEVEL_BITS;
+   }
+   uint64_t GetLevelMask(int level)
+   {
+      return (level == 0 ? LEVEL0_SIZE : LEVEL_SIZE) - 1;
+   }
+}
+
+TimerWheel::TimerWheel()
+   : _startTime(std::chrono::steady_clock::now())
+   , _currentTick(0)
+   , _wakeTick(0)
+   , _pendingCount(0)
+   , _firedCount(0)
+   , _shuttingDown(false)
+{
+   for (int level = 0; level < NUM_LEVELS; level++)
+      _levels[level].resize((size_t)GetLevelMask(level) + 1);
+   _thread = std::thread(&TimerWheel::Run, this);
+}
+TimerWheel::~TimerWheel()
+{
+   {
+      std::lock_guard<std::mutex> lock(_lock);
+      _shuttingDown = true;
+   }
+   _wakeup.notify_one();
+   if (_thread.joinable())
+   {
+      if (IsWheelThread())
+         _thread.detach();
+      else
+         _thread.join();
+   }
+}
+
+TimerWheel& TimerWheel::Instance()
+{
+   //never destroyed so timers owned by other statics can still be stopped during exit
+   static TimerWheel* pWheel = new TimerWheel();
+   return *pWheel;
+}
+
+void TimerWheel::Schedule(uint32_t delayMS, Callback callback)
+{
+   bool wake = false;
+   {
+      std::lock_guard<std::mutex> lock(_lock);
+      auto nowTick = GetNowTick();
+      //nothing is pending so the thread has no ticks to catch up on
+      if (_pendingCount == 0 && _currentTick < nowTick)
+         _currentTick = nowTick;
+      Entry entry;
+      //nowTick is rounded down so round the expiry up to never fire early
+      entry._expiryTick = nowTick + delayMS + 1;
+      entry._callback = std::move(callback);
+      auto expiryTick = entry._expiryTick > _currentTick ? entry._expiryTick : _currentTick + 1;
+      Insert(std::move(entry), _currentTick + 1);
+      _pendingCount++;
+      if (_wakeTick == 0 || expiryTick < _wakeTick)
+      {
+         _wakeTick = expiryTick;
+         wake = true;
+      }
+   }
+   if (wake)
+      _wakeup.notify_one();
+}
+
+size_t TimerWheel::GetPendingCount()
+{
+   std::lock_guard<std::mutex> lock(_lock);
+   return _pendingCount;
+}
+
+int64_t TimerWheel::GetFiredCount()
+{
+   std::lock_guard<std::mutex> lock(_lock);
+   return _firedCount;
+}
+
+void TimerWheel::Run()
+{
+   std::vector<Callback> expired;
+   std::unique_lock<std::mutex> lock(_lock);
+   while (!_shuttingDown)
+   {
+      auto nowTick = GetNowTick();
+      if (_pendingCount == 0)
+      {
+         if (_currentTick < nowTick)
+            _currentTick = nowTick;
+      }
+      else
+      {
+         while (_currentTick < nowTick)
+            Advance(&expired);
+      }
+      if (!expired.empty())
+      {
+         _firedCount += (int64_t)expired.size();
+         lock.unlock();
+         for (auto& callback : expired)
+            callback();
+         //destroy the callbacks outside the lock; they may own timers that schedule again
+         expired.clear();
+         lock.lock();
+         continue;
+      }
+      if (_pendingCount == 0)
+      {
+         _wakeTick = 0;
+         _wakeup.wait(lock);
+      }
+      else
+      {
+         _wakeTick = GetNextWakeTick();
+         _wakeup.wait_until(lock, _startTime + std::chrono::milliseconds(_wakeTick));
+      }
+   }
+}
+
+uint64_t TimerWheel::GetNowTick() const
+{
+   return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _startTime).count();
+}
+
+void TimerWheel::Insert(Entry&& entry, uint64_t minTick)
+{
+   auto expiryTick = entry._expiryTick < minTick ? minTick : entry._expiryTick;
+   auto delta = expiryTick - _currentTick;
+   for (int level = 0; level < NUM_LEVELS; level++)
+   {
+      auto shift = GetLevelShift(level);
+      auto limit = (GetLevelMask(level) + 1) << shift;
+      if (delta < limit)
+      {
+         _levels[level][(size_t)((expiryTick >> shift) & GetLevelMask(level))].push_back(std::move(entry));
+         return;
+      }
+   }
+   //beyond the top level - park it in the last slot to be visited; it is re-inserted when cascaded
+   auto top = NUM_LEVELS - 1;
+   auto shift = GetLevelShift(top);
+   _levels[top][(size_t)(((_currentTick >> shift) + GetLevelMask(top)) & GetLevelMask(top))].push_back(std::move(entry));
+}
+
+void TimerWheel::Cascade(int level, size_t index)
+{
+   std::vector<Entry> entries;
+   entries.swap(_levels[level][index]);
+   for (auto& entry : entries)
+      Insert(std::move(entry), _currentTick);
+}
+
+void TimerWheel::Advance(std::vector<Callback>* pExpired)
+{
+   auto tick = ++_currentTick;
+   //cascade from the highest level that wrapped down to level 1 so entries land in the right slots
+   int wrapped = 0;
+   while (wrapped < NUM_LEVELS - 1 && (tick & ((1ull << GetLevelShift(wrapped + 1)) - 1)) == 0)
+      wrapped++;
+   for (int level = wrapped; level > 0; level--)
+      Cascade(level, (size_t)((tick >> GetLevelShift(level)) & GetLevelMask(level)));
+
+   auto& slot = _levels[0][(size_t)(tick & GetLevelMask(0))];
+   if (slot.empty())
+      return;
+   std::vector<Entry> entries;
+   entries.swap(slot);
+   for (auto& entry : entries)
+   {
+      if (entry._expiryTick <= tick)
+      {
+         pExpired->push_back(std::move(entry._callback));
+         _pendingCount--;
+      }
+      else
+         Insert(std::move(entry), _currentTick);
+   }
+}
+
+uint64_t TimerWheel::GetNextWakeTick() const
+{
+   //level 0 only needs to be searched up to where it wraps and level 1 cascades
+   auto boundary = (_currentTick | GetLevelMask(0)) + 1;
+   for (auto tick = _currentTick + 1; tick < boundary; tick++)
+   {
+      if (!_levels[0][(size_t)(tick & GetLevelMask(0))].empty())
+         return tick;
+   }
+   return boundary;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+#include "../stdafx.h"
+
+namespace Matrix
+{
+namespace Common
+{
+   /// <summary>
+   /// A flag that threads can wait on to become true; waiters wake as soon as it is set instead of
+   /// polling.  It can be assigned and read like a bool, and cleared again to be reused.
+   /// </summary>
+   class Completion
+   {
+      //****************************************
+      // Constructors/Destructors
+      //****************************************
+   public:
+      /// <summary>
+      /// Initializes a new instance of the <see cref="Completion"/> class.
+      /// </summary>
+      /// <param name="isComplete">The initial state</param>
+      explicit Completion(bool isComplete = false) : _isComplete(isComplete) {}
+   private:
+      Completion(const Completion&);
+      Completion& operator=(const Completion&);
+
+      //****************************************
+      // Fields
+      //****************************************
+   private:
+      std::atomic<bool> _isComplete;
+      std::mutex _lock;
+      std::condition_variable _completed;
+
+      //****************************************
+      // Methods
+      //****************************************
+   public:
+      /// <summary>
+      /// Sets or clears the flag; setting it wakes every waiter
+      /// </summary>
+      void Set(bool isComplete)
+      {
+         {
+            std::lock_guard<std::mutex> lock(_lock);
+            _isComplete = isComplete;
+         }
+         if (isComplete)
+            _completed.notify_all();
+      }
+      Completion& operator=(bool isComplete)
+      {
+         Set(isComplete);
+         return *this;
+      }
+      bool IsComplete() const { return _isComplete.load(); }
+      operator bool() const { return IsComplete(); }
+      /// <summary>
+      /// Waits until the flag is set or deadline passes
+      /// </summary>
+      /// <returns>true if the flag is set</returns>
+      bool WaitUntil(std::chrono::steady_clock::time_point deadline)
+      {
+         std::unique_lock<std::mutex> lock(_lock);
+         return _completed.wait_until(lock, deadline, [this]() { return _isComplete.load(); });
+      }
+      /// <summary>
+      /// Waits up to timeoutMS milliseconds for the flag to be set
+      /// </summary>
+      /// <returns>true if the flag is set</returns>
+      bool WaitFor(int timeoutMS)
+      {
+         return WaitUntil(std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMS));
+      }
+   };
+}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#include "../stdafx.h"
+
+namespace Matrix
+{
+namespace Common
+{
+   /// <summary>
+   /// Lets one thread wait for a number of operations running elsewhere to finish: each calls
+   /// CountDown once and the waiter wakes when the count reaches 0.
+   /// </summary>
+   class CountdownLatch
+   {
+      //****************************************
+      // Constructors/Destructors
+      //****************************************
+   public:
+      /// <summary>
+      /// Initializes a new instance of the <see cref="CountdownLatch"/> class.
+      /// </summary>
+      /// <param name="count">The number of CountDown calls to wait for</param>
+      explicit CountdownLatch(size_t count) : _count(count) {}
+   private:
+      CountdownLatch(const CountdownLatch&);
+      CountdownLatch& operator=(const CountdownLatch&);
+
+      //****************************************
+      // Fields
+      //****************************************
+   private:
+      size_t _count;
+      std::mutex _lock;
+      std::condition_variable _released;
+
+      //****************************************
+      // Methods
+      //****************************************
+   public:
+      /// <summary>
+      /// Records that one operation has finished; calls once the count is 0 are ignored
+      /// </summary>
+      void CountDown()
+      {
+         std::lock_guard<std::mutex> lock(_lock);
+         if (_count > 0 && --_count == 0)
+            _released.notify_all();
+      }
+      /// <summary>
+      /// Gets the number of operations still to finish
+      /// </summary>
+      size_t GetCount()
+      {
+         std::lock_guard<std::mutex> lock(_lock);
+         return _count;
+      }
+      /// <summary>
+      /// Waits until the count reaches 0 or deadline passes
+      /// </summary>
+      /// <returns>true if the count reached 0</returns>
+      bool WaitUntil(std::chrono::steady_clock::time_point deadline)
+      {
+         std::unique_lock<std::mutex> lock(_lock);
+         return _released.wait_until(lock, deadline, [this]() { return _count == 0; });
+      }
+   };
+}
+}
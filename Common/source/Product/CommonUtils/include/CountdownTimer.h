@@ -3,44 +3,16 @@
 #include <string>
 #include <chrono>
 #include <mutex>
+#include <memory>
+#include <functional>
 #include <condition_variable>
-#include <future>
+
+#include "TimerWheel.h"
 
 namespace Matrix
 {
 namespace Common
 {
-   /// <summary>
-   /// A struct that can be used to kill a timer before it has elapsed
-   /// </summary>
-   struct timer_killer
-   {
-      // returns false if killed:
-      template<class R, class P>
-      bool wait_for(std::chrono::duration<R, P> const& time)
-      {
-         std::unique_lock<std::mutex> lock(_lock);
-         return _cv.wait_for(lock, time, [&]
-         {
-            return _terminate;
-         });
-      }
-      void Reset()
-      {
-         _terminate = false;
-      }
-      void kill()
-      {
-         std::unique_lock<std::mutex> lock(_lock);
-         _terminate = true;
-         _cv.notify_all();
-      }
-   private:
-      std::condition_variable _cv;
-      std::mutex _lock;
-      bool _terminate = false;
-   };
-
    /// <summary>
    /// A timer that allows a function to be called after a specified period of time
    /// or to be called every so many milliseconds
@@ -70,9 +42,7 @@ namespace Common
       //****************************************
    public:
       CountdownTimer() :
-          _numMilliseconds{ 0 },
-          _onceOnly{ false },
-          _stopCompleted{ false }
+          _pState(std::make_shared<TimerState>())
       {
       }
       ~CountdownTimer()
@@ -83,75 +53,142 @@ namespace Common
       // Fields
       //****************************************
    protected:
-      int _numMilliseconds;
-      std::function<void()> _timeoutFunction;
-      timer_killer _timerKiller;
-      bool _stopCompleted;
-      bool _onceOnly;
+      /// <summary>
+      /// The state shared with the callbacks scheduled on the TimerWheel.  Stopping or restarting
+      /// bumps _generation so callbacks that are already scheduled do nothing when they fire.
+      /// </summary>
+      struct TimerState
+      {
+         std::mutex _lock;
+         std::condition_variable _callbackDone;
+         uint64_t _generation = 0;
+         int _numMilliseconds = 0;
+         std::function<void()> _timeoutFunction;
+         bool _onceOnly = false;
+         bool _armed = false;
+         bool _inCallback = false;
+         std::thread::id _callbackThread;
+         bool _stopCompleted = false;
+      };
+      std::shared_ptr<TimerState> _pState;
 
       //****************************************
       // Methods
       //****************************************
    public:
-      //void TestThis(std::function<void(std::string)> functionToCall, std::string arg)
-      //{
-      //   functionToCall(arg);
-      //}
-
       /// <summary>
-      /// Starts a timer that will call functionToCall every numMilliseconds ms
+      /// Starts a timer that will call functionToCall every numMilliseconds ms.  The calls are made
+      /// from the shared TimerWheel thread so functionToCall should not block for long.
+      /// Restarting a running timer replaces the previous function and interval.
       /// </summary>
       /// <param name="numMilliseconds">Number of milliseconds between calls.</param>
       /// <param name="functionToCall">the function to call.</param>
       /// <param name="onceOnly">true to quit after the first call of functionToCall.</param>
       void StartTimer(int numMilliseconds, std::function<void()> functionToCall, bool onceOnly = false)
       {
-         _onceOnly = onceOnly;
-         _numMilliseconds = numMilliseconds;
-         _timeoutFunction = functionToCall;
-         _timerKiller.Reset();
-         std::thread monitorThread(&CountdownTimer::TaskFunction, this);
-         monitorThread.detach();
-      }
-      static void TaskFunction(CountdownTimer* pTimer)
-      {
-         pTimer->_stopCompleted = false;
-         while (!pTimer->_timerKiller.wait_for(std::chrono::milliseconds(pTimer->_numMilliseconds)))
+         uint64_t generation;
+         std::function<void()> oldFunction;
          {
-            pTimer->_timeoutFunction();
-            if (pTimer->_onceOnly)
-               break;
+            std::lock_guard<std::mutex> lock(_pState->_lock);
+            generation = ++_pState->_generation;
+            _pState->_numMilliseconds = numMilliseconds;
+            _pState->_onceOnly = onceOnly;
+            oldFunction.swap(_pState->_timeoutFunction);
+            _pState->_timeoutFunction = functionToCall;
+            _pState->_armed = true;
+            _pState->_stopCompleted = false;
          }
-         pTimer->_stopCompleted = true;
+         Schedule(_pState, generation, numMilliseconds);
       }
       /// <summary>
       /// Sets a flag to tell the timer to stop.
       /// </summary>
       void Stop()
       {
-         _timerKiller.kill();
+         std::function<void()> oldFunction;
+         {
+            std::lock_guard<std::mutex> lock(_pState->_lock);
+            _pState->_generation++;
+            _pState->_armed = false;
+            //release whatever the function captured; a running callback holds its own copy
+            oldFunction.swap(_pState->_timeoutFunction);
+            if (!_pState->_inCallback)
+               _pState->_stopCompleted = true;
+         }
       }
       /// <summary>
-      /// Sets a flag to tell the timer to stop then loops every 10ms for up to num10ms 
+      /// Tells the timer to stop then waits for up to num10ms 10 millisecond periods
       /// until IsStopCompleted is true before returning
       /// </summary>
       /// <param name="num10ms">Number of 10 millisecond periods to wait for stop.</param>
       void StopAndWait(int num10ms)
       {
-         _timerKiller.kill();
-         int quit = num10ms;
-         while (!this->_stopCompleted && quit > 0)
+         Stop();
+         std::unique_lock<std::mutex> lock(_pState->_lock);
+         //called from within our own callback - it cannot complete until we return
+         if (_pState->_inCallback && _pState->_callbackThread == std::this_thread::get_id())
+            return;
+         _pState->_callbackDone.wait_for(lock, std::chrono::milliseconds(10 * (num10ms < 0 ? 0 : num10ms)), [this]()
          {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            quit--;
-         }
+            return _pState->_stopCompleted;
+         });
       }
       /// <summary>
-      /// Returns true if the timer loop is no longer running
+      /// Returns true if the timer is stopped and its function is not running
       /// </summary>
       bool IsStopCompleted()
       {
-         return _stopCompleted;
+         std::lock_guard<std::mutex> lock(_pState->_lock);
+         return _pState->_stopCompleted;
+      }
+   private:
+      static void Schedule(const std::shared_ptr<TimerState>& pState, uint64_t generation, int numMilliseconds)
+      {
+         TimerWheel::Instance().Schedule(numMilliseconds < 0 ? 0 : (uint32_t)numMilliseconds, [pState, generation]()
+         {
+            Fire(pState, generation);
+         });
+      }
+      static void Fire(const std::shared_ptr<TimerState>& pState, uint64_t generation)
+      {
+         std::function<void()> timeoutFunction;
+         {
+            std::lock_guard<std::mutex> lock(pState->_lock);
+            if (generation != pState->_generation || !pState->_armed)
+               return;
+            pState->_inCallback = true;
+            pState->_callbackThread = std::this_thread::get_id();
+            timeoutFunction = pState->_timeoutFunction;
+         }
+         timeoutFunction();
+         timeoutFunction = nullptr;
+
+         bool reschedule = false;
+         int numMilliseconds = 0;
+         std::function<void()> oldFunction;
+         {
+            std::lock_guard<std::mutex> lock(pState->_lock);
+            pState->_inCallback = false;
+            if (generation == pState->_generation && pState->_armed)
+            {
+               if (pState->_onceOnly)
+               {
+                  pState->_armed = false;
+                  oldFunction.swap(pState->_timeoutFunction);
+               }
+               else
+               {
+                  reschedule = true;
+                  numMilliseconds = pState->_numMilliseconds;
+               }
+            }
+            //stopped, or started again with a new generation that is still armed
+            if (!pState->_armed)
+               pState->_stopCompleted = true;
+         }
+         pState->_callbackDone.notify_all();
+         if (reschedule)
+            Schedule(pState, generation, numMilliseconds);
       }
    };
 }
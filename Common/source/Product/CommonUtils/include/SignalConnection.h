@@ -142,6 +142,16 @@ namespace Common
          return found;
       }
 
+      bool empty() const
+      {
+         for (auto& item : _list)
+         {
+            if (item->connected())
+               return false;
+         }
+         return true;
+      }
+
       void disconnectAll()
       {
          for (auto& item : _list)
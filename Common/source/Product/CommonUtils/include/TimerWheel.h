@@ -0,0 +1,137 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+
+#include "../stdafx.h"
+
+namespace Matrix
+{
+namespace Common
+{
+   /// <summary>
+   /// A hierarchical timer wheel with a 1ms tick that runs every scheduled callback on a
+   /// single thread.  Scheduling is O(1) regardless of how many timers are pending, so any
+   /// number of timers costs one thread.
+   ///
+   /// Level 0 holds the next 256ms in 1ms slots; each higher level holds 64 slots covering
+   /// 64 slots of the level below.  When level 0 wraps, the next slot of level 1 is cascaded
+   /// down, and so on.  Delays beyond the top level are parked in its last slot and re-inserted
+   /// when they are cascaded.
+   ///
+   /// Callbacks run on the wheel thread so they should be short; post longer work elsewhere.
+   /// </summary>
+   class TimerWheel
+   {
+   public:
+      typedef std::function<void()> Callback;
+
+      //****************************************
+      // Constructors/Destructors
+      //****************************************
+   public:
+      /// <summary>
+      /// Initializes a new instance of the <see cref="TimerWheel"/> class and starts its thread
+      /// </summary>
+      COMMONUTILS_API TimerWheel();
+      /// <summary>
+      /// Stops the thread; pending callbacks are discarded
+      /// </summary>
+      COMMONUTILS_API ~TimerWheel();
+   private:
+      TimerWheel(const TimerWheel&);
+      TimerWheel& operator=(const TimerWheel&);
+
+      //****************************************
+      // Fields
+      //****************************************
+   public:
+      /// <summary>
+      /// Number of bits of the tick that index level 0
+      /// </summary>
+      static const int LEVEL0_BITS = 8;
+      /// <summary>
+      /// Number of bits of the tick that index each higher level
+      /// </summary>
+      static const int LEVEL_BITS = 6;
+      /// <summary>
+      /// Number of levels in the wheel
+      /// </summary>
+      static const int NUM_LEVELS = 4;
+   private:
+      struct Entry
+      {
+         uint64_t _expiryTick;
+         Callback _callback;
+      };
+      std::vector<std::vector<Entry>> _levels[NUM_LEVELS];
+      std::mutex _lock;
+      std::condition_variable _wakeup;
+      std::chrono::steady_clock::time_point _startTime;
+      /// <summary>
+      /// The last tick that has been processed
+      /// </summary>
+      uint64_t _currentTick;
+      /// <summary>
+      /// The tick the thread will next wake at; 0 if it is waiting for a callback to be scheduled
+      /// </summary>
+      uint64_t _wakeTick;
+      size_t _pendingCount;
+      int64_t _firedCount;
+      bool _shuttingDown;
+      std::thread _thread;
+
+      //****************************************
+      // Methods
+      //****************************************
+   public:
+      /// <summary>
+      /// Gets the process wide wheel
+      /// </summary>
+      COMMONUTILS_API static TimerWheel& Instance();
+      /// <summary>
+      /// Schedules callback to run on the wheel thread once delayMS has elapsed
+      /// </summary>
+      /// <param name="delayMS">Number of milliseconds to wait; 0 runs it on the next tick</param>
+      /// <param name="callback">The function to call</param>
+      COMMONUTILS_API void Schedule(uint32_t delayMS, Callback callback);
+      /// <summary>
+      /// Gets the number of callbacks that have not yet run
+      /// </summary>
+      COMMONUTILS_API size_t GetPendingCount();
+      /// <summary>
+      /// Gets the number of callbacks that have run
+      /// </summary>
+      COMMONUTILS_API int64_t GetFiredCount();
+      /// <summary>
+      /// Returns true if called from the wheel thread (i.e. from within a callback)
+      /// </summary>
+      bool IsWheelThread() const { return std::this_thread::get_id() == _thread.get_id(); }
+   private:
+      void Run();
+      uint64_t GetNowTick() const;
+      /// <summary>
+      /// Places entry in the slot for its expiry relative to _currentTick.  _lock must be held.
+      /// </summary>
+      /// <param name="entry">The entry to place</param>
+      /// <param name="minTick">The earliest tick the entry can be placed at</param>
+      void Insert(Entry&& entry, uint64_t minTick);
+      /// <summary>
+      /// Re-inserts every entry of a higher level slot.  _lock must be held.
+      /// </summary>
+      void Cascade(int level, size_t index);
+      /// <summary>
+      /// Moves _currentTick on by one, collecting the callbacks that expire.  _lock must be held.
+      /// </summary>
+      void Advance(std::vector<Callback>* pExpired);
+      /// <summary>
+      /// Gets the next tick with something to do: a level 0 callback or a cascade.  _lock must be held.
+      /// </summary>
+      uint64_t GetNextWakeTick() const;
+   };
+}
+}
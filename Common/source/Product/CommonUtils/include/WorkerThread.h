@@ -11,6 +11,7 @@
 #endif
 
 #include "../stdafx.h"
+#include "Completion.h"
 
 namespace Matrix
 {
@@ -58,9 +59,10 @@ namespace Common
       /// </summary>
       bool _shuttingDown;
       /// <summary>
-      /// The flag that should be set when shutdown has completed (or thread was never started)
+      /// The flag that should be set when shutdown has completed (or thread was never started);
+      /// setting it wakes WaitForShutdown
       /// </summary>
-      bool _shutdownComplete;
+      Completion _shutdownComplete;
       /// <summary>
       /// Name to use during logging
       /// </summary>
@@ -89,19 +91,15 @@ namespace Common
       /// </summary>
       COMMONUTILS_API virtual void ShutDown() { _shuttingDown = true; }
       /// <summary>
-      /// Waits up to retryTimes*msBetweenRetries milliseconds for IsShutdownComplete() to be true.
+      /// Waits up to retryTimes*msBetweenRetries milliseconds for IsShutdownComplete() to be true,
+      /// returning as soon as it is.
       /// </summary>
       /// <param name="retryTimes">Number of times to retry before giving up.</param>
       /// <param name="msBetweenRetries">Milliseconds to wait between retries.</param>
       ///<returns>true if shutdown was completed before returning</returns>
       COMMONUTILS_API virtual bool WaitForShutdown(int retryTimes = 40, int msBetweenRetries = 50) override
       {
-         while (!_shutdownComplete && retryTimes > 0)
-         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(msBetweenRetries));
-            retryTimes--;
-         }
-         return _shutdownComplete;
+         return _shutdownComplete.WaitFor(retryTimes * msBetweenRetries);
       }
       /// <summary>
       /// Gets the thread name (for logging and debugging)
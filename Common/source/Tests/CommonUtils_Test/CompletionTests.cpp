@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "Completion.h"
+#include "CountdownLatch.h"
+
+using namespace Matrix::Common;
+
+namespace
+{
+   int64_t GetElapsedMS(std::chrono::steady_clock::time_point start)
+   {
+      return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+   }
+}
+
+TEST(CompletionTest, WaitFor_SetFromOtherThread_WakesPromptly)
+{
+   //Setup
+   Completion completion;
+   auto start = std::chrono::steady_clock::now();
+   std::thread setter([&]()
+   {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      completion = true;
+   });
+
+   //Test
+   auto result = completion.WaitFor(5000);
+   auto elapsedMS = GetElapsedMS(start);
+   setter.join();
+
+   //Expectations
+   EXPECT_TRUE(result);
+   EXPECT_TRUE(completion);
+   //generous for a loaded machine; it is the 20ms the setter sleeps
+   EXPECT_GT(1000, elapsedMS);
+}
+
+TEST(CompletionTest, WaitFor_NotSet_TimesOut)
+{
+   //Setup
+   Completion completion;
+   auto start = std::chrono::steady_clock::now();
+
+   //Test
+   auto result = completion.WaitFor(30);
+
+   //Expectations
+   EXPECT_FALSE(result);
+   EXPECT_LE(30, GetElapsedMS(start));
+}
+
+TEST(CompletionTest, Set_False_Clears)
+{
+   //Setup
+   Completion completion(true);
+
+   //Test
+   completion = false;
+
+   //Expectations
+   EXPECT_FALSE(completion);
+   EXPECT_FALSE(completion.WaitFor(0));
+}
+
+TEST(CountdownLatchTest, WaitUntil_AllCountedDown_Wakes)
+{
+   //Setup
+   const size_t count = 4;
+   CountdownLatch latch(count);
+   std::vector<std::thread> threads;
+
+   //Test
+   for (size_t index = 0; index < count; index++)
+      threads.push_back(std::thread([&latch]() { latch.CountDown(); }));
+   auto result = latch.WaitUntil(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+   for (auto& thread : threads)
+      thread.join();
+
+   //Expectations
+   EXPECT_TRUE(result);
+   EXPECT_EQ((size_t)0, latch.GetCount());
+}
+
+TEST(CountdownLatchTest, WaitUntil_NotAllCountedDown_TimesOut)
+{
+   //Setup
+   CountdownLatch latch(2);
+   latch.CountDown();
+
+   //Test
+   auto result = latch.WaitUntil(std::chrono::steady_clock::now() + std::chrono::milliseconds(20));
+
+   //Expectations
+   EXPECT_FALSE(result);
+   EXPECT_EQ((size_t)1, latch.GetCount());
+}
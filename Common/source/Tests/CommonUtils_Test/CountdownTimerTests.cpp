@@ -1,102 +1,146 @@
-#include <gtest/gtest.h>
-#include <functional>
-#include "CountdownTimer.h"
-
+#include <gtest/gtest.h>
+#include <functional>
+#include <atomic>
+#include "CountdownTimer.h"
+
 using namespace Matrix::Common;
-
-class CountdownTimerTest : public testing::Test
-{
-protected:
-   CountdownTimer* mpTimer;
-   virtual void SetUp()
-   {
-      mpTimer = new CountdownTimer();
-   }
-   virtual void TearDown()
-   {
-      if (mpTimer)
-      {
-         delete mpTimer;
-      }
-   }
-};
-
-TEST_F(CountdownTimerTest, StartTimerCallsFunction)
-{
-   //Setup
-   int times = 0;
-
-   //Test
-   mpTimer->StartTimer(10, [&]() -> void { times++; });
-
-   //Expectations
-   std::this_thread::sleep_for(std::chrono::milliseconds(150));
-   mpTimer->StopAndWait(100);
-   EXPECT_LE(2, times);
-}
-
-TEST_F(CountdownTimerTest, StopStopsTimer)
-{
-   //Setup
-   bool timedout = false;
-   mpTimer->StartTimer(50, [&]() -> void { timedout = true; });
-
-   //Test
-   mpTimer->Stop();
-   std::this_thread::sleep_for(std::chrono::milliseconds(60));
-
-   //Expectations
-   EXPECT_FALSE(timedout);
-}
-TEST_F(CountdownTimerTest, StopAndWait_Waits)
-{
-   //Setup
-   mpTimer->StartTimer(100, [&]() -> void { std::this_thread::sleep_for(std::chrono::milliseconds(110)); });
-
-   //Test
-   std::this_thread::sleep_for(std::chrono::milliseconds(50));
-   mpTimer->StopAndWait(100);
-
-   //Expectations
-   EXPECT_TRUE(mpTimer->IsStopCompleted());
-}
-
-TEST_F(CountdownTimerTest, IsStopCompletedGetsSet)
-{
-   //Setup
-   bool timedout = false;
-   mpTimer->StartTimer(50, [&]() -> void { timedout = true; });
-
-   //Test
-   mpTimer->Stop();
-   std::this_thread::sleep_for(std::chrono::milliseconds(70));
-
-   //Expectations
-   EXPECT_TRUE(mpTimer->IsStopCompleted());
-}
-TEST_F(CountdownTimerTest, IsStopCompleted_IsNotSetTilComplete)
-{
-   //Setup
-   mpTimer->StartTimer(10, [&]() -> void { std::this_thread::sleep_for(std::chrono::milliseconds(300)); });
-
-   //Test
-   std::this_thread::sleep_for(std::chrono::milliseconds(100));
-   mpTimer->Stop();
-
-   //Expectations
-   EXPECT_FALSE(mpTimer->IsStopCompleted());
-}
-
-TEST_F(CountdownTimerTest, StartTimer_OnceOnly_CallsOnce)
-{
-   //Setup
-   int times = 0;
-
-   //Test
-   mpTimer->StartTimer(10, [&]() -> void { times++; }, true);
-
-   //Expectations
-   std::this_thread::sleep_for(std::chrono::milliseconds(150));
-   mpTimer->StopAndWait(100);
-   EXPECT_EQ(1, times);
-}
+
+class CountdownTimerTest : public testing::Test
+{
+protected:
+   CountdownTimer* mpTimer;
+   virtual void SetUp()
+   {
+      mpTimer = new CountdownTimer();
+   }
+   virtual void TearDown()
+   {
+      if (mpTimer)
+      {
+         delete mpTimer;
+      }
+   }
+};
+
+TEST_F(CountdownTimerTest, StartTimerCallsFunction)
+{
+   //Setup
+   int times = 0;
+
+   //Test
+   mpTimer->StartTimer(10, [&]() -> void { times++; });
+
+   //Expectations
+   std::this_thread::sleep_for(std::chrono::milliseconds(150));
+   mpTimer->StopAndWait(100);
+   EXPECT_LE(2, times);
+}
+
+TEST_F(CountdownTimerTest, StopStopsTimer)
+{
+   //Setup
+   bool timedout = false;
+   mpTimer->StartTimer(50, [&]() -> void { timedout = true; });
+
+   //Test
+   mpTimer->Stop();
+   std::this_thread::sleep_for(std::chrono::milliseconds(60));
+
+   //Expectations
+   EXPECT_FALSE(timedout);
+}
+TEST_F(CountdownTimerTest, StopAndWait_Waits)
+{
+   //Setup
+   mpTimer->StartTimer(100, [&]() -> void { std::this_thread::sleep_for(std::chrono::milliseconds(110)); });
+
+   //Test
+   std::this_thread::sleep_for(std::chrono::milliseconds(50));
+   mpTimer->StopAndWait(100);
+
+   //Expectations
+   EXPECT_TRUE(mpTimer->IsStopCompleted());
+}
+
+TEST_F(CountdownTimerTest, IsStopCompletedGetsSet)
+{
+   //Setup
+   bool timedout = false;
+   mpTimer->StartTimer(50, [&]() -> void { timedout = true; });
+
+   //Test
+   mpTimer->Stop();
+   std::this_thread::sleep_for(std::chrono::milliseconds(70));
+
+   //Expectations
+   EXPECT_TRUE(mpTimer->IsStopCompleted());
+}
+TEST_F(CountdownTimerTest, IsStopCompleted_IsNotSetTilComplete)
+{
+   //Setup
+   mpTimer->StartTimer(10, [&]() -> void { std::this_thread::sleep_for(std::chrono::milliseconds(300)); });
+
+   //Test
+   std::this_thread::sleep_for(std::chrono::milliseconds(100));
+   mpTimer->Stop();
+
+   //Expectations
+   EXPECT_FALSE(mpTimer->IsStopCompleted());
+}
+
+TEST_F(CountdownTimerTest, StartTimer_OnceOnly_CallsOnce)
+{
+   //Setup
+   int times = 0;
+
+   //Test
+   mpTimer->StartTimer(10, [&]() -> void { times++; }, true);
+
+   //Expectations
+   std::this_thread::sleep_for(std::chrono::milliseconds(150));
+   mpTimer->StopAndWait(100);
+   EXPECT_EQ(1, times);
+}
+
+TEST_F(CountdownTimerTest, StartTimer_Restart_OnlyCallsNewFunction)
+{
+   //Setup
+   int oldTimes = 0;
+   int newTimes = 0;
+   mpTimer->StartTimer(30, [&]() -> void { oldTimes++; }, true);
+
+   //Test
+   mpTimer->StartTimer(10, [&]() -> void { newTimes++; }, true);
+
+   //Expectations
+   std::this_thread::sleep_for(std::chrono::milliseconds(100));
+   mpTimer->StopAndWait(100);
+   EXPECT_EQ(0, oldTimes);
+   EXPECT_EQ(1, newTimes);
+}
+
+TEST_F(CountdownTimerTest, StopAndWait_FromOwnCallback_DoesNotWait)
+{
+   //Setup
+   std::atomic<int> times(0);
+   std::atomic<bool> done(false);
+   std::chrono::milliseconds elapsed(0);
+   mpTimer->StartTimer(10, [&]() -> void
+   {
+      auto start = std::chrono::steady_clock::now();
+      mpTimer->StopAndWait(1000);
+      elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+      times++;
+      done = true;
+   });
+
+   //Test
+   //waits past the 10 seconds the callback would block for if StopAndWait waited on itself
+   for (int retry = 0; retry < 1100 && !done; retry++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+   //Expectations
+   EXPECT_EQ(1, times);
+   EXPECT_GT(100, (int)elapsed.count());
+}
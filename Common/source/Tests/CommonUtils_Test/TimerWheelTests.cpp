@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "TimerWheel.h"
+
+using namespace Matrix::Common;
+
+namespace
+{
+   //waits up to timeoutMS for condition to become true
+   template<class Condition>
+   bool WaitFor(Condition condition, int timeoutMS)
+   {
+      for (int waited = 0; waited < timeoutMS && !condition(); waited += 5)
+         std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      return condition();
+   }
+}
+
+TEST(TimerWheelTest, Schedule_CallsAfterDelay)
+{
+   //Setup
+   TimerWheel wheel;
+   std::atomic<bool> called(false);
+   auto start = std::chrono::steady_clock::now();
+   std::chrono::steady_clock::time_point calledAt;
+
+   //Test
+   wheel.Schedule(30, [&]() -> void { calledAt = std::chrono::steady_clock::now(); called = true; });
+
+   //Expectations
+   ASSERT_TRUE(WaitFor([&]() { return (bool)called; }, 1000));
+   EXPECT_LE(30, (int)std::chrono::duration_cast<std::chrono::milliseconds>(calledAt - start).count());
+   EXPECT_EQ(0u, wheel.GetPendingCount());
+   EXPECT_EQ(1, wheel.GetFiredCount());
+}
+
+TEST(TimerWheelTest, Schedule_CallsInDelayOrder)
+{
+   //Setup
+   TimerWheel wheel;
+   std::mutex lock;
+   std::vector<int> order;
+
+   //Test
+   for (int delay : { 40, 10, 30, 0, 20 })
+   {
+      wheel.Schedule(delay, [&lock, &order, delay]() -> void
+      {
+         std::lock_guard<std::mutex> guard(lock);
+         order.push_back(delay);
+      });
+   }
+
+   //Expectations
+   ASSERT_TRUE(WaitFor([&]() { return wheel.GetFiredCount() == 5; }, 1000));
+   EXPECT_EQ(std::vector<int>({ 0, 10, 20, 30, 40 }), order);
+}
+
+// Tests that a delay beyond level 0 is cascaded down and still fires on time
+TEST(TimerWheelTest, Schedule_BeyondFirstLevel_Cascades)
+{
+   //Setup
+   TimerWheel wheel;
+   std::atomic<bool> called(false);
+   auto start = std::chrono::steady_clock::now();
+   std::chrono::steady_clock::time_point calledAt;
+
+   //Test
+   wheel.Schedule(300, [&]() -> void { calledAt = std::chrono::steady_clock::now(); called = true; });
+
+   //Expectations
+   ASSERT_TRUE(WaitFor([&]() { return (bool)called; }, 2000));
+   auto elapsedMS = (int)std::chrono::duration_cast<std::chrono::milliseconds>(calledAt - start).count();
+   EXPECT_LE(300, elapsedMS);
+   EXPECT_GT(400, elapsedMS);
+}
+
+TEST(TimerWheelTest, Schedule_ManyTimers_AllFire)
+{
+   //Setup
+   TimerWheel wheel;
+   std::atomic<int> calls(0);
+   const int numTimers = 10000;
+
+   //Test
+   for (int index = 0; index < numTimers; index++)
+      wheel.Schedule(index % 500, [&calls]() -> void { calls++; });
+
+   //Expectations
+   ASSERT_TRUE(WaitFor([&]() { return calls == numTimers; }, 3000));
+   EXPECT_EQ(0u, wheel.GetPendingCount());
+}
+
+TEST(TimerWheelTest, Destroy_DiscardsPending)
+{
+   //Setup
+   std::atomic<bool> called(false);
+   {
+      TimerWheel wheel;
+      wheel.Schedule(50, [&]() -> void { called = true; });
+      EXPECT_EQ(1u, wheel.GetPendingCount());
+   }
+
+   //Test
+   std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+   //Expectations
+   EXPECT_FALSE(called);
+}
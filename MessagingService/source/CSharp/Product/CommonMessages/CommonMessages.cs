@@ -25,23 +25,24 @@ namespace Matrix.MsgService.CommonMessages {
       byte[] descriptorData = global::System.Convert.FromBase64String(
           string.Concat(
             "ChRDb21tb25NZXNzYWdlcy5wcm90bxIgTWF0cml4Lk1zZ1NlcnZpY2UuQ29t",
-            "bW9uTWVzc2FnZXMiiAIKBkhlYWRlchI8Cgltc2dUeXBlSUQYASABKA4yKS5N",
+            "bW9uTWVzc2FnZXMisAIKBkhlYWRlchI8Cgltc2dUeXBlSUQYASABKA4yKS5N",
             "YXRyaXguTXNnU2VydmljZS5Db21tb25NZXNzYWdlcy5Nc2dUeXBlEg4KBm1z",
             "Z0tleRgCIAEoBRIWCg5vcmlnQ2xpZW50VHlwZRgDIAEoBRIUCgxvcmlnQ2xp",
             "ZW50SUQYBCABKAUSFgoOZGVzdENsaWVudFR5cGUYBSABKAUSFAoMZGVzdENs",
             "aWVudElEGAYgASgFEg8KB2Fja0tleXMYByADKAUSDQoFdG9waWMYCCABKAUS",
-            "EgoKaXNBcmNoaXZlZBgJIAEoCBITCgtyZXBseU1zZ0tleRgKIAEoBRILCgNt",
-            "c2cYDyABKAwiLgoLTmFja0RldGFpbHMSDgoGcmVhc29uGAEgASgFEg8KB2Rl",
-            "dGFpbHMYAiABKAkiLQoFTG9nb24SEgoKY2xpZW50VHlwZRgBIAEoBRIQCghj",
-            "bGllbnRJRBgCIAEoBSJACglTdWJzY3JpYmUSEgoKY2xpZW50VHlwZRgBIAEo",
-            "BRIQCghjbGllbnRJRBgCIAEoBRINCgV0b3BpYxgDIAEoBSp1CgdNc2dUeXBl",
-            "EhQKEElOVkFMSURfTVNHX1RZUEUQABIHCgNBQ0sQARIJCgVMT0dPThACEgoK",
-            "BkxPR09GRhADEg0KCVNVQlNDUklCRRAEEg8KC1VOU1VCU0NSSUJFEAUSCAoE",
-            "TkFDSxAGEgoKBkNVU1RPTRBkQgJIA2IGcHJvdG8z"));
+            "EgoKaXNBcmNoaXZlZBgJIAEoCBITCgtyZXBseU1zZ0tleRgKIAEoBRIQCghw",
+            "cmlvcml0eRgLIAEoBRIUCgxhY2tLZXlSYW5nZXMYDCADKAUSCwoDbXNnGA8g",
+            "ASgMIi4KC05hY2tEZXRhaWxzEg4KBnJlYXNvbhgBIAEoBRIPCgdkZXRhaWxz",
+            "GAIgASgJIi0KBUxvZ29uEhIKCmNsaWVudFR5cGUYASABKAUSEAoIY2xpZW50",
+            "SUQYAiABKAUiQAoJU3Vic2NyaWJlEhIKCmNsaWVudFR5cGUYASABKAUSEAoI",
+            "Y2xpZW50SUQYAiABKAUSDQoFdG9waWMYAyABKAUqdQoHTXNnVHlwZRIUChBJ",
+            "TlZBTElEX01TR19UWVBFEAASBwoDQUNLEAESCQoFTE9HT04QAhIKCgZMT0dP",
+            "RkYQAxINCglTVUJTQ1JJQkUQBBIPCgtVTlNVQlNDUklCRRAFEggKBE5BQ0sQ",
+            "BhIKCgZDVVNUT00QZEIFSAP4AQFiBnByb3RvMw=="));
       descriptor = pbr::FileDescriptor.FromGeneratedCode(descriptorData,
           new pbr::FileDescriptor[] { },
           new pbr::GeneratedClrTypeInfo(new[] {typeof(global::Matrix.MsgService.CommonMessages.MsgType), }, null, new pbr::GeneratedClrTypeInfo[] {
-            new pbr::GeneratedClrTypeInfo(typeof(global::Matrix.MsgService.CommonMessages.Header), global::Matrix.MsgService.CommonMessages.Header.Parser, new[]{ "MsgTypeID", "MsgKey", "OrigClientType", "OrigClientID", "DestClientType", "DestClientID", "AckKeys", "Topic", "IsArchived", "ReplyMsgKey", "Msg" }, null, null, null, null),
+            new pbr::GeneratedClrTypeInfo(typeof(global::Matrix.MsgService.CommonMessages.Header), global::Matrix.MsgService.CommonMessages.Header.Parser, new[]{ "MsgTypeID", "MsgKey", "OrigClientType", "OrigClientID", "DestClientType", "DestClientID", "AckKeys", "Topic", "IsArchived", "ReplyMsgKey", "Priority", "AckKeyRanges", "Msg" }, null, null, null, null),
             new pbr::GeneratedClrTypeInfo(typeof(global::Matrix.MsgService.CommonMessages.NackDetails), global::Matrix.MsgService.CommonMessages.NackDetails.Parser, new[]{ "Reason", "Details" }, null, null, null, null),
             new pbr::GeneratedClrTypeInfo(typeof(global::Matrix.MsgService.CommonMessages.Logon), global::Matrix.MsgService.CommonMessages.Logon.Parser, new[]{ "ClientType", "ClientID" }, null, null, null, null),
             new pbr::GeneratedClrTypeInfo(typeof(global::Matrix.MsgService.CommonMessages.Subscribe), global::Matrix.MsgService.CommonMessages.Subscribe.Parser, new[]{ "ClientType", "ClientID", "Topic" }, null, null, null, null)
@@ -118,6 +119,8 @@ namespace Matrix.MsgService.CommonMessages {
       topic_ = other.topic_;
       isArchived_ = other.isArchived_;
       replyMsgKey_ = other.replyMsgKey_;
+      priority_ = other.priority_;
+      ackKeyRanges_ = other.ackKeyRanges_.Clone();
       msg_ = other.msg_;
       _unknownFields = pb::UnknownFieldSet.Clone(other._unknownFields);
     }
@@ -260,6 +263,33 @@ namespace Matrix.MsgService.CommonMessages {
       }
     }
 
+    /// <summary>Field number for the "priority" field.</summary>
+    public const int PriorityFieldNumber = 11;
+    private int priority_;
+    /// <summary>
+    ///0 for normal; a CUSTOM message with a priority above 0 is sent ahead of normal CUSTOM messages
+    /// </summary>
+    [global::System.Diagnostics.DebuggerNonUserCodeAttribute]
+    public int Priority {
+      get { return priority_; }
+      set {
+        priority_ = value;
+      }
+    }
+
+    /// <summary>Field number for the "ackKeyRanges" field.</summary>
+    public const int AckKeyRangesFieldNumber = 12;
+    private static readonly pb::FieldCodec<int> _repeated_ackKeyRanges_codec
+        = pb::FieldCodec.ForInt32(98);
+    private readonly pbc::RepeatedField<int> ackKeyRanges_ = new pbc::RepeatedField<int>();
+    /// <summary>
+    ///first and last key of each run of consecutive keys that this message is acking, in pairs
+    /// </summary>
+    [global::System.Diagnostics.DebuggerNonUserCodeAttribute]
+    public pbc::RepeatedField<int> AckKeyRanges {
+      get { return ackKeyRanges_; }
+    }
+
     /// <summary>Field number for the "msg" field.</summary>
     public const int MsgFieldNumber = 15;
     private pb::ByteString msg_ = pb::ByteString.Empty;
@@ -294,6 +324,8 @@ namespace Matrix.MsgService.CommonMessages {
       if (Topic != other.Topic) return false;
       if (IsArchived != other.IsArchived) return false;
       if (ReplyMsgKey != other.ReplyMsgKey) return false;
+      if (Priority != other.Priority) return false;
+      if(!ackKeyRanges_.Equals(other.ackKeyRanges_)) return false;
       if (Msg != other.Msg) return false;
       return Equals(_unknownFields, other._unknownFields);
     }
@@ -311,6 +343,8 @@ namespace Matrix.MsgService.CommonMessages {
       if (Topic != 0) hash ^= Topic.GetHashCode();
       if (IsArchived != false) hash ^= IsArchived.GetHashCode();
       if (ReplyMsgKey != 0) hash ^= ReplyMsgKey.GetHashCode();
+      if (Priority != 0) hash ^= Priority.GetHashCode();
+      hash ^= ackKeyRanges_.GetHashCode();
       if (Msg.Length != 0) hash ^= Msg.GetHashCode();
       if (_unknownFields != null) {
         hash ^= _unknownFields.GetHashCode();
@@ -365,6 +399,11 @@ namespace Matrix.MsgService.CommonMessages {
         output.WriteRawTag(80);
         output.WriteInt32(ReplyMsgKey);
       }
+      if (Priority != 0) {
+        output.WriteRawTag(88);
+        output.WriteInt32(Priority);
+      }
+      ackKeyRanges_.WriteTo(output, _repeated_ackKeyRanges_codec);
       if (Msg.Length != 0) {
         output.WriteRawTag(122);
         output.WriteBytes(Msg);
@@ -415,6 +454,11 @@ namespace Matrix.MsgService.CommonMessages {
         output.WriteRawTag(80);
         output.WriteInt32(ReplyMsgKey);
       }
+      if (Priority != 0) {
+        output.WriteRawTag(88);
+        output.WriteInt32(Priority);
+      }
+      ackKeyRanges_.WriteTo(ref output, _repeated_ackKeyRanges_codec);
       if (Msg.Length != 0) {
         output.WriteRawTag(122);
         output.WriteBytes(Msg);
@@ -456,6 +500,10 @@ namespace Matrix.MsgService.CommonMessages {
       if (ReplyMsgKey != 0) {
         size += 1 + pb::CodedOutputStream.ComputeInt32Size(ReplyMsgKey);
       }
+      if (Priority != 0) {
+        size += 1 + pb::CodedOutputStream.ComputeInt32Size(Priority);
+      }
+      size += ackKeyRanges_.CalculateSize(_repeated_ackKeyRanges_codec);
       if (Msg.Length != 0) {
         size += 1 + pb::CodedOutputStream.ComputeBytesSize(Msg);
       }
@@ -498,6 +546,10 @@ namespace Matrix.MsgService.CommonMessages {
       if (other.ReplyMsgKey != 0) {
         ReplyMsgKey = other.ReplyMsgKey;
       }
+      if (other.Priority != 0) {
+        Priority = other.Priority;
+      }
+      ackKeyRanges_.Add(other.ackKeyRanges_);
       if (other.Msg.Length != 0) {
         Msg = other.Msg;
       }
@@ -556,6 +608,15 @@ namespace Matrix.MsgService.CommonMessages {
             ReplyMsgKey = input.ReadInt32();
             break;
           }
+          case 88: {
+            Priority = input.ReadInt32();
+            break;
+          }
+          case 98:
+          case 96: {
+            ackKeyRanges_.AddEntriesFrom(input, _repeated_ackKeyRanges_codec);
+            break;
+          }
           case 122: {
             Msg = input.ReadBytes();
             break;
@@ -615,6 +676,15 @@ namespace Matrix.MsgService.CommonMessages {
             ReplyMsgKey = input.ReadInt32();
             break;
           }
+          case 88: {
+            Priority = input.ReadInt32();
+            break;
+          }
+          case 98:
+          case 96: {
+            ackKeyRanges_.AddEntriesFrom(ref input, _repeated_ackKeyRanges_codec);
+            break;
+          }
           case 122: {
             Msg = input.ReadBytes();
             break;
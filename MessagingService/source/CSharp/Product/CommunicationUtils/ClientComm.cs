@@ -297,6 +297,10 @@ namespace Matrix.MsgService.CommunicationUtils
       /// Default maximum time to wait before timing out
       /// </summary>
       public const int DEFAULT_WAITTIME = 5000;
+      /// <summary>
+      /// Received ack key ranges covering more keys than this are ignored
+      /// </summary>
+      public const int MAX_ACK_RANGE_SIZE = 65536;
 		#endregion
 
 		#region fields
@@ -1179,7 +1183,7 @@ namespace Matrix.MsgService.CommunicationUtils
                   //if we are tracking
                   if (_msgStore != null)
                   {
-                     foreach (var ack in msg.AckKeys)
+                     foreach (var ack in GetAckedKeys(msg))
                      {
                         _msgStore.RemoveMessage(ack);
                      }
@@ -1211,7 +1215,7 @@ namespace Matrix.MsgService.CommunicationUtils
                      }
                      if (msg.AckKeys != null)
                      {
-                        foreach (var key in msg.AckKeys)
+                        foreach (var key in GetAckedKeys(msg))
                         {
                            HandleReceivedMessage(key, msg, true);
                         }
@@ -1224,6 +1228,24 @@ namespace Matrix.MsgService.CommunicationUtils
             }
          }
       }
+      /// <summary>
+      /// Gets every key acked by msg - its AckKeys followed by the keys of its AckKeyRanges.
+      /// An inverted or oversized range is ignored.
+      /// </summary>
+      static IEnumerable<int> GetAckedKeys(Header msg)
+      {
+         foreach (var key in msg.AckKeys)
+            yield return key;
+         for (int index = 0; index + 1 < msg.AckKeyRanges.Count; index += 2)
+         {
+            long first = msg.AckKeyRanges[index];
+            long last = msg.AckKeyRanges[index + 1];
+            if (last < first || last - first >= MAX_ACK_RANGE_SIZE)
+               continue;
+            for (var key = first; key <= last; key++)
+               yield return (int)key;
+         }
+      }
       bool HandleReceivedMessage(int msgKey, Header rxMsg, bool ackReceived)
       {
          IClientContext clientContext;
@@ -0,0 +1,111 @@
+#include "BufferPool.h"
+#include "Message.h"
+#include <stdlib.h>
+
+using namespace Matrix::MsgService::CommonMessages;
+
+void PooledBuffer::Release()
+{
+   if (_pData != nullptr)
+   {
+      BufferPool::Instance().Release(_pData, _capacity, _sizeClass);
+      _pData = nullptr;
+      _capacity = 0;
+      _sizeClass = -1;
+   }
+}
+
+BufferPool::BufferPool()
+   : _bytesInUse(0)
+   , _bytesCached(0)
+{
+   size_t size = MIN_BUFFER_SIZE;
+   for (int index = 0; index < NUM_SIZE_CLASSES - 1; index++)
+   {
+      _sizeClasses[index].bufferSize = size;
+      size *= 4;
+   }
+   _sizeClasses[NUM_SIZE_CLASSES - 1].bufferSize = HDR_SIZE + MAX_MESSAGE_SIZE;
+}
+
+BufferPool& BufferPool::Instance()
+{
+   //never destroyed so buffers released during static destruction are still safe
+   static BufferPool* pInstance = new BufferPool();
+   return *pInstance;
+}
+
+size_t BufferPool::GetClassSize(int sizeClass) const
+{
+   if (sizeClass < 0 || sizeClass >= NUM_SIZE_CLASSES)
+      return 0;
+   return _sizeClasses[sizeClass].bufferSize;
+}
+
+int BufferPool::GetSizeClass(size_t size) const
+{
+   for (int index = 0; index < NUM_SIZE_CLASSES; index++)
+   {
+      if (size <= _sizeClasses[index].bufferSize)
+         return index;
+   }
+   return -1;
+}
+
+PooledBuffer BufferPool::Acquire(size_t size)
+{
+   auto sizeClass = GetSizeClass(size);
+   char* pData = nullptr;
+   size_t capacity = size;
+   if (sizeClass >= 0)
+   {
+      auto& entry = _sizeClasses[sizeClass];
+      capacity = entry.bufferSize;
+      std::lock_guard<std::mutex> lock(entry.lock);
+      if (!entry.freeList.empty())
+      {
+         pData = entry.freeList.back();
+         entry.freeList.pop_back();
+         _bytesCached -= capacity;
+      }
+   }
+   if (pData == nullptr)
+      pData = (char*)malloc(capacity);
+   if (pData == nullptr)
+      return PooledBuffer();
+   _bytesInUse += capacity;
+   return PooledBuffer(pData, capacity, sizeClass);
+}
+
+void BufferPool::Release(char* pData, size_t capacity, int sizeClass)
+{
+   if (pData == nullptr)
+      return;
+   _bytesInUse -= capacity;
+   if (sizeClass >= 0 && sizeClass < NUM_SIZE_CLASSES)
+   {
+      auto& entry = _sizeClasses[sizeClass];
+      std::lock_guard<std::mutex> lock(entry.lock);
+      if ((entry.freeList.size() + 1) * entry.bufferSize <= MAX_CACHED_BYTES_PER_CLASS)
+      {
+         entry.freeList.push_back(pData);
+         _bytesCached += capacity;
+         return;
+      }
+   }
+   free(pData);
+}
+
+void BufferPool::Trim()
+{
+   for (auto& entry : _sizeClasses)
+   {
+      std::lock_guard<std::mutex> lock(entry.lock);
+      for (auto pData : entry.freeList)
+      {
+         _bytesCached -= entry.bufferSize;
+         free(pData);
+      }
+      entry.freeList.clear();
+   }
+}
@@ -24,6 +24,8 @@ constexpr Header::Header(
   ::PROTOBUF_NAMESPACE_ID::internal::ConstantInitialized)
   : ackkeys_()
   , _ackkeys_cached_byte_size_()
+  , ackkeyranges_()
+  , _ackkeyranges_cached_byte_size_()
   , msg_(&::PROTOBUF_NAMESPACE_ID::internal::fixed_address_empty_string)
   , msgtypeid_(0)
 
@@ -34,7 +36,8 @@ constexpr Header::Header(
   , destclientid_(0)
   , topic_(0)
   , isarchived_(false)
-  , replymsgkey_(0){}
+  , replymsgkey_(0)
+  , priority_(0){}
 struct HeaderDefaultTypeInternal {
   constexpr HeaderDefaultTypeInternal()
     : _instance(::PROTOBUF_NAMESPACE_ID::internal::ConstantInitialized{}) {}
@@ -174,14 +177,16 @@ class Header::_Internal {
 
 Header::Header(::PROTOBUF_NAMESPACE_ID::Arena* arena)
   : ::PROTOBUF_NAMESPACE_ID::MessageLite(arena),
-  ackkeys_(arena) {
+  ackkeys_(arena),
+  ackkeyranges_(arena) {
   SharedCtor();
   RegisterArenaDtor(arena);
   // @@protoc_insertion_point(arena_constructor:Matrix.MsgService.CommonMessages.Header)
 }
 Header::Header(const Header& from)
   : ::PROTOBUF_NAMESPACE_ID::MessageLite(),
-      ackkeys_(from.ackkeys_) {
+      ackkeys_(from.ackkeys_),
+      ackkeyranges_(from.ackkeyranges_) {
   _internal_metadata_.MergeFrom<std::string>(from._internal_metadata_);
   msg_.UnsafeSetDefault(&::PROTOBUF_NAMESPACE_ID::internal::GetEmptyStringAlreadyInited());
   if (!from._internal_msg().empty()) {
@@ -189,8 +194,8 @@ Header::Header(const Header& from)
       GetArena());
   }
   ::memcpy(&msgtypeid_, &from.msgtypeid_,
-    static_cast<size_t>(reinterpret_cast<char*>(&replymsgkey_) -
-    reinterpret_cast<char*>(&msgtypeid_)) + sizeof(replymsgkey_));
+    static_cast<size_t>(reinterpret_cast<char*>(&priority_) -
+    reinterpret_cast<char*>(&msgtypeid_)) + sizeof(priority_));
   // @@protoc_insertion_point(copy_constructor:Matrix.MsgService.CommonMessages.Header)
 }
 
@@ -198,8 +203,8 @@ void Header::SharedCtor() {
 msg_.UnsafeSetDefault(&::PROTOBUF_NAMESPACE_ID::internal::GetEmptyStringAlreadyInited());
 ::memset(reinterpret_cast<char*>(this) + static_cast<size_t>(
     reinterpret_cast<char*>(&msgtypeid_) - reinterpret_cast<char*>(this)),
-    0, static_cast<size_t>(reinterpret_cast<char*>(&replymsgkey_) -
-    reinterpret_cast<char*>(&msgtypeid_)) + sizeof(replymsgkey_));
+    0, static_cast<size_t>(reinterpret_cast<char*>(&priority_) -
+    reinterpret_cast<char*>(&msgtypeid_)) + sizeof(priority_));
 }
 
 Header::~Header() {
@@ -230,10 +235,11 @@ void Header::Clear() {
   (void) cached_has_bits;
 
   ackkeys_.Clear();
+  ackkeyranges_.Clear();
   msg_.ClearToEmpty();
   ::memset(&msgtypeid_, 0, static_cast<size_t>(
-      reinterpret_cast<char*>(&replymsgkey_) -
-      reinterpret_cast<char*>(&msgtypeid_)) + sizeof(replymsgkey_));
+      reinterpret_cast<char*>(&priority_) -
+      reinterpret_cast<char*>(&msgtypeid_)) + sizeof(priority_));
   _internal_metadata_.Clear<std::string>();
 }
 
@@ -318,6 +324,23 @@ const char* Header::_InternalParse(const char* ptr, ::PROTOBUF_NAMESPACE_ID::int
           CHK_(ptr);
         } else goto handle_unusual;
         continue;
+      // int32 priority = 11;
+      case 11:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<::PROTOBUF_NAMESPACE_ID::uint8>(tag) == 88)) {
+          priority_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint64(&ptr);
+          CHK_(ptr);
+        } else goto handle_unusual;
+        continue;
+      // repeated int32 ackKeyRanges = 12;
+      case 12:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<::PROTOBUF_NAMESPACE_ID::uint8>(tag) == 98)) {
+          ptr = ::PROTOBUF_NAMESPACE_ID::internal::PackedInt32Parser(_internal_mutable_ackkeyranges(), ptr, ctx);
+          CHK_(ptr);
+        } else if (static_cast<::PROTOBUF_NAMESPACE_ID::uint8>(tag) == 96) {
+          _internal_add_ackkeyranges(::PROTOBUF_NAMESPACE_ID::internal::ReadVarint64(&ptr));
+          CHK_(ptr);
+        } else goto handle_unusual;
+        continue;
       // bytes msg = 15;
       case 15:
         if (PROTOBUF_PREDICT_TRUE(static_cast<::PROTOBUF_NAMESPACE_ID::uint8>(tag) == 122)) {
@@ -418,6 +441,21 @@ failure:
     target = ::PROTOBUF_NAMESPACE_ID::internal::WireFormatLite::WriteInt32ToArray(10, this->_internal_replymsgkey(), target);
   }
 
+  // int32 priority = 11;
+  if (this->priority() != 0) {
+    target = stream->EnsureSpace(target);
+    target = ::PROTOBUF_NAMESPACE_ID::internal::WireFormatLite::WriteInt32ToArray(11, this->_internal_priority(), target);
+  }
+
+  // repeated int32 ackKeyRanges = 12;
+  {
+    int byte_size = _ackkeyranges_cached_byte_size_.load(std::memory_order_relaxed);
+    if (byte_size > 0) {
+      target = stream->WriteInt32Packed(
+          12, _internal_ackkeyranges(), byte_size, target);
+    }
+  }
+
   // bytes msg = 15;
   if (this->msg().size() > 0) {
     target = stream->WriteBytesMaybeAliased(
@@ -455,6 +493,21 @@ size_t Header::ByteSizeLong() const {
     total_size += data_size;
   }
 
+  // repeated int32 ackKeyRanges = 12;
+  {
+    size_t data_size = ::PROTOBUF_NAMESPACE_ID::internal::WireFormatLite::
+      Int32Size(this->ackkeyranges_);
+    if (data_size > 0) {
+      total_size += 1 +
+        ::PROTOBUF_NAMESPACE_ID::internal::WireFormatLite::Int32Size(
+            static_cast<::PROTOBUF_NAMESPACE_ID::int32>(data_size));
+    }
+    int cached_size = ::PROTOBUF_NAMESPACE_ID::internal::ToCachedSize(data_size);
+    _ackkeyranges_cached_byte_size_.store(cached_size,
+                                    std::memory_order_relaxed);
+    total_size += data_size;
+  }
+
   // bytes msg = 15;
   if (this->msg().size() > 0) {
     total_size += 1 +
@@ -522,6 +575,13 @@ size_t Header::ByteSizeLong() const {
         this->_internal_replymsgkey());
   }
 
+  // int32 priority = 11;
+  if (this->priority() != 0) {
+    total_size += 1 +
+      ::PROTOBUF_NAMESPACE_ID::internal::WireFormatLite::Int32Size(
+        this->_internal_priority());
+  }
+
   if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
     total_size += _internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).size();
   }
@@ -544,6 +604,7 @@ void Header::MergeFrom(const Header& from) {
   (void) cached_has_bits;
 
   ackkeys_.MergeFrom(from.ackkeys_);
+  ackkeyranges_.MergeFrom(from.ackkeyranges_);
   if (from.msg().size() > 0) {
     _internal_set_msg(from._internal_msg());
   }
@@ -574,6 +635,9 @@ void Header::MergeFrom(const Header& from) {
   if (from.replymsgkey() != 0) {
     _internal_set_replymsgkey(from._internal_replymsgkey());
   }
+  if (from.priority() != 0) {
+    _internal_set_priority(from._internal_priority());
+  }
 }
 
 void Header::CopyFrom(const Header& from) {
@@ -591,10 +655,11 @@ void Header::InternalSwap(Header* other) {
   using std::swap;
   _internal_metadata_.Swap<std::string>(&other->_internal_metadata_);
   ackkeys_.InternalSwap(&other->ackkeys_);
+  ackkeyranges_.InternalSwap(&other->ackkeyranges_);
   msg_.Swap(&other->msg_, &::PROTOBUF_NAMESPACE_ID::internal::GetEmptyStringAlreadyInited(), GetArena());
   ::PROTOBUF_NAMESPACE_ID::internal::memswap<
-      PROTOBUF_FIELD_OFFSET(Header, replymsgkey_)
-      + sizeof(Header::replymsgkey_)
+      PROTOBUF_FIELD_OFFSET(Header, priority_)
+      + sizeof(Header::priority_)
       - PROTOBUF_FIELD_OFFSET(Header, msgtypeid_)>(
           reinterpret_cast<char*>(&msgtypeid_),
           reinterpret_cast<char*>(&other->msgtypeid_));
@@ -213,6 +213,7 @@ class COMMONMESSAGES_API Header PROTOBUF_FINAL :
 
   enum : int {
     kAckKeysFieldNumber = 7,
+    kAckKeyRangesFieldNumber = 12,
     kMsgFieldNumber = 15,
     kMsgTypeIDFieldNumber = 1,
     kMsgKeyFieldNumber = 2,
@@ -223,6 +224,7 @@ class COMMONMESSAGES_API Header PROTOBUF_FINAL :
     kTopicFieldNumber = 8,
     kIsArchivedFieldNumber = 9,
     kReplyMsgKeyFieldNumber = 10,
+    kPriorityFieldNumber = 11,
   };
   // repeated int32 ackKeys = 7;
   int ackkeys_size() const;
@@ -246,6 +248,28 @@ class COMMONMESSAGES_API Header PROTOBUF_FINAL :
   ::PROTOBUF_NAMESPACE_ID::RepeatedField< ::PROTOBUF_NAMESPACE_ID::int32 >*
       mutable_ackkeys();
 
+  // repeated int32 ackKeyRanges = 12;
+  int ackkeyranges_size() const;
+  private:
+  int _internal_ackkeyranges_size() const;
+  public:
+  void clear_ackkeyranges();
+  private:
+  ::PROTOBUF_NAMESPACE_ID::int32 _internal_ackkeyranges(int index) const;
+  const ::PROTOBUF_NAMESPACE_ID::RepeatedField< ::PROTOBUF_NAMESPACE_ID::int32 >&
+      _internal_ackkeyranges() const;
+  void _internal_add_ackkeyranges(::PROTOBUF_NAMESPACE_ID::int32 value);
+  ::PROTOBUF_NAMESPACE_ID::RepeatedField< ::PROTOBUF_NAMESPACE_ID::int32 >*
+      _internal_mutable_ackkeyranges();
+  public:
+  ::PROTOBUF_NAMESPACE_ID::int32 ackkeyranges(int index) const;
+  void set_ackkeyranges(int index, ::PROTOBUF_NAMESPACE_ID::int32 value);
+  void add_ackkeyranges(::PROTOBUF_NAMESPACE_ID::int32 value);
+  const ::PROTOBUF_NAMESPACE_ID::RepeatedField< ::PROTOBUF_NAMESPACE_ID::int32 >&
+      ackkeyranges() const;
+  ::PROTOBUF_NAMESPACE_ID::RepeatedField< ::PROTOBUF_NAMESPACE_ID::int32 >*
+      mutable_ackkeyranges();
+
   // bytes msg = 15;
   void clear_msg();
   const std::string& msg() const;
@@ -343,6 +367,15 @@ class COMMONMESSAGES_API Header PROTOBUF_FINAL :
   void _internal_set_replymsgkey(::PROTOBUF_NAMESPACE_ID::int32 value);
   public:
 
+  // int32 priority = 11;
+  void clear_priority();
+  ::PROTOBUF_NAMESPACE_ID::int32 priority() const;
+  void set_priority(::PROTOBUF_NAMESPACE_ID::int32 value);
+  private:
+  ::PROTOBUF_NAMESPACE_ID::int32 _internal_priority() const;
+  void _internal_set_priority(::PROTOBUF_NAMESPACE_ID::int32 value);
+  public:
+
   // @@protoc_insertion_point(class_scope:Matrix.MsgService.CommonMessages.Header)
  private:
   class _Internal;
@@ -352,6 +385,8 @@ class COMMONMESSAGES_API Header PROTOBUF_FINAL :
   typedef void DestructorSkippable_;
   ::PROTOBUF_NAMESPACE_ID::RepeatedField< ::PROTOBUF_NAMESPACE_ID::int32 > ackkeys_;
   mutable std::atomic<int> _ackkeys_cached_byte_size_;
+  ::PROTOBUF_NAMESPACE_ID::RepeatedField< ::PROTOBUF_NAMESPACE_ID::int32 > ackkeyranges_;
+  mutable std::atomic<int> _ackkeyranges_cached_byte_size_;
   ::PROTOBUF_NAMESPACE_ID::internal::ArenaStringPtr msg_;
   int msgtypeid_;
   ::PROTOBUF_NAMESPACE_ID::int32 msgkey_;
@@ -362,6 +397,7 @@ class COMMONMESSAGES_API Header PROTOBUF_FINAL :
   ::PROTOBUF_NAMESPACE_ID::int32 topic_;
   bool isarchived_;
   ::PROTOBUF_NAMESPACE_ID::int32 replymsgkey_;
+  ::PROTOBUF_NAMESPACE_ID::int32 priority_;
   mutable ::PROTOBUF_NAMESPACE_ID::internal::CachedSize _cached_size_;
   friend struct ::TableStruct_CommonMessages_2eproto;
 };
@@ -1023,6 +1059,73 @@ inline void Header::set_replymsgkey(::PROTOBUF_NAMESPACE_ID::int32 value) {
   // @@protoc_insertion_point(field_set:Matrix.MsgService.CommonMessages.Header.replyMsgKey)
 }
 
+// int32 priority = 11;
+inline void Header::clear_priority() {
+  priority_ = 0;
+}
+inline ::PROTOBUF_NAMESPACE_ID::int32 Header::_internal_priority() const {
+  return priority_;
+}
+inline ::PROTOBUF_NAMESPACE_ID::int32 Header::priority() const {
+  // @@protoc_insertion_point(field_get:Matrix.MsgService.CommonMessages.Header.priority)
+  return _internal_priority();
+}
+inline void Header::_internal_set_priority(::PROTOBUF_NAMESPACE_ID::int32 value) {
+  
+  priority_ = value;
+}
+inline void Header::set_priority(::PROTOBUF_NAMESPACE_ID::int32 value) {
+  _internal_set_priority(value);
+  // @@protoc_insertion_point(field_set:Matrix.MsgService.CommonMessages.Header.priority)
+}
+
+// repeated int32 ackKeyRanges = 12;
+inline int Header::_internal_ackkeyranges_size() const {
+  return ackkeyranges_.size();
+}
+inline int Header::ackkeyranges_size() const {
+  return _internal_ackkeyranges_size();
+}
+inline void Header::clear_ackkeyranges() {
+  ackkeyranges_.Clear();
+}
+inline ::PROTOBUF_NAMESPACE_ID::int32 Header::_internal_ackkeyranges(int index) const {
+  return ackkeyranges_.Get(index);
+}
+inline ::PROTOBUF_NAMESPACE_ID::int32 Header::ackkeyranges(int index) const {
+  // @@protoc_insertion_point(field_get:Matrix.MsgService.CommonMessages.Header.ackKeyRanges)
+  return _internal_ackkeyranges(index);
+}
+inline void Header::set_ackkeyranges(int index, ::PROTOBUF_NAMESPACE_ID::int32 value) {
+  ackkeyranges_.Set(index, value);
+  // @@protoc_insertion_point(field_set:Matrix.MsgService.CommonMessages.Header.ackKeyRanges)
+}
+inline void Header::_internal_add_ackkeyranges(::PROTOBUF_NAMESPACE_ID::int32 value) {
+  ackkeyranges_.Add(value);
+}
+inline void Header::add_ackkeyranges(::PROTOBUF_NAMESPACE_ID::int32 value) {
+  _internal_add_ackkeyranges(value);
+  // @@protoc_insertion_point(field_add:Matrix.MsgService.CommonMessages.Header.ackKeyRanges)
+}
+inline const ::PROTOBUF_NAMESPACE_ID::RepeatedField< ::PROTOBUF_NAMESPACE_ID::int32 >&
+Header::_internal_ackkeyranges() const {
+  return ackkeyranges_;
+}
+inline const ::PROTOBUF_NAMESPACE_ID::RepeatedField< ::PROTOBUF_NAMESPACE_ID::int32 >&
+Header::ackkeyranges() const {
+  // @@protoc_insertion_point(field_list:Matrix.MsgService.CommonMessages.Header.ackKeyRanges)
+  return _internal_ackkeyranges();
+}
+inline ::PROTOBUF_NAMESPACE_ID::RepeatedField< ::PROTOBUF_NAMESPACE_ID::int32 >*
+Header::_internal_mutable_ackkeyranges() {
+  return &ackkeyranges_;
+}
+inline ::PROTOBUF_NAMESPACE_ID::RepeatedField< ::PROTOBUF_NAMESPACE_ID::int32 >*
+Header::mutable_ackkeyranges() {
+  // @@protoc_insertion_point(field_mutable_list:Matrix.MsgService.CommonMessages.Header.ackKeyRanges)
+  return _internal_mutable_ackkeyranges();
+}
+
 // bytes msg = 15;
 inline void Header::clear_msg() {
   msg_.ClearToEmpty();
@@ -0,0 +1,60 @@
+#include "EncodedFrame.h"
+#include "Message.h"
+#include "MessageUtils.h"
+#include <string.h>
+
+using namespace Matrix::MsgService::CommonMessages;
+
+namespace
+{
+   void WriteSizePrefix(char* pBuffer, uint32_t size)
+   {
+      pBuffer[0] = (char)(size & 0xFF);
+      pBuffer[1] = (char)((size >> 8) & 0xFF);
+      pBuffer[2] = (char)((size >> 16) & 0xFF);
+      pBuffer[3] = (char)((size >> 24) & 0xFF);
+   }
+   EncodedFramePtr CreateHeartbeat()
+   {
+      auto buffer = BufferPool::Instance().Acquire(HDR_SIZE);
+      WriteSizePrefix(buffer.GetData(), 0);
+      return std::make_shared<EncodedFrame>(std::move(buffer), (size_t)HDR_SIZE, true, true);
+   }
+}
+
+EncodedFramePtr EncodedFrame::Create(const Header& msg)
+{
+   auto msgSize = msg.ByteSizeLong();
+   if (msgSize > (size_t)MAX_MESSAGE_SIZE)
+      return nullptr;
+   auto totalSize = msgSize + HDR_SIZE;
+   auto buffer = BufferPool::Instance().Acquire(totalSize);
+   if (buffer.GetData() == nullptr)
+      return nullptr;
+   WriteSizePrefix(buffer.GetData(), (uint32_t)msgSize);
+   msg.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(buffer.GetData() + HDR_SIZE));
+   return std::make_shared<EncodedFrame>(std::move(buffer), totalSize, MessageUtils::IsPriority(msg.msgtypeid(), msg.replymsgkey(), msg.priority())
+         , MessageUtils::IsControl(msg.msgtypeid()));
+}
+
+EncodedFramePtr EncodedFrame::Create(const char* pMsgData, size_t msgSize, const char* pSuffix, size_t suffixSize, bool isPriority, bool isControl)
+{
+   auto totalMsgSize = msgSize + suffixSize;
+   if (totalMsgSize > (size_t)MAX_MESSAGE_SIZE)
+      return nullptr;
+   auto totalSize = totalMsgSize + HDR_SIZE;
+   auto buffer = BufferPool::Instance().Acquire(totalSize);
+   if (buffer.GetData() == nullptr)
+      return nullptr;
+   WriteSizePrefix(buffer.GetData(), (uint32_t)totalMsgSize);
+   memcpy(buffer.GetData() + HDR_SIZE, pMsgData, msgSize);
+   if (suffixSize > 0)
+      memcpy(buffer.GetData() + HDR_SIZE + msgSize, pSuffix, suffixSize);
+   return std::make_shared<EncodedFrame>(std::move(buffer), totalSize, isPriority, isControl);
+}
+
+EncodedFramePtr EncodedFrame::GetHeartbeat()
+{
+   static EncodedFramePtr pHeartbeat = CreateHeartbeat();
+   return pHeartbeat;
+}
@@ -0,0 +1,114 @@
+#include "FrameDecoder.h"
+#include "Message.h"
+#include <string.h>
+
+using namespace Matrix::MsgService::CommonMessages;
+
+FrameDecoder::FrameDecoder(size_t initialCapacity)
+   : _initialCapacity(initialCapacity < HDR_SIZE ? HDR_SIZE : initialCapacity)
+   , _smallReads(0)
+   , _readPos(0)
+   , _writePos(0)
+{
+   _buffer = BufferPool::Instance().Acquire(_initialCapacity);
+   //the pool rounds up to its size class
+   _initialCapacity = _buffer.GetCapacity();
+}
+FrameDecoder::~FrameDecoder()
+{
+}
+
+uint32_t FrameDecoder::ReadSize(size_t pos) const
+{
+   auto pBytes = reinterpret_cast<const uint8_t*>(_buffer.GetData() + pos);
+   return (uint32_t)pBytes[0]
+      | ((uint32_t)pBytes[1] << 8)
+      | ((uint32_t)pBytes[2] << 16)
+      | ((uint32_t)pBytes[3] << 24);
+}
+
+void FrameDecoder::Resize(size_t capacity)
+{
+   auto buffered = GetBufferedBytes();
+   auto newBuffer = BufferPool::Instance().Acquire(capacity);
+   if (buffered > 0)
+      memcpy(newBuffer.GetData(), _buffer.GetData() + _readPos, buffered);
+   _buffer = std::move(newBuffer);
+   _readPos = 0;
+   _writePos = buffered;
+}
+
+char* FrameDecoder::GetWriteBuffer()
+{
+   auto buffered = GetBufferedBytes();
+   if (buffered == 0)
+   {
+      //everything has been consumed - start over at the beginning of the buffer
+      _readPos = 0;
+      _writePos = 0;
+      //give a grown buffer back once the connection has gone back to small reads
+      if (GetCapacity() > _initialCapacity && _smallReads >= SHRINK_AFTER_READS)
+         Resize(_initialCapacity);
+   }
+   else
+   {
+      //room needed for the rest of the partial frame
+      size_t needed = HDR_SIZE;
+      if (buffered >= HDR_SIZE)
+      {
+         auto size = ReadSize(_readPos);
+         if (size <= (uint32_t)MAX_MESSAGE_SIZE)
+            needed += size;
+      }
+      if (needed > GetCapacity())
+      {
+         Resize(needed);
+      }
+      else if (_readPos + needed > GetCapacity())
+      {
+         //move the partial frame to the front
+         memmove(_buffer.GetData(), _buffer.GetData() + _readPos, buffered);
+         _readPos = 0;
+         _writePos = buffered;
+      }
+   }
+   return _buffer.GetData() + _writePos;
+}
+
+void FrameDecoder::Commit(size_t bytes)
+{
+   _writePos += bytes;
+   if (_writePos > GetCapacity())
+      _writePos = GetCapacity();
+   if (GetBufferedBytes() > _initialCapacity)
+      _smallReads = 0;
+   else if (_smallReads < SHRINK_AFTER_READS)
+      _smallReads++;
+}
+
+FrameDecoder::FrameStatus FrameDecoder::NextFrame(const char** ppData, uint32_t* pSize)
+{
+   auto buffered = GetBufferedBytes();
+   if (buffered < HDR_SIZE)
+      return FrameStatus::Incomplete;
+
+   auto size = ReadSize(_readPos);
+   if (size > (uint32_t)MAX_MESSAGE_SIZE)
+      return FrameStatus::Invalid;
+   if (buffered - HDR_SIZE < size)
+      return FrameStatus::Incomplete;
+
+   *ppData = _buffer.GetData() + _readPos + HDR_SIZE;
+   *pSize = size;
+   _readPos += HDR_SIZE + size;
+   return FrameStatus::Complete;
+}
+
+void FrameDecoder::Reset()
+{
+   _readPos = 0;
+   _writePos = 0;
+   _smallReads = 0;
+   if (GetCapacity() > _initialCapacity)
+      Resize(_initialCapacity);
+}
@@ -0,0 +1,187 @@
+#include "HeaderScanner.h"
+
+using namespace Matrix::MsgService::CommonMessages;
+
+namespace
+{
+   //protobuf wire types
+   const uint32_t WIRETYPE_VARINT = 0;
+   const uint32_t WIRETYPE_FIXED64 = 1;
+   const uint32_t WIRETYPE_LENGTH_DELIMITED = 2;
+   const uint32_t WIRETYPE_FIXED32 = 5;
+
+   bool ReadVarint(const uint8_t*& pData, const uint8_t* pEnd, uint64_t* pValue)
+   {
+      uint64_t value = 0;
+      for (int shift = 0; shift < 64; shift += 7)
+      {
+         if (pData >= pEnd)
+            return false;
+         uint8_t byte = *pData++;
+         value |= (uint64_t)(byte & 0x7F) << shift;
+         if ((byte & 0x80) == 0)
+         {
+            *pValue = value;
+            return true;
+         }
+      }
+      return false;
+   }
+   size_t WriteVarint(char* pBuffer, uint64_t value)
+   {
+      size_t size = 0;
+      while (value >= 0x80)
+      {
+         pBuffer[size++] = (char)((value & 0x7F) | 0x80);
+         value >>= 7;
+      }
+      pBuffer[size++] = (char)value;
+      return size;
+   }
+   size_t WriteInt32Field(char* pBuffer, int fieldNumber, int value)
+   {
+      auto size = WriteVarint(pBuffer, ((uint64_t)fieldNumber << 3) | WIRETYPE_VARINT);
+      //negative int32s are sign extended to 10 bytes, as protobuf does
+      return size + WriteVarint(pBuffer + size, (uint64_t)(int64_t)value);
+   }
+   bool ReadAckKeys(const uint8_t* pData, const uint8_t* pEnd, std::vector<int>* pAckKeys)
+   {
+      while (pData < pEnd)
+      {
+         uint64_t value;
+         if (!ReadVarint(pData, pEnd, &value))
+            return false;
+         pAckKeys->push_back((int)value);
+      }
+      return true;
+   }
+
+   /// <summary>
+   /// Walks each field of the message, calling handleField with the value of varint fields or 
+   /// the bounds of length delimited fields.  handleField returns false if the field is malformed.
+   /// </summary>
+   template<typename HandleField>
+   bool ScanFields(const void* data, int len, HandleField handleField)
+   {
+      if (data == nullptr || len < 0)
+         return false;
+      auto pData = static_cast<const uint8_t*>(data);
+      auto pEnd = pData + len;
+      while (pData < pEnd)
+      {
+         uint64_t tag;
+         if (!ReadVarint(pData, pEnd, &tag))
+            return false;
+         auto fieldNumber = (int)(tag >> 3);
+         auto wireType = (uint32_t)(tag & 0x7);
+         if (fieldNumber == 0)
+            return false;
+         switch (wireType)
+         {
+            case WIRETYPE_VARINT:
+            {
+               uint64_t value;
+               if (!ReadVarint(pData, pEnd, &value))
+                  return false;
+               if (!handleField(fieldNumber, value, nullptr, nullptr))
+                  return false;
+               break;
+            }
+            case WIRETYPE_FIXED64:
+               if (pEnd - pData < 8)
+                  return false;
+               pData += 8;
+               break;
+            case WIRETYPE_LENGTH_DELIMITED:
+            {
+               uint64_t size;
+               if (!ReadVarint(pData, pEnd, &size) || size > (uint64_t)(pEnd - pData))
+                  return false;
+               if (!handleField(fieldNumber, 0, pData, pData + size))
+                  return false;
+               pData += size;
+               break;
+            }
+            case WIRETYPE_FIXED32:
+               if (pEnd - pData < 4)
+                  return false;
+               pData += 4;
+               break;
+            default:
+               //groups are not used by proto3
+               return false;
+         }
+      }
+      return true;
+   }
+}
+
+bool HeaderScanner::Scan(const void* data, int len, RoutingHeader* pHeader)
+{
+   *pHeader = RoutingHeader();
+   return ScanFields(data, len, [pHeader](int fieldNumber, uint64_t value, const uint8_t* pStart, const uint8_t* pEnd)
+   {
+      //a length delimited field is only expected for packed ackKeys (and the msg payload, which is skipped)
+      if (pStart != nullptr)
+      {
+         if (fieldNumber == Header::kAckKeysFieldNumber && !ReadAckKeys(pStart, pEnd, &pHeader->_ackKeys))
+            return false;
+         return true;
+      }
+      switch (fieldNumber)
+      {
+         case Header::kMsgTypeIDFieldNumber:
+            pHeader->_msgTypeID = (MsgType)(int)value;
+            break;
+         case Header::kMsgKeyFieldNumber:
+            pHeader->_msgKey = (int)value;
+            break;
+         case Header::kOrigClientTypeFieldNumber:
+            pHeader->_origClientType = (int)value;
+            break;
+         case Header::kOrigClientIDFieldNumber:
+            pHeader->_origClientID = (int)value;
+            break;
+         case Header::kDestClientTypeFieldNumber:
+            pHeader->_destClientType = (int)value;
+            break;
+         case Header::kDestClientIDFieldNumber:
+            pHeader->_destClientID = (int)value;
+            break;
+         case Header::kAckKeysFieldNumber:
+            pHeader->_ackKeys.push_back((int)value);
+            break;
+         case Header::kTopicFieldNumber:
+            pHeader->_topic = (int)value;
+            break;
+         case Header::kReplyMsgKeyFieldNumber:
+            pHeader->_replyMsgKey = (int)value;
+            break;
+         case Header::kPriorityFieldNumber:
+            pHeader->_priority = (int)value;
+            break;
+         default:
+            break;
+      }
+      return true;
+   });
+}
+
+MsgType HeaderScanner::ScanMsgTypeID(const void* data, int len)
+{
+   //the last occurrence of the field wins, so keep scanning to the end of the message
+   MsgType msgType = MsgType::INVALID_MSG_TYPE;
+   bool valid = ScanFields(data, len, [&msgType](int fieldNumber, uint64_t value, const uint8_t* pStart, const uint8_t*)
+   {
+      if (pStart == nullptr && fieldNumber == Header::kMsgTypeIDFieldNumber)
+         msgType = (MsgType)(int)value;
+      return true;
+   });
+   return valid ? msgType : MsgType::INVALID_MSG_TYPE;
+}
+
+size_t HeaderScanner::AppendOrigClient(char* pBuffer, int clientType, int clientID)
+{
+   auto size = WriteInt32Field(pBuffer, Header::kOrigClientTypeFieldNumber, clientType);
+   return size + WriteInt32Field(pBuffer + size, Header::kOrigClientIDFieldNumber, clientID);
+}
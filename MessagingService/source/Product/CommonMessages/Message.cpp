@@ -3,10 +3,18 @@
 
 using namespace Matrix::MsgService::CommonMessages;
 
+void Message::ReserveBuffer(size_t size)
+{
+   auto& pool = BufferPool::Instance();
+   if (_buffer.GetData() == nullptr || _buffer.GetSizeClass() != pool.GetSizeClass(size))
+      _buffer = pool.Acquire(size);
+}
+
 int Message::CreateEmptyMsg()
 {
    int totalSize = HDR_SIZE;
-   google::protobuf::io::ArrayOutputStream aos(_buffer, (int)totalSize);
+   ReserveBuffer(totalSize);
+   google::protobuf::io::ArrayOutputStream aos(_buffer.GetData(), (int)totalSize);
    // We create a new coded stream for each message.  Don't worry, this is fast.
    google::protobuf::io::CodedOutputStream output(&aos);
    // Write the size.
@@ -18,8 +26,13 @@ int Message::PackMsg(const Header& msg)
 {
    _msg = msg;
    auto msgSize = msg.ByteSizeLong();
+   if (msgSize > (size_t)MAX_MESSAGE_SIZE)
+      return -1;
    auto totalSize = msgSize + HDR_SIZE;
-   google::protobuf::io::ArrayOutputStream aos(_buffer, totalSize);
+   ReserveBuffer(totalSize);
+   if (_buffer.GetData() == nullptr)
+      return -1;
+   google::protobuf::io::ArrayOutputStream aos(_buffer.GetData(), (int)totalSize);
    // We create a new coded stream for each message.  Don't worry, this is fast.
    google::protobuf::io::CodedOutputStream output(&aos);
    // Write the size.
@@ -31,7 +44,9 @@ int Message::PackMsg(const Header& msg)
 }
 int Message::Decode()
 {
-   google::protobuf::io::ArrayInputStream ais(_buffer, HDR_SIZE + MAX_MESSAGE_SIZE);
+   if (_buffer.GetData() == nullptr)
+      return -1;
+   google::protobuf::io::ArrayInputStream ais(_buffer.GetData(), (int)_buffer.GetCapacity());
    google::protobuf::io::CodedInputStream coded_input(&ais);
    google::protobuf::uint32 size;
    if (coded_input.ReadLittleEndian32(&size))
@@ -54,7 +69,9 @@ int Message::Decode()
 }
 int Message::Decode(Header* pMsg)
 {
-   google::protobuf::io::ArrayInputStream ais(_buffer, HDR_SIZE + MAX_MESSAGE_SIZE);
+   if (_buffer.GetData() == nullptr)
+      return -1;
+   google::protobuf::io::ArrayInputStream ais(_buffer.GetData(), (int)_buffer.GetCapacity());
    google::protobuf::io::CodedInputStream coded_input(&ais);
    google::protobuf::uint32 size;
    if (coded_input.ReadLittleEndian32(&size))
@@ -136,4 +153,4 @@ bool Message::readDelimitedFrom(google::protobuf::io::ZeroCopyInputStream* rawIn
    input.PopLimit(limit);
 
    return true;
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#include "MessageArena.h"
+
+using namespace Matrix::MsgService::CommonMessages;
+
+MessageArena::MessageArena()
+   : _initialBlock(BufferPool::Instance().Acquire(INITIAL_BLOCK_SIZE))
+   , _resetCount(0)
+{
+   google::protobuf::ArenaOptions options;
+   options.initial_block = _initialBlock.GetData();
+   options.initial_block_size = _initialBlock.GetCapacity();
+   _pArena.reset(new google::protobuf::Arena(options));
+}
+MessageArena::~MessageArena()
+{
+   //the arena has to go before the block it was given
+   _pArena = nullptr;
+}
+void MessageArena::Reset()
+{
+   _pArena->Reset();
+   _resetCount++;
+}
+int64_t MessageArena::GetSpaceAllocated() const
+{
+   return (int64_t)_pArena->SpaceAllocated();
+}
+std::unique_ptr<Header> MessageArena::ToHeap(HeaderPtr pMsg)
+{
+   if (pMsg == nullptr)
+      return nullptr;
+   if (pMsg->GetArena() == nullptr)
+      return std::unique_ptr<Header>(pMsg.release());
+   return std::unique_ptr<Header>(new Header(*pMsg));
+}
@@ -1,19 +1,35 @@
 
 #include "MessageUtils.h"
 #include "StringUtils.h"
+#include "HeaderScanner.h"
 
 using namespace Matrix::MsgService::CommonMessages;
 
 MsgType MessageUtils::GetMsgTypeID(const void* data, int len)
 {
-   MsgType messageID = MsgType::INVALID_MSG_TYPE;
+   //only the MsgTypeID is needed, so scan for it rather than parsing the whole message
+   return HeaderScanner::ScanMsgTypeID(data, len);
+}
 
-   Header reqHdr;
-   if (reqHdr.ParseFromArray(data, len))
+bool MessageUtils::IsControl(MsgType msgType)
+{
+   switch (msgType)
    {
-      messageID = reqHdr.msgtypeid();
+      case MsgType::ACK:
+      case MsgType::NACK:
+      case MsgType::LOGON:
+      case MsgType::LOGOFF:
+      case MsgType::SUBSCRIBE:
+      case MsgType::UNSUBSCRIBE:
+         return true;
+      default:
+         return false;
    }
-   return messageID;
+}
+
+bool MessageUtils::IsPriority(MsgType msgType, int replyMsgKey, int priority)
+{
+   return IsControl(msgType) || replyMsgKey != 0 || priority > 0;
 }
 
 bool MessageUtils::ParseHeader(Header& reqHdr, const void* data, int len)
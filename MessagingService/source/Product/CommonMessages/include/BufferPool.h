@@ -0,0 +1,162 @@
+#pragma once
+
+#include "../stdafx.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace Matrix
+{
+namespace MsgService
+{
+namespace CommonMessages
+{
+   /// <summary>
+   /// A buffer that was acquired from the BufferPool.  The buffer is returned to the pool
+   /// when this object is destroyed.  It can be moved but not copied.
+   /// </summary>
+   class PooledBuffer
+   {
+      //****************************************
+      // Constructors/Destructors
+      //****************************************
+   public:
+      PooledBuffer() : _pData(nullptr), _capacity(0), _sizeClass(-1) {}
+      PooledBuffer(char* pData, size_t capacity, int sizeClass) : _pData(pData), _capacity(capacity), _sizeClass(sizeClass) {}
+      PooledBuffer(PooledBuffer&& other) : _pData(other._pData), _capacity(other._capacity), _sizeClass(other._sizeClass)
+      {
+         other._pData = nullptr;
+         other._capacity = 0;
+         other._sizeClass = -1;
+      }
+      ~PooledBuffer() { Release(); }
+      PooledBuffer& operator=(PooledBuffer&& other)
+      {
+         if (this != &other)
+         {
+            Release();
+            _pData = other._pData;
+            _capacity = other._capacity;
+            _sizeClass = other._sizeClass;
+            other._pData = nullptr;
+            other._capacity = 0;
+            other._sizeClass = -1;
+         }
+         return *this;
+      }
+   private:
+      PooledBuffer(const PooledBuffer&);
+      PooledBuffer& operator=(const PooledBuffer&);
+
+      //****************************************
+      // Fields
+      //****************************************
+   private:
+      char* _pData;
+      size_t _capacity;
+      int _sizeClass;
+
+      //****************************************
+      // Methods
+      //****************************************
+   public:
+      /// <summary>
+      /// Gets the start of the buffer; null if no buffer has been acquired
+      /// </summary>
+      char* GetData() const { return _pData; }
+      /// <summary>
+      /// Gets the number of bytes available in the buffer
+      /// </summary>
+      size_t GetCapacity() const { return _capacity; }
+      /// <summary>
+      /// Gets the size class the buffer came from; -1 if it is not pooled
+      /// </summary>
+      int GetSizeClass() const { return _sizeClass; }
+      /// <summary>
+      /// Returns the buffer to the pool
+      /// </summary>
+      COMMONMESSAGES_API void Release();
+   };
+
+   /// <summary>
+   /// Process wide pool of message buffers grouped into size classes.  Buffers that are
+   /// released are kept for reuse up to a byte limit per size class.
+   /// </summary>
+   class BufferPool
+   {
+      //****************************************
+      // Constructors/Destructors
+      //****************************************
+   private:
+      BufferPool();
+      BufferPool(const BufferPool&);
+      BufferPool& operator=(const BufferPool&);
+
+      //****************************************
+      // Fields
+      //****************************************
+   public:
+      /// <summary>
+      /// Number of size classes.  Classes grow by 4x starting at MIN_BUFFER_SIZE; the last
+      /// class holds a full size frame (HDR_SIZE + MAX_MESSAGE_SIZE)
+      /// </summary>
+      static const int NUM_SIZE_CLASSES = 8;
+      static const size_t MIN_BUFFER_SIZE = 256;
+      /// <summary>
+      /// Maximum number of bytes of released buffers kept for each size class
+      /// </summary>
+      static const size_t MAX_CACHED_BYTES_PER_CLASS = 4 * 1024 * 1024;
+   private:
+      struct SizeClass
+      {
+         size_t bufferSize;
+         std::mutex lock;
+         std::vector<char*> freeList;
+      };
+      SizeClass _sizeClasses[NUM_SIZE_CLASSES];
+      std::atomic<int64_t> _bytesInUse;
+      std::atomic<int64_t> _bytesCached;
+
+      //****************************************
+      // Methods
+      //****************************************
+   public:
+      /// <summary>
+      /// Gets the process wide pool
+      /// </summary>
+      COMMONMESSAGES_API static BufferPool& Instance();
+      /// <summary>
+      /// Gets a buffer that can hold at least size bytes
+      /// </summary>
+      /// <param name="size">The number of bytes needed</param>
+      COMMONMESSAGES_API PooledBuffer Acquire(size_t size);
+      /// <summary>
+      /// Returns a buffer to the pool.  Normally called by PooledBuffer.
+      /// </summary>
+      COMMONMESSAGES_API void Release(char* pData, size_t capacity, int sizeClass);
+      /// <summary>
+      /// Gets the size of the buffers in a size class
+      /// </summary>
+      COMMONMESSAGES_API size_t GetClassSize(int sizeClass) const;
+      /// <summary>
+      /// Gets the size class that will be used for a buffer of size bytes; -1 if it is too large to pool
+      /// </summary>
+      COMMONMESSAGES_API int GetSizeClass(size_t size) const;
+      /// <summary>
+      /// Gets the number of bytes in buffers that are currently acquired
+      /// </summary>
+      int64_t GetBytesInUse() const { return _bytesInUse.load(); }
+      /// <summary>
+      /// Gets the number of bytes in released buffers kept for reuse
+      /// </summary>
+      int64_t GetBytesCached() const { return _bytesCached.load(); }
+      /// <summary>
+      /// Frees all of the cached buffers
+      /// </summary>
+      COMMONMESSAGES_API void Trim();
+   };
+}
+}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "../stdafx.h"
+#include <memory>
+#include "BufferPool.h"
+
+namespace Matrix
+{
+namespace MsgService
+{
+namespace CommonMessages
+{
+   class Header;
+   class EncodedFrame;
+   typedef std::shared_ptr<const EncodedFrame> EncodedFramePtr;
+
+   /// <summary>
+   /// An immutable size prefixed frame ready to be written to a socket.  Frames are
+   /// refcounted so the same bytes can be queued on any number of connections.
+   /// </summary>
+   class EncodedFrame
+   {
+      //****************************************
+      // Constructors/Destructors
+      //****************************************
+   public:
+      EncodedFrame(PooledBuffer&& buffer, size_t size, bool isPriority = false, bool isControl = false)
+         : _buffer(std::move(buffer)), _size(size), _isPriority(isPriority), _isControl(isControl) {}
+   private:
+      EncodedFrame(const EncodedFrame&);
+      EncodedFrame& operator=(const EncodedFrame&);
+
+      //****************************************
+      // Fields
+      //****************************************
+   private:
+      PooledBuffer _buffer;
+      size_t _size;
+      bool _isPriority;
+      bool _isControl;
+
+      //****************************************
+      // Methods
+      //****************************************
+   public:
+      /// <summary>
+      /// Serializes msg into a new size prefixed frame, which is a priority or control frame if msg is
+      /// (see MessageUtils::IsPriority and MessageUtils::IsControl)
+      /// </summary>
+      /// <param name="msg">The message to encode</param>
+      /// <returns>The frame; null if msg is larger than MAX_MESSAGE_SIZE or could not be serialized</returns>
+      COMMONMESSAGES_API static EncodedFramePtr Create(const Header& msg);
+      /// <summary>
+      /// Copies an already encoded Header into a new size prefixed frame, optionally followed by
+      /// extra encoded fields (see HeaderScanner::AppendOrigClient)
+      /// </summary>
+      /// <param name="pMsgData">The encoded Header, without a size prefix</param>
+      /// <param name="msgSize">The size of the encoded Header</param>
+      /// <param name="pSuffix">Encoded fields to append; may be null</param>
+      /// <param name="suffixSize">The size of pSuffix</param>
+      /// <param name="isPriority">true if the frame is sent ahead of bulk frames (see MessageUtils::IsPriority)</param>
+      /// <param name="isControl">true if the frame is a control frame (see MessageUtils::IsControl)</param>
+      /// <returns>The frame; null if the result is larger than MAX_MESSAGE_SIZE</returns>
+      COMMONMESSAGES_API static EncodedFramePtr Create(const char* pMsgData, size_t msgSize, const char* pSuffix = nullptr, size_t suffixSize = 0
+            , bool isPriority = false, bool isControl = false);
+      /// <summary>
+      /// Gets the shared 0 size (heartbeat) frame, which is a priority control frame
+      /// </summary>
+      COMMONMESSAGES_API static EncodedFramePtr GetHeartbeat();
+      /// <summary>
+      /// Gets the start of the frame, including the size prefix
+      /// </summary>
+      const char* GetData() const { return _buffer.GetData(); }
+      /// <summary>
+      /// Gets the total size of the frame, including the size prefix
+      /// </summary>
+      size_t GetSize() const { return _size; }
+      /// <summary>
+      /// Gets the number of bytes of buffer held by the frame
+      /// </summary>
+      size_t GetCapacity() const { return _buffer.GetCapacity(); }
+      /// <summary>
+      /// Returns true if the frame is sent ahead of bulk frames queued on a connection
+      /// </summary>
+      bool IsPriority() const { return _isPriority; }
+      /// <summary>
+      /// Returns true if the frame is a control frame, which is queued even when a connection's send
+      /// queue is over its limits
+      /// </summary>
+      bool IsControl() const { return _isControl; }
+   };
+}
+}
+}
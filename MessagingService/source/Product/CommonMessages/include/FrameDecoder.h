@@ -0,0 +1,124 @@
+#pragma once
+
+#include "../stdafx.h"
+#include <stdint.h>
+#include <stddef.h>
+#include "BufferPool.h"
+
+namespace Matrix
+{
+namespace MsgService
+{
+namespace CommonMessages
+{
+   /// <summary>
+   /// Incremental decoder for a stream of 4 byte little endian size prefixed frames.
+   /// Bytes read from the socket are appended with GetWriteBuffer()/Commit() and every
+   /// complete frame is then pulled out with NextFrame().  A partial frame at the end
+   /// of a read is kept and completed by the following reads.
+   /// The receive buffer comes from the BufferPool.  It starts at the initial capacity,
+   /// grows only to fit a large frame and shrinks back once reads are small again.
+   /// </summary>
+   class FrameDecoder
+   {
+   public:
+      /// <summary>
+      /// Result of a call to NextFrame
+      /// </summary>
+      enum class FrameStatus
+      {
+         /// <summary>
+         /// A complete frame was returned
+         /// </summary>
+         Complete,
+         /// <summary>
+         /// More bytes are needed to complete the next frame
+         /// </summary>
+         Incomplete,
+         /// <summary>
+         /// The size prefix is larger than MAX_MESSAGE_SIZE; the stream can not be recovered
+         /// </summary>
+         Invalid,
+      };
+
+      //****************************************
+      // Constructors/Destructors
+      //****************************************
+   public:
+      /// <summary>
+      /// Initializes a new instance of the <see cref="FrameDecoder"/> class.
+      /// </summary>
+      /// <param name="initialCapacity">The initial size of the receive buffer</param>
+      COMMONMESSAGES_API FrameDecoder(size_t initialCapacity = DEFAULT_CAPACITY);
+      COMMONMESSAGES_API ~FrameDecoder();
+
+      //****************************************
+      // Fields
+      //****************************************
+   public:
+      static const size_t DEFAULT_CAPACITY = 4 * 1024;
+      /// <summary>
+      /// Number of consecutive reads that fit in the initial capacity before a grown buffer is shrunk
+      /// </summary>
+      static const int SHRINK_AFTER_READS = 16;
+   private:
+      size_t _initialCapacity;
+      PooledBuffer _buffer;
+      //number of consecutive reads that fit in the initial capacity
+      int _smallReads;
+      //start of the first byte that has not been returned by NextFrame
+      size_t _readPos;
+      //end of the bytes that have been committed
+      size_t _writePos;
+
+      //****************************************
+      // Methods
+      //****************************************
+   public:
+      /// <summary>
+      /// Gets the location that the next read should be stored in.  Compacts or grows the
+      /// buffer as needed so there is room for at least the rest of the current partial frame.
+      /// </summary>
+      COMMONMESSAGES_API char* GetWriteBuffer();
+      /// <summary>
+      /// Gets the number of bytes that can be stored at GetWriteBuffer()
+      /// </summary>
+      size_t GetWriteSpace() const { return _buffer.GetCapacity() - _writePos; }
+      /// <summary>
+      /// Marks bytes stored at GetWriteBuffer() as available for decoding
+      /// </summary>
+      /// <param name="bytes">The number of bytes that were stored</param>
+      COMMONMESSAGES_API void Commit(size_t bytes);
+      /// <summary>
+      /// Gets the next complete frame.  The data returned is only valid until the next call
+      /// to GetWriteBuffer() or Reset().
+      /// </summary>
+      /// <param name="ppData">Set to the start of the frame payload (after the size prefix)</param>
+      /// <param name="pSize">Set to the size of the frame payload; 0 indicates a heartbeat</param>
+      /// <returns>Complete if a frame was returned</returns>
+      COMMONMESSAGES_API FrameStatus NextFrame(const char** ppData, uint32_t* pSize);
+      /// <summary>
+      /// Gets the number of bytes that have been committed but not returned by NextFrame
+      /// </summary>
+      size_t GetBufferedBytes() const { return _writePos - _readPos; }
+      /// <summary>
+      /// Gets the size of the receive buffer
+      /// </summary>
+      size_t GetCapacity() const { return _buffer.GetCapacity(); }
+      /// <summary>
+      /// Discards any buffered bytes
+      /// </summary>
+      COMMONMESSAGES_API void Reset();
+   private:
+      /// <summary>
+      /// Reads the size prefix at pos
+      /// </summary>
+      uint32_t ReadSize(size_t pos) const;
+      /// <summary>
+      /// Replaces the buffer with one that can hold capacity bytes, keeping the unread bytes
+      /// </summary>
+      void Resize(size_t capacity);
+   };
+}
+}
+}
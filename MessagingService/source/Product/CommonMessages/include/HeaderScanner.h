@@ -0,0 +1,101 @@
+#pragma once
+#include "../stdafx.h"
+#include <vector>
+#include <stdint.h>
+
+//this is trying to disable warnings that are caused by the protobuf created file - it doesn't seem to completely work
+#ifdef _WIN32
+#pragma warning( push )
+#pragma warning( disable: 4251 4100 4146)
+#endif
+#include "../CommonMessages.pb.h"
+#ifdef _WIN32
+#pragma warning( pop )
+#endif
+
+namespace Matrix
+{
+namespace MsgService
+{
+namespace CommonMessages
+{
+   /// <summary>
+   /// The Header fields needed to route a message, read straight from the encoded bytes
+   /// </summary>
+   struct RoutingHeader
+   {
+   public:
+      RoutingHeader()
+         : _msgTypeID(MsgType::INVALID_MSG_TYPE)
+         , _msgKey(0)
+         , _origClientType(0)
+         , _origClientID(0)
+         , _destClientType(0)
+         , _destClientID(0)
+         , _topic(0)
+         , _replyMsgKey(0)
+         , _priority(0)
+      {
+      }
+   public:
+      MsgType _msgTypeID;
+      int _msgKey;
+      int _origClientType;
+      int _origClientID;
+      int _destClientType;
+      int _destClientID;
+      int _topic;
+      int _replyMsgKey;
+      int _priority;
+      std::vector<int> _ackKeys;
+   };
+
+   /// <summary>
+   /// Reads the routing fields of an encoded Header without parsing the whole message.  
+   /// Fields that are not needed for routing (including the msg payload) are skipped over
+   /// without being copied.
+   /// </summary>
+   class HeaderScanner
+   {
+      //****************************************
+      // Fields
+      //****************************************
+   public:
+      //largest number of bytes written by AppendOrigClient
+      static const size_t MAX_ORIG_CLIENT_SIZE = 22;
+
+      //****************************************
+      // Static Methods
+      //****************************************
+   public:
+      /// <summary>
+      /// Scans an encoded Header for its routing fields
+      /// </summary>
+      /// <param name="data">Pointer to the binary message (without the size prefix)</param>
+      /// <param name="len">Length of the message</param>
+      /// <param name="pHeader">Filled in with the routing fields; fields that are not present are 0</param>
+      /// <returns>true if the whole message was well formed</returns>
+      static COMMONMESSAGES_API bool Scan(const void* data, int len, RoutingHeader* pHeader);
+
+      /// <summary>
+      /// Scans an encoded Header for its MsgTypeID only
+      /// </summary>
+      /// <param name="data">Pointer to the binary message (without the size prefix)</param>
+      /// <param name="len">Length of the message</param>
+      /// <returns>MsgType if found or INVALID_MSG_TYPE if not</returns>
+      static COMMONMESSAGES_API MsgType ScanMsgTypeID(const void* data, int len);
+
+      /// <summary>
+      /// Writes the encoded origClientType and origClientID fields.  Appending these to an 
+      /// encoded Header sets those fields without re-encoding the rest of the message, since
+      /// the last occurrence of a field wins when the message is parsed.
+      /// </summary>
+      /// <param name="pBuffer">Where to write; must hold at least MAX_ORIG_CLIENT_SIZE bytes</param>
+      /// <param name="clientType">The originating client type</param>
+      /// <param name="clientID">The originating client ID</param>
+      /// <returns>The number of bytes written</returns>
+      static COMMONMESSAGES_API size_t AppendOrigClient(char* pBuffer, int clientType, int clientID);
+   };
+}
+}
+}
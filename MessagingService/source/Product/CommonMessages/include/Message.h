@@ -14,6 +14,7 @@
 #pragma warning( pop )
 #endif
 #include <stdlib.h>
+#include "BufferPool.h"
 
 using namespace google::protobuf::io;
 
@@ -27,26 +28,19 @@ namespace CommonMessages
 //   const int MAX_MESSAGE_SIZE = 16300;
    const int MAX_MESSAGE_SIZE = 1048576;
    /// <summary>
-   /// Class for packing and unpacking messages into and out of a byte buffer 
+   /// Class for packing and unpacking messages into and out of a byte buffer.
+   /// The buffer comes from the BufferPool and is sized to the packed message.
    /// </summary>
    class Message
    {
    public:
-      //TODO - use vector so we can accept any size message?
       typedef std::vector<uint8_t> DataBuffer;
 
-      Message() { _buffer = (char*)malloc(HDR_SIZE + MAX_MESSAGE_SIZE); }
-      ~Message() 
-      { 
-          if (_buffer != NULL)
-          {
-              free(_buffer);
-              _buffer = NULL;
-          }
-      }
+      Message() {}
+      ~Message() {}
    private:
       Header _msg;
-      char* _buffer;
+      PooledBuffer _buffer;
 
    public:
       /// <summary>
@@ -55,9 +49,13 @@ namespace CommonMessages
       /// </summary>
       Header& GetMsg() { return _msg; }
       /// <summary>
-      /// Class for packing and unpacking messages into and out of a byte buffer 
+      /// Gets the buffer filled by CreateEmptyMsg or PackMsg; null until one of them is called
       /// </summary>
-      char* GetBuffer() { return _buffer; }
+      char* GetBuffer() { return _buffer.GetData(); }
+      /// <summary>
+      /// Gets the size of the buffer retrieved by GetBuffer()
+      /// </summary>
+      size_t GetBufferCapacity() const { return _buffer.GetCapacity(); }
 
       /// <summary>
       /// Fills the buffer retreived by GetBuffer() with a 0 size prefix
@@ -68,7 +66,7 @@ namespace CommonMessages
       /// Converts msg into a size prefixed byte array and stores it in the buffer retreived by GetBuffer()
       /// </summary>
       /// <param name="msg">The message to convert to byte array</param>
-      /// <returns>Total size of the data in the buffer</returns>
+      /// <returns>Total size of the data in the buffer; -1 if msg is larger than MAX_MESSAGE_SIZE or could not be serialized</returns>
       COMMONMESSAGES_API int PackMsg(const Header& msg);
       /// <summary>
       /// Decodes a size prefixed byte array and parses it into Header retrieved by GetMsg()
@@ -91,7 +89,13 @@ namespace CommonMessages
       COMMONMESSAGES_API static bool readDelimitedFrom(google::protobuf::io::ZeroCopyInputStream* rawInput,
          google::protobuf::MessageLite* message,
          bool* clean_eof);
+   private:
+      /// <summary>
+      /// Makes sure the buffer is from the size class for size bytes, so large buffers are
+      /// given back to the pool once smaller messages are packed
+      /// </summary>
+      void ReserveBuffer(size_t size);
    };
 }
 }
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+#include "../stdafx.h"
+#include <memory>
+#include <stdint.h>
+#include "BufferPool.h"
+
+//this is trying to disable warnings that are caused by the protobuf created file - it doesn't seem to completely work
+#ifdef _WIN32
+#pragma warning( push )
+#pragma warning( disable: 4251 4100 4146)
+#endif
+#include "../CommonMessages.pb.h"
+#ifdef _WIN32
+#pragma warning( pop )
+#endif
+
+namespace Matrix
+{
+namespace MsgService
+{
+namespace CommonMessages
+{
+   /// <summary>
+   /// Deletes a Header unless it was created on an arena, in which case the arena owns it
+   /// </summary>
+   struct HeaderDeleter
+   {
+      HeaderDeleter() {}
+      //allows a std::unique_ptr<Header> to be moved into a HeaderPtr
+      HeaderDeleter(const std::default_delete<Header>&) {}
+      void operator()(Header* pMsg) const
+      {
+         if (pMsg != nullptr && pMsg->GetArena() == nullptr)
+            delete pMsg;
+      }
+   };
+   /// <summary>
+   /// A received Header - may be on the heap or on the MessageArena of the connection that received it
+   /// </summary>
+   typedef std::unique_ptr<Header, HeaderDeleter> HeaderPtr;
+
+   /// <summary>
+   /// A recycled protobuf arena for the messages parsed from one connection.  Everything created on it
+   /// is freed at once by Reset, so messages must not be kept after the read they came from has been
+   /// handled - use ToHeap to keep one.
+   /// </summary>
+   class MessageArena
+   {
+      //****************************************
+      // Constructors/Destructors
+      //****************************************
+   public:
+      COMMONMESSAGES_API MessageArena();
+      COMMONMESSAGES_API ~MessageArena();
+   private:
+      MessageArena(const MessageArena&);
+      MessageArena& operator=(const MessageArena&);
+
+      //****************************************
+      // Fields
+      //****************************************
+   public:
+      //size of the block the arena starts with and keeps between resets
+      static const size_t INITIAL_BLOCK_SIZE = 16 * 1024;
+   private:
+      PooledBuffer _initialBlock;
+      std::unique_ptr<google::protobuf::Arena> _pArena;
+      int64_t _resetCount;
+
+      //****************************************
+      // Methods
+      //****************************************
+   public:
+      /// <summary>
+      /// Creates an empty message of type T on the arena
+      /// </summary>
+      template<typename T>
+      T* Create() { return google::protobuf::Arena::CreateMessage<T>(_pArena.get()); }
+      /// <summary>
+      /// Creates an empty Header on the arena
+      /// </summary>
+      HeaderPtr CreateHeader() { return HeaderPtr(Create<Header>()); }
+      /// <summary>
+      /// Frees everything created on the arena, keeping the initial block for reuse
+      /// </summary>
+      COMMONMESSAGES_API void Reset();
+      /// <summary>
+      /// Gets the number of bytes the arena currently holds
+      /// </summary>
+      COMMONMESSAGES_API int64_t GetSpaceAllocated() const;
+      /// <summary>
+      /// Gets the number of times the arena has been reset
+      /// </summary>
+      int64_t GetResetCount() const { return _resetCount; }
+
+      /// <summary>
+      /// Returns a heap Header that can be kept after the arena is reset; pMsg is copied if it is on an arena
+      /// </summary>
+      /// <param name="pMsg">The message to keep</param>
+      COMMONMESSAGES_API static std::unique_ptr<Header> ToHeap(HeaderPtr pMsg);
+   };
+}
+}
+}
@@ -49,6 +49,25 @@ namespace CommonMessages
       /// <param name="msgType">the MsgType to get</param>
       /// <returns>a user-readable string for msgTyper</returns>
       static COMMONMESSAGES_API std::string ToString(MsgType msgType);
+
+      /// <summary>
+      /// Determines if a message is a control message (ACK, NACK, LOGON, LOGOFF, SUBSCRIBE or UNSUBSCRIBE).
+      /// Control messages are small and are queued even when a connection's send queue is over its limits.
+      /// </summary>
+      /// <param name="msgType">the MsgTypeID of the message</param>
+      /// <returns>true if the message is a control message</returns>
+      static COMMONMESSAGES_API bool IsControl(MsgType msgType);
+
+      /// <summary>
+      /// Determines if a message is sent ahead of bulk messages already queued on a connection: 
+      /// control messages (ACK, NACK, LOGON, LOGOFF, SUBSCRIBE and UNSUBSCRIBE), replies, and messages
+      /// marked with a priority
+      /// </summary>
+      /// <param name="msgType">the MsgTypeID of the message</param>
+      /// <param name="replyMsgKey">the replyMsgKey of the message</param>
+      /// <param name="priority">the priority of the message</param>
+      /// <returns>true if the message is sent ahead of bulk messages</returns>
+      static COMMONMESSAGES_API bool IsPriority(MsgType msgType, int replyMsgKey, int priority);
    };
 }
 }
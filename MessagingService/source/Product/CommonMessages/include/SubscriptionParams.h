@@ -1,4 +1,5 @@
 #pragma once
+#include <stdint.h>
 #include <functional>
 
 namespace Matrix
@@ -31,14 +32,13 @@ namespace CommonMessages
    {
       std::size_t operator()(const SubscriptionParams& k) const
       {
-         using std::size_t;
-         using std::hash;
-         using std::string;
-
-         return ((hash<int>()(k._clientType)
-            ^ (hash<int>()(k._clientID)
-               ^ (hash<int>()(k._topic) << 1)) >> 1))
-            ;
+         //hash<int> is the identity on common implementations, so mix the fields rather than xor them;
+         //xor maps (1, 2, t) and (2, 1, t) and many small ids to the same bucket
+         uint64_t hash = (uint32_t)k._clientType;
+         hash = hash * 0x9E3779B97F4A7C15ull + (uint32_t)k._clientID;
+         hash = hash * 0x9E3779B97F4A7C15ull + (uint32_t)k._topic;
+         hash ^= hash >> 29;
+         return (std::size_t)hash;
       }
    };
 }
@@ -1,5 +1,8 @@
 #include "IncludeBoostASIO.h"
 #include <memory>
+#ifdef __linux__
+#include <netinet/tcp.h>
+#endif
 
 #include "ClientComm.h"
 #include "ContextHandler.h"
@@ -8,6 +11,7 @@
 #include "CountdownTimer.h"
 #include "Message.h"
 #include "SubscriberMessageLists.h"
+#include "TimerWheel.h"
 
 using namespace Matrix::Common;
 using namespace Matrix::MsgService::CommunicationUtils;
@@ -22,9 +26,19 @@ ClientComm::ClientComm(std::shared_ptr<IContextHandler> pContextHandler, const s
       , _ipAddress(ipAddress)
       , _port(port)
       , _reconnectRetryTimeMS(reconnectRetryTimeMS)
+      , _maxReconnectRetryTimeMS(DEFAULT_MAX_RECONNECT_RETRY_TIME_MS)
+      , _connectTimeoutMS(DEFAULT_CONNECT_TIMEOUT_MS)
+      , _useTcpFastOpen(false)
       , _resolver(pContextHandler->GetIOContext())
+      , _connectTimer(pContextHandler->GetIOContext())
+      , _connectAttempt(0)
+      , _connectFailures(0)
+      , _random(std::random_device()())
       , _isLoggedOn(false)
       , _msgKey(1)
+      , _ackDelayMS(0)
+      , _maxPendingAcks(DEFAULT_MAX_PENDING_ACKS)
+      , _isAckFlushScheduled(false)
 {
 #ifdef USING_SSL
    pContextHandler->GetSSLContext().set_default_verify_paths();
@@ -79,61 +93,153 @@ bool ClientComm::WrappedConnect(bool isRetry)
       return false;
    }
    LOG_MESSAGE(isRetry ? Logging::LogLevels::TRACE_LVL: Logging::LogLevels::INFO_LVL) << "Client " << GetName() << ": Attempting to connect";
-   try
+   _isLoggedOn = false;
+   CheckConnectionChanged(SocketState::Connecting);
+   if (!_endpoints.empty())
+   {
+      StartConnect(isRetry, 0);
+   }
+   else
+   {
+      auto attempt = ++_connectAttempt;
+      _resolver.async_resolve(_ipAddress, _port, _strand.wrap(std::bind(&ClientComm::HandleResolve, shared_from_this()
+            , attempt, isRetry, std::placeholders::_1, std::placeholders::_2)));
+   }
+   return true;
+}
+void ClientComm::HandleResolve(int attempt, bool isRetry, const boost::system::error_code& error, boost::asio::ip::tcp::resolver::results_type results)
+{
+   if (attempt != _connectAttempt)
+      return;
+   if (error)
+   {
+      LOG_MESSAGE(isRetry ? Logging::LogLevels::TRACE_LVL : Logging::LogLevels::WARNING_LVL) << "Client " << GetName() << ": Could not resolve - " << error.message();
+      ConnectFailed();
+      return;
+   }
+   LOG_MESSAGE(Logging::LogLevels::TRACE_LVL) << "Client " << GetName() << ": Resolved " << results.size() << " endpoints";
+   _endpoints.clear();
+   for (auto& entry : results)
+      _endpoints.push_back(entry.endpoint());
+   StartConnect(isRetry, 0);
+}
+void ClientComm::StartConnect(bool isRetry, size_t endpointIndex)
+{
+   if (_shuttingDown || _stopped)
    {
       _isLoggedOn = false;
-      CheckConnectionChanged(SocketState::Connecting);
-      asio::ip::tcp::resolver::query query(_ipAddress, _port);
-      boost::system::error_code error = boost::asio::error::host_not_found;
-      boost::asio::ip::tcp::resolver::iterator endpoint_iterator = _resolver.resolve(query, error);
-      if(error)
-      {
-         LOG_MESSAGE(isRetry ? Logging::LogLevels::TRACE_LVL : Logging::LogLevels::WARNING_LVL) << "Client " << GetName() << ": Could not resolve - " << error.message();
-      }
-      else
-      {
-         LOG_MESSAGE(Logging::LogLevels::TRACE_LVL) << "Client " << GetName() << ": Resolved";
-         if (_pSocket != nullptr)
-         {
-            _pSocket.reset(new boost::asio::ip::tcp::socket(_pContextHandler->GetIOContext()));
-            LOG_MESSAGE(Logging::LogLevels::TRACE_LVL) << "Client " << GetName() << ": pSocket is not null";
-            boost::asio::ip::tcp::resolver::iterator end;
-            error = boost::asio::error::host_not_found;
-            while (error && endpoint_iterator != end && !(_shuttingDown || _stopped))
-            {
-               _pSocket->lowest_layer().connect(*endpoint_iterator, error);
-               if (error)
-               {
-                  LOG_MESSAGE(isRetry ? Logging::LogLevels::TRACE_LVL : Logging::LogLevels::INFO_LVL) << "Client " << GetName() << ": Did not connect-" << error.message();
-               }
-               else
-               {
-                  ConnectComplete(endpoint_iterator);
-                  return true;
-               }
-               endpoint_iterator++;
-            }
-         }
-      }
+      CheckConnectionChanged(SocketState::Disconnected, DisconnectReason::Manual);
+      return;
+   }
+   if (endpointIndex >= _endpoints.size())
+   {
+      //none of the endpoints could be connected, so resolve again on the next attempt
+      _endpoints.clear();
+      ConnectFailed();
+      return;
    }
-   catch (std::exception ex)
+   auto attempt = ++_connectAttempt;
+   auto& endpoint = _endpoints[endpointIndex];
+#ifdef USING_SSL
+   _pSocket = std::make_shared<socket_type>(_pContextHandler->GetIOContext(), _pContextHandler->GetSSLContext());
+#else
+   _pSocket = std::make_shared<socket_type>(_pContextHandler->GetIOContext());
+#endif
+   boost::system::error_code error;
+   _pSocket->lowest_layer().open(endpoint.protocol(), error);
+   if (error)
    {
-      LOG_MESSAGE(Logging::LogLevels::EXCEPTION_LVL) << "Client " << GetName() << ": Exception connecting - ", ex.what();
+      LOG_MESSAGE(isRetry ? Logging::LogLevels::TRACE_LVL : Logging::LogLevels::INFO_LVL) << "Client " << GetName() << ": Could not open socket-" << error.message();
+      StartConnect(isRetry, endpointIndex + 1);
+      return;
    }
+   if (_useTcpFastOpen)
+      EnableTcpFastOpen();
+   _connectTimer.expires_after(std::chrono::milliseconds(_connectTimeoutMS));
+   _connectTimer.async_wait(_strand.wrap(std::bind(&ClientComm::HandleConnectTimeout, shared_from_this(), attempt, std::placeholders::_1)));
+   _pSocket->lowest_layer().async_connect(endpoint, _strand.wrap(std::bind(&ClientComm::HandleConnect, shared_from_this()
+         , attempt, isRetry, endpointIndex, std::placeholders::_1)));
+}
+void ClientComm::HandleConnect(int attempt, bool isRetry, size_t endpointIndex, const boost::system::error_code& error)
+{
+   if (attempt != _connectAttempt)
+      return;
+   _connectTimer.cancel();
+   if (_shuttingDown || _stopped)
+   {
+      _isLoggedOn = false;
+      CheckConnectionChanged(SocketState::Disconnected, DisconnectReason::Manual);
+      return;
+   }
+   if (error)
+   {
+      LOG_MESSAGE(isRetry ? Logging::LogLevels::TRACE_LVL : Logging::LogLevels::INFO_LVL) << "Client " << GetName() << ": Did not connect-" << error.message();
+      StartConnect(isRetry, endpointIndex + 1);
+      return;
+   }
+   _connectFailures = 0;
+   ConnectComplete(_endpoints[endpointIndex]);
+}
+void ClientComm::HandleConnectTimeout(int attempt, const boost::system::error_code& error)
+{
+   if (error == asio::error::operation_aborted || attempt != _connectAttempt || GetSocketState() != SocketState::Connecting)
+      return;
+   LOG_MESSAGE(Logging::LogLevels::TRACE_LVL) << "Client " << GetName() << ": Connect timed out after " << _connectTimeoutMS << " ms";
+   //closing the socket completes the pending connect with an error, which moves on to the next endpoint
+   boost::system::error_code ec;
+   _pSocket->lowest_layer().close(ec);
+}
+void ClientComm::ConnectFailed()
+{
    _isLoggedOn = false;
    CheckConnectionChanged(SocketState::Disconnected, DisconnectReason::CouldNotConnect);
+   _connectFailures++;
+   ScheduleReconnect();
+}
+void ClientComm::ScheduleReconnect()
+{
    if (_reconnectRetryTimeMS > 0)
    {
+      auto delayMS = GetReconnectDelay(_connectFailures);
+      LOG_MESSAGE(Logging::LogLevels::TRACE_LVL) << "Client " << GetName() << ": Retrying connect in " << delayMS << " ms";
       auto func = std::bind(&ClientComm::RetryConnect, shared_from_this());
-      _reconnectTimer.StartTimer(_reconnectRetryTimeMS, func, true);
+      _reconnectTimer.StartTimer((int)delayMS, func, true);
    }
-   return false;
 }
-void ClientComm::ConnectComplete(asio::ip::tcp::resolver::iterator iterator)
+uint32_t ClientComm::GetReconnectDelay(int numFailures)
 {
-   LOG_MESSAGE(Logging::LogLevels::INFO_LVL) << "Client " << GetName() << ":  Connected to server " << iterator->host_name() << "!";
+   uint64_t maxDelayMS = (_maxReconnectRetryTimeMS > _reconnectRetryTimeMS) ? _maxReconnectRetryTimeMS : _reconnectRetryTimeMS;
+   uint64_t delayMS = _reconnectRetryTimeMS;
+   for (int failure = 0; failure < numFailures && delayMS < maxDelayMS; failure++)
+      delayMS *= 2;
+   if (delayMS > maxDelayMS)
+      delayMS = maxDelayMS;
+   //keep the lower half and randomize the upper half
+   auto halfMS = delayMS / 2;
+   std::uniform_int_distribution<uint64_t> jitter(0, delayMS - halfMS);
+   return (uint32_t)(halfMS + jitter(_random));
+}
+void ClientComm::EnableTcpFastOpen()
+{
+#if defined(__linux__) && defined(TCP_FASTOPEN_CONNECT)
+   //with TCP_FASTOPEN_CONNECT the connect completes immediately and the first write (the logon) goes out with the SYN
+   //when a cookie for the server is cached; otherwise it falls back to a normal handshake
+   boost::system::error_code error;
+   _pSocket->lowest_layer().set_option(asio::detail::socket_option::boolean<IPPROTO_TCP, TCP_FASTOPEN_CONNECT>(true), error);
+   if (error)
+   {
+      LOG_MESSAGE(Logging::LogLevels::TRACE_LVL) << "Client " << GetName() << ": TCP Fast Open not available - " << error.message();
+   }
+#endif
+}
+void ClientComm::ConnectComplete(const asio::ip::tcp::endpoint& endpoint)
+{
+   LOG_MESSAGE(Logging::LogLevels::INFO_LVL) << "Client " << GetName() << ":  Connected to server " << endpoint.address().to_string() << ":" << endpoint.port() << "!";
    _isLoggedOn = false;
+   //acks owed on an earlier connection are not sent on this one; the peers resend what was not acked
+   _pendingAcks.Clear();
    CheckConnectionChanged(SocketState::Connected);
+   StartLiveness();
 
    StartRead();
    if(_pLogonMsg != nullptr)
@@ -159,6 +265,66 @@ void ClientComm::OnConnectionChanged(bool isConnected)
 
    CommHandler::OnConnectionChanged(isConnected);
 }
+void ClientComm::SetDelayedAcks(uint32_t ackDelayMS, size_t maxPendingAcks)
+{
+   _ackDelayMS = ackDelayMS;
+   if (maxPendingAcks == 0)
+      maxPendingAcks = 1;
+   else if (maxPendingAcks > MAX_PENDING_ACKS)
+      maxPendingAcks = MAX_PENDING_ACKS;
+   _maxPendingAcks = maxPendingAcks;
+   if (ackDelayMS == 0)
+      FlushAcks();
+}
+void ClientComm::FlushAcks()
+{
+   _isAckFlushScheduled = false;
+   for (auto& client : _pendingAcks.GetClients())
+      SendPendingAcks(client._clientType, client._clientID);
+}
+void ClientComm::AckRxMsg(const Matrix::MsgService::CommonMessages::Header& rxMsg)
+{
+   if (_ackDelayMS == 0)
+   {
+      SendAckMessage(rxMsg);
+      return;
+   }
+   if (_pendingAcks.Add(rxMsg.origclienttype(), rxMsg.origclientid(), rxMsg.msgkey()) >= _maxPendingAcks)
+      SendPendingAcks(rxMsg.origclienttype(), rxMsg.origclientid());
+   else
+      ScheduleAckFlush();
+}
+void ClientComm::SendPendingAcks(int clientType, int clientID)
+{
+   //the keys are all in ackKeys/ackKeyRanges, so the ACK itself has no key
+   CommonMessages::Header ackMsg;
+   ackMsg.set_msgtypeid(CommonMessages::MsgType::ACK);
+   ackMsg.set_destclienttype(clientType);
+   ackMsg.set_destclientid(clientID);
+   std::vector<int> keys;
+   if (_pendingAcks.Take(clientType, clientID, &ackMsg, &keys) > 0 && !SendMsg(ackMsg))
+      RestorePendingAcks(clientType, clientID, keys);
+}
+void ClientComm::RestorePendingAcks(int clientType, int clientID, const std::vector<int>& keys)
+{
+   //the message taking them was not sent, so they go with the next message or flush instead of being lost
+   _pendingAcks.Restore(clientType, clientID, keys);
+   if (IsConnected())
+      ScheduleAckFlush();
+}
+void ClientComm::ScheduleAckFlush()
+{
+   if (_isAckFlushScheduled.exchange(true))
+      return;
+   //a weak pointer so a pending flush does not keep a closed client alive
+   std::weak_ptr<ClientComm> pWeakThis = shared_from_this();
+   Matrix::Common::TimerWheel::Instance().Schedule(_ackDelayMS, [pWeakThis]()
+   {
+      auto pThis = pWeakThis.lock();
+      if (pThis != nullptr)
+         pThis->_strand.post(std::bind(&ClientComm::FlushAcks, pThis));
+   });
+}
 bool ClientComm::SendAckMessage(const Matrix::MsgService::CommonMessages::Header msgToAck)
 {
    return SendCommonMsgInternal(CommonMessages::MsgType::ACK, nullptr, msgToAck.msgkey(), 0, msgToAck.origclienttype(), msgToAck.origclientid());
@@ -217,31 +383,14 @@ int ClientComm::SendCommonMsgInternal(CommonMessages::MsgType msgType
    headerMsg.set_isarchived(isArchived);
    if (pMessage != nullptr)
       headerMsg.set_allocated_msg(new std::string(pMessage->SerializeAsString()));
-   std::vector<int> ackKeyList;
-   if (_pSubscriberMsgLists != nullptr)
-   {
-      if(NeedToTrackSentMsg(&headerMsg))
-         _pSubscriberMsgLists->AddSentMessage(headerMsg);
-
-      //if this message is for a specific client, add any acks to the message
-      if (destClientType > 0)
-      {
-         ackKeyList = _pSubscriberMsgLists->GetNeedToAckList(destClientType, destClientID);
-         for each (auto key in ackKeyList)
-         {
-            headerMsg.add_ackkeys(key);
-         }
-      }
-
-   }
-   if (SendMsg(headerMsg))
-   {
-      if (_pSubscriberMsgLists != nullptr && destClientType > 0)
-      {
-         _pSubscriberMsgLists->RemoveFromNeedToAckList(destClientType, destClientID, ackKeyList);
-      }
-
-   }
+   if (_pSubscriberMsgLists != nullptr && NeedToTrackSentMsg(&headerMsg))
+      _pSubscriberMsgLists->AddSentMessage(headerMsg);
+   //if this message is for a specific client, add any acks that are waiting to be sent to it
+   std::vector<int> pendingAckKeys;
+   if (destClientType > 0)
+      _pendingAcks.Take(destClientType, destClientID, &headerMsg, &pendingAckKeys);
+   if (!SendMsg(headerMsg) && !pendingAckKeys.empty())
+      RestorePendingAcks(destClientType, destClientID, pendingAckKeys);
    return msgKey;
 }
 
@@ -301,12 +450,17 @@ void ClientComm::SendSubscribeMessages()
 
 void ClientComm::HandleDisconnect(DisconnectReason reason)
 {
+   //abandon any connect that is in progress
+   _connectAttempt++;
+   _connectTimer.cancel();
+   _resolver.cancel();
+   //cleared before the state changes, so observers of the disconnect see none pending
+   _pendingAcks.Clear();
    CommHandler::HandleDisconnect(reason);
    //if we should retry connecting and we are not shutting down
-   if (_reconnectRetryTimeMS > 0 && reason != DisconnectReason::None && reason != DisconnectReason::Manual)
+   if (reason != DisconnectReason::None && reason != DisconnectReason::Manual)
    {
-      auto func = std::bind(&ClientComm::RetryConnect, shared_from_this());
-      _reconnectTimer.StartTimer(_reconnectRetryTimeMS, func, true);
+      ScheduleReconnect();
    }
 }
 void ClientComm::Disconnect(DisconnectReason reason)
@@ -316,7 +470,7 @@ void ClientComm::Disconnect(DisconnectReason reason)
    CommHandler::Disconnect(reason);
 }
 
-void ClientComm::HandleMessageReceived(std::unique_ptr<CommonMessages::Header> pMsg)
+void ClientComm::HandleMessageReceived(CommonMessages::HeaderPtr pMsg)
 {
    if (pMsg != nullptr)
    {
@@ -328,6 +482,9 @@ void ClientComm::HandleMessageReceived(std::unique_ptr<CommonMessages::Header> p
          _isLoggedOn = true;
          SendSubscribeMessages();
       }
+      //the keys acked by this message, including any sent as ranges
+      google::protobuf::RepeatedField<int> ackedKeys;
+      PendingAcks::GetAckedKeys(*pMsg, &ackedKeys);
       //if we are tracking
       if (_pSubscriberMsgLists != nullptr)
       {
@@ -347,15 +504,13 @@ void ClientComm::HandleMessageReceived(std::unique_ptr<CommonMessages::Header> p
             if (replyMsgKey > 0)
                _pSubscriberMsgLists->RemoveSentMessage(pMsg->origclienttype(), pMsg->origclientid(), replyMsgKey);
          }
-         _pSubscriberMsgLists->RemoveSentMessages(pMsg->origclienttype(), pMsg->origclientid(), pMsg->ackkeys());
+         _pSubscriberMsgLists->RemoveSentMessages(pMsg->origclienttype(), pMsg->origclientid(), ackedKeys);
       }
 
       CommHandler::OnMessageReceived(pMsg.get());
 
-      //TODO: eventually add the actual tracking of sent messages and acks and only ack periodically
-      bool needToAck = NeedToAckRxMsg(pMsg.get());
-      if (needToAck)
-         SendAckMessage(*pMsg.get());
+      if (NeedToAckRxMsg(pMsg.get()))
+         AckRxMsg(*pMsg);
 
       int replyMsgKey = 0;
       //if this is a reply to a message, signal if there is one waiting in SendCommonMessageAndWait
@@ -372,17 +527,18 @@ void ClientComm::HandleMessageReceived(std::unique_ptr<CommonMessages::Header> p
             return;
          }
       }
-      //if there are any acks, signal there is one waiting in SendCommonMessageAndWait
-      for(auto key: pMsg->ackkeys())
+      //if there are any acks, signal each one waiting in SendCommonMessageAndWait - a cumulative ack can cover several
+      std::vector<std::shared_ptr<WaitResponse>> waiting;
+      for(auto key: ackedKeys)
       {
-         //if this acked key matches the received message and it is an ack msg, we've already set the event
          auto find = _waitResponses.find(key);
          if (find != _waitResponses.end())
-         {
-            find->second->Signal(std::move(pMsg));
-            return;
-         }
+            waiting.push_back(find->second);
       }
+      for (size_t index = 0; index + 1 < waiting.size(); index++)
+         waiting[index]->Signal(CommonMessages::HeaderPtr(new CommonMessages::Header(*pMsg)));
+      if (!waiting.empty())
+         waiting.back()->Signal(std::move(pMsg));
    }
 }
 /// <summary>
@@ -3,6 +3,7 @@
 #pragma warning( disable: 4251 4100 4146)
 #endif
 #include "Message.h"
+#include "FrameDecoder.h"
 #ifdef _WIN32
 #pragma warning( pop )
 #endif
@@ -13,6 +14,16 @@
 #include "IContextHandler.h"
 #include "StringUtils.h"
 #include "MessageUtils.h"
+#include "TimerWheel.h"
+
+namespace
+{
+   //asio writes at most 64 buffers per system call
+   const size_t MAX_FRAMES_PER_WRITE = 64;
+   //bulk frames stop being added to a write once it holds this many bytes of them, so a priority frame
+   //queued while it is in flight does not wait behind the whole bulk backlog
+   const size_t MAX_BULK_BYTES_PER_WRITE = 64 * 1024;
+}
 
 namespace CommonMessages = Matrix::MsgService::CommonMessages;
 
@@ -32,16 +43,35 @@ CommHandler::CommHandler(
       , _name(name)
       , _isServer(isServer)
       , _stopped(false)
+      , _clientType(clientType)
+      , _clientID(clientID)
       , _socketState(SocketState::Disconnected)
       , _disconnectReason(DisconnectReason::None)
-      , _pRxMsg(std::make_shared<CommonMessages::Message>())
-      , _pSendMsg(std::make_shared<CommonMessages::Message>())
-      , _pEmptyMsg(nullptr)
-      , _emptySize(0)
+      , _pFrameDecoder(new CommonMessages::FrameDecoder())
+      , _sendQueueHeadSeq(0)
+      , _writeInProgress(false)
+      , _sendQueueDepth(0)
+      , _sendQueueBytes(0)
+      , _maxSendQueueDepth(0)
+      , _droppedFrameCount(0)
+      , _publishedFrameCount(0)
+      , _conflatedFrameCount(0)
+      , _priorityFrameCount(0)
+      , _writeStartMS(0)
+      , _isWriteStallCheckPending(false)
+      , _writeStallCount(0)
+      , _isSlowConsumer(false)
       , _msgRxCount(0)
       , _msgSendCount(0)
-      , _clientType(clientType)
-      , _clientID(clientID)
+      , _readCount(0)
+      , _writeCount(0)
+      , _heartbeatIntervalMS(0)
+      , _idleTimeoutMS(0)
+      , _lastReceiveMS(0)
+      , _lastSendMS(0)
+      , _livenessGeneration(0)
+      , _heartbeatSendCount(0)
+      , _heartbeatRxCount(0)
 {
 #ifdef USING_SSL
    _pSocket = std::make_shared<ssl::stream<boost::asio::ip::tcp::socket>>(_pContextHandler->GetIOContext(), _pContextHandler->GetSSLContext());
@@ -82,14 +112,38 @@ CommHandler::~CommHandler()
 void CommHandler::ShutDown()
 { 
    //if we are not already shutting down
+   if (!_shuttingDown)
+   {
+      StartShutDown();
+      WaitForShutdown();
+   }
+}
+void CommHandler::StartShutDown()
+{
    if (!_shuttingDown)
    {
       LOG_MESSAGE(Logging::LogLevels::DEBUG_LVL) << GetName() << ": Shutting down";
       WorkerThread::ShutDown();
       Disconnect();
-      WaitForShutdown();
+      //never connected (or already closed) so there is no disconnect to wait for
+      if (_socketState == SocketState::Disconnected)
+         _shutdownComplete = true;
    }
 }
+void CommHandler::ForceClose()
+{
+   LOG_MESSAGE(Logging::LogLevels::WARNING_LVL) << GetName() << ": Forcing close";
+   _stopped = true;
+   WorkerThread::ShutDown();
+   _shutdownComplete = true;
+   //on the strand as the socket is not thread safe; an SSL socket is closed without waiting for the peer's close_notify
+   auto pThis = shared_from_this();
+   _strand.post([pThis]()
+   {
+      boost::system::error_code ec;
+      pThis->_pSocket->lowest_layer().close(ec);
+   });
+}
 void CommHandler::Disconnect()
 {
    _stopped = true;
@@ -103,6 +157,53 @@ void CommHandler::Disconnect(DisconnectReason reason)
       _strand.dispatch(std::bind(&CommHandler::HandleDisconnect, shared_from_this(), reason));
    }
 }
+void CommHandler::Reset()
+{
+   //first, so a liveness or write stall check for the old connection that has just locked its weak pointer does nothing
+   StopLiveness();
+#ifdef USING_SSL
+   //an ssl stream cannot be used again once it has been shut down
+   _pSocket = std::make_shared<ssl::stream<boost::asio::ip::tcp::socket>>(_pContextHandler->GetIOContext(), _pContextHandler->GetSSLContext());
+   _pSocket->set_verify_mode(boost::asio::ssl::verify_peer);
+   _pSocket->set_verify_callback(std::bind(&CommHandler::VerifyCertificate, this, std::placeholders::_1, std::placeholders::_2));
+#else
+   boost::system::error_code ec;
+   _pSocket->close(ec);
+#endif
+   _stopped = false;
+   _shuttingDown = false;
+   _shutdownComplete = false;
+   if (IsConnected())
+      _pContextHandler->RemoveConnection();
+   _socketState = SocketState::Disconnected;
+   _disconnectReason = DisconnectReason::None;
+   _pFrameDecoder->Reset();
+   _messageArena.Reset();
+   ClearSendQueue();
+   {
+      //a write stall check already posted reads these under the lock
+      std::lock_guard<std::mutex> lock(_sendLock);
+      _writeInProgress = false;
+      _sendQueueLimits = SendQueueLimits();
+   }
+   _maxSendQueueDepth = 0;
+   _droppedFrameCount = 0;
+   _publishedFrameCount = 0;
+   _conflatedFrameCount = 0;
+   _priorityFrameCount = 0;
+   _isWriteStallCheckPending = false;
+   _writeStallCount = 0;
+   _isSlowConsumer = false;
+   _connectionChangeEvent.disconnectAll();
+   _socketStateChangeEvent.disconnectAll();
+   _messageRxEvent.disconnectAll();
+   _msgRxCount = 0;
+   _msgSendCount = 0;
+   _readCount = 0;
+   _writeCount = 0;
+   _heartbeatSendCount = 0;
+   _heartbeatRxCount = 0;
+}
 void CommHandler::HandleDisconnect(DisconnectReason reason)
 {
    if (_pSocket != nullptr)
@@ -123,6 +224,10 @@ void CommHandler::HandleDisconnect(DisconnectReason reason)
          LOG_MESSAGE(Logging::LogLevels::DEBUG_LVL) << GetName() << ": Error disconnecting - " << ex.what();
       }
    }
+   StopLiveness();
+   //discard any partial frame so a reconnect starts on a frame boundary
+   _pFrameDecoder->Reset();
+   ClearSendQueue();
    if (_shuttingDown)
    {
       _shutdownComplete = true;
@@ -145,6 +250,7 @@ void CommHandler::Run()
          _name = endpoint.address().to_string();
       }
       CheckConnectionChanged(SocketState::Connected, DisconnectReason::None);
+      StartLiveness();
 
 #ifdef USING_SSL
       auto handshakeType = boost::asio::ssl::stream_base::client;
@@ -202,7 +308,27 @@ void CommHandler::Diagnostics(DiagnosticTypes type)
 }
 std::string CommHandler::GetDiagnosticsInfo()
 {
-   return StringUtils::Format("Connected=%d; Rx count: %d; Send count %d", IsConnected(), _msgRxCount , _msgSendCount);
+   double framesPerRead = (_readCount == 0) ? 0.0 : (double)_msgRxCount / (double)_readCount;
+   double framesPerWrite = (_writeCount == 0) ? 0.0 : (double)_msgSendCount / (double)_writeCount;
+   auto publishedCount = GetPublishedFrameCount();
+   double conflatedPercent = (publishedCount == 0) ? 0.0 : 100.0 * (double)GetConflatedFrameCount() / (double)publishedCount;
+   auto& bufferPool = CommonMessages::BufferPool::Instance();
+   return StringUtils::Format("Connected=%d; Rx count: %" PRId64 "; Send count %" PRId64 "; Reads: %" PRId64 " (%.2f frames/read)"
+         "; Writes: %" PRId64 " (%.2f frames/write); Send queue: %" PRId64 " frames, %" PRId64 " bytes (max %" PRId64 " frames)"
+         "; Buffers: %" PRId64 " bytes (all connections %" PRId64 ", pooled %" PRId64 "); Arena: %" PRId64 " bytes"
+         "; Heartbeats: sent %" PRId64 ", received %" PRId64 "; Idle: rx %" PRId64 " ms, tx %" PRId64 " ms"
+         "; Slow consumer=%d: policy %s, dropped %" PRId64 ", write stalls %" PRId64
+         "; Published: %" PRId64 ", conflated %" PRId64 " (%.1f%%); Priority: %" PRId64
+         , IsConnected(), _msgRxCount, _msgSendCount, _readCount, framesPerRead
+         , _writeCount, framesPerWrite, GetSendQueueDepth(), GetSendQueueBytes(), _maxSendQueueDepth
+         , GetBufferBytes(), bufferPool.GetBytesInUse(), bufferPool.GetBytesCached(), _messageArena.GetSpaceAllocated()
+         , GetHeartbeatSendCount(), GetHeartbeatRxCount(), GetSteadyMS() - _lastReceiveMS.load(), GetSteadyMS() - _lastSendMS.load()
+         , IsSlowConsumer(), ToString(GetSendQueueLimits()._policy), GetDroppedFrameCount(), GetWriteStallCount()
+         , publishedCount, GetConflatedFrameCount(), conflatedPercent, GetPriorityFrameCount());
+}
+int64_t CommHandler::GetBufferBytes()
+{
+   return (int64_t)_pFrameDecoder->GetCapacity() + GetSendQueueBytes();
 }
 
 void CommHandler::StartRead()
@@ -211,13 +337,17 @@ void CommHandler::StartRead()
    {
       LOG_MESSAGE(Logging::LogLevels::TRACE_LVL) << GetName() << ": waiting for read.";
 
-      asio::async_read(*_pSocket, asio::buffer(_pRxMsg->GetBuffer(), CommonMessages::HDR_SIZE + CommonMessages::MAX_MESSAGE_SIZE), asio::transfer_at_least(1),
-         std::bind(&CommHandler::HandleRead, shared_from_this(),
-            std::placeholders::_1, std::placeholders::_2));
+      //read whatever is available; HandleRead pulls out every complete frame.  It runs on the strand so
+      //it is never concurrent with this connection's writes, disconnect or liveness checks when
+      //several threads run the io_context
+      auto pWriteBuffer = _pFrameDecoder->GetWriteBuffer();
+      _pSocket->async_read_some(asio::buffer(pWriteBuffer, _pFrameDecoder->GetWriteSpace()),
+         _strand.wrap(std::bind(&CommHandler::HandleRead, shared_from_this(),
+            std::placeholders::_1, std::placeholders::_2)));
    }
 }
 
-void CommHandler::HandleRead(const boost::system::error_code& error, size_t /*bytes_transferred*/)
+void CommHandler::HandleRead(const boost::system::error_code& error, size_t bytes_transferred)
 {
    if (error)
    {
@@ -236,79 +366,387 @@ void CommHandler::HandleRead(const boost::system::error_code& error, size_t /*by
    }
    else
    {
-      _msgRxCount++;
-      auto pMsg = std::unique_ptr<CommonMessages::Header>(new CommonMessages::Header());
-      auto size = _pRxMsg->Decode(pMsg.get());
-      if (size == 0)
+      _readCount++;
+      _lastReceiveMS = GetSteadyMS();
+      _pFrameDecoder->Commit(bytes_transferred);
+
+      const char* pData;
+      uint32_t size;
+      auto status = _pFrameDecoder->NextFrame(&pData, &size);
+      while (status == CommonMessages::FrameDecoder::FrameStatus::Complete)
       {
-         //0 size message is a keep alive
-         HandleMessageReceived(nullptr);
+         _msgRxCount++;
+         HandleFrameReceived(pData, size);
+         status = _pFrameDecoder->NextFrame(&pData, &size);
       }
-      else if(size > 0)
+      HandleFramesComplete();
+      //the messages from this read have all been handled
+      _messageArena.Reset();
+      if (status == CommonMessages::FrameDecoder::FrameStatus::Invalid)
       {
-         HandleMessageReceived(std::move(pMsg));
+         //the size prefix is corrupt so the frame boundaries are lost
+         LOG_MESSAGE(Logging::LogLevels::WARNING_LVL) << GetName() << ": Invalid frame size received.";
+         _pFrameDecoder->Reset();
+         Disconnect(DisconnectReason::Exception);
       }
       else
       {
-         LOG_MESSAGE(Logging::LogLevels::WARNING_LVL) << GetName() << ": Could not decode msg.";
+         StartRead();
       }
-      StartRead();
+   }
+}
+void CommHandler::HandleFrameReceived(const char* pData, uint32_t size)
+{
+   if (size == 0)
+   {
+      //0 size message is a keep alive
+      HandleHeartbeatReceived();
+      HandleMessageReceived(nullptr);
+   }
+   else
+   {
+      auto pMsg = _messageArena.CreateHeader();
+      if (pMsg->ParseFromArray(pData, (int)size))
+         HandleMessageReceived(std::move(pMsg));
+      else
+         LOG_MESSAGE(Logging::LogLevels::WARNING_LVL) << GetName() << ": Could not decode msg.";
    }
 }
 void CommHandler::OnMessageReceived(CommonMessages::Header* pMsg)
 {
    _messageRxEvent(pMsg);
 }
-void CommHandler::HandleMessageReceived(std::unique_ptr<CommonMessages::Header> pMsg)
+void CommHandler::HandleMessageReceived(CommonMessages::HeaderPtr pMsg)
 {
    if(pMsg != nullptr)
       OnMessageReceived(pMsg.get());
 }
+void CommHandler::HandleHeartbeatReceived()
+{
+   _heartbeatRxCount++;
+   //the peer is already hearing from us unless nothing has been sent for the heartbeat interval.  A reply
+   //to our own heartbeat arrives just after that heartbeat was sent, so it is never answered.  Without an
+   //interval this side does not heartbeat itself and echoes, as the broker always has.
+   if (GetSteadyMS() - _lastSendMS.load() >= (int64_t)_heartbeatIntervalMS)
+      SendHeartbeat();
+}
 bool CommHandler::SendHeartbeat()
 {
-   if (!IsStopped() && _pSocket != nullptr)
+   if (!QueueFrame(CommonMessages::EncodedFrame::GetHeartbeat()))
+      return false;
+   _heartbeatSendCount++;
+   return true;
+}
+void CommHandler::SetLiveness(uint32_t heartbeatIntervalMS, uint32_t idleTimeoutMS)
+{
+   _heartbeatIntervalMS = heartbeatIntervalMS;
+   _idleTimeoutMS = idleTimeoutMS;
+}
+void CommHandler::StartLiveness()
+{
+   auto now = GetSteadyMS();
+   _lastReceiveMS = now;
+   _lastSendMS = now;
+   auto generation = ++_livenessGeneration;
+   if (_heartbeatIntervalMS > 0 || _idleTimeoutMS > 0)
    {
-      if (_pEmptyMsg == nullptr)
+      auto delayMS = _heartbeatIntervalMS;
+      if (delayMS == 0 || (_idleTimeoutMS > 0 && _idleTimeoutMS < delayMS))
+         delayMS = _idleTimeoutMS;
+      ScheduleLivenessCheck(generation, delayMS);
+   }
+}
+void CommHandler::StopLiveness()
+{
+   //a pending check sees the generation has moved on and does nothing
+   _livenessGeneration++;
+}
+void CommHandler::ScheduleLivenessCheck(int generation, uint32_t delayMS)
+{
+   //a weak pointer so a pending check does not keep a closed connection alive
+   std::weak_ptr<CommHandler> pWeakThis = shared_from_this();
+   Matrix::Common::TimerWheel::Instance().Schedule(delayMS, [pWeakThis, generation]()
+   {
+      auto pThis = pWeakThis.lock();
+      if (pThis != nullptr && pThis->_livenessGeneration == generation)
+         pThis->_strand.post(std::bind(&CommHandler::CheckLiveness, pThis, generation));
+   });
+}
+void CommHandler::CheckLiveness(int generation)
+{
+   if (generation != _livenessGeneration || !IsConnected() || IsStopped())
+      return;
+   auto now = GetSteadyMS();
+   auto rxIdleMS = now - _lastReceiveMS.load();
+   if (_idleTimeoutMS > 0 && rxIdleMS >= (int64_t)_idleTimeoutMS)
+   {
+      LOG_MESSAGE(Logging::LogLevels::INFO_LVL) << GetName() << ": Nothing received for " << rxIdleMS << " ms - disconnecting";
+      Disconnect(DisconnectReason::ServerNotResponding);
+      return;
+   }
+   auto nextCheckMS = (int64_t)UINT32_MAX;
+   if (_heartbeatIntervalMS > 0)
+   {
+      auto heartbeatMS = (int64_t)_heartbeatIntervalMS;
+      auto txIdleMS = now - _lastSendMS.load();
+      //a heartbeat when either direction is idle: the peer answers one that arrives while its side is idle
+      if (txIdleMS >= heartbeatMS || rxIdleMS >= heartbeatMS)
       {
-         _pEmptyMsg = std::unique_ptr<CommonMessages::Message>(new CommonMessages::Message());
-         _emptySize = _pEmptyMsg->CreateEmptyMsg();
+         SendHeartbeat();
+         txIdleMS = 0;
       }
-      asio::async_write(*_pSocket, asio::buffer(_pEmptyMsg->GetBuffer(), _emptySize), asio::transfer_at_least(1),
-         _strand.wrap(std::bind(&CommHandler::HandleWrite, shared_from_this(),
-            std::placeholders::_1, std::placeholders::_2)));
+      nextCheckMS = heartbeatMS - txIdleMS;
+      if (rxIdleMS < heartbeatMS && heartbeatMS - rxIdleMS < nextCheckMS)
+         nextCheckMS = heartbeatMS - rxIdleMS;
    }
-   return true;
-
+   if (_idleTimeoutMS > 0 && (int64_t)_idleTimeoutMS - rxIdleMS < nextCheckMS)
+      nextCheckMS = (int64_t)_idleTimeoutMS - rxIdleMS;
+   ScheduleLivenessCheck(generation, (uint32_t)(nextCheckMS < 1 ? 1 : nextCheckMS));
+}
+int64_t CommHandler::GetSteadyMS()
+{
+   return (int64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 bool CommHandler::SendMsg(CommonMessages::Header& msg)
 {
    if (!IsStopped() && _pSocket != nullptr)
    {
-      auto totalSize = _pSendMsg->PackMsg(msg);
-      //TODO: _pSendMsg is shared - need to ensure additional calls to this SendMsg don't happen before it is completed in HandleWrite
-      if (totalSize < 0)
+      auto pFrame = CommonMessages::EncodedFrame::Create(msg);
+      if (pFrame == nullptr)
       {
          LOG_MESSAGE(Logging::LogLevels::WARNING_LVL) << GetName() << ": Pack Message error!";
       }
       else
       {
-         _msgSendCount++;
          LOG_MESSAGE(Logging::LogLevels::DEBUG_LVL) << GetName() << ": Sending " << CommonMessages::MessageUtils::ToString(msg.msgtypeid()) 
                << " msg (key=" << msg.msgkey() << ")" 
                << ((msg.destclienttype() == 0 || msg.destclienttype() == _clientType) ? "" : StringUtils::Format(" to client (%d,%d)", msg.destclienttype(), msg.destclientid()))
                << ((msg.origclienttype() == 0) ? "" : StringUtils::Format(" from client (%d,%d)", msg.origclienttype(), msg.origclientid()));
 
-
-         asio::async_write(*_pSocket, asio::buffer(_pSendMsg->GetBuffer(), totalSize), asio::transfer_at_least(1),
-            _strand.wrap(std::bind(&CommHandler::HandleWrite, shared_from_this(),
-               std::placeholders::_1, std::placeholders::_2)));
-         return true;
+         return SendFrame(pFrame);
       }
    }
    return false;
 }
+bool CommHandler::SendFrame(const CommonMessages::EncodedFramePtr& pFrame)
+{
+   if (!QueueFrame(pFrame))
+      return false;
+   _msgSendCount++;
+   return true;
+}
+bool CommHandler::SendPublishedFrame(const CommonMessages::EncodedFramePtr& pFrame, const CommonMessages::SubscriptionParams& source)
+{
+   if (!QueueFrame(pFrame, &source))
+      return false;
+   _msgSendCount++;
+   return true;
+}
+void CommHandler::SetSendQueueLimits(const SendQueueLimits& limits)
+{
+   std::lock_guard<std::mutex> lock(_sendLock);
+   _sendQueueLimits = limits;
+   if (!limits.CanConflate())
+      _conflationIndex.clear();
+}
+SendQueueLimits CommHandler::GetSendQueueLimits()
+{
+   std::lock_guard<std::mutex> lock(_sendLock);
+   return _sendQueueLimits;
+}
+bool CommHandler::QueueFrame(const CommonMessages::EncodedFramePtr& pFrame, const CommonMessages::SubscriptionParams* pSource)
+{
+   //once it is disconnecting the frame would only be thrown away with the send queue, so say it was not sent
+   if (IsStopped() || _pSocket == nullptr || pFrame == nullptr || !IsConnected())
+      return false;
+
+   bool startWrite = false;
+   bool disconnect = false;
+   {
+      std::lock_guard<std::mutex> lock(_sendLock);
+      //priority frames jump the bulk queue so they are never conflated into a place in it, and control frames
+      //are never dropped; they are small and what senders wait on.  Anything else counts toward the limits,
+      //or a sender could bypass them by marking its messages as priorities or replies.
+      auto isPriority = pFrame->IsPriority();
+      auto isControl = pFrame->IsControl();
+      if (pSource != nullptr)
+         _publishedFrameCount++;
+      if (pSource != nullptr && !isPriority)
+      {
+         if (_sendQueueLimits.ConflatesTopic(pSource->_topic) && ConflateFrame(pFrame, *pSource))
+         {
+            _conflatedFrameCount++;
+            _lastSendMS = GetSteadyMS();
+            return true;
+         }
+      }
+      if (!isControl && IsOverSendQueueLimits(pFrame->GetSize()))
+      {
+         switch (_sendQueueLimits._policy)
+         {
+            case SlowConsumerPolicy::Disconnect:
+               disconnect = true;
+               break;
+            case SlowConsumerPolicy::Conflate:
+               if (pSource != nullptr && !isPriority && ConflateFrame(pFrame, *pSource))
+               {
+                  _conflatedFrameCount++;
+                  _lastSendMS = GetSteadyMS();
+                  return true;
+               }
+               //falls through - nothing queued from source to replace so make room as DropOldest
+            case SlowConsumerPolicy::DropOldest:
+               //fails if the frames being written alone fill the queue
+               if (!DropOldestFrames(pFrame->GetSize()))
+               {
+                  _droppedFrameCount++;
+                  return false;
+               }
+               break;
+            case SlowConsumerPolicy::DropNewest:
+               _droppedFrameCount++;
+               return false;
+         }
+      }
+      if (!disconnect)
+      {
+         _lastSendMS = GetSteadyMS();
+         if (isPriority)
+         {
+            _prioritySendQueue.push_back(pFrame);
+            _priorityFrameCount++;
+         }
+         else
+         {
+            QueuedFrame queued;
+            queued._pFrame = pFrame;
+            queued._hasSource = pSource != nullptr;
+            if (queued._hasSource)
+            {
+               queued._source = *pSource;
+               if (_sendQueueLimits.CanConflate())
+                  _conflationIndex[*pSource] = _sendQueueHeadSeq + _sendQueue.size();
+            }
+            _sendQueue.push_back(std::move(queued));
+         }
+         auto depth = ++_sendQueueDepth;
+         _sendQueueBytes += (int64_t)pFrame->GetSize();
+         if (depth > _maxSendQueueDepth)
+            _maxSendQueueDepth = depth;
+         //only one write is in flight at a time; HandleWrite picks up anything queued behind it
+         if (!_writeInProgress)
+         {
+            _writeInProgress = true;
+            startWrite = true;
+         }
+      }
+   }
+   if (disconnect)
+   {
+      _droppedFrameCount++;
+      _strand.post(std::bind(&CommHandler::DisconnectSlowConsumer, shared_from_this()));
+      return false;
+   }
+   if (startWrite)
+      _strand.dispatch(std::bind(&CommHandler::StartWrite, shared_from_this()));
+   return true;
+}
+bool CommHandler::IsOverSendQueueLimits(size_t size) const
+{
+   return (_sendQueueLimits._maxFrames > 0 && _sendQueueDepth.load() + 1 > (int64_t)_sendQueueLimits._maxFrames)
+         || (_sendQueueLimits._maxBytes > 0 && _sendQueueBytes.load() + (int64_t)size > (int64_t)_sendQueueLimits._maxBytes);
+}
+bool CommHandler::DropOldestFrames(size_t size)
+{
+   while (!_sendQueue.empty() && IsOverSendQueueLimits(size))
+   {
+      auto pDropped = PopSendQueueFront();
+      _sendQueueDepth--;
+      _sendQueueBytes -= (int64_t)pDropped->GetSize();
+      _droppedFrameCount++;
+   }
+   return !IsOverSendQueueLimits(size);
+}
+bool CommHandler::ConflateFrame(const CommonMessages::EncodedFramePtr& pFrame, const CommonMessages::SubscriptionParams& source)
+{
+   auto find = _conflationIndex.find(source);
+   if (find == _conflationIndex.end())
+      return false;
+   //replaced where it is queued so it keeps its place relative to the other sources
+   auto& queued = _sendQueue[(size_t)(find->second - _sendQueueHeadSeq)];
+   _sendQueueBytes += (int64_t)pFrame->GetSize() - (int64_t)queued._pFrame->GetSize();
+   queued._pFrame = pFrame;
+   return true;
+}
+CommonMessages::EncodedFramePtr CommHandler::PopSendQueueFront()
+{
+   auto& queued = _sendQueue.front();
+   if (queued._hasSource)
+   {
+      //once it leaves the queue a later frame from the same source has to be queued behind it
+      auto find = _conflationIndex.find(queued._source);
+      if (find != _conflationIndex.end() && find->second == _sendQueueHeadSeq)
+         _conflationIndex.erase(find);
+   }
+   auto pFrame = std::move(queued._pFrame);
+   _sendQueue.pop_front();
+   _sendQueueHeadSeq++;
+   return pFrame;
+}
+void CommHandler::DisconnectSlowConsumer()
+{
+   if (IsConnected() && !IsStopped())
+   {
+      LOG_MESSAGE(Logging::LogLevels::WARNING_LVL) << GetName() << ": Send queue over its limits (" << GetSendQueueDepth() << " frames, " << GetSendQueueBytes() << " bytes) - disconnecting slow consumer";
+      Disconnect(DisconnectReason::SlowConsumer);
+   }
+}
+void CommHandler::StartWrite()
+{
+   std::lock_guard<std::mutex> lock(_sendLock);
+   if ((_prioritySendQueue.empty() && _sendQueue.empty()) || _pSocket == nullptr)
+   {
+      _writeInProgress = false;
+      return;
+   }
+   while (!_prioritySendQueue.empty() && _framesInFlight.size() < MAX_FRAMES_PER_WRITE)
+   {
+      _writeBuffers.push_back(asio::buffer(_prioritySendQueue.front()->GetData(), _prioritySendQueue.front()->GetSize()));
+      _framesInFlight.push_back(std::move(_prioritySendQueue.front()));
+      _prioritySendQueue.pop_front();
+   }
+   size_t bulkBytes = 0;
+   while (!_sendQueue.empty() && _framesInFlight.size() < MAX_FRAMES_PER_WRITE && bulkBytes < MAX_BULK_BYTES_PER_WRITE)
+   {
+      auto pFrame = PopSendQueueFront();
+      bulkBytes += pFrame->GetSize();
+      _writeBuffers.push_back(asio::buffer(pFrame->GetData(), pFrame->GetSize()));
+      _framesInFlight.push_back(std::move(pFrame));
+   }
+   _writeCount++;
+   _writeStartMS = GetSteadyMS();
+   if (_sendQueueLimits._writeStallMS > 0 && !_isWriteStallCheckPending)
+   {
+      _isWriteStallCheckPending = true;
+      ScheduleWriteStallCheck(_livenessGeneration, _sendQueueLimits._writeStallMS);
+   }
+   asio::async_write(*_pSocket, _writeBuffers,
+      _strand.wrap(std::bind(&CommHandler::HandleWrite, shared_from_this(),
+         std::placeholders::_1, std::placeholders::_2)));
+}
 void CommHandler::HandleWrite(const boost::system::error_code& error, size_t /*bytes_transferred*/)
 {
+   {
+      std::lock_guard<std::mutex> lock(_sendLock);
+      for (auto& pFrame : _framesInFlight)
+      {
+         _sendQueueDepth--;
+         _sendQueueBytes -= (int64_t)pFrame->GetSize();
+      }
+      _framesInFlight.clear();
+      _writeBuffers.clear();
+   }
+   _isSlowConsumer = false;
    if (error)
    {
       if ((boost::asio::error::eof == error) ||
@@ -326,6 +764,81 @@ void CommHandler::HandleWrite(const boost::system::error_code& error, size_t /*b
    {
       LOG_MESSAGE(Logging::LogLevels::TRACE_LVL) << GetName() << ": sent message.";
    }
+
+   bool startWrite = false;
+   {
+      std::lock_guard<std::mutex> lock(_sendLock);
+      if (_prioritySendQueue.empty() && _sendQueue.empty())
+         _writeInProgress = false;
+      else
+         startWrite = true;
+   }
+   if (startWrite)
+      StartWrite();
+}
+void CommHandler::ClearSendQueue()
+{
+   std::lock_guard<std::mutex> lock(_sendLock);
+   for (auto& queued : _sendQueue)
+   {
+      _sendQueueDepth--;
+      _sendQueueBytes -= (int64_t)queued._pFrame->GetSize();
+   }
+   for (auto& pFrame : _prioritySendQueue)
+   {
+      _sendQueueDepth--;
+      _sendQueueBytes -= (int64_t)pFrame->GetSize();
+   }
+   _prioritySendQueue.clear();
+   _sendQueueHeadSeq += _sendQueue.size();
+   _sendQueue.clear();
+   _conflationIndex.clear();
+}
+void CommHandler::ScheduleWriteStallCheck(int generation, uint32_t delayMS)
+{
+   std::weak_ptr<CommHandler> pWeakThis = shared_from_this();
+   Matrix::Common::TimerWheel::Instance().Schedule(delayMS, [pWeakThis, generation]()
+   {
+      auto pThis = pWeakThis.lock();
+      if (pThis != nullptr && pThis->_livenessGeneration == generation)
+         pThis->_strand.post(std::bind(&CommHandler::CheckWriteStall, pThis, generation));
+   });
+}
+void CommHandler::CheckWriteStall(int generation)
+{
+   bool writeInProgress;
+   uint32_t writeStallMS;
+   {
+      std::lock_guard<std::mutex> lock(_sendLock);
+      writeInProgress = _writeInProgress;
+      writeStallMS = _sendQueueLimits._writeStallMS;
+   }
+   if (generation != _livenessGeneration || !writeInProgress || writeStallMS == 0 || !IsConnected() || IsStopped())
+   {
+      _isWriteStallCheckPending = false;
+      return;
+   }
+   auto writeMS = GetSteadyMS() - _writeStartMS;
+   if (writeMS < (int64_t)writeStallMS)
+   {
+      ScheduleWriteStallCheck(generation, (uint32_t)((int64_t)writeStallMS - writeMS));
+      return;
+   }
+   //the next write schedules a check again
+   _isWriteStallCheckPending = false;
+   if (!_isSlowConsumer.exchange(true))
+   {
+      _writeStallCount++;
+      LOG_MESSAGE(Logging::LogLevels::WARNING_LVL) << GetName() << ": Write has not completed for " << writeMS << " ms (" << GetSendQueueDepth() << " frames, " << GetSendQueueBytes() << " bytes queued) - slow consumer";
+      try
+      {
+         _socketStateChangeEvent(_socketState, _socketState, DisconnectReason::WriteStalled);
+      }
+      catch (const std::exception& ex)
+      {
+         LOG_MESSAGE(Logging::LogLevels::DEBUG_LVL) << GetName() << ": Error raising write stalled - " << ex.what();
+      }
+   }
 }
 bool CommHandler::CheckConnectionChanged(SocketState newState, DisconnectReason reason)
 {
@@ -337,6 +850,14 @@ bool CommHandler::CheckConnectionChanged(SocketState newState, DisconnectReason
       auto oldConnected = IsConnected();
       _socketState = newState;
       _disconnectReason = reason;
+      //counted for as long as it is connected, so the pool can put new connections on the least busy context
+      if (oldConnected != IsConnected())
+      {
+         if (IsConnected())
+            _pContextHandler->AddConnection();
+         else
+            _pContextHandler->RemoveConnection();
+      }
       try
       {
          _socketStateChangeEvent(oldState, newState, reason);
@@ -18,6 +18,7 @@ ContextHandler::ContextHandler()
    : WorkerThread("ContextHandler")
 #endif
    , _workGuard(boost::asio::make_work_guard(_ioContext))
+   , _connectionCount(0)
 {
 }
 boost::asio::io_context& ContextHandler::GetIOContext()
@@ -0,0 +1,80 @@
+#include "IncludeBoostASIO.h"
+#include <thread>
+
+#include "ContextPool.h"
+#include "Logger.h"
+
+using namespace Matrix::Common;
+using namespace Matrix::MsgService::CommunicationUtils;
+
+namespace
+{
+   size_t GetNumContexts(size_t numContexts)
+   {
+      if (numContexts == 0)
+         numContexts = std::thread::hardware_concurrency();
+      return numContexts == 0 ? 1 : numContexts;
+   }
+}
+
+#ifdef USING_SSL
+ContextPool::ContextPool(size_t numContexts, boost::asio::ssl::context& sslContext)
+{
+   numContexts = GetNumContexts(numContexts);
+   for (size_t index = 0; index < numContexts; index++)
+      _contextHandlers.push_back(std::make_shared<ContextHandler>(sslContext));
+}
+#else
+ContextPool::ContextPool(size_t numContexts)
+{
+   numContexts = GetNumContexts(numContexts);
+   for (size_t index = 0; index < numContexts; index++)
+      _contextHandlers.push_back(std::make_shared<ContextHandler>());
+}
+#endif
+ContextPool::~ContextPool()
+{
+   ShutDown();
+}
+
+void ContextPool::StartThreads()
+{
+   LOG_MESSAGE(Logging::LogLevels::INFO_LVL) << "Starting " << _contextHandlers.size() << " IO threads";
+   for (auto& pContextHandler : _contextHandlers)
+      pContextHandler->StartThread();
+}
+void ContextPool::ShutDown()
+{
+   for (auto& pContextHandler : _contextHandlers)
+   {
+      if (!pContextHandler->IsShuttingDown())
+      {
+         pContextHandler->ShutDown();
+         pContextHandler->WaitForShutdown(5);
+      }
+   }
+}
+std::shared_ptr<IContextHandler> ContextPool::GetContextHandler(size_t index)
+{
+   return _contextHandlers[index % _contextHandlers.size()];
+}
+std::shared_ptr<IContextHandler> ContextPool::GetLeastLoaded()
+{
+   size_t bestIndex = 0;
+   auto bestLoad = GetLoad(0);
+   for (size_t index = 1; index < _contextHandlers.size() && bestLoad > 0; index++)
+   {
+      auto load = GetLoad(index);
+      if (load < bestLoad)
+      {
+         bestIndex = index;
+         bestLoad = load;
+      }
+   }
+   return _contextHandlers[bestIndex];
+}
+size_t ContextPool::GetLoad(size_t index)
+{
+   auto count = _contextHandlers[index % _contextHandlers.size()]->GetConnectionCount();
+   return count > 0 ? (size_t)count : 0;
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include <vector>
+#include <google/protobuf/repeated_field.h>
 
 #include "../stdafx.h"
 
@@ -20,6 +21,7 @@ namespace CommunicationUtils
    class ISubscriberMessageLists
    {
    public:
+      virtual ~ISubscriberMessageLists() {}
       /// <summary>
       /// Adds a topic subscription to the lists
       /// </summary>
@@ -67,26 +69,6 @@ namespace CommunicationUtils
       /// <returns>list of messages that were last sent more than numSeconds ago</returns>
       virtual std::vector<Matrix::MsgService::CommonMessages::Header> GetMessages(int clientType, int clientID, int numSeconds) = 0;
 
-      /// <summary>
-      /// Adds msg.msgKey to the list of msgKeys that need to be acked
-      /// for each subscribing client
-      /// </summary>
-      /// <param name="msg">the message to add to the list of keys that need to be acked</param>
-      virtual void AddToNeedToAckList(const Matrix::MsgService::CommonMessages::Header* pMsg) = 0;
-      /// <summary>
-      /// Removes msg keys from the list of msg keys that need to be acked
-      /// </summary>
-      /// <param name="clientType">type of client</param>
-      /// <param name="clientID">id of client</param>
-      /// <param name="msgKeyList">msg keys to remove</param>
-      virtual void RemoveFromNeedToAckList(int clientType, int clientID, std::vector<int> msgKeyList) = 0;
-      /// <summary>
-      /// Gets the list of msg keys that need to be acked
-      /// </summary>
-      /// <param name="clientType">type of client</param>
-      /// <param name="clientID">id of client</param>
-      /// <returns>list of msg keys that need to be acked</returns>
-      virtual std::vector<int> GetNeedToAckList(int clientType, int clientID) = 0;
       /// <summary>
       /// Sets/clears the online flag for this client
       /// </summary>
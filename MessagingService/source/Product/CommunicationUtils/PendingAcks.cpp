@@ -0,0 +1,120 @@
+#include <algorithm>
+#include "PendingAcks.h"
+
+using namespace Matrix::MsgService::CommunicationUtils;
+namespace CommonMessages = Matrix::MsgService::CommonMessages;
+
+PendingAcks::PendingAcks()
+   : _count(0)
+{
+}
+
+size_t PendingAcks::Add(int clientType, int clientID, int msgKey)
+{
+   std::lock_guard<std::mutex> lock(_lock);
+   auto& keys = _keys[CommonMessages::SubscriptionParams(clientType, clientID)];
+   keys.push_back(msgKey);
+   _count++;
+   return keys.size();
+}
+
+size_t PendingAcks::Take(int clientType, int clientID, CommonMessages::Header* pMsg, std::vector<int>* pKeys)
+{
+   std::vector<int> keys;
+   {
+      std::lock_guard<std::mutex> lock(_lock);
+      auto find = _keys.find(CommonMessages::SubscriptionParams(clientType, clientID));
+      if (find == _keys.end())
+         return 0;
+      keys.swap(find->second);
+      _keys.erase(find);
+      _count -= keys.size();
+   }
+   AddAckKeys(keys, pMsg);
+   auto numKeys = keys.size();
+   if (pKeys != nullptr)
+      pKeys->swap(keys);
+   return numKeys;
+}
+
+void PendingAcks::Restore(int clientType, int clientID, const std::vector<int>& keys)
+{
+   if (keys.empty())
+      return;
+   std::lock_guard<std::mutex> lock(_lock);
+   auto& pending = _keys[CommonMessages::SubscriptionParams(clientType, clientID)];
+   pending.insert(pending.end(), keys.begin(), keys.end());
+   _count += keys.size();
+}
+
+std::vector<CommonMessages::SubscriptionParams> PendingAcks::GetClients()
+{
+   std::vector<CommonMessages::SubscriptionParams> clients;
+   std::lock_guard<std::mutex> lock(_lock);
+   clients.reserve(_keys.size());
+   for (auto& entry : _keys)
+      clients.push_back(entry.first);
+   return clients;
+}
+
+size_t PendingAcks::GetCount()
+{
+   std::lock_guard<std::mutex> lock(_lock);
+   return _count;
+}
+
+void PendingAcks::Clear()
+{
+   std::lock_guard<std::mutex> lock(_lock);
+   _keys.clear();
+   _count = 0;
+}
+
+void PendingAcks::AddAckKeys(std::vector<int>& keys, CommonMessages::Header* pMsg)
+{
+   //keys normally arrive in order, so this is usually already sorted
+   if (!std::is_sorted(keys.begin(), keys.end()))
+      std::sort(keys.begin(), keys.end());
+   size_t start = 0;
+   while (start < keys.size())
+   {
+      //find the end of the run of consecutive keys (duplicates are part of the run)
+      auto end = start + 1;
+      while (end < keys.size() && (keys[end] == keys[end - 1] || (int64_t)keys[end] == (int64_t)keys[end - 1] + 1))
+         end++;
+      //every key from first to last is in the run; a receiver ignores a range over MAX_RANGE_SIZE keys,
+      //so a longer run is split into ranges of at most that many
+      int64_t runLast = keys[end - 1];
+      for (int64_t first = keys[start]; first <= runLast; )
+      {
+         auto last = std::min(runLast, first + MAX_RANGE_SIZE - 1);
+         if (last - first + 1 >= MIN_RANGE_SIZE)
+         {
+            pMsg->add_ackkeyranges((int)first);
+            pMsg->add_ackkeyranges((int)last);
+         }
+         else
+         {
+            for (auto key = first; key <= last; key++)
+               pMsg->add_ackkeys((int)key);
+         }
+         first = last + 1;
+      }
+      start = end;
+   }
+}
+
+void PendingAcks::GetAckedKeys(const CommonMessages::Header& msg, google::protobuf::RepeatedField<int>* pKeys)
+{
+   *pKeys = msg.ackkeys();
+   auto& ranges = msg.ackkeyranges();
+   for (int index = 0; index + 1 < ranges.size(); index += 2)
+   {
+      int64_t first = ranges.Get(index);
+      int64_t last = ranges.Get(index + 1);
+      if (last < first || last - first >= MAX_RANGE_SIZE)
+         continue;
+      for (auto key = first; key <= last; key++)
+         pKeys->Add((int)key);
+   }
+}
@@ -1,48 +1,354 @@
+#include <chrono>
 #include "MessageUtils.h"
 #include "SubscriberMessageLists.h"
 
 using namespace Matrix::MsgService::CommunicationUtils;
+namespace CommonMessages = Matrix::MsgService::CommonMessages;
 
-bool SubscriberMessageLists::AddSubscription(int /*clientType*/, int /*clientID*/)
+namespace
 {
-   return false;
+   const int MIN_SLOT_BITS = 4;
+   const size_t MIN_TIMES = 16;
+   //values of the presence table
+   const uint8_t PRESENCE_EMPTY = 0;
+   const uint8_t PRESENCE_OFFLINE = 1;
+   const uint8_t PRESENCE_ONLINE = 2;
+
+   int64_t GetSteadyMS()
+   {
+      return (int64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+   }
+   uint64_t GetPresenceKey(int clientType, int clientID)
+   {
+      return ((uint64_t)(uint32_t)clientType << 32) | (uint32_t)clientID;
+   }
+   //multiplicative hashing spreads the sequential keys and ids over the table
+   size_t HashPresenceKey(uint64_t key, size_t mask)
+   {
+      return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+   }
+}
+
+//****************************************
+// ClientMessages
+//****************************************
+SubscriberMessageLists::ClientMessages::ClientMessages()
+   : _slots((size_t)1 << MIN_SLOT_BITS)
+   , _slotBits(MIN_SLOT_BITS)
+   , _count(0)
+   , _nextSequence(1)
+   , _sentTimes(MIN_TIMES)
+   , _timesHead(0)
+   , _timesCount(0)
+{
+}
+
+size_t SubscriberMessageLists::ClientMessages::GetHome(int msgKey) const
+{
+   return (size_t)(((uint32_t)msgKey * 0x9E3779B9u) >> (32 - _slotBits));
+}
+
+size_t SubscriberMessageLists::ClientMessages::FindSlot(int msgKey) const
+{
+   auto mask = _slots.size() - 1;
+   auto index = GetHome(msgKey);
+   while (_slots[index]._sequence != 0 && _slots[index]._msgKey != msgKey)
+      index = (index + 1) & mask;
+   return index;
+}
+
+void SubscriberMessageLists::ClientMessages::Grow()
+{
+   std::vector<SentMessage> oldSlots;
+   oldSlots.swap(_slots);
+   _slotBits++;
+   _slots.resize((size_t)1 << _slotBits);
+   for (auto& slot : oldSlots)
+   {
+      if (slot._sequence != 0)
+         _slots[FindSlot(slot._msgKey)] = std::move(slot);
+   }
+}
+
+bool SubscriberMessageLists::ClientMessages::Add(CommonMessages::Header& msg, int64_t nowMS)
+{
+   //keep the load under 3/4 so probes stay short
+   if ((_count + 1) * 4 > _slots.size() * 3)
+      Grow();
+   auto msgKey = msg.msgkey();
+   auto& slot = _slots[FindSlot(msgKey)];
+   bool added = slot._sequence == 0;
+   if (added)
+   {
+      _count++;
+      if (_freeMessages.empty())
+      {
+         slot._message = (uint32_t)_messages.size();
+         _messages.emplace_back();
+      }
+      else
+      {
+         slot._message = _freeMessages.back();
+         _freeMessages.pop_back();
+      }
+   }
+   slot._msgKey = msgKey;
+   slot._sequence = _nextSequence++;
+   _messages[slot._message].Swap(&msg);
+   SentTime sentTime;
+   sentTime._sequence = slot._sequence;
+   sentTime._msgKey = msgKey;
+   sentTime._sentMS = nowMS;
+   PushSentTime(sentTime);
+   return added;
+}
+
+bool SubscriberMessageLists::ClientMessages::Remove(int msgKey)
+{
+   auto mask = _slots.size() - 1;
+   auto hole = FindSlot(msgKey);
+   if (_slots[hole]._sequence == 0)
+      return false;
+   //the payload is released now; the entry may not be reused for a long time after a burst
+   _messages[_slots[hole]._message] = CommonMessages::Header();
+   _freeMessages.push_back(_slots[hole]._message);
+   _count--;
+   //messages are normally acked in the order they were sent, so this is usually the oldest entry
+   if (_timesCount > 0 && GetSentTime(0)._sequence == _slots[hole]._sequence)
+   {
+      _timesHead = (_timesHead + 1) & (_sentTimes.size() - 1);
+      _timesCount--;
+   }
+   //backward shift deletion: move up each following entry that may fill the hole, so no tombstones are needed
+   auto index = hole;
+   for (;;)
+   {
+      index = (index + 1) & mask;
+      if (_slots[index]._sequence == 0)
+         break;
+      auto home = GetHome(_slots[index]._msgKey);
+      if (((index - home) & mask) >= ((index - hole) & mask))
+      {
+         _slots[hole] = std::move(_slots[index]);
+         hole = index;
+      }
+   }
+   _slots[hole] = SentMessage();
+   return true;
+}
+
+void SubscriberMessageLists::ClientMessages::GetSentBefore(int64_t cutoffMS, std::vector<CommonMessages::Header>* pMsgs) const
+{
+   for (size_t index = 0; index < _timesCount; index++)
+   {
+      auto& sentTime = GetSentTime(index);
+      if (sentTime._sentMS > cutoffMS)
+         break;
+      auto& slot = _slots[FindSlot(sentTime._msgKey)];
+      if (slot._sequence == sentTime._sequence)
+         pMsgs->push_back(_messages[slot._message]);
+   }
+}
+
+size_t SubscriberMessageLists::ClientMessages::GetBytes() const
+{
+   size_t bytes = 0;
+   for (auto& msg : _messages)
+      bytes += msg.ByteSizeLong();
+   return bytes;
+}
+
+bool SubscriberMessageLists::ClientMessages::IsCurrent(const SentTime& sentTime) const
+{
+   return _slots[FindSlot(sentTime._msgKey)]._sequence == sentTime._sequence;
+}
+
+void SubscriberMessageLists::ClientMessages::PushSentTime(const SentTime& sentTime)
+{
+   if (_timesCount == _sentTimes.size())
+   {
+      RebuildTimes(_sentTimes.size());
+      //grow when dropping the stale entries leaves it more than half full, so rebuilds stay rare
+      if (_timesCount * 2 > _sentTimes.size())
+         RebuildTimes(_sentTimes.size() * 2);
+   }
+   _sentTimes[(_timesHead + _timesCount) & (_sentTimes.size() - 1)] = sentTime;
+   _timesCount++;
 }
-bool SubscriberMessageLists::RemoveSubscription(int /*clientType*/, int /*clientID*/)
+
+void SubscriberMessageLists::ClientMessages::RebuildTimes(size_t capacity)
 {
-   return false;
+   std::vector<SentTime> sentTimes(capacity);
+   size_t count = 0;
+   for (size_t index = 0; index < _timesCount; index++)
+   {
+      auto& sentTime = GetSentTime(index);
+      if (IsCurrent(sentTime))
+         sentTimes[count++] = sentTime;
+   }
+   _sentTimes.swap(sentTimes);
+   _timesHead = 0;
+   _timesCount = count;
 }
 
-bool SubscriberMessageLists::AddSentMessage(const Matrix::MsgService::CommonMessages::Header msg) 
+
+//****************************************
+// SubscriberMessageLists
+//****************************************
+SubscriberMessageLists::SubscriberMessageLists()
+{
+}
+SubscriberMessageLists::~SubscriberMessageLists()
 {
-   return false;
 }
 
-bool SubscriberMessageLists::RemoveSentMessages(int /*clientType*/, int /*clientID*/, const google::protobuf::RepeatedField<int>& /*ackKeys*/)
+SubscriberMessageLists::Stripe& SubscriberMessageLists::GetStripe(int clientType, int clientID)
 {
-   return false;
+   auto hash = CommonMessages::SubscriptionParamsHasher()(CommonMessages::SubscriptionParams(clientType, clientID));
+   return _stripes[(hash >> 7) % NUM_STRIPES];
 }
 
-bool SubscriberMessageLists::RemoveSentMessage(int /*clientType*/, int /*clientID*/, int /*msgKey*/)
+SubscriberMessageLists::ClientMessages* SubscriberMessageLists::GetClient(Stripe& stripe, int clientType, int clientID, bool create)
 {
-   return false;
+   CommonMessages::SubscriptionParams params(clientType, clientID);
+   auto find = stripe._clients.find(params);
+   if (find != stripe._clients.end())
+      return find->second.get();
+   if (!create)
+      return nullptr;
+   auto pClient = new ClientMessages();
+   stripe._clients[params] = std::unique_ptr<ClientMessages>(pClient);
+   return pClient;
 }
 
-std::vector<Matrix::MsgService::CommonMessages::Header> SubscriberMessageLists::GetMessages(int /*clientType*/, int /*clientID*/, int /*numSeconds*/)
+bool SubscriberMessageLists::AddSubscription(int clientType, int clientID)
+{
+   auto& stripe = GetStripe(clientType, clientID);
+   std::lock_guard<std::mutex> lock(stripe._lock);
+   if (GetClient(stripe, clientType, clientID, false) != nullptr)
+      return false;
+   GetClient(stripe, clientType, clientID, true);
+   return true;
+}
+bool SubscriberMessageLists::RemoveSubscription(int clientType, int clientID)
 {
+   std::unique_ptr<ClientMessages> pClient;
+   auto& stripe = GetStripe(clientType, clientID);
+   {
+      std::lock_guard<std::mutex> lock(stripe._lock);
+      auto find = stripe._clients.find(CommonMessages::SubscriptionParams(clientType, clientID));
+      if (find == stripe._clients.end())
+         return false;
+      //free the messages outside the lock
+      pClient = std::move(find->second);
+      stripe._clients.erase(find);
+   }
+   return true;
+}
+
+bool SubscriberMessageLists::AddSentMessage(Matrix::MsgService::CommonMessages::Header msg)
+{
+   auto clientType = msg.destclienttype();
+   auto clientID = msg.destclientid();
+   if (clientType <= 0)
+      return false;
+   //msg is already a copy, so it is swapped into the client's slab rather than copied again;
+   //whatever the reused entry held is freed with msg, outside the lock
+   auto& stripe = GetStripe(clientType, clientID);
+   std::lock_guard<std::mutex> lock(stripe._lock);
+   //read the time under the lock so each client's messages are queued in time order
+   return GetClient(stripe, clientType, clientID, true)->Add(msg, GetSteadyMS());
+}
+
+size_t SubscriberMessageLists::RemoveKeys(int clientType, int clientID, const int* pKeys, int numKeys)
+{
+   auto& stripe = GetStripe(clientType, clientID);
+   std::lock_guard<std::mutex> lock(stripe._lock);
+   auto pClient = GetClient(stripe, clientType, clientID, false);
+   if (pClient == nullptr)
+      return 0;
+   size_t numRemoved = 0;
+   for (int index = 0; index < numKeys; index++)
+   {
+      if (pClient->Remove(pKeys[index]))
+         numRemoved++;
+   }
+   return numRemoved;
+}
+
+bool SubscriberMessageLists::RemoveSentMessages(int clientType, int clientID, const google::protobuf::RepeatedField<int>& ackKeys)
+{
+   if (ackKeys.size() == 0)
+      return false;
+   auto numRemoved = RemoveKeys(clientType, clientID, ackKeys.data(), ackKeys.size());
+   //a message sent to every client of a type is done once one of them acks it
+   if (clientID != 0 && (int)numRemoved < ackKeys.size())
+      numRemoved += RemoveKeys(clientType, 0, ackKeys.data(), ackKeys.size());
+   return numRemoved > 0;
+}
+
+bool SubscriberMessageLists::RemoveSentMessage(int clientType, int clientID, int msgKey)
+{
+   if (RemoveKeys(clientType, clientID, &msgKey, 1) > 0)
+      return true;
+   return clientID != 0 && RemoveKeys(clientType, 0, &msgKey, 1) > 0;
+}
+
+std::vector<Matrix::MsgService::CommonMessages::Header> SubscriberMessageLists::GetMessages(int clientType, int clientID, int numSeconds)
+{
+   //resends are rare next to sends, so the copies are made under the lock rather than every send paying to share the message
    std::vector<Matrix::MsgService::CommonMessages::Header> list;
+   auto& stripe = GetStripe(clientType, clientID);
+   std::lock_guard<std::mutex> lock(stripe._lock);
+   auto pClient = GetClient(stripe, clientType, clientID, false);
+   if (pClient != nullptr)
+      pClient->GetSentBefore(GetSteadyMS() - (int64_t)numSeconds * 1000, &list);
    return list;
 }
 
-void SubscriberMessageLists::AddToNeedToAckList(const Matrix::MsgService::CommonMessages::Header* const /*pMsg*/)
+size_t SubscriberMessageLists::GetSentMessageCount(int clientType, int clientID)
 {
+   auto& stripe = GetStripe(clientType, clientID);
+   std::lock_guard<std::mutex> lock(stripe._lock);
+   auto pClient = GetClient(stripe, clientType, clientID, false);
+   return pClient == nullptr ? 0 : pClient->GetCount();
 }
-void SubscriberMessageLists::RemoveFromNeedToAckList(int /*clientType*/, int /*clientID*/, std::vector<int> /*msgKeyList*/)
+
+size_t SubscriberMessageLists::GetSentMessageBytes(int clientType, int clientID)
 {
+   auto& stripe = GetStripe(clientType, clientID);
+   std::lock_guard<std::mutex> lock(stripe._lock);
+   auto pClient = GetClient(stripe, clientType, clientID, false);
+   return pClient == nullptr ? 0 : pClient->GetBytes();
 }
-std::vector<int> SubscriberMessageLists::GetNeedToAckList(int /*clientType*/, int /*clientID*/)
+
+size_t SubscriberMessageLists::FindPresence(const Stripe& stripe, uint64_t key)
 {
-   std::vector<int> list;
-   return list;
+   auto mask = stripe._presenceKeys.size() - 1;
+   auto index = HashPresenceKey(key, mask);
+   while (stripe._presence[index] != PRESENCE_EMPTY && stripe._presenceKeys[index] != key)
+      index = (index + 1) & mask;
+   return index;
+}
+
+void SubscriberMessageLists::GrowPresence(Stripe& stripe)
+{
+   std::vector<uint64_t> oldKeys;
+   std::vector<uint8_t> oldPresence;
+   oldKeys.swap(stripe._presenceKeys);
+   oldPresence.swap(stripe._presence);
+   auto size = oldKeys.empty() ? (size_t)16 : oldKeys.size() * 2;
+   stripe._presenceKeys.resize(size);
+   stripe._presence.assign(size, PRESENCE_EMPTY);
+   for (size_t index = 0; index < oldKeys.size(); index++)
+   {
+      if (oldPresence[index] != PRESENCE_EMPTY)
+      {
+         auto newIndex = FindPresence(stripe, oldKeys[index]);
+         stripe._presenceKeys[newIndex] = oldKeys[index];
+         stripe._presence[newIndex] = oldPresence[index];
+      }
+   }
 }
 
 /// <summary>
@@ -51,8 +357,21 @@ std::vector<int> SubscriberMessageLists::GetNeedToAckList(int /*clientType*/, in
 /// <param name="clientType">type of client</param>
 /// <param name="clientID">id of client</param>
 /// <param name="isOnline">true to set online, false to set offline</param>
-void SubscriberMessageLists::SetClientOnLine(int /*clientType*/, int /*clientID*/, bool /*isOnline*/)
+void SubscriberMessageLists::SetClientOnLine(int clientType, int clientID, bool isOnline)
 {
+   auto key = GetPresenceKey(clientType, clientID);
+   auto& stripe = GetStripe(clientType, clientID);
+   std::lock_guard<std::mutex> lock(stripe._lock);
+   //clients are never removed, so the table only grows
+   if ((stripe._presenceCount + 1) * 2 > stripe._presence.size())
+      GrowPresence(stripe);
+   auto index = FindPresence(stripe, key);
+   if (stripe._presence[index] == PRESENCE_EMPTY)
+   {
+      stripe._presenceKeys[index] = key;
+      stripe._presenceCount++;
+   }
+   stripe._presence[index] = isOnline ? PRESENCE_ONLINE : PRESENCE_OFFLINE;
 }
 
 /// <summary>
@@ -60,7 +379,11 @@ void SubscriberMessageLists::SetClientOnLine(int /*clientType*/, int /*clientID*
 /// </summary>
 /// <param name="clientType">type of client</param>
 /// <param name="clientID">id of client</param>
-bool SubscriberMessageLists::IsClientOnline(int /*clientType*/, int /*clientID*/)
+bool SubscriberMessageLists::IsClientOnline(int clientType, int clientID)
 {
-   return false;
+   auto& stripe = GetStripe(clientType, clientID);
+   std::lock_guard<std::mutex> lock(stripe._lock);
+   if (stripe._presence.empty())
+      return false;
+   return stripe._presence[FindPresence(stripe, GetPresenceKey(clientType, clientID))] == PRESENCE_ONLINE;
 }
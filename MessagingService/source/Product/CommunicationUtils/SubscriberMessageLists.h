@@ -1,8 +1,14 @@
 #pragma once
+#include <stdint.h>
 #include <memory>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
 
-#include "../stdafx.h"
+#include "stdafx.h"
 #include "ISubscriberMessageLists.h"
+#include "MessageUtils.h"
+#include "SubscriptionParams.h"
 
 namespace Matrix
 {
@@ -12,9 +18,148 @@ namespace CommunicationUtils
 {
    /// <summary>
    /// maintains lists of messages that need to be acked
+   ///
+   /// Clients are spread over NUM_STRIPES stripes by hash, each with its own lock, so the io thread and
+   /// application threads only contend when they touch clients in the same stripe.  Within a stripe each
+   /// client sent to has an open addressing table of the messages waiting for an ack, keyed by msgKey,
+   /// and a ring buffer of the same messages in the order they were sent, so GetMessages only visits the
+   /// messages it returns.  The messages themselves are kept in a per client slab whose entries are reused,
+   /// so tracking a send does not allocate once the client has reached its usual number outstanding.
+   /// Whether each client is online is kept in a compact table of its own.
    /// </summary>
    class SubscriberMessageLists : public ISubscriberMessageLists
    {
+      //****************************************
+      // Class and Type definitions
+      //****************************************
+   private:
+      /// <summary>
+      /// A slot of the sent message table
+      /// </summary>
+      struct SentMessage
+      {
+         SentMessage() : _msgKey(0), _message(0), _sequence(0) {}
+         int _msgKey;
+         /// <summary>
+         /// Index of the message in the slab
+         /// </summary>
+         uint32_t _message;
+         /// <summary>
+         /// Set when the message was last sent, to tell its current entry in the time queue from older ones;
+         /// 0 for an empty slot
+         /// </summary>
+         uint64_t _sequence;
+      };
+      /// <summary>
+      /// An entry of the time queue; stale once the message has been removed or sent again
+      /// </summary>
+      struct SentTime
+      {
+         uint64_t _sequence;
+         int _msgKey;
+         int64_t _sentMS;
+      };
+      /// <summary>
+      /// Everything kept for one client
+      /// </summary>
+      class ClientMessages
+      {
+      public:
+         ClientMessages();
+         /// <summary>
+         /// Adds the message, or replaces the message with the same key and makes it the newest.
+         /// The message is swapped into the slab, leaving msg with whatever the entry held.
+         /// </summary>
+         /// <returns>true if it was added, false if it replaced one</returns>
+         bool Add(CommonMessages::Header& msg, int64_t nowMS);
+         /// <summary>
+         /// Removes the message with msgKey, emptying its slab entry for reuse
+         /// </summary>
+         /// <returns>true if it was removed, false if there was none</returns>
+         bool Remove(int msgKey);
+         /// <summary>
+         /// Adds copies of the messages last sent at or before cutoffMS to pMsgs, oldest first
+         /// </summary>
+         void GetSentBefore(int64_t cutoffMS, std::vector<CommonMessages::Header>* pMsgs) const;
+         size_t GetCount() const { return _count; }
+         /// <summary>
+         /// Gets the encoded size of every message in the slab, including entries free for reuse
+         /// </summary>
+         size_t GetBytes() const;
+      private:
+         /// <summary>
+         /// Gets the slot holding msgKey, or the empty slot where it would go
+         /// </summary>
+         size_t FindSlot(int msgKey) const;
+         size_t GetHome(int msgKey) const;
+         void Grow();
+         bool IsCurrent(const SentTime& sentTime) const;
+         const SentTime& GetSentTime(size_t index) const { return _sentTimes[(_timesHead + index) & (_sentTimes.size() - 1)]; }
+         void PushSentTime(const SentTime& sentTime);
+         /// <summary>
+         /// Rebuilds the time queue in capacity entries, keeping only its current entries
+         /// </summary>
+         void RebuildTimes(size_t capacity);
+         std::vector<SentMessage> _slots;
+         int _slotBits;
+         size_t _count;
+         uint64_t _nextSequence;
+         /// <summary>
+         /// The messages, indexed by their slots; entries in _freeMessages are not in use
+         /// </summary>
+         std::vector<CommonMessages::Header> _messages;
+         std::vector<uint32_t> _freeMessages;
+         /// <summary>
+         /// Ring buffer of _timesCount entries from _timesHead, oldest first; its size is a power of 2.
+         /// Stale entries are dropped from the front as the messages they were for are removed, and the rest when it fills.
+         /// </summary>
+         std::vector<SentTime> _sentTimes;
+         size_t _timesHead;
+         size_t _timesCount;
+      };
+      /// <summary>
+      /// The clients whose hashes fall in one stripe
+      /// </summary>
+      struct Stripe
+      {
+         Stripe() : _presenceCount(0) {}
+         std::mutex _lock;
+         std::unordered_map<CommonMessages::SubscriptionParams, std::unique_ptr<ClientMessages>, CommonMessages::SubscriptionParamsHasher> _clients;
+         /// <summary>
+         /// Open addressing table of client (type in the high 32 bits, id in the low) to whether it is online
+         /// </summary>
+         std::vector<uint64_t> _presenceKeys;
+         std::vector<uint8_t> _presence;
+         size_t _presenceCount;
+      };
+
+      //****************************************
+      // Constructors/Destructors
+      //****************************************
+   public:
+      /// <summary>
+      /// Initializes a new instance of the <see cref="SubscriberMessageLists"/> class.
+      /// </summary>
+      COMMUNICATIONUTILS_API SubscriberMessageLists();
+      COMMUNICATIONUTILS_API virtual ~SubscriberMessageLists();
+   private:
+      SubscriberMessageLists(const SubscriberMessageLists&);
+      SubscriberMessageLists& operator=(const SubscriberMessageLists&);
+
+      //****************************************
+      // Fields
+      //****************************************
+   public:
+      /// <summary>
+      /// Number of independently locked stripes the clients are spread over
+      /// </summary>
+      static const int NUM_STRIPES = 16;
+   private:
+      Stripe _stripes[NUM_STRIPES];
+
+      //****************************************
+      // Methods
+      //****************************************
    public:
       /// <summary>
       /// Adds a subscription to the lists
@@ -22,82 +167,92 @@ namespace CommunicationUtils
       /// <param name="clientType">type of client</param>
       /// <param name="clientID">id of client</param>
       /// <returns>true if it was added, false if it was already there</returns>
-      virtual bool AddSubscription(int clientType, int clientID) override;
+      COMMUNICATIONUTILS_API virtual bool AddSubscription(int clientType, int clientID) override;
       /// <summary>
-      /// Removes a subscription from the lists
+      /// Removes a subscription from the lists, along with the messages waiting for it to ack them
       /// </summary>
       /// <param name="clientType">type of client</param>
       /// <param name="clientID">id of client</param>
       /// <returns>true if it was removed, false if it was not there</returns>
-      virtual bool RemoveSubscription(int clientType, int clientID) override;
+      COMMUNICATIONUTILS_API virtual bool RemoveSubscription(int clientType, int clientID) override;
       /// <summary>
-      /// Add a message to each subscribers list to wait for an ack
+      /// Add a message to its destination's list to wait for an ack; only messages for a specific
+      /// client type are added.  Adding a key that is already there replaces the message and its sent time.
       /// </summary>
       /// <param name="msg">message to add</param>
       /// <returns>true if the message was added</returns>
-      virtual bool AddSentMessage(Matrix::MsgService::CommonMessages::Header msg) override;
+      COMMUNICATIONUTILS_API virtual bool AddSentMessage(Matrix::MsgService::CommonMessages::Header msg) override;
       /// <summary>
-      /// Removes each message with a key in ackKeys from the subscriber
+      /// Removes each message with a key in ackKeys from the subscriber, or from the messages sent to
+      /// every client of its type
       /// </summary>
       /// <param name="clientType">type of client</param>
       /// <param name="clientID">id of client</param>
       /// <param name="ackKeys">List of keys that have been acked</param>
-      /// <returns>true if the message was removed</returns>
-      virtual bool RemoveSentMessages(int clientType, int clientID, const google::protobuf::RepeatedField<int>& ackKeys) override;
+      /// <returns>true if a message was removed</returns>
+      COMMUNICATIONUTILS_API virtual bool RemoveSentMessages(int clientType, int clientID, const google::protobuf::RepeatedField<int>& ackKeys) override;
       /// <summary>
-      /// Remove a message with msgKey from the subscriber
+      /// Remove a message with msgKey from the subscriber, or from the messages sent to every client of its type
       /// </summary>
       /// <param name="clientType">type of client</param>
       /// <param name="clientID">id of client</param>
       /// <param name="msgKey">The key of the message that has been acked</param>
       /// <returns>true if the message was removed</returns>
-      virtual bool RemoveSentMessage(int clientType, int clientID, int msgKey) override;
+      COMMUNICATIONUTILS_API virtual bool RemoveSentMessage(int clientType, int clientID, int msgKey) override;
 
       /// <summary>
-      /// Gets a list of messages that were last sent more than numSeconds ago
+      /// Gets a list of messages that were last sent more than numSeconds ago, oldest first
       /// </summary>
       /// <param name="clientType">type of client</param>
       /// <param name="clientID">id of client</param>
       /// <param name="numSeconds">Number of seconds since they were last sent</param>
       /// <returns>list of messages that were last sent more than numSeconds ago</returns>
-      virtual std::vector<Matrix::MsgService::CommonMessages::Header> GetMessages(int clientType, int clientID, int numSeconds) override;
+      COMMUNICATIONUTILS_API virtual std::vector<Matrix::MsgService::CommonMessages::Header> GetMessages(int clientType, int clientID, int numSeconds) override;
 
       /// <summary>
-      /// Adds msg.msgKey to the list of msgKeys that need to be acked
-      /// for each subscribing client
-      /// </summary>
-      /// <param name="msg">the message to add to the list of keys that need to be acked</param>
-      virtual void AddToNeedToAckList(const Matrix::MsgService::CommonMessages::Header* pMsg);
-      /// <summary>
-      /// Removes msg keys from the list of msg keys that need to be acked
+      /// Sets/clears the online flag for this client
       /// </summary>
       /// <param name="clientType">type of client</param>
       /// <param name="clientID">id of client</param>
-      /// <param name="msgKeyList">msg keys to remove</param>
-      virtual void RemoveFromNeedToAckList(int clientType, int clientID, std::vector<int> msgKeyList) override;
+      /// <param name="isOnline">true to set online, false to set offline</param>
+      COMMUNICATIONUTILS_API void SetClientOnLine(int clientType, int clientID, bool isOnline) override;
       /// <summary>
-      /// Gets the list of msg keys that need to be acked
+      /// returns the online flag for this client; false for a client that has not been seen
       /// </summary>
       /// <param name="clientType">type of client</param>
       /// <param name="clientID">id of client</param>
-      /// <returns>list of msg keys that need to be acked</returns>
-      virtual std::vector<int> GetNeedToAckList(int clientType, int clientID) override;
+      COMMUNICATIONUTILS_API bool IsClientOnline(int clientType, int clientID) override;
       /// <summary>
-      /// Sets/clears the online flag for this client
+      /// Gets the number of messages waiting for the client to ack them
       /// </summary>
       /// <param name="clientType">type of client</param>
       /// <param name="clientID">id of client</param>
-      /// <param name="isOnline">true to set online, false to set offline</param>
-      void SetClientOnLine(int clientType, int clientID, bool isOnline) override;
+      COMMUNICATIONUTILS_API size_t GetSentMessageCount(int clientType, int clientID);
       /// <summary>
-      /// returns the online flag for this client
+      /// Gets the encoded size of the messages held for the client, including any left in entries free for reuse
       /// </summary>
       /// <param name="clientType">type of client</param>
       /// <param name="clientID">id of client</param>
-      bool IsClientOnline(int clientType, int clientID) override;
+      COMMUNICATIONUTILS_API size_t GetSentMessageBytes(int clientType, int clientID);
 
+   private:
+      Stripe& GetStripe(int clientType, int clientID);
+      /// <summary>
+      /// Gets the client's messages, creating them if create is true.  The stripe's lock must be held.
+      /// </summary>
+      ClientMessages* GetClient(Stripe& stripe, int clientType, int clientID, bool create);
+      /// <summary>
+      /// Removes the client's messages with the keys
+      /// </summary>
+      /// <returns>the number removed</returns>
+      size_t RemoveKeys(int clientType, int clientID, const int* pKeys, int numKeys);
+      /// <summary>
+      /// Gets the presence slot for key, or the empty slot where it would go.  The stripe's lock must be held.
+      /// </summary>
+      static size_t FindPresence(const Stripe& stripe, uint64_t key);
+      static void GrowPresence(Stripe& stripe);
    };
 
 }
 }
-}
\ No newline at end of file
+}
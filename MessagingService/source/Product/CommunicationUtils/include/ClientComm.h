@@ -8,6 +8,9 @@
 
 #include "IncludeBoostASIO.h"
 #include <memory>
+#include <atomic>
+#include <random>
+#include <vector>
 
 #include "../stdafx.h"
 #include "SharedFromThis.h"
@@ -17,6 +20,7 @@
 #include "SubscriptionParams.h"
 #include "IClientComm.h"
 #include "CountdownTimer.h"
+#include "PendingAcks.h"
 
 namespace asio = boost::asio;
 namespace CommonMessages = Matrix::MsgService::CommonMessages;
@@ -100,10 +104,10 @@ namespace CommunicationUtils
          /// <summary>
          /// Signal that the message was received and set the message
          /// </summary>
-         /// <param name="pMessage">the Message that was received</param>
-         void Signal(std::unique_ptr<CommonMessages::Header> pMessage)
+         /// <param name="pMessage">the Message that was received; copied off of the arena it was received on</param>
+         void Signal(CommonMessages::HeaderPtr pMessage)
          {
-            _pMessage = std::move(pMessage);
+            _pMessage = CommonMessages::MessageArena::ToHeap(std::move(pMessage));
             _ackEvent.notify_all();
          }
       };
@@ -120,7 +124,8 @@ namespace CommunicationUtils
       /// <param name="port">Port to use to connect</param>
       /// <param name="clientType">The type for this client</param>
       /// <param name="clientID">The ID for this client</param>
-      /// <param name="reconnectRetryTimeMS">Number of milliseconds to retry to connect when connection is lost</param>
+      /// <param name="reconnectRetryTimeMS">Number of milliseconds to wait before the first retry when the connection is lost or
+      ///    could not be made; the wait doubles (with jitter) after each failed attempt, up to the max reconnect retry time</param>
       /// <param name="name">The optional name for this client (for logging)</param>
       /// <param name="pLogonSubMsg">Additional Logon sub message to send with the logon message</param>
       /// <param name="trackSentMessages">True to track sent messages and resend if they are not acked (not fully implemented yet)</param>
@@ -138,11 +143,31 @@ namespace CommunicationUtils
       //****************************************
       // Fields
       //****************************************
+   public:
+      //default maximum time for one connection attempt to an endpoint
+      static const uint32_t DEFAULT_CONNECT_TIMEOUT_MS = 5000;
+      //default limit for the reconnect backoff
+      static const uint32_t DEFAULT_MAX_RECONNECT_RETRY_TIME_MS = 30000;
+      //default number of keys pending for one client that are flushed in an ACK message without waiting for the delay
+      static const size_t DEFAULT_MAX_PENDING_ACKS = 64;
+      //most keys that can be pending for one client; flushed as ackKeys that are not consecutive, they still fit in one message
+      static const size_t MAX_PENDING_ACKS = 65536;
    private:
       std::string _ipAddress;
       std::string _port;
       uint32_t _reconnectRetryTimeMS;
+      uint32_t _maxReconnectRetryTimeMS;
+      uint32_t _connectTimeoutMS;
+      bool _useTcpFastOpen;
       boost::asio::ip::tcp::resolver _resolver;
+      //endpoints from the last resolve; cleared when none of them can be connected so the next attempt resolves again
+      std::vector<boost::asio::ip::tcp::endpoint> _endpoints;
+      boost::asio::steady_timer _connectTimer;
+      //incremented for each step of a connect so stale handlers can be ignored
+      int _connectAttempt;
+      //number of connect attempts that have failed since the last connection; drives the backoff
+      int _connectFailures;
+      std::minstd_rand _random;
       std::unique_ptr<CommonMessages::Message> _pMessage;
       bool _isLoggedOn;
       std::unique_ptr<CommonMessages::Header> _pLogonMsg;
@@ -152,6 +177,12 @@ namespace CommunicationUtils
       std::vector<Matrix::MsgService::CommonMessages::SubscriptionParams> _subscriptions;
       std::shared_ptr<ISubscriberMessageLists> _pSubscriberMsgLists;
       std::unordered_map<int, std::shared_ptr<WaitResponse>> _waitResponses;
+      //0 to ack each received message as it arrives; set by SetDelayedAcks on any thread, read on the strand
+      std::atomic<uint32_t> _ackDelayMS;
+      std::atomic<size_t> _maxPendingAcks;
+      //keys of received messages waiting for a message to piggyback on or for the ack flush
+      PendingAcks _pendingAcks;
+      std::atomic<bool> _isAckFlushScheduled;
 
       //****************************************
       // Methods
@@ -164,6 +195,40 @@ namespace CommunicationUtils
       /// </summary>
       COMMUNICATIONUTILS_API bool Connect() override;
       /// <summary>
+      /// Sets the maximum time to wait for a connection to one endpoint before trying the next
+      /// </summary>
+      /// <param name="connectTimeoutMS">the timeout in milliseconds</param>
+      COMMUNICATIONUTILS_API void SetConnectTimeout(uint32_t connectTimeoutMS) { _connectTimeoutMS = connectTimeoutMS; }
+      /// <summary>
+      /// Sets the limit for the time between reconnect attempts
+      /// </summary>
+      /// <param name="maxReconnectRetryTimeMS">the limit in milliseconds</param>
+      COMMUNICATIONUTILS_API void SetMaxReconnectRetryTime(uint32_t maxReconnectRetryTimeMS) { _maxReconnectRetryTimeMS = maxReconnectRetryTimeMS; }
+      /// <summary>
+      /// Enables TCP Fast Open for connections (Linux only - ignored elsewhere)
+      /// </summary>
+      /// <param name="useTcpFastOpen">true to send the logon with the SYN when the server supports it</param>
+      COMMUNICATIONUTILS_API void SetTcpFastOpen(bool useTcpFastOpen) { _useTcpFastOpen = useTcpFastOpen; }
+      /// <summary>
+      /// Delays the acks of received messages so they can be sent together.  The key of each message that
+      /// needs to be acked is held for its sender and goes out in the ackKeys/ackKeyRanges of the next message
+      /// sent to that client; keys still pending after ackDelayMS, or once maxPendingAcks are pending for a
+      /// client, are flushed in one ACK message.  A sender waiting in SendCommonMsgAndWait for the ack may
+      /// wait up to ackDelayMS longer.
+      /// </summary>
+      /// <param name="ackDelayMS">the longest time to hold a key; 0 to ack each message as it arrives (the default)</param>
+      /// <param name="maxPendingAcks">the number of keys pending for one client that are flushed without waiting;
+      ///    at most MAX_PENDING_ACKS</param>
+      COMMUNICATIONUTILS_API void SetDelayedAcks(uint32_t ackDelayMS, size_t maxPendingAcks = DEFAULT_MAX_PENDING_ACKS);
+      /// <summary>
+      /// Sends an ACK message now to each client with keys waiting to be acked
+      /// </summary>
+      COMMUNICATIONUTILS_API void FlushAcks();
+      /// <summary>
+      /// Gets the number of received messages waiting to be acked
+      /// </summary>
+      COMMUNICATIONUTILS_API size_t GetPendingAckCount() { return _pendingAcks.GetCount(); }
+      /// <summary>
       /// Sends a Common message
       /// </summary>
       /// <param name="msgType">The type of message to send</param>
@@ -224,14 +289,23 @@ namespace CommunicationUtils
       /// </summary>
       COMMUNICATIONUTILS_API void RetryConnect();
       /// <summary>
-      /// Handles the connection attempt
+      /// Starts a connection attempt.  The server is resolved (unless a previous resolve is cached) and
+      /// each endpoint is tried in turn, all asynchronously.
       /// </summary>
       COMMUNICATIONUTILS_API bool WrappedConnect(bool isRetry);
       /// <summary>
       /// Completes the successful connection
       /// </summary>
       /// <param name="endpoint">The endpoint that was connected</param>
-      COMMUNICATIONUTILS_API void ConnectComplete(asio::ip::tcp::resolver::iterator endpoint);
+      COMMUNICATIONUTILS_API void ConnectComplete(const asio::ip::tcp::endpoint& endpoint);
+      /// <summary>
+      /// Gets the time to wait before the next reconnect attempt: the reconnect retry time doubled for each
+      /// failure, limited to the max reconnect retry time, with the upper half randomized so clients that lost
+      /// the server at the same time do not all retry at once
+      /// </summary>
+      /// <param name="numFailures">The number of attempts that have failed since the last connection</param>
+      /// <returns>The time to wait in milliseconds</returns>
+      COMMUNICATIONUTILS_API uint32_t GetReconnectDelay(int numFailures);
       /// <summary>
       /// Raises the Connection Changed event
       /// </summary>
@@ -241,7 +315,7 @@ namespace CommunicationUtils
       /// Override to handle received messages 
       /// </summary>
       /// <param name="pMsg">The message received</param>
-      COMMUNICATIONUTILS_API virtual void HandleMessageReceived(std::unique_ptr<CommonMessages::Header> pMsg) override;
+      COMMUNICATIONUTILS_API virtual void HandleMessageReceived(CommonMessages::HeaderPtr pMsg) override;
       /// <summary>
       /// Override to Cancel the reconnect timer
       /// </summary>
@@ -258,6 +332,13 @@ namespace CommunicationUtils
       std::shared_ptr<const ClientComm> shared_from_this() const { return shared_from(this); }
 
    private:
+      void HandleResolve(int attempt, bool isRetry, const boost::system::error_code& error, boost::asio::ip::tcp::resolver::results_type results);
+      void StartConnect(bool isRetry, size_t endpointIndex);
+      void HandleConnect(int attempt, bool isRetry, size_t endpointIndex, const boost::system::error_code& error);
+      void HandleConnectTimeout(int attempt, const boost::system::error_code& error);
+      void ConnectFailed();
+      void ScheduleReconnect();
+      void EnableTcpFastOpen();
       void SendSubscribeMessages();
       int SendCommonMsgInternal(CommonMessages::MsgType msgType
             , const google::protobuf::MessageLite* const pMessage
@@ -273,6 +354,25 @@ namespace CommunicationUtils
       /// <returns>true if an ack should be sent</returns>
       bool NeedToAckRxMsg(const Matrix::MsgService::CommonMessages::Header* const pRxMsg);
       /// <summary>
+      /// Acks rxMsg now, or adds it to the pending acks when acks are delayed
+      /// </summary>
+      /// <param name="rxMsg">the message to ack</param>
+      void AckRxMsg(const Matrix::MsgService::CommonMessages::Header& rxMsg);
+      /// <summary>
+      /// Sends an ACK message for the keys pending for a client
+      /// </summary>
+      /// <param name="clientType">type of client</param>
+      /// <param name="clientID">id of client</param>
+      void SendPendingAcks(int clientType, int clientID);
+      /// <summary>
+      /// Puts back the keys taken for a message that could not be sent and schedules a flush for them
+      /// </summary>
+      void RestorePendingAcks(int clientType, int clientID, const std::vector<int>& keys);
+      /// <summary>
+      /// Starts the ack delay unless a flush is already scheduled
+      /// </summary>
+      void ScheduleAckFlush();
+      /// <summary>
       /// Return true if this msg needs to be tracked and resent until acked
       /// </summary>
       /// <param name="sentMsg">the message to check</param>
@@ -8,6 +8,11 @@
 
 #include "IncludeBoostASIO.h"
 #include <memory>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
 
 #include "../stdafx.h"
 #include "SharedFromThis.h"
@@ -15,6 +20,9 @@
 #include "ICommHandler.h"
 #include "IContextHandler.h"
 #include "CommHandlerSignals.h"
+#include "EncodedFrame.h"
+#include "MessageArena.h"
+#include "SendQueueLimits.h"
 
 namespace asio = boost::asio;
 using namespace boost::asio::ip;
@@ -33,6 +41,7 @@ namespace MsgService
    {
       class Message;
       class Header;
+      class FrameDecoder;
    };
 
 namespace CommunicationUtils
@@ -78,15 +87,67 @@ namespace CommunicationUtils
    private:
       SocketState _socketState;
       DisconnectReason _disconnectReason;
-      std::shared_ptr<CommonMessages::Message> _pRxMsg;
-      std::shared_ptr<CommonMessages::Message> _pSendMsg;
-      std::unique_ptr<CommonMessages::Message> _pEmptyMsg;
-      int _emptySize;
+      std::unique_ptr<CommonMessages::FrameDecoder> _pFrameDecoder;
+      //received messages are parsed onto this and freed after each read
+      CommonMessages::MessageArena _messageArena;
+      struct QueuedFrame
+      {
+         CommonMessages::EncodedFramePtr _pFrame;
+         //who published it, if it was sent with SendPublishedFrame
+         CommonMessages::SubscriptionParams _source;
+         bool _hasSource;
+      };
+      //priority frames (see EncodedFrame::IsPriority) waiting for the current write to complete; each write
+      //takes these before any of _sendQueue
+      std::deque<CommonMessages::EncodedFramePtr> _prioritySendQueue;
+      //bulk frames waiting for the current write to complete
+      std::deque<QueuedFrame> _sendQueue;
+      //the sequence number of the front of _sendQueue; a frame's position is its sequence number minus this
+      uint64_t _sendQueueHeadSeq;
+      //when published frames can be conflated, the sequence number of the newest queued frame from each source
+      std::unordered_map<CommonMessages::SubscriptionParams, uint64_t, CommonMessages::SubscriptionParamsHasher> _conflationIndex;
+      SendQueueLimits _sendQueueLimits;
+      //frames (and their buffers) being written by the current async_write
+      std::vector<CommonMessages::EncodedFramePtr> _framesInFlight;
+      std::vector<asio::const_buffer> _writeBuffers;
+      bool _writeInProgress;
+      std::mutex _sendLock;
+      //frames and bytes that are queued or being written
+      std::atomic<int64_t> _sendQueueDepth;
+      std::atomic<int64_t> _sendQueueBytes;
+      int64_t _maxSendQueueDepth;
+      //frames discarded to keep the send queue within its limits
+      std::atomic<int64_t> _droppedFrameCount;
+      //published frames queued, and those that replaced a queued frame from the same source instead
+      std::atomic<int64_t> _publishedFrameCount;
+      std::atomic<int64_t> _conflatedFrameCount;
+      //frames queued ahead of bulk frames
+      std::atomic<int64_t> _priorityFrameCount;
+      //when the current write started and whether a write stall check is scheduled; only used on the strand
+      int64_t _writeStartMS;
+      bool _isWriteStallCheckPending;
+      std::atomic<int64_t> _writeStallCount;
+      //set when a write stalls, cleared when it completes
+      std::atomic<bool> _isSlowConsumer;
       ConnectionChangeSignal _connectionChangeEvent;
       SocketStateChangeSignal _socketStateChangeEvent;
       MessageRxSignal _messageRxEvent;
       int64_t _msgRxCount;
       int64_t _msgSendCount;
+      //number of completed socket reads; _msgRxCount / _readCount is the frames per read
+      int64_t _readCount;
+      //number of gather writes started
+      int64_t _writeCount;
+      //liveness settings; 0 disables
+      uint32_t _heartbeatIntervalMS;
+      uint32_t _idleTimeoutMS;
+      //steady clock milliseconds of the last bytes received and the last frame queued
+      std::atomic<int64_t> _lastReceiveMS;
+      std::atomic<int64_t> _lastSendMS;
+      //bumped for each connection and disconnect so liveness checks for an earlier connection stop
+      std::atomic<int> _livenessGeneration;
+      std::atomic<int64_t> _heartbeatSendCount;
+      std::atomic<int64_t> _heartbeatRxCount;
 
       //****************************************
       // Methods
@@ -113,6 +174,10 @@ namespace CommunicationUtils
       COMMUNICATIONUTILS_API virtual void Diagnostics(DiagnosticTypes type) override;
       COMMUNICATIONUTILS_API virtual std::string GetDiagnosticsInfo() override;
       /// <summary>
+      /// Gets the number of bytes of message buffers held by this connection
+      /// </summary>
+      COMMUNICATIONUTILS_API int64_t GetBufferBytes();
+      /// <summary>
       /// Gets the current connection state.
       /// </summary>
       COMMUNICATIONUTILS_API SocketState GetSocketState() { return _socketState; }
@@ -120,20 +185,40 @@ namespace CommunicationUtils
       /// Gets the socket.
       /// </summary>
       COMMUNICATIONUTILS_API socket_type* GetSocket();
+      /// <summary>
+      /// Gets the context the connection runs on
+      /// </summary>
+      std::shared_ptr<IContextHandler> GetContextHandler() const { return _pContextHandler; }
 
       /// <summary>
       /// Starts the read process
       /// </summary>
       COMMUNICATIONUTILS_API void Run() override;
       /// <summary>
-      /// Signals that the client comm should shutdown completely
+      /// Signals that the client comm should shutdown completely and waits for the disconnect to complete
       /// </summary>
       COMMUNICATIONUTILS_API virtual void ShutDown() override;
       /// <summary>
+      /// Starts shutting down without waiting; IsShutdownComplete() becomes true once the disconnect
+      /// completes, which WaitForShutdown() can wait for
+      /// </summary>
+      COMMUNICATIONUTILS_API void StartShutDown();
+      /// <summary>
+      /// Gives up on an orderly shutdown: marks shutdown complete straight away and closes the socket
+      /// without a protocol shutdown, for a connection whose disconnect has not completed in time
+      /// </summary>
+      COMMUNICATIONUTILS_API void ForceClose();
+      /// <summary>
       /// Asynchrounously disconnects the socket
       /// </summary>
       COMMUNICATIONUTILS_API virtual void Disconnect();
       /// <summary>
+      /// Returns a disconnected handler to the state it was constructed in so it can be used for a new
+      /// connection without reallocating its strand, socket and buffers.  Observers are removed.  Only call
+      /// once nothing else holds a reference to the handler, so no handlers for the old connection are pending.
+      /// </summary>
+      COMMUNICATIONUTILS_API virtual void Reset();
+      /// <summary>
       /// Returns true if Disconnect() was called
       /// </summary>
       COMMUNICATIONUTILS_API bool IsStopped() { return _stopped || IsShuttingDown(); }
@@ -148,30 +233,146 @@ namespace CommunicationUtils
       /// <returns>A name to use for this client</return>
       COMMUNICATIONUTILS_API virtual std::string GetName() override;
       /// <summary>
-      /// Asynchronously sends a message on the socket.  The HandleWrite
-      /// method is called asynchrounously
+      /// Encodes msg and adds it to the send queue.  Queued frames are written
+      /// asynchrounously, one write at a time.
       /// </summary>
       /// <param name="msg">The message to send</param>
-      /// <returns>True if it successfully kicked off the async send</return>
+      /// <returns>True if the message was queued</return>
       COMMUNICATIONUTILS_API virtual bool SendMsg(CommonMessages::Header& msg);
       /// <summary>
-      /// Asynchronously sends a heartbeat message on the socket.  The HandleWrite
-      /// method is called asynchrounously
+      /// Adds an already encoded frame to the send queue.  The frame is shared, not copied,
+      /// so the same frame can be sent to any number of clients after encoding it once.
+      /// Priority frames (see EncodedFrame::IsPriority) are written ahead of bulk frames already queued and
+      /// are never conflated.  They count toward the send queue limits like any other frame, except control
+      /// frames (see EncodedFrame::IsControl), which are never dropped to keep the queue within its limits.
       /// </summary>
-      /// <returns>True if it successfully kicked off the async send</return>
+      /// <param name="pFrame">The frame to send</param>
+      /// <returns>True if the frame was queued</return>
+      COMMUNICATIONUTILS_API virtual bool SendFrame(const CommonMessages::EncodedFramePtr& pFrame);
+      /// <summary>
+      /// As SendFrame, for a frame published by source.  If the limits conflate its topic, or it would
+      /// take the send queue over its limits with the Conflate policy, it replaces the unsent frame from the
+      /// same source where it is queued.
+      /// </summary>
+      /// <param name="pFrame">The frame to send</param>
+      /// <param name="source">The publishing client's type and ID, and the topic</param>
+      /// <returns>True if the frame was queued</return>
+      COMMUNICATIONUTILS_API virtual bool SendPublishedFrame(const CommonMessages::EncodedFramePtr& pFrame, const CommonMessages::SubscriptionParams& source) override;
+      /// <summary>
+      /// Adds a heartbeat message to the send queue.
+      /// </summary>
+      /// <returns>True if the message was queued</return>
       COMMUNICATIONUTILS_API bool SendHeartbeat();
+      /// <summary>
+      /// Configures liveness detection for the connection; call before Run.  Anything received counts as
+      /// liveness, so heartbeats are only sent when the link has been idle for heartbeatIntervalMS, and
+      /// the connection is dropped with DisconnectReason::ServerNotResponding when nothing has been received
+      /// for idleTimeoutMS.  The checks for every connection are scheduled on the shared TimerWheel.
+      /// </summary>
+      /// <param name="heartbeatIntervalMS">Idle time before a heartbeat is sent; 0 to not send heartbeats</param>
+      /// <param name="idleTimeoutMS">Time without receiving anything before disconnecting; 0 to not check.
+      ///    Should be at least twice heartbeatIntervalMS.</param>
+      COMMUNICATIONUTILS_API void SetLiveness(uint32_t heartbeatIntervalMS, uint32_t idleTimeoutMS);
+      /// <summary>
+      /// Limits what is buffered for a peer that is not reading fast enough.  Frames over the limits are
+      /// handled by limits._policy; a disconnect is reported with DisconnectReason::SlowConsumer.  A write
+      /// that takes longer than limits._writeStallMS marks the peer as a slow consumer and raises the
+      /// socket state event with the state unchanged and DisconnectReason::WriteStalled.
+      /// </summary>
+      /// <param name="limits">The limits; the default has none</param>
+      COMMUNICATIONUTILS_API void SetSendQueueLimits(const SendQueueLimits& limits);
+      /// <summary>
+      /// Gets the send queue limits
+      /// </summary>
+      COMMUNICATIONUTILS_API SendQueueLimits GetSendQueueLimits();
+      /// <summary>
+      /// Gets the number of frames discarded to keep the send queue within its limits
+      /// </summary>
+      int64_t GetDroppedFrameCount() const { return _droppedFrameCount.load(); }
+      /// <summary>
+      /// Gets the number of queued frames replaced by a newer frame from the same source
+      /// </summary>
+      int64_t GetConflatedFrameCount() const { return _conflatedFrameCount.load(); }
+      /// <summary>
+      /// Gets the number of published frames sent (see SendPublishedFrame), including those conflated
+      /// </summary>
+      int64_t GetPublishedFrameCount() const { return _publishedFrameCount.load(); }
+      /// <summary>
+      /// Gets the number of priority frames sent (see EncodedFrame::IsPriority), which are written ahead of
+      /// any bulk frames queued before them
+      /// </summary>
+      int64_t GetPriorityFrameCount() const { return _priorityFrameCount.load(); }
+      /// <summary>
+      /// Gets the number of writes that have taken longer than the write stall timeout
+      /// </summary>
+      int64_t GetWriteStallCount() const { return _writeStallCount.load(); }
+      /// <summary>
+      /// Returns true while a write that has taken longer than the write stall timeout is outstanding
+      /// </summary>
+      bool IsSlowConsumer() const { return _isSlowConsumer.load(); }
+      /// <summary>
+      /// Gets the number of heartbeats sent
+      /// </summary>
+      int64_t GetHeartbeatSendCount() const { return _heartbeatSendCount.load(); }
+      /// <summary>
+      /// Gets the number of heartbeats received
+      /// </summary>
+      int64_t GetHeartbeatRxCount() const { return _heartbeatRxCount.load(); }
+      /// <summary>
+      /// Gets the number of frames that are queued or being written
+      /// </summary>
+      int64_t GetSendQueueDepth() const { return _sendQueueDepth.load(); }
+      /// <summary>
+      /// Gets the number of bytes that are queued or being written
+      /// </summary>
+      int64_t GetSendQueueBytes() const { return _sendQueueBytes.load(); }
    protected:
       /// <summary>
-      /// Performs the message handling.  if pMsg is null, it is a heartbeat message
+      /// Adds an encoded frame to the send queue and starts a write if one is not in progress
+      /// </summary>
+      /// <param name="pFrame">The frame to send</param>
+      /// <param name="pSource">Who published the frame; null if it was not published</param>
+      /// <returns>True if the frame was queued; false if it is not connected</return>
+      COMMUNICATIONUTILS_API bool QueueFrame(const CommonMessages::EncodedFramePtr& pFrame, const CommonMessages::SubscriptionParams* pSource = nullptr);
+      /// <summary>
+      /// Handles one complete frame pulled out of the receive stream.  Parses the Header
+      /// and calls HandleMessageReceived.
+      /// </summary>
+      /// <param name="pData">The frame payload (without the size prefix); only valid during this call</param>
+      /// <param name="size">The size of the payload; 0 indicates a heartbeat</param>
+      COMMUNICATIONUTILS_API virtual void HandleFrameReceived(const char* pData, uint32_t size);
+      /// <summary>
+      /// Called once every frame of a read has been passed to HandleFrameReceived, so state shared by
+      /// the frames of one read can be released.
+      /// </summary>
+      COMMUNICATIONUTILS_API virtual void HandleFramesComplete() {}
+      /// <summary>
+      /// Replies to a received heartbeat when nothing has been sent for the heartbeat interval; otherwise
+      /// the peer is already hearing from us.  So a reply, which arrives just after our own heartbeat, is
+      /// never answered.  With no heartbeat interval every heartbeat is echoed.
+      /// </summary>
+      COMMUNICATIONUTILS_API virtual void HandleHeartbeatReceived();
+      /// <summary>
+      /// Performs the message handling.  if pMsg is null, it is a heartbeat message.
+      /// A received message is on the MessageArena so it is freed once the read is handled.
       /// </summary>
       /// <param name="msg">The message received, null if a heartbeat message was received</param>
-      COMMUNICATIONUTILS_API virtual void HandleMessageReceived(std::unique_ptr<CommonMessages::Header> pMsg);
+      COMMUNICATIONUTILS_API virtual void HandleMessageReceived(CommonMessages::HeaderPtr pMsg);
       /// <summary>
       /// Raises the Message Received event
       /// </summary>
       /// <param name="msg">The message received</param>
       COMMUNICATIONUTILS_API void OnMessageReceived(CommonMessages::Header* pMsg);
       /// <summary>
+      /// Gets the arena received messages are parsed onto.  Anything created on it is only valid
+      /// until the current read has been handled.
+      /// </summary>
+      CommonMessages::MessageArena& GetMessageArena() { return _messageArena; }
+      /// <summary>
+      /// Returns true if anything is observing received messages
+      /// </summary>
+      bool HasMessageRxObservers() const { return !_messageRxEvent.empty(); }
+      /// <summary>
       /// Asynchrounously reads the next message.  The HandleMessageReceived
       /// method will be called to handle the message recieved
       /// </summary>
@@ -198,17 +399,75 @@ namespace CommunicationUtils
       /// </summary>
       /// <param name="reason">The reason for the disconnect</param>
       COMMUNICATIONUTILS_API virtual void HandleDisconnect(DisconnectReason reason);
+      /// <summary>
+      /// Resets the liveness times for a new connection and schedules the first check; call once connected
+      /// </summary>
+      COMMUNICATIONUTILS_API void StartLiveness();
+      /// <summary>
+      /// Stops the liveness checks for the current connection; call when it drops
+      /// </summary>
+      COMMUNICATIONUTILS_API void StopLiveness();
    private:
       /// <summary>
-      /// StartRead will call this asynchrounously
+      /// StartRead will call this asynchrounously.  Every complete frame in the receive
+      /// buffer is handled before the next read is started.
       /// </summary>
       COMMUNICATIONUTILS_API virtual void HandleRead(const boost::system::error_code& error,
             size_t bytes_transferred);
       /// <summary>
-      /// SendMsg will call this asynchrounously
+      /// Writes everything in the send queue with a single gather write.  Called on the strand.
+      /// </summary>
+      COMMUNICATIONUTILS_API void StartWrite();
+      /// <summary>
+      /// StartWrite will call this asynchrounously.  Starts the next write if more frames were queued.
       /// </summary>
       COMMUNICATIONUTILS_API virtual void HandleWrite(const boost::system::error_code& error,
             size_t bytes_transferred);
+      /// <summary>
+      /// Discards all queued frames
+      /// </summary>
+      void ClearSendQueue();
+      /// <summary>
+      /// Returns true if adding size bytes would take the send queue over its limits.  _sendLock must be held.
+      /// </summary>
+      bool IsOverSendQueueLimits(size_t size) const;
+      /// <summary>
+      /// Makes room for a frame of size bytes by discarding the oldest queued frames.  _sendLock must be held.
+      /// </summary>
+      /// <returns>True if there is now room</returns>
+      bool DropOldestFrames(size_t size);
+      /// <summary>
+      /// Replaces the queued frame from source with pFrame.  _sendLock must be held.
+      /// </summary>
+      /// <returns>True if there was a queued frame from source</returns>
+      bool ConflateFrame(const CommonMessages::EncodedFramePtr& pFrame, const CommonMessages::SubscriptionParams& source);
+      /// <summary>
+      /// Removes the front of the send queue.  _sendLock must be held.
+      /// </summary>
+      CommonMessages::EncodedFramePtr PopSendQueueFront();
+      /// <summary>
+      /// Disconnects with DisconnectReason::SlowConsumer if still connected.  Called on the strand.
+      /// </summary>
+      void DisconnectSlowConsumer();
+      /// <summary>
+      /// Schedules CheckWriteStall on the TimerWheel; it runs on the strand
+      /// </summary>
+      void ScheduleWriteStallCheck(int generation, uint32_t delayMS);
+      /// <summary>
+      /// Marks the peer as a slow consumer if the current write has taken longer than the write stall
+      /// timeout, otherwise checks again when it could next have
+      /// </summary>
+      void CheckWriteStall(int generation);
+      /// <summary>
+      /// Schedules CheckLiveness on the TimerWheel; it runs on the strand
+      /// </summary>
+      void ScheduleLivenessCheck(int generation, uint32_t delayMS);
+      /// <summary>
+      /// Disconnects if nothing has been received for the idle timeout, sends a heartbeat if the link
+      /// is idle, then schedules the next check for when one of those could next be due
+      /// </summary>
+      void CheckLiveness(int generation);
+      static int64_t GetSteadyMS();
 
       COMMUNICATIONUTILS_API void HandleHandshake(const boost::system::error_code& error);
 
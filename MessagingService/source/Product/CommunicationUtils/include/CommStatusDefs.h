@@ -64,6 +64,15 @@ namespace CommunicationUtils
       /// An exception occurred during read/write
       /// </summary>
       Exception,
+      /// <summary>
+      /// The peer was not reading fast enough to keep the send queue within its limits
+      /// </summary>
+      SlowConsumer,
+      /// <summary>
+      /// Not a disconnect: reported with the socket state unchanged when a write has not completed
+      /// within the write stall timeout
+      /// </summary>
+      WriteStalled,
    };
 
 }
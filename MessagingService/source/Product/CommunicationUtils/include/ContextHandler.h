@@ -7,6 +7,7 @@
 #endif
 
 #include <memory>
+#include <atomic>
 #include "IncludeBoostASIO.h"
 
 #include "../stdafx.h"
@@ -54,6 +55,7 @@ namespace CommunicationUtils
    private:
       boost::asio::io_context _ioContext;
       boost::asio::executor_work_guard<boost::asio::io_context::executor_type> _workGuard;
+      std::atomic<int64_t> _connectionCount;
 
       //****************************************
       // Methods
@@ -65,6 +67,18 @@ namespace CommunicationUtils
       /// </summary>
       COMMUNICATIONUTILS_API boost::asio::io_context& GetIOContext() override;
       /// <summary>
+      /// Counts a connection established on this context
+      /// </summary>
+      COMMUNICATIONUTILS_API void AddConnection() override { _connectionCount++; }
+      /// <summary>
+      /// Stops counting a connection on this context
+      /// </summary>
+      COMMUNICATIONUTILS_API void RemoveConnection() override { _connectionCount--; }
+      /// <summary>
+      /// Gets the number of connections established on this context
+      /// </summary>
+      COMMUNICATIONUTILS_API int64_t GetConnectionCount() override { return _connectionCount.load(); }
+      /// <summary>
       /// Stops the IOContext and shuts down the thread
       /// </summary>
       COMMUNICATIONUTILS_API void ShutDown() override;
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "IncludeBoostASIO.h"
+
+#include "../stdafx.h"
+#include "ContextHandler.h"
+
+namespace Matrix
+{
+namespace MsgService
+{
+namespace CommunicationUtils
+{
+   /// <summary>
+   /// A pool of ContextHandlers, each running its own io_context on its own thread.  Connections
+   /// are spread across the pool so socket reads, parsing and fan-out use every core; each
+   /// connection stays on one context and its strand keeps its handlers in order.
+   /// </summary>
+   class ContextPool
+   {
+      //****************************************
+      // Constructors/Destructors
+      //****************************************
+   public:
+#ifdef USING_SSL
+      /// <summary>
+      /// Creates the pool
+      /// </summary>
+      /// <param name="numContexts">Number of io_contexts (and threads); 0 uses one per core</param>
+      /// <param name="sslContext">The SSL context used by every connection</param>
+      COMMUNICATIONUTILS_API ContextPool(size_t numContexts, boost::asio::ssl::context& sslContext);
+#else
+      /// <summary>
+      /// Creates the pool
+      /// </summary>
+      /// <param name="numContexts">Number of io_contexts (and threads); 0 uses one per core</param>
+      COMMUNICATIONUTILS_API ContextPool(size_t numContexts);
+#endif
+      COMMUNICATIONUTILS_API ~ContextPool();
+   private:
+      ContextPool(const ContextPool&);
+      ContextPool& operator=(const ContextPool&);
+
+      //****************************************
+      // Fields
+      //****************************************
+   private:
+      std::vector<std::shared_ptr<ContextHandler>> _contextHandlers;
+
+      //****************************************
+      // Methods
+      //****************************************
+   public:
+      /// <summary>
+      /// Starts the thread for each context
+      /// </summary>
+      COMMUNICATIONUTILS_API void StartThreads();
+      /// <summary>
+      /// Stops every context and waits for its thread to finish
+      /// </summary>
+      COMMUNICATIONUTILS_API void ShutDown();
+      /// <summary>
+      /// Gets the number of contexts in the pool
+      /// </summary>
+      size_t GetSize() const { return _contextHandlers.size(); }
+      /// <summary>
+      /// Gets the context at index
+      /// </summary>
+      COMMUNICATIONUTILS_API std::shared_ptr<IContextHandler> GetContextHandler(size_t index);
+      /// <summary>
+      /// Gets the context with the fewest connections for a new connection
+      /// </summary>
+      COMMUNICATIONUTILS_API std::shared_ptr<IContextHandler> GetLeastLoaded();
+      /// <summary>
+      /// Gets the number of connections established on the context at index
+      /// </summary>
+      COMMUNICATIONUTILS_API size_t GetLoad(size_t index);
+   };
+}
+}
+}
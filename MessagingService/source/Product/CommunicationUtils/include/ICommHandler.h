@@ -6,6 +6,8 @@
 #include "../stdafx.h"
 #include "WorkerThread.h"
 #include "CommHandlerSignals.h"
+#include "EncodedFrame.h"
+#include "SubscriptionParams.h"
 
 namespace asio = boost::asio;
 using namespace boost::asio::ip;
@@ -30,6 +32,12 @@ namespace CommunicationUtils
    public:
       virtual ~ICommHandler() {}
       virtual bool SendMsg(CommonMessages::Header& msg) = 0;
+      virtual bool SendFrame(const CommonMessages::EncodedFramePtr& pFrame) = 0;
+      /// <summary>
+      /// Sends a frame published by source (the publishing client's type and ID and the topic), which a
+      /// connection can use to conflate it with an earlier frame from the same source
+      /// </summary>
+      virtual bool SendPublishedFrame(const CommonMessages::EncodedFramePtr& pFrame, const CommonMessages::SubscriptionParams& /*source*/) { return SendFrame(pFrame); }
       virtual bool IsConnected() = 0;
       virtual void Disconnect() = 0;
       virtual void Diagnostics(DiagnosticTypes type) = 0;
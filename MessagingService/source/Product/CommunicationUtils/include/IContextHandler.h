@@ -27,6 +27,18 @@ namespace CommunicationUtils
 #ifdef USING_SSL
       virtual boost::asio::ssl::context& GetSSLContext() = 0;
 #endif
+      /// <summary>
+      /// Counts a connection established on this context; each call is paired with a RemoveConnection
+      /// </summary>
+      virtual void AddConnection() = 0;
+      /// <summary>
+      /// Stops counting a connection on this context once it has dropped
+      /// </summary>
+      virtual void RemoveConnection() = 0;
+      /// <summary>
+      /// Gets the number of connections established on this context
+      /// </summary>
+      virtual int64_t GetConnectionCount() = 0;
    };
 }
 }
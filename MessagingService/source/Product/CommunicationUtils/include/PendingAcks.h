@@ -0,0 +1,114 @@
+#pragma once
+
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include "../stdafx.h"
+#include "MessageUtils.h"
+#include "SubscriptionParams.h"
+
+namespace Matrix
+{
+namespace MsgService
+{
+namespace CommunicationUtils
+{
+   /// <summary>
+   /// The keys of received messages that still need to be acked, per sending client.  Keys pile up
+   /// here so they can be acked together - piggybacked on the next message sent to that client or
+   /// flushed in one ACK message - rather than with one ACK message each.
+   ///
+   /// Keys are written to a message as ackKeys and ackKeyRanges: each run of at least MIN_RANGE_SIZE
+   /// consecutive keys is sent as its first and last key, a longer run than MAX_RANGE_SIZE as several ranges.
+   /// Thread safe.
+   /// </summary>
+   class PendingAcks
+   {
+      //****************************************
+      // Constructors/Destructors
+      //****************************************
+   public:
+      /// <summary>
+      /// Initializes a new instance of the <see cref="PendingAcks"/> class.
+      /// </summary>
+      COMMUNICATIONUTILS_API PendingAcks();
+   private:
+      PendingAcks(const PendingAcks&);
+      PendingAcks& operator=(const PendingAcks&);
+
+      //****************************************
+      // Fields
+      //****************************************
+   public:
+      /// <summary>
+      /// The shortest run of consecutive keys sent as a range; shorter runs are no bigger as ackKeys
+      /// </summary>
+      static const int MIN_RANGE_SIZE = 3;
+      /// <summary>
+      /// Received ranges covering more keys than this are ignored, so a bad message cannot make us expand
+      /// billions of keys.  Ranges that are sent never cover more.
+      /// </summary>
+      static const int MAX_RANGE_SIZE = 65536;
+   private:
+      std::mutex _lock;
+      std::unordered_map<CommonMessages::SubscriptionParams, std::vector<int>, CommonMessages::SubscriptionParamsHasher> _keys;
+      size_t _count;
+
+      //****************************************
+      // Methods
+      //****************************************
+   public:
+      /// <summary>
+      /// Adds a key that needs to be acked
+      /// </summary>
+      /// <param name="clientType">type of the client that sent the message</param>
+      /// <param name="clientID">id of the client that sent the message</param>
+      /// <param name="msgKey">the key of the message</param>
+      /// <returns>the number of keys now pending for the client</returns>
+      COMMUNICATIONUTILS_API size_t Add(int clientType, int clientID, int msgKey);
+      /// <summary>
+      /// Moves the keys pending for a client into the ackKeys and ackKeyRanges of pMsg
+      /// </summary>
+      /// <param name="clientType">type of client</param>
+      /// <param name="clientID">id of client</param>
+      /// <param name="pMsg">the message to add the keys to</param>
+      /// <param name="pKeys">if not null, set to the keys taken so they can be restored if pMsg is not sent</param>
+      /// <returns>the number of keys added</returns>
+      COMMUNICATIONUTILS_API size_t Take(int clientType, int clientID, CommonMessages::Header* pMsg, std::vector<int>* pKeys = nullptr);
+      /// <summary>
+      /// Puts back keys taken for a message that could not be sent
+      /// </summary>
+      /// <param name="clientType">type of client</param>
+      /// <param name="clientID">id of client</param>
+      /// <param name="keys">the keys taken</param>
+      COMMUNICATIONUTILS_API void Restore(int clientType, int clientID, const std::vector<int>& keys);
+      /// <summary>
+      /// Gets the clients that have keys pending
+      /// </summary>
+      COMMUNICATIONUTILS_API std::vector<CommonMessages::SubscriptionParams> GetClients();
+      /// <summary>
+      /// Gets the number of keys pending for all clients
+      /// </summary>
+      COMMUNICATIONUTILS_API size_t GetCount();
+      /// <summary>
+      /// Removes every pending key
+      /// </summary>
+      COMMUNICATIONUTILS_API void Clear();
+      /// <summary>
+      /// Adds keys to the ackKeys and ackKeyRanges of pMsg
+      /// </summary>
+      /// <param name="keys">the keys to add; sorted in place</param>
+      /// <param name="pMsg">the message to add them to</param>
+      COMMUNICATIONUTILS_API static void AddAckKeys(std::vector<int>& keys, CommonMessages::Header* pMsg);
+      /// <summary>
+      /// Gets every key acked by msg - its ackKeys followed by the keys of its ackKeyRanges.  An unpaired,
+      /// inverted or oversized (see MAX_RANGE_SIZE) range is ignored.
+      /// </summary>
+      /// <param name="msg">the received message</param>
+      /// <param name="pKeys">set to the acked keys</param>
+      COMMUNICATIONUTILS_API static void GetAckedKeys(const CommonMessages::Header& msg, google::protobuf::RepeatedField<int>* pKeys);
+   };
+}
+}
+}
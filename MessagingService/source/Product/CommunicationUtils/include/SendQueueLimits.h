@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <memory>
+#include <unordered_set>
+#include "../stdafx.h"
+
+namespace Matrix
+{
+namespace MsgService
+{
+namespace CommunicationUtils
+{
+   /// <summary>
+   /// What a connection does with a frame that would take its send queue over its limits
+   /// </summary>
+   enum class SlowConsumerPolicy
+   {
+      /// <summary>
+      /// Disconnects with DisconnectReason::SlowConsumer
+      /// </summary>
+      Disconnect,
+      /// <summary>
+      /// Discards the oldest frames that are not being written yet to make room
+      /// </summary>
+      DropOldest,
+      /// <summary>
+      /// Discards the new frame
+      /// </summary>
+      DropNewest,
+      /// <summary>
+      /// Replaces the queued frame with the same conflation key (see CommHandler::SendFrame) with the new
+      /// frame; if there is none, as DropOldest
+      /// </summary>
+      Conflate,
+   };
+
+   /// <summary>
+   /// Limits on what a connection buffers for a peer that is not reading fast enough, and which published
+   /// frames it conflates: a frame that is conflated replaces the unsent frame from the same source (the
+   /// publishing client and topic) where it is queued rather than being added behind it
+   /// </summary>
+   struct SendQueueLimits
+   {
+      typedef std::shared_ptr<const std::unordered_set<int>> TopicSetPtr;
+
+      SendQueueLimits(uint32_t maxFrames = 0, uint64_t maxBytes = 0, SlowConsumerPolicy policy = SlowConsumerPolicy::Disconnect, uint32_t writeStallMS = 0)
+            : _maxFrames(maxFrames)
+            , _maxBytes(maxBytes)
+            , _policy(policy)
+            , _writeStallMS(writeStallMS)
+            , _conflateAllTopics(false)
+      {}
+      //frames queued or being written; 0 for no limit
+      uint32_t _maxFrames;
+      //bytes queued or being written; 0 for no limit
+      uint64_t _maxBytes;
+      SlowConsumerPolicy _policy;
+      //a write that has not completed in this time marks the peer as a slow consumer; 0 to not check
+      uint32_t _writeStallMS;
+      //conflate every published frame, within the limits or not
+      bool _conflateAllTopics;
+      //conflate the published frames of these topics; may be null
+      TopicSetPtr _pConflatedTopics;
+
+      /// <summary>
+      /// Returns true if published frames of topic are always conflated
+      /// </summary>
+      bool ConflatesTopic(int topic) const
+      {
+         return _conflateAllTopics || (_pConflatedTopics != nullptr && _pConflatedTopics->count(topic) > 0);
+      }
+      /// <summary>
+      /// Returns true if any published frame can be conflated, always or to stay within the limits
+      /// </summary>
+      bool CanConflate() const
+      {
+         return _conflateAllTopics || _policy == SlowConsumerPolicy::Conflate
+               || (_pConflatedTopics != nullptr && !_pConflatedTopics->empty());
+      }
+   };
+
+   /// <summary>
+   /// Gets the name of policy, as accepted by TryParse
+   /// </summary>
+   inline const char* ToString(SlowConsumerPolicy policy)
+   {
+      switch (policy)
+      {
+         case SlowConsumerPolicy::Disconnect: return "disconnect";
+         case SlowConsumerPolicy::DropOldest: return "dropoldest";
+         case SlowConsumerPolicy::DropNewest: return "dropnewest";
+         case SlowConsumerPolicy::Conflate: return "conflate";
+      }
+      return "unknown";
+   }
+   /// <summary>
+   /// Gets the policy with the name text
+   /// </summary>
+   /// <returns>false if text is not the name of a policy</returns>
+   inline bool TryParse(const std::string& text, SlowConsumerPolicy* pPolicy)
+   {
+      for (auto policy : { SlowConsumerPolicy::Disconnect, SlowConsumerPolicy::DropOldest, SlowConsumerPolicy::DropNewest, SlowConsumerPolicy::Conflate })
+      {
+         if (text == ToString(policy))
+         {
+            *pPolicy = policy;
+            return true;
+         }
+      }
+      return false;
+   }
+}
+}
+}
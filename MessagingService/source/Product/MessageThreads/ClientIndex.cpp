@@ -0,0 +1,229 @@
+#include <algorithm>
+
+#include "ClientIndex.h"
+#include "ClientMsgHandler.h"
+
+using namespace Matrix::MsgService::MessageThreads;
+
+const size_t ClientIndex::NUM_SHARDS;
+const size_t ClientIndex::CHUNK_SIZE;
+
+namespace
+{
+   uint64_t MakeKey(int clientType, int clientID)
+   {
+      return ((uint64_t)(uint32_t)clientType << 32) | (uint32_t)clientID;
+   }
+   //the high bits of a multiplicative hash, so nearby IDs land in different shards
+   size_t GetShard(uint64_t key)
+   {
+      return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) % ClientIndex::NUM_SHARDS;
+   }
+
+   //gets a copy of pList with pClient added; null if it is already there.  Only the clients logged on with
+   //one (type, ID) are in pList, so searching it is cheap.
+   ClientIndex::ClientListPtr AddToList(const ClientIndex::ClientListPtr& pList, const std::shared_ptr<ClientMsgHandler>& pClient)
+   {
+      auto pNewList = std::make_shared<ClientIndex::ClientList>();
+      if (pList != nullptr)
+      {
+         if (std::find(pList->begin(), pList->end(), pClient) != pList->end())
+            return nullptr;
+         pNewList->reserve(pList->size() + 1);
+         pNewList->assign(pList->begin(), pList->end());
+      }
+      pNewList->push_back(pClient);
+      return pNewList;
+   }
+   //gets a copy of list without pClient
+   ClientIndex::ClientListPtr RemoveFromList(const ClientIndex::ClientList& list, ClientMsgHandler* pClient)
+   {
+      auto pNewList = std::make_shared<ClientIndex::ClientList>();
+      pNewList->reserve(list.size());
+      for (auto& pMyClient : list)
+      {
+         if (pMyClient.get() != pClient)
+            pNewList->push_back(pMyClient);
+      }
+      return pNewList;
+   }
+
+   //replaces a chunk of set with a copy that can be changed
+   ClientIndex::ClientList& CopyChunk(ClientIndex::ClientSet& set, size_t chunk)
+   {
+      auto pCopy = std::make_shared<ClientIndex::ClientList>(*set._chunks[chunk]);
+      set._chunks[chunk] = pCopy;
+      return *pCopy;
+   }
+
+   //gets the shard with value stored under key, or with key removed if value is null.  The index lock must be held.
+   template<class Lookup, class Key, class Value>
+   void StoreInShard(std::shared_ptr<const Lookup>& pShard, const std::shared_ptr<const Lookup>& pCurrent, Key key, const Value& value)
+   {
+      auto pNext = (pCurrent == nullptr) ? std::make_shared<Lookup>() : std::make_shared<Lookup>(*pCurrent);
+      if (value == nullptr)
+         pNext->erase(key);
+      else
+         (*pNext)[key] = value;
+      std::atomic_store(&pShard, pNext->empty() ? std::shared_ptr<const Lookup>() : std::shared_ptr<const Lookup>(std::move(pNext)));
+   }
+
+   //adds pClient under key in the shard; returns false if it is already there.  The index lock must be held.
+   template<class Lookup, class Key>
+   bool AddToShard(std::shared_ptr<const Lookup>& pShard, Key key, const std::shared_ptr<ClientMsgHandler>& pClient)
+   {
+      auto pCurrent = std::atomic_load(&pShard);
+      ClientIndex::ClientListPtr pList;
+      if (pCurrent != nullptr)
+      {
+         auto find = pCurrent->find(key);
+         if (find != pCurrent->end())
+            pList = find->second;
+      }
+      auto pNewList = AddToList(pList, pClient);
+      if (pNewList == nullptr)
+         return false;
+      StoreInShard(pShard, pCurrent, key, pNewList);
+      return true;
+   }
+   //removes pClient from under key in the shard; returns false if it is not there.  The index lock must be held.
+   template<class Lookup, class Key>
+   bool RemoveFromShard(std::shared_ptr<const Lookup>& pShard, Key key, ClientMsgHandler* pClient)
+   {
+      auto pCurrent = std::atomic_load(&pShard);
+      if (pCurrent == nullptr)
+         return false;
+      auto find = pCurrent->find(key);
+      if (find == pCurrent->end())
+         return false;
+      auto& list = *find->second;
+      if (std::none_of(list.begin(), list.end(), [pClient](const std::shared_ptr<ClientMsgHandler>& pMyClient) { return pMyClient.get() == pClient; }))
+         return false;
+      StoreInShard(pShard, pCurrent, key, (list.size() == 1) ? nullptr : RemoveFromList(list, pClient));
+      return true;
+   }
+}
+
+ClientIndex::ClientIndex()
+      : _count(0)
+{
+}
+
+void ClientIndex::Add(const std::shared_ptr<ClientMsgHandler>& pClient, int clientType, int clientID)
+{
+   if (pClient == nullptr)
+      return;
+   auto key = MakeKey(clientType, clientID);
+   std::lock_guard<std::mutex> lock(_lock);
+   if (AddToShard(_idShards[GetShard(key)], key, pClient))
+   {
+      AddToType(pClient, clientType);
+      _count++;
+   }
+}
+void ClientIndex::Remove(ClientMsgHandler* pClient, int clientType, int clientID)
+{
+   auto key = MakeKey(clientType, clientID);
+   std::lock_guard<std::mutex> lock(_lock);
+   if (RemoveFromShard(_idShards[GetShard(key)], key, pClient))
+   {
+      RemoveFromType(pClient, clientType);
+      _count--;
+   }
+}
+void ClientIndex::Clear()
+{
+   std::lock_guard<std::mutex> lock(_lock);
+   for (size_t shard = 0; shard < NUM_SHARDS; shard++)
+   {
+      std::atomic_store(&_idShards[shard], std::shared_ptr<const IDLookup>());
+      std::atomic_store(&_typeShards[shard], std::shared_ptr<const TypeLookup>());
+   }
+   _typePositions.clear();
+   _count = 0;
+}
+void ClientIndex::AddToType(const std::shared_ptr<ClientMsgHandler>& pClient, int clientType)
+{
+   //a client logged on under two IDs of a type is only listed once
+   auto& positions = _typePositions[clientType];
+   if (positions.find(pClient.get()) != positions.end())
+      return;
+   auto& pShard = _typeShards[GetShard((uint32_t)clientType)];
+   auto pCurrent = std::atomic_load(&pShard);
+   std::shared_ptr<ClientSet> pNewSet;
+   if (pCurrent != nullptr)
+   {
+      auto find = pCurrent->find(clientType);
+      if (find != pCurrent->end())
+         pNewSet = std::make_shared<ClientSet>(*find->second);
+   }
+   if (pNewSet == nullptr)
+      pNewSet = std::make_shared<ClientSet>();
+   if (pNewSet->_size % CHUNK_SIZE == 0)
+   {
+      auto pChunk = std::make_shared<ClientList>();
+      pChunk->reserve(CHUNK_SIZE);
+      pChunk->push_back(pClient);
+      pNewSet->_chunks.push_back(pChunk);
+   }
+   else
+   {
+      CopyChunk(*pNewSet, pNewSet->_chunks.size() - 1).push_back(pClient);
+   }
+   positions[pClient.get()] = pNewSet->_size++;
+   StoreInShard(pShard, pCurrent, clientType, ClientSetPtr(std::move(pNewSet)));
+}
+void ClientIndex::RemoveFromType(ClientMsgHandler* pClient, int clientType)
+{
+   auto findType = _typePositions.find(clientType);
+   if (findType == _typePositions.end())
+      return;
+   auto& positions = findType->second;
+   auto findPosition = positions.find(pClient);
+   if (findPosition == positions.end())
+      return;
+   auto position = findPosition->second;
+   positions.erase(findPosition);
+
+   auto& pShard = _typeShards[GetShard((uint32_t)clientType)];
+   auto pCurrent = std::atomic_load(&pShard);
+   auto& set = *pCurrent->find(clientType)->second;
+   if (set._size == 1)
+   {
+      _typePositions.erase(findType);
+      StoreInShard(pShard, pCurrent, clientType, ClientSetPtr());
+      return;
+   }
+   //the last client takes the removed one's place, so only its chunk and the last are copied
+   auto pNewSet = std::make_shared<ClientSet>(set);
+   auto lastPosition = set._size - 1;
+   if (position != lastPosition)
+   {
+      auto& pMoved = (*set._chunks[lastPosition / CHUNK_SIZE])[lastPosition % CHUNK_SIZE];
+      CopyChunk(*pNewSet, position / CHUNK_SIZE)[position % CHUNK_SIZE] = pMoved;
+      positions[pMoved.get()] = position;
+   }
+   if (lastPosition % CHUNK_SIZE == 0)
+      pNewSet->_chunks.pop_back();
+   else
+      CopyChunk(*pNewSet, pNewSet->_chunks.size() - 1).pop_back();
+   pNewSet->_size--;
+   StoreInShard(pShard, pCurrent, clientType, ClientSetPtr(std::move(pNewSet)));
+}
+std::shared_ptr<ClientMsgHandler> ClientIndex::Find(int clientType, int clientID) const
+{
+   auto key = MakeKey(clientType, clientID);
+   auto pShard = std::atomic_load(&_idShards[GetShard(key)]);
+   if (pShard == nullptr)
+      return nullptr;
+   auto find = pShard->find(key);
+   return (find == pShard->end()) ? nullptr : find->second->front();
+}
+ClientIndex::ClientSetPtr ClientIndex::FindAll(int clientType) const
+{
+   auto pShard = std::atomic_load(&_typeShards[GetShard((uint32_t)clientType)]);
+   if (pShard == nullptr)
+      return nullptr;
+   auto find = pShard->find(clientType);
+   return (find == pShard->end()) ? nullptr : find->second;
+}
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <chrono>
+
 #include "Logger.h"
 #include "ClientManager.h"
 #include "SubscriptionHandler.h"
@@ -6,88 +9,244 @@
 using namespace Matrix::Common;
 using namespace Matrix::MsgService::MessageThreads;
 
-ClientManager::ClientManager(int freqMS) : TimedThread("ClientManager", freqMS)
+namespace
+{
+   int64_t GetSteadyUS()
+   {
+      return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+   }
+   void StoreMax(std::atomic<int64_t>& max, int64_t value)
+   {
+      auto current = max.load();
+      while (value > current && !max.compare_exchange_weak(current, value))
+         ;
+   }
+}
+
+class ClientManager::ListLock
+{
+private:
+   ClientManager& _manager;
+   std::unique_lock<std::mutex> _lock;
+   std::chrono::steady_clock::time_point _lockedAt;
+public:
+   ListLock(ClientManager& manager)
+         : _manager(manager)
+         , _lock(manager._lock)
+         , _lockedAt(std::chrono::steady_clock::now())
+   {}
+   ~ListLock()
+   {
+      auto holdNS = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _lockedAt).count();
+      _lock.unlock();
+      _manager._lockCount++;
+      _manager._totalLockHoldNS += holdNS;
+      StoreMax(_manager._maxLockHoldNS, holdNS);
+   }
+};
+
+ClientManager::ClientManager()
+      : _shuttingDown(false)
       , _pSubscriptionHandler(std::make_shared<SubscriptionHandler>())
+      , _pClientPool(std::make_shared<ClientMsgHandlerPool>())
+      , _removedCount(0)
+      , _totalCleanupUS(0)
+      , _maxCleanupUS(0)
+      , _lockCount(0)
+      , _totalLockHoldNS(0)
+      , _maxLockHoldNS(0)
+      , _forceClosedCount(0)
 {}
 
 ClientManager::~ClientManager()
 {
    ShutDown();
-   WaitForShutdown(100, 10);
    _clients.clear();
    _pSubscriptionHandler->ClearAll();
    _pSubscriptionHandler = nullptr;
 }
 void ClientManager::ShutDown()
 {
-   if (!_shuttingDown)
+   if (!_shuttingDown.exchange(true))
    {
-      TimedThread::ShutDown();
       ClearAll();
-      _shutdownComplete = true;
+      _clientIndex.Clear();
+      //idle clients hold this manager
+      _pClientPool->Clear();
    }
 }
-void ClientManager::ClearAll()
+size_t ClientManager::ClearAll(uint32_t timeoutMS)
 {
-   LOG_MESSAGE(Logging::LogLevels::DEBUG_LVL) << "Closing " << _clients.size() << " clients!";
+   auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMS);
+   std::vector<std::shared_ptr<ClientMsgHandler>> clients;
+   std::shared_ptr<CountdownLatch> pRemovedLatch;
+   {
+      ListLock lock(*this);
+      pRemovedLatch = std::make_shared<CountdownLatch>(_clients.size());
+      for (auto& pair : _clients)
+      {
+         clients.push_back(pair.second->_pClient);
+         pair.second->_pRemovedLatch = pRemovedLatch;
+      }
+   }
+   LOG_MESSAGE(Logging::LogLevels::DEBUG_LVL) << "Closing " << clients.size() << " clients!";
+   //outside the lock as each client removes itself when its disconnect completes
+   for (auto& pClient : clients)
+   {
+      pClient->StartShutDown();
+      //never connected so no disconnect will remove it
+      if (pClient->IsShutdownComplete() && pClient->GetSocketState() == CommunicationUtils::SocketState::Disconnected)
+         RemoveClient(pClient.get());
+   }
+   if (pRemovedLatch->WaitUntil(deadline))
+      return 0;
 
-   std::lock_guard<std::mutex> lock(_lock);
-   for (auto client : _clients)
+   size_t forceClosed = 0;
+   for (auto& pClient : clients)
    {
-      client->ShutDown();
-      client->WaitForShutdown(100, 10);
+      bool isListed;
+      {
+         ListLock lock(*this);
+         isListed = _clients.find(pClient.get()) != _clients.end();
+      }
+      if (isListed)
+      {
+         pClient->ForceClose();
+         RemoveClient(pClient.get());
+         forceClosed++;
+      }
    }
+   _forceClosedCount += (int64_t)forceClosed;
+   LOG_MESSAGE(Logging::LogLevels::WARNING_LVL) << "Force closed " << forceClosed << " of " << clients.size() << " clients that did not disconnect within " << timeoutMS << "ms";
+   return forceClosed;
 }
 
 void ClientManager::Diagnostics(Matrix::MsgService::CommunicationUtils::DiagnosticTypes )
 {
-   std::lock_guard<std::mutex> lock(_lock);
    std::string msg;
    msg = "\n===========DIAGNOSTICS===========";
-   if (_clients.size() == 0)
-      msg = "\nNo clients connected.";
-   else
    {
-      for (auto client : _clients)
+      ListLock lock(*this);
+      if (_clients.size() == 0)
+         msg = "\nNo clients connected.";
+      else
       {
-         msg += StringUtils::Format("\n%s", client->GetDiagnosticsInfo().c_str());
+         for (auto& pair : _clients)
+         {
+            msg += StringUtils::Format("\n%s", pair.second->_pClient->GetDiagnosticsInfo().c_str());
+         }
       }
    }
+   auto removedCount = _removedCount.load();
+   auto lockCount = _lockCount.load();
+   msg += StringUtils::Format("\nClients removed=%lld; Clean-up avg=%lldus max=%lldus",
+         (long long)removedCount, (long long)(removedCount > 0 ? _totalCleanupUS.load() / removedCount : 0), (long long)_maxCleanupUS.load());
+   msg += StringUtils::Format("\nClient list locked=%lld; Hold avg=%lldns max=%lldns",
+         (long long)lockCount, (long long)(lockCount > 0 ? _totalLockHoldNS.load() / lockCount : 0), (long long)_maxLockHoldNS.load());
+   msg += StringUtils::Format("\nClients force closed=%lld", (long long)_forceClosedCount.load());
+   msg += "\n" + _pSubscriptionHandler->GetLastValueCache().GetDiagnosticsInfo();
    msg += "\n=================================";
    LOG_MESSAGE(Logging::LogLevels::NO_LVL) << msg;
 }
 
-void ClientManager::AddClient(std::shared_ptr<ClientMsgHandler> pClient)
+void ClientManager::SetDefaultSendQueueLimits(const CommunicationUtils::SendQueueLimits& limits)
+{
+   std::lock_guard<std::mutex> lock(_sendQueueLimitsLock);
+   _defaultSendQueueLimits = limits;
+}
+void ClientManager::SetSendQueueLimits(int clientTypeID, const CommunicationUtils::SendQueueLimits& limits)
+{
+   std::lock_guard<std::mutex> lock(_sendQueueLimitsLock);
+   _sendQueueLimitsByType[clientTypeID] = limits;
+}
+CommunicationUtils::SendQueueLimits ClientManager::GetDefaultSendQueueLimits()
 {
-   std::lock_guard<std::mutex> lock(_lock);
-   _clients.push_back(pClient);
+   std::lock_guard<std::mutex> lock(_sendQueueLimitsLock);
+   return _defaultSendQueueLimits;
+}
+CommunicationUtils::SendQueueLimits ClientManager::GetSendQueueLimits(int clientTypeID)
+{
+   std::lock_guard<std::mutex> lock(_sendQueueLimitsLock);
+   auto find = _sendQueueLimitsByType.find(clientTypeID);
+   return (find == _sendQueueLimitsByType.end()) ? _defaultSendQueueLimits : find->second;
 }
 
-std::shared_ptr<ClientMsgHandler> ClientManager::GetClient(int clientTypeID, int clientID)
+void ClientManager::AddClient(std::shared_ptr<ClientMsgHandler> pClient)
 {
-   std::lock_guard<std::mutex> lock(_lock);
-   auto it = find_if(_clients.begin(), _clients.end(),
-         [clientTypeID, clientID](std::shared_ptr<ClientMsgHandler> pClient) -> bool {
-               return pClient->GetClientType() == clientTypeID && pClient->GetClientID() == clientID;
+   auto pEntry = std::make_shared<ClientEntry>();
+   pEntry->_pClient = pClient;
+   std::weak_ptr<ClientManager> pWeakThis = shared_from_this();
+   auto pRawClient = pClient.get();
+   pEntry->_stateConnection = pClient->AddSocketStateChangeObserver(
+         [pWeakThis, pRawClient](CommunicationUtils::SocketState, CommunicationUtils::SocketState newState, CommunicationUtils::DisconnectReason)
+         {
+            auto pThis = pWeakThis.lock();
+            if (pThis != nullptr)
+               pThis->HandleSocketStateChange(pRawClient, newState);
          });
-   if (it != _clients.end())
-      return *it;
-   else
-      return nullptr;
+   ListLock lock(*this);
+   _clients[pRawClient] = pEntry;
 }
 
-bool ClientManager::ExecuteLoopActions()
+size_t ClientManager::GetClientCount()
 {
-   std::lock_guard<std::mutex> lock(_lock);
-   _clients.erase(
-         std::remove_if(
-            _clients.begin(),
-            _clients.end(),
-            [](std::shared_ptr<ClientMsgHandler> pClient) -> bool {
-               return pClient->IsShutdownComplete();
-            }
-         ),
-         _clients.end());
-   return true;
+   ListLock lock(*this);
+   return _clients.size();
+}
 
-}
\ No newline at end of file
+void ClientManager::HandleSocketStateChange(ClientMsgHandler* pClient, CommunicationUtils::SocketState newState)
+{
+   if (newState == CommunicationUtils::SocketState::Disconnecting)
+   {
+      std::shared_ptr<ClientEntry> pEntry;
+      {
+         ListLock lock(*this);
+         auto find = _clients.find(pClient);
+         if (find != _clients.end())
+            pEntry = find->second;
+      }
+      if (pEntry != nullptr)
+      {
+         int64_t notSet = 0;
+         pEntry->_disconnectingUS.compare_exchange_strong(notSet, GetSteadyUS());
+      }
+   }
+   //ClientMsgHandler always shuts down when disconnected, so this is the end of the connection
+   else if (newState == CommunicationUtils::SocketState::Disconnected && pClient->IsShutdownComplete())
+   {
+      RemoveClient(pClient);
+   }
+}
+
+void ClientManager::RemoveClient(ClientMsgHandler* pClient)
+{
+   std::shared_ptr<ClientEntry> pEntry;
+   std::shared_ptr<CountdownLatch> pRemovedLatch;
+   {
+      ListLock lock(*this);
+      auto find = _clients.find(pClient);
+      if (find == _clients.end())
+         return;
+      pEntry = find->second;
+      _clients.erase(find);
+      pRemovedLatch = std::move(pEntry->_pRemovedLatch);
+   }
+   //normally removed when it disconnected
+   if (pEntry->_pClient->IsAuthenticated())
+      _clientIndex.Remove(pClient, pEntry->_pClient->GetClientType(), pEntry->_pClient->GetClientID());
+   pEntry->_stateConnection.disconnect();
+
+   auto nowUS = GetSteadyUS();
+   auto disconnectingUS = pEntry->_disconnectingUS.load();
+   auto cleanupUS = (disconnectingUS > 0) ? nowUS - disconnectingUS : 0;
+   _removedCount++;
+   _totalCleanupUS += cleanupUS;
+   StoreMax(_maxCleanupUS, cleanupUS);
+
+   //the pool only reuses it once the callbacks still running for this connection have let go of it
+   if (!_shuttingDown)
+      _pClientPool->Release(std::move(pEntry->_pClient));
+   //last, so ClearAll returns with the client fully removed
+   if (pRemovedLatch != nullptr)
+      pRemovedLatch->CountDown();
+}
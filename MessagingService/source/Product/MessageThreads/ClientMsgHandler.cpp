@@ -7,6 +7,7 @@
 #include "ClientManager.h"
 #include "Message.h"
 #include "MessageUtils.h"
+#include "HeaderScanner.h"
 
 using namespace Matrix::Common;
 using namespace Matrix::MsgService::MessageThreads;
@@ -25,6 +26,16 @@ std::string ClientMsgHandler::GetDiagnosticsInfo()
 {
    return StringUtils::Format("Client Type=%d; Client ID=%d; %s", _clientType, _clientID, CommHandler::GetDiagnosticsInfo().c_str());
 }
+void ClientMsgHandler::Reset()
+{
+   CommHandler::Reset();
+   _pSubscriptions = nullptr;
+   _isAuthenticated = false;
+   _clientType = 0;
+   _clientID = 0;
+   //the name is taken from the remote address of the next connection
+   _name = "";
+}
 std::string ClientMsgHandler::GetName()
 {
    //TODO: reset the name to when these change
@@ -37,9 +48,13 @@ std::string ClientMsgHandler::GetName()
 void ClientMsgHandler::HandleDisconnect(CommunicationUtils::DisconnectReason reason)
 {
    _pClientManager->GetSubscriptionHandler()->RemoveSubscriptionsFor(this);
+   if (_isAuthenticated)
+      _pClientManager->RemoveLoggedOnClient(this, _clientType, _clientID);
    //send LOGOFF message to subscribers
    if (_clientType > 0)
    {
+      //its values are no longer current, so new subscribers must not be sent them
+      _pClientManager->GetSubscriptionHandler()->GetLastValueCache().RemoveClient(_clientType, _clientID);
       CommonMessages::Header msgToSend;
       msgToSend.set_msgtypeid(CommonMessages::MsgType::LOGOFF);
       CommonMessages::Logon msgLogoff;
@@ -49,15 +64,68 @@ void ClientMsgHandler::HandleDisconnect(CommunicationUtils::DisconnectReason rea
       _pClientManager->GetSubscriptionHandler()->SendToSubscribers(this, msgToSend);
    }
    _shuttingDown = true;
+   //completes the shutdown; the ClientManager removes this client when it sees the socket is disconnected
    CommHandler::HandleDisconnect(reason);
 }
-void ClientMsgHandler::HandleMessageReceived(std::unique_ptr<CommonMessages::Header> pMsg)
+void ClientMsgHandler::HandleFrameReceived(const char* pData, uint32_t size)
 {
-   if (pMsg == nullptr)
+   //heartbeats, messages from unauthenticated clients and messages someone is observing take the full parse path
+   CommonMessages::RoutingHeader routing;
+   if (size == 0 || !_isAuthenticated || HasMessageRxObservers()
+      || !CommonMessages::HeaderScanner::Scan(pData, (int)size, &routing))
+   {
+      CommHandler::HandleFrameReceived(pData, size);
+      return;
+   }
+   switch (routing._msgTypeID)
+   {
+      case CommonMessages::MsgType::LOGON:
+      case CommonMessages::MsgType::LOGOFF:
+      case CommonMessages::MsgType::SUBSCRIBE:
+      case CommonMessages::MsgType::UNSUBSCRIBE:
+         //the broker acts on these so they need to be parsed
+         CommHandler::HandleFrameReceived(pData, size);
+         return;
+      default:
+         break;
+   }
+
+   LOG_MESSAGE(Logging::LogLevels::DEBUG_LVL) << GetName() << ": Received " << CommonMessages::MessageUtils::ToString(routing._msgTypeID) << " msg (key " << routing._msgKey << ")";
+   if (IsStopped())
+      return;
+   //stamp the originating client by appending the fields to the received bytes
+   char origClient[CommonMessages::HeaderScanner::MAX_ORIG_CLIENT_SIZE];
+   size_t origClientSize = 0;
+   if (routing._origClientType == 0 && _clientType != 0)
+      origClientSize = CommonMessages::HeaderScanner::AppendOrigClient(origClient, _clientType, _clientID);
+   auto pFrame = CommonMessages::EncodedFrame::Create(pData, size, origClient, origClientSize
+         , CommonMessages::MessageUtils::IsPriority(routing._msgTypeID, routing._replyMsgKey, routing._priority)
+         , CommonMessages::MessageUtils::IsControl(routing._msgTypeID));
+   if (pFrame == nullptr)
    {
-      SendHeartbeat();
+      LOG_MESSAGE(Logging::LogLevels::WARNING_LVL) << GetName() << ": Unable to forward " << CommonMessages::MessageUtils::ToString(routing._msgTypeID) << " msg (key " << routing._msgKey << ")";
+      return;
    }
+   if (routing._destClientType > 0)
+      SendFrameToClient(routing._destClientType, routing._destClientID, pFrame);
    else
+      _pClientManager->GetSubscriptionHandler()->SendToSubscribers(GetSubscriptions(), this, routing._topic, pFrame
+            , routing._msgTypeID == CommonMessages::MsgType::CUSTOM, routing._origClientType, routing._origClientID);
+}
+void ClientMsgHandler::HandleFramesComplete()
+{
+   _pSubscriptions = nullptr;
+}
+const std::shared_ptr<const SubscriptionTable>& ClientMsgHandler::GetSubscriptions()
+{
+   if (_pSubscriptions == nullptr)
+      _pSubscriptions = _pClientManager->GetSubscriptionHandler()->GetSnapshot();
+   return _pSubscriptions;
+}
+void ClientMsgHandler::HandleMessageReceived(CommonMessages::HeaderPtr pMsg)
+{
+   //heartbeats (null) are answered by CommHandler::HandleHeartbeatReceived when the link is idle
+   if (pMsg != nullptr)
    {
       //if client is not authenticated and this is not a LOGON message, shut em down.
       if (!_isAuthenticated && pMsg->msgtypeid() != CommonMessages::MsgType::LOGON)
@@ -77,14 +145,19 @@ void ClientMsgHandler::HandleMessageReceived(std::unique_ptr<CommonMessages::Hea
       {
          case CommonMessages::MsgType::LOGON:
          {
-            CommonMessages::Logon request;
-            if (request.ParseFromString(pMsg->msg()))
+            auto pRequest = GetMessageArena().Create<CommonMessages::Logon>();
+            if (pRequest->ParseFromString(pMsg->msg()))
             {
+               //logging on again replaces the type and ID it was found by
+               if (_isAuthenticated)
+                  _pClientManager->RemoveLoggedOnClient(this, _clientType, _clientID);
                _isAuthenticated = false;
-               _clientType = request.clienttype();
-               _clientID = request.clientid();
+               _clientType = pRequest->clienttype();
+               _clientID = pRequest->clientid();
                //TODO: actual authentication of some kind
                _isAuthenticated = true;
+               _pClientManager->AddLoggedOnClient(shared_from_this(), _clientType, _clientID);
+               SetSendQueueLimits(_pClientManager->GetSendQueueLimits(_clientType));
                //TODO: if the client is not authenticated, need to call ShutDown after acking
                LOG_MESSAGE(Logging::LogLevels::INFO_LVL) << GetName() << ": Received LOGON request (key " << pMsg->msgkey() << ")";
                sendAck = true;
@@ -94,10 +167,12 @@ void ClientMsgHandler::HandleMessageReceived(std::unique_ptr<CommonMessages::Hea
          }
          case CommonMessages::MsgType::LOGOFF:
          {
-            CommonMessages::Logon request;
-            if (request.ParseFromString(pMsg->msg()))
+            auto pRequest = GetMessageArena().Create<CommonMessages::Logon>();
+            if (pRequest->ParseFromString(pMsg->msg()))
             {
                LOG_MESSAGE(Logging::LogLevels::INFO_LVL) << GetName() << ": Received LOGOFF request (key " << pMsg->msgkey() << ")";
+               _pClientManager->RemoveLoggedOnClient(this, _clientType, _clientID);
+               _pClientManager->GetSubscriptionHandler()->GetLastValueCache().RemoveClient(_clientType, _clientID);
                _clientType = 0;
                _clientID = 0;
                sendToSubscribers = true;
@@ -106,38 +181,45 @@ void ClientMsgHandler::HandleMessageReceived(std::unique_ptr<CommonMessages::Hea
          }
          case CommonMessages::MsgType::SUBSCRIBE:
          {
-            CommonMessages::Subscribe request;
-            if (request.ParseFromString(pMsg->msg()))
+            auto pRequest = GetMessageArena().Create<CommonMessages::Subscribe>();
+            if (pRequest->ParseFromString(pMsg->msg()))
             {
-               LOG_MESSAGE(Logging::LogLevels::DEBUG_LVL) << GetName() << ": Received SUBSCRIBE (key " << pMsg->msgkey() << ") for client (" << request.clienttype() << "," << request.clientid() << ")";
-               _pClientManager->GetSubscriptionHandler()->AddSubscription(shared_from_this(), request);
-//TODO: change to GetClients to handle when clienttype and/or clientid is 0
-               //if the client we are subscribing to is logged on, send a logon message from that client
-               auto pClient = _pClientManager->GetClient(request.clienttype(), request.clientid());
-               if(pClient != nullptr)
+               LOG_MESSAGE(Logging::LogLevels::DEBUG_LVL) << GetName() << ": Received SUBSCRIBE (key " << pMsg->msgkey() << ") for client (" << pRequest->clienttype() << "," << pRequest->clientid() << ")";
+               _pClientManager->GetSubscriptionHandler()->AddSubscription(shared_from_this(), *pRequest);
+               //the rest of the read is routed with the table that includes this change
+               _pSubscriptions = nullptr;
+//TODO: handle when clienttype is 0
+               //if the clients we are subscribing to are logged on, send a logon message from each of them
+               if (pRequest->clientid() == 0)
+               {
+                  auto pClients = _pClientManager->GetClients(pRequest->clienttype());
+                  if (pClients != nullptr)
+                  {
+                     pClients->ForEach([this](const std::shared_ptr<ClientMsgHandler>& pClient)
+                     {
+                        SendLogonFrom(pClient->GetClientType(), pClient->GetClientID());
+                     });
+                  }
+               }
+               else if (_pClientManager->GetClient(pRequest->clienttype(), pRequest->clientid()) != nullptr)
                {
-                  CommonMessages::Header sendLogon;
-                  sendLogon.set_msgtypeid(CommonMessages::MsgType::LOGON);
-                  sendLogon.set_origclienttype(request.clienttype());
-                  sendLogon.set_origclientid(request.clientid());
-                  CommonMessages::Logon msgLogon;
-                  msgLogon.set_clienttype(request.clienttype());
-                  msgLogon.set_clientid(request.clientid());
-                  sendLogon.set_allocated_msg(new std::string(msgLogon.SerializeAsString()));
-                  SendMsg(sendLogon);
+                  SendLogonFrom(pRequest->clienttype(), pRequest->clientid());
                }
+               //then the current values, so the client does not have to ask each publisher for them
+               _pClientManager->GetSubscriptionHandler()->SendLastValues(this, *pRequest);
                sendAck = true;
             } 
             break;
          }
          case CommonMessages::MsgType::UNSUBSCRIBE:
          {
-            CommonMessages::Subscribe request;
-            if (request.ParseFromString(pMsg->msg()))
+            auto pRequest = GetMessageArena().Create<CommonMessages::Subscribe>();
+            if (pRequest->ParseFromString(pMsg->msg()))
             {
                LOG_MESSAGE(Logging::LogLevels::DEBUG_LVL) << GetName() << ": Received UNSUBSCRIBE request (key " << pMsg->msgkey()
-                     << ") for client (" << request.clienttype() << ", " << request.clientid() << ")";
-               _pClientManager->GetSubscriptionHandler()->RemoveSubscription(this, request);
+                     << ") for client (" << pRequest->clienttype() << ", " << pRequest->clientid() << ")";
+               _pClientManager->GetSubscriptionHandler()->RemoveSubscription(this, *pRequest);
+               _pSubscriptions = nullptr;
             }
             sendAck = true;
             break;
@@ -171,17 +253,52 @@ void ClientMsgHandler::SendMessageToSubscribers(CommonMessages::Header* pMsg)
    //if it is directed to a specific client, send it to that client only
    if (pMsg->destclienttype() > 0) 
    {
-      auto pClient = _pClientManager->GetClient(pMsg->destclienttype(), pMsg->destclientid());
-      if (pClient != nullptr)
-      {
-         LOG_MESSAGE(Logging::LogLevels::TRACE_LVL) << GetName() << ": Sending " << CommonMessages::MessageUtils::ToString(pMsg->msgtypeid()) << " msg (key " << pMsg->msgkey() << ") to dest client (" << pMsg->destclienttype() << ", " << pMsg->destclientid() << ")";
-         pClient->SendMsg(*pMsg);
-      }
+      auto pFrame = CommonMessages::EncodedFrame::Create(*pMsg);
+      if (pFrame == nullptr)
+         LOG_MESSAGE(Logging::LogLevels::WARNING_LVL) << GetName() << ": Unable to encode " << CommonMessages::MessageUtils::ToString(pMsg->msgtypeid()) << " msg (key " << pMsg->msgkey() << ")";
+      else
+         SendFrameToClient(pMsg->destclienttype(), pMsg->destclientid(), pFrame);
    }
    //otherwise, send it to all subscribed clients
    else
    {
-      _pClientManager->GetSubscriptionHandler()->SendToSubscribers(this, *pMsg);
+      _pClientManager->GetSubscriptionHandler()->SendToSubscribers(GetSubscriptions(), this, *pMsg);
    }
 
-}
\ No newline at end of file
+}
+void ClientMsgHandler::SendLogonFrom(int clientType, int clientID)
+{
+   CommonMessages::Header sendLogon;
+   sendLogon.set_msgtypeid(CommonMessages::MsgType::LOGON);
+   sendLogon.set_origclienttype(clientType);
+   sendLogon.set_origclientid(clientID);
+   CommonMessages::Logon msgLogon;
+   msgLogon.set_clienttype(clientType);
+   msgLogon.set_clientid(clientID);
+   sendLogon.set_allocated_msg(new std::string(msgLogon.SerializeAsString()));
+   SendMsg(sendLogon);
+}
+void ClientMsgHandler::SendFrameToClient(int destClientType, int destClientID, const CommonMessages::EncodedFramePtr& pFrame)
+{
+   //an ID of 0 sends to every client of the type
+   if (destClientID == 0)
+   {
+      auto pClients = _pClientManager->GetClients(destClientType);
+      if (pClients != nullptr)
+      {
+         LOG_MESSAGE(Logging::LogLevels::TRACE_LVL) << GetName() << ": Sending frame to " << pClients->size() << " clients of type " << destClientType;
+         pClients->ForEach([this, &pFrame](const std::shared_ptr<ClientMsgHandler>& pClient)
+         {
+            if (pClient.get() != this)
+               pClient->SendFrame(pFrame);
+         });
+      }
+      return;
+   }
+   auto pClient = _pClientManager->GetClient(destClientType, destClientID);
+   if (pClient != nullptr)
+   {
+      LOG_MESSAGE(Logging::LogLevels::TRACE_LVL) << GetName() << ": Sending frame to dest client (" << destClientType << ", " << destClientID << ")";
+      pClient->SendFrame(pFrame);
+   }
+}
@@ -0,0 +1,87 @@
+#include "ClientMsgHandlerPool.h"
+#include "ClientManager.h"
+
+using namespace Matrix::MsgService::MessageThreads;
+
+const size_t ClientMsgHandlerPool::DEFAULT_MAX_IDLE;
+
+ClientMsgHandlerPool::ClientMsgHandlerPool()
+      : _createdCount(0)
+      , _reusedCount(0)
+{
+}
+ClientMsgHandlerPool::~ClientMsgHandlerPool()
+{
+   Clear();
+}
+
+void ClientMsgHandlerPool::Warm(std::shared_ptr<CommunicationUtils::IContextHandler> pContextHandler, size_t count)
+{
+   std::lock_guard<std::mutex> lock(_lock);
+   auto& idle = _idleHandlers[pContextHandler.get()];
+   if (idle._maxIdle < count)
+      idle._maxIdle = count;
+   while (idle._handlers.size() < count)
+   {
+      idle._handlers.push_back(std::make_shared<ClientMsgHandler>(pContextHandler, nullptr));
+      _createdCount++;
+   }
+}
+std::shared_ptr<ClientMsgHandler> ClientMsgHandlerPool::Acquire(std::shared_ptr<CommunicationUtils::IContextHandler> pContextHandler
+      , std::shared_ptr<ClientManager> pClientManager)
+{
+   std::shared_ptr<ClientMsgHandler> pClient;
+   {
+      std::lock_guard<std::mutex> lock(_lock);
+      auto it = _idleHandlers.find(pContextHandler.get());
+      if (it != _idleHandlers.end())
+      {
+         auto& handlers = it->second._handlers;
+         //a released handler may still be referenced by handlers for its old connection that have not run yet.
+         //A timer wheel check can still lock its weak pointer after this; it compares the liveness generation,
+         //which Reset() moves on, and does nothing.
+         for (auto handlerIt = handlers.begin(); handlerIt != handlers.end(); ++handlerIt)
+         {
+            if (handlerIt->use_count() == 1)
+            {
+               pClient = std::move(*handlerIt);
+               handlers.erase(handlerIt);
+               break;
+            }
+         }
+      }
+   }
+   if (pClient == nullptr)
+   {
+      _createdCount++;
+      return std::make_shared<ClientMsgHandler>(pContextHandler, pClientManager);
+   }
+   _reusedCount++;
+   pClient->Reset();
+   pClient->SetClientManager(pClientManager);
+   return pClient;
+}
+void ClientMsgHandlerPool::Release(std::shared_ptr<ClientMsgHandler> pClient)
+{
+   auto pContextHandler = pClient->GetContextHandler();
+   std::lock_guard<std::mutex> lock(_lock);
+   auto& idle = _idleHandlers[pContextHandler.get()];
+   if (idle._handlers.size() < idle._maxIdle)
+      idle._handlers.push_back(std::move(pClient));
+}
+void ClientMsgHandlerPool::Clear()
+{
+   std::map<CommunicationUtils::IContextHandler*, IdleHandlers> idleHandlers;
+   {
+      std::lock_guard<std::mutex> lock(_lock);
+      idleHandlers.swap(_idleHandlers);
+   }
+   //destroyed outside the lock
+   idleHandlers.clear();
+}
+size_t ClientMsgHandlerPool::GetIdleCount(const std::shared_ptr<CommunicationUtils::IContextHandler>& pContextHandler)
+{
+   std::lock_guard<std::mutex> lock(_lock);
+   auto it = _idleHandlers.find(pContextHandler.get());
+   return it == _idleHandlers.end() ? 0 : it->second._handlers.size();
+}
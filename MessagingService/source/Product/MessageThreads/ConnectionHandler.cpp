@@ -6,20 +6,118 @@
 using namespace Matrix::Common;
 using namespace Matrix::MsgService::MessageThreads;
 
+#ifdef SO_REUSEPORT
+namespace
+{
+   typedef asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port;
+}
+#endif
+
 ConnectionHandler::ConnectionHandler(std::shared_ptr<CommunicationUtils::IContextHandler> pContextHandler, unsigned short port, std::shared_ptr<ClientManager> pClientManager) : WorkerThread("ConnectionHandler")
       , _pContextHandler(pContextHandler)
       , _port(port)
-      , _acceptor(pContextHandler->GetIOContext(), asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port))
-      , _pClientConnection(nullptr)
+      , _reusePort(false)
       , _pClientManager(pClientManager)
+      , _heartbeatIntervalMS(0)
+      , _idleTimeoutMS(0)
 {
+   OpenAcceptors(false);
+}
+ConnectionHandler::ConnectionHandler(std::shared_ptr<CommunicationUtils::ContextPool> pContextPool, unsigned short port, std::shared_ptr<ClientManager> pClientManager
+      , bool reusePort, bool dualStack) : WorkerThread("ConnectionHandler")
+      , _pContextHandler(pContextPool->GetContextHandler(0))
+      , _pContextPool(pContextPool)
+      , _port(port)
+      , _reusePort(reusePort)
+      , _pClientManager(pClientManager)
+      , _heartbeatIntervalMS(0)
+      , _idleTimeoutMS(0)
+{
+#ifndef SO_REUSEPORT
+   if (_reusePort)
+   {
+      LOG_MESSAGE(Logging::LogLevels::WARNING_LVL) << "SO_REUSEPORT is not supported - using a single acceptor";
+   }
+   _reusePort = false;
+#endif
+   OpenAcceptors(dualStack);
 }
 
+void ConnectionHandler::OpenAcceptors(bool dualStack)
+{
+   size_t numAcceptors = _reusePort ? _pContextPool->GetSize() : 1;
+   for (size_t index = 0; index < numAcceptors; index++)
+   {
+      auto& ioContext = (_pContextPool != nullptr) ? _pContextPool->GetContextHandler(index)->GetIOContext() : _pContextHandler->GetIOContext();
+      _acceptors.push_back(OpenAcceptor(ioContext, dualStack));
+      //the rest must share the port the first was given
+      if (_port == 0)
+         _port = _acceptors.front()->local_endpoint().port();
+   }
+   _pendingConnections.resize(_acceptors.size());
+}
+std::unique_ptr<asio::ip::tcp::acceptor> ConnectionHandler::OpenAcceptor(asio::io_context& ioContext, bool dualStack)
+{
+   std::unique_ptr<asio::ip::tcp::acceptor> pAcceptor(new asio::ip::tcp::acceptor(ioContext));
+   asio::ip::tcp::endpoint endpoint(asio::ip::tcp::v4(), _port);
+   boost::system::error_code ec;
+   if (dualStack)
+   {
+      pAcceptor->open(asio::ip::tcp::v6(), ec);
+      if (ec)
+      {
+         LOG_MESSAGE(Logging::LogLevels::WARNING_LVL) << "IPv6 is not available - listening on IPv4 only: " << ec.message();
+      }
+      else
+      {
+         //accept IPv4 connections as mapped addresses on the same socket
+         pAcceptor->set_option(asio::ip::v6_only(false), ec);
+         endpoint = asio::ip::tcp::endpoint(asio::ip::tcp::v6(), _port);
+      }
+   }
+   if (!pAcceptor->is_open())
+      pAcceptor->open(asio::ip::tcp::v4());
+   pAcceptor->set_option(asio::ip::tcp::acceptor::reuse_address(true));
+#ifdef SO_REUSEPORT
+   if (_reusePort)
+      pAcceptor->set_option(reuse_port(true));
+#endif
+   pAcceptor->bind(endpoint);
+   pAcceptor->listen();
+   return pAcceptor;
+}
+
+void ConnectionHandler::WarmClientPool(size_t countPerContext)
+{
+   if (countPerContext == 0)
+      return;
+   auto pClientPool = _pClientManager->GetClientPool();
+   if (_pContextPool == nullptr)
+   {
+      pClientPool->Warm(_pContextHandler, countPerContext);
+   }
+   else
+   {
+      for (size_t index = 0; index < _pContextPool->GetSize(); index++)
+         pClientPool->Warm(_pContextPool->GetContextHandler(index), countPerContext);
+   }
+   LOG_MESSAGE(Logging::LogLevels::INFO_LVL) << "Created " << pClientPool->GetCreatedCount() << " client handlers ahead of accepting.";
+}
+std::shared_ptr<CommunicationUtils::IContextHandler> ConnectionHandler::GetLeastLoadedContext()
+{
+   return _pContextPool->GetLeastLoaded();
+}
 void ConnectionHandler::Run()
 {
-   LOG_MESSAGE(Logging::LogLevels::INFO_LVL) << "Server starting on port " << _port << ".";
-   StartAccept();
-   _pContextHandler->GetIOContext().run();
+   LOG_MESSAGE(Logging::LogLevels::INFO_LVL) << "Server starting on port " << _port << " with " << _acceptors.size() << " acceptor(s).";
+   for (size_t index = 0; index < _acceptors.size(); index++)
+      StartAccept(index);
+   if (_pContextPool == nullptr)
+      _pContextHandler->GetIOContext().run();
+}
+unsigned short ConnectionHandler::GetPort()
+{
+   return _port;
 }
 
 void ConnectionHandler::ShutDown()
@@ -29,11 +127,19 @@ void ConnectionHandler::ShutDown()
       WorkerThread::ShutDown();
       try
       {
-         _acceptor.close();
-         if (_pClientConnection != nullptr)
+         std::lock_guard<std::mutex> lock(_acceptLock);
+         for (auto& pAcceptor : _acceptors)
+         {
+            boost::system::error_code ec;
+            pAcceptor->close(ec);
+         }
+         for (auto& pClientConnection : _pendingConnections)
          {
-            _pClientConnection->ShutDown();
-            _pClientConnection = nullptr;
+            if (pClientConnection != nullptr)
+            {
+               pClientConnection->ShutDown();
+               pClientConnection = nullptr;
+            }
          }
          if (_pClientManager)
          {
@@ -47,21 +153,32 @@ void ConnectionHandler::ShutDown()
       }
    }
 }
-void ConnectionHandler::StartAccept()
+void ConnectionHandler::StartAccept(size_t index)
 {
+   std::lock_guard<std::mutex> lock(_acceptLock);
    if (!_shuttingDown)
    {
       LOG_MESSAGE(Logging::LogLevels::DEBUG_LVL) << "Waiting for client.";
       // Create a new client for the next connection to use.
-      _pClientConnection = std::make_shared<ClientMsgHandler>(_pContextHandler, _pClientManager);
+      // With an acceptor per context the kernel has already balanced the connection, so keep it on the accepting context.
+      std::shared_ptr<CommunicationUtils::IContextHandler> pContextHandler = _pContextHandler;
+      if (_reusePort)
+         pContextHandler = _pContextPool->GetContextHandler(index);
+      else if (_pContextPool != nullptr)
+         pContextHandler = GetLeastLoadedContext();
+      auto pClientConnection = _pClientManager->GetClientPool()->Acquire(pContextHandler, _pClientManager);
+      pClientConnection->SetLiveness(_heartbeatIntervalMS, _idleTimeoutMS);
+      //until it logs on and its type's limits apply
+      pClientConnection->SetSendQueueLimits(_pClientManager->GetDefaultSendQueueLimits());
+      _pendingConnections[index] = pClientConnection;
 
       // Asynchronously wait to accept a new client
       //
-      _acceptor.async_accept(_pClientConnection->GetSocket()->lowest_layer(),
-         std::bind(&ConnectionHandler::HandleAccept, shared_from_this(), _pClientConnection, std::placeholders::_1));
+      _acceptors[index]->async_accept(pClientConnection->GetSocket()->lowest_layer(),
+         std::bind(&ConnectionHandler::HandleAccept, shared_from_this(), index, pClientConnection, std::placeholders::_1));
    }
 }
-void ConnectionHandler::HandleAccept(
+void ConnectionHandler::HandleAccept(size_t index,
       std::shared_ptr<ClientMsgHandler> pClientConnection,
       const boost::system::error_code& error)
 {
@@ -87,6 +204,6 @@ void ConnectionHandler::HandleAccept(
       }
       // Accept another client
       //
-      StartAccept();
+      StartAccept(index);
    }
 }
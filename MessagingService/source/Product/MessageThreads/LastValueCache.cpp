@@ -0,0 +1,205 @@
+#include "LastValueCache.h"
+#include "StringUtils.h"
+#include "Logger.h"
+
+using namespace Matrix::Common;
+using namespace Matrix::MsgService::MessageThreads;
+namespace CommonMessages = Matrix::MsgService::CommonMessages;
+
+const size_t LastValueCache::NUM_SHARDS;
+
+namespace
+{
+   bool Matches(const CommonMessages::SubscriptionParams& subscription, const CommonMessages::SubscriptionParams& source)
+   {
+      return (subscription._clientType == 0 || subscription._clientType == source._clientType)
+            && (subscription._clientID == 0 || subscription._clientID == source._clientID)
+            && (subscription._topic == 0 || subscription._topic == source._topic);
+   }
+}
+
+LastValueCache::LastValueCache(uint64_t maxBytes)
+      : _maxBytes(maxBytes)
+      , _entryCount(0)
+      , _byteCount(0)
+      , _updateCount(0)
+      , _evictionCount(0)
+      , _oversizedCount(0)
+      , _lookupCount(0)
+      , _hitCount(0)
+{}
+
+void LastValueCache::SetMaxBytes(uint64_t maxBytes)
+{
+   _maxBytes = maxBytes;
+   for (auto& shard : _shards)
+   {
+      std::lock_guard<std::mutex> lock(shard._lock);
+      if (maxBytes == 0)
+         ClearShard(shard);
+      else
+         Evict(shard, maxBytes / NUM_SHARDS);
+   }
+}
+LastValueCache::Shard& LastValueCache::GetShard(const CommonMessages::SubscriptionParams& source)
+{
+   //remixed and the high bits taken: consecutive topics differ only in the low bits of the hash, which also
+   //pick the bucket within the shard
+   auto hash = (uint64_t)CommonMessages::SubscriptionParamsHasher()(source);
+   return _shards[(size_t)((hash * 0x9E3779B97F4A7C15ull) >> 32) % NUM_SHARDS];
+}
+void LastValueCache::Update(const CommonMessages::SubscriptionParams& source, const CommonMessages::EncodedFramePtr& pFrame)
+{
+   auto maxBytes = _maxBytes.load();
+   if (maxBytes == 0 || pFrame == nullptr)
+      return;
+   auto bytes = pFrame->GetCapacity();
+   auto& shard = GetShard(source);
+   std::lock_guard<std::mutex> lock(shard._lock);
+   auto find = shard._lookup.find(source);
+   if (bytes > maxBytes / NUM_SHARDS)
+   {
+      //keeping it would evict everything else in the shard and then the frame itself; the older value is
+      //dropped as a subscriber must not be sent it
+      if (find != shard._lookup.end())
+         RemoveEntry(shard, find->second);
+      if (_oversizedCount++ == 0)
+      {
+         LOG_MESSAGE(Logging::LogLevels::WARNING_LVL) << "Last value cache: a " << bytes << " byte frame from (" << source._clientType << ", "
+               << source._clientID << ") topic " << source._topic << " is bigger than a shard's share of the cap (" << maxBytes / NUM_SHARDS
+               << " bytes) and is not kept; raise the cap to keep frames this size";
+      }
+      else
+      {
+         LOG_MESSAGE(Logging::LogLevels::DEBUG_LVL) << "Last value cache: " << bytes << " byte frame from (" << source._clientType << ", "
+               << source._clientID << ") topic " << source._topic << " is not kept";
+      }
+      return;
+   }
+   if (find == shard._lookup.end())
+   {
+      Entry entry;
+      entry._source = source;
+      entry._pFrame = pFrame;
+      entry._bytes = bytes;
+      shard._entries.push_front(std::move(entry));
+      shard._lookup[source] = shard._entries.begin();
+      _entryCount++;
+   }
+   else
+   {
+      auto& entry = *find->second;
+      shard._bytes -= entry._bytes;
+      _byteCount -= (int64_t)entry._bytes;
+      entry._pFrame = pFrame;
+      entry._bytes = bytes;
+      shard._entries.splice(shard._entries.begin(), shard._entries, find->second);
+   }
+   shard._bytes += bytes;
+   _byteCount += (int64_t)bytes;
+   _updateCount++;
+   Evict(shard, maxBytes / NUM_SHARDS);
+}
+size_t LastValueCache::Find(const CommonMessages::SubscriptionParams& subscription, FrameList* pFrames)
+{
+   return ForEach(subscription, [pFrames](const CommonMessages::SubscriptionParams& source, const CommonMessages::EncodedFramePtr& pFrame)
+   {
+      pFrames->push_back(std::make_pair(source, pFrame));
+   });
+}
+size_t LastValueCache::ForEach(const CommonMessages::SubscriptionParams& subscription, const FrameCallback& func)
+{
+   if (!IsEnabled())
+      return 0;
+   _lookupCount++;
+   size_t numFound = 0;
+   if (subscription._clientType != 0 && subscription._clientID != 0 && subscription._topic != 0)
+   {
+      auto& shard = GetShard(subscription);
+      std::lock_guard<std::mutex> lock(shard._lock);
+      auto find = shard._lookup.find(subscription);
+      if (find != shard._lookup.end())
+      {
+         func(subscription, find->second->_pFrame);
+         shard._entries.splice(shard._entries.begin(), shard._entries, find->second);
+         numFound++;
+      }
+   }
+   else
+   {
+      for (auto& shard : _shards)
+      {
+         std::lock_guard<std::mutex> lock(shard._lock);
+         for (auto& entry : shard._entries)
+         {
+            //not moved to the front; that would reorder the list being walked
+            if (Matches(subscription, entry._source))
+            {
+               func(entry._source, entry._pFrame);
+               numFound++;
+            }
+         }
+      }
+   }
+   if (numFound > 0)
+      _hitCount++;
+   return numFound;
+}
+size_t LastValueCache::RemoveClient(int clientType, int clientID)
+{
+   if (!IsEnabled())
+      return 0;
+   size_t numRemoved = 0;
+   for (auto& shard : _shards)
+   {
+      std::lock_guard<std::mutex> lock(shard._lock);
+      for (auto position = shard._entries.begin(); position != shard._entries.end();)
+      {
+         auto current = position++;
+         if (current->_source._clientType == clientType && current->_source._clientID == clientID)
+         {
+            RemoveEntry(shard, current);
+            numRemoved++;
+         }
+      }
+   }
+   return numRemoved;
+}
+void LastValueCache::Clear()
+{
+   for (auto& shard : _shards)
+   {
+      std::lock_guard<std::mutex> lock(shard._lock);
+      ClearShard(shard);
+   }
+}
+std::string LastValueCache::GetDiagnosticsInfo() const
+{
+   return StringUtils::Format("Last value cache: %lld frames, %lld bytes (max %llu); updates=%lld; evictions=%lld; oversized=%lld; lookups=%lld, hits=%lld",
+         (long long)GetEntryCount(), (long long)GetByteCount(), (unsigned long long)GetMaxBytes(), (long long)GetUpdateCount()
+         , (long long)GetEvictionCount(), (long long)GetOversizedCount(), (long long)GetLookupCount(), (long long)GetHitCount());
+}
+void LastValueCache::Evict(Shard& shard, uint64_t maxBytes)
+{
+   while (shard._bytes > maxBytes && !shard._entries.empty())
+   {
+      RemoveEntry(shard, std::prev(shard._entries.end()));
+      _evictionCount++;
+   }
+}
+void LastValueCache::RemoveEntry(Shard& shard, EntryList::iterator position)
+{
+   shard._bytes -= position->_bytes;
+   _byteCount -= (int64_t)position->_bytes;
+   shard._lookup.erase(position->_source);
+   shard._entries.erase(position);
+   _entryCount--;
+}
+void LastValueCache::ClearShard(Shard& shard)
+{
+   _byteCount -= (int64_t)shard._bytes;
+   _entryCount -= (int64_t)shard._entries.size();
+   shard._bytes = 0;
+   shard._entries.clear();
+   shard._lookup.clear();
+}
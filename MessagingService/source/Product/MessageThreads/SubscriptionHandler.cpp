@@ -3,6 +3,7 @@
 #include "Message.h"
 #include "MessageUtils.h"
 #include "ClientMsgHandler.h"
+#include "EncodedFrame.h"
 
 using namespace Matrix::Common;
 using namespace Matrix::MsgService::MessageThreads;
@@ -12,126 +13,535 @@ SubscriptionHandler::~SubscriptionHandler()
    ClearAll();
 };
 
+namespace
+{
+   const size_t MIN_BUCKETS = SubscriptionTable::BUCKETS_PER_PAGE;
+   //the table is rehashed into twice the buckets when it has more keys than this per bucket
+   const size_t MAX_KEYS_PER_BUCKET = 8;
+
+   size_t GetBucketIndex(const CommonMessages::SubscriptionParams& key, size_t numBuckets)
+   {
+      return CommonMessages::SubscriptionParamsHasher()(key) & (numBuckets - 1);
+   }
+
+   /// <summary>
+   /// Marks the slots already added to the send list of the message being routed on this thread.  A slot
+   /// is marked if its entry is the current epoch, so starting the next message just moves to the next epoch.
+   /// </summary>
+   class DedupMarks
+   {
+   private:
+      std::vector<uint32_t> _marks;
+      uint32_t _epoch;
+   public:
+      DedupMarks() : _epoch(0) {}
+      void Start(size_t numSlots)
+      {
+         if (_marks.size() < numSlots)
+            _marks.resize(numSlots, 0);
+         if (++_epoch == 0)
+         {
+            //wrapped, so old marks could look current
+            std::fill(_marks.begin(), _marks.end(), 0);
+            _epoch = 1;
+         }
+      }
+      //marks slot, returning false if it already was
+      bool Mark(uint32_t slot)
+      {
+         if (_marks[slot] == _epoch)
+            return false;
+         _marks[slot] = _epoch;
+         return true;
+      }
+   };
+   thread_local DedupMarks threadDedupMarks;
+
+   /// <summary>
+   /// Makes the changes for a new version of the table, copying each page and bucket the first time it is changed
+   /// </summary>
+   class TableBuilder
+   {
+   private:
+      SubscriptionTable& _table;
+      std::unordered_map<size_t, std::shared_ptr<SubscriptionTable::Page>> _copiedPages;
+      std::unordered_map<size_t, std::shared_ptr<SubscriptionTable::Bucket>> _copiedBuckets;
+      std::unordered_map<size_t, std::shared_ptr<SubscriptionTable::SlotPage>> _copiedSlotPages;
+   public:
+      //table must be a copy that has not been published yet
+      TableBuilder(SubscriptionTable& table) : _table(table)
+      {
+         if (_table._numBuckets == 0)
+         {
+            _table._numBuckets = MIN_BUCKETS;
+            _table._pages.resize(MIN_BUCKETS / SubscriptionTable::BUCKETS_PER_PAGE);
+         }
+      }
+      //sets the subscribers to key; a null pList removes the key
+      void SetList(const CommonMessages::SubscriptionParams& key, std::shared_ptr<const SubscriptionTable::SubscriberList> pList)
+      {
+         auto& bucket = GetBucket(key);
+         if (pList != nullptr)
+         {
+            auto& pEntry = bucket[key];
+            if (pEntry == nullptr)
+               _table._size++;
+            pEntry = pList;
+         }
+         else if (bucket.erase(key) > 0)
+         {
+            _table._size--;
+         }
+      }
+      //gives pClient a slot, reusing a free one if there is one
+      SubscriberHandle AddClient(std::shared_ptr<IClientMsgHandler> pClient, std::vector<uint32_t>& freeSlots)
+      {
+         uint32_t index;
+         if (!freeSlots.empty())
+         {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+         }
+         else
+         {
+            index = _table._numSlots++;
+            if (index / SubscriptionTable::SLOTS_PER_PAGE >= _table._slotPages.size())
+               _table._slotPages.resize(index / SubscriptionTable::SLOTS_PER_PAGE + 1);
+         }
+         auto& slot = GetSlot(index);
+         slot._pClient = std::move(pClient);
+         SubscriberHandle handle = { index, slot._generation };
+         return handle;
+      }
+      //frees the slot of handle; handles to it no longer resolve
+      void RemoveClient(SubscriberHandle handle, std::vector<uint32_t>& freeSlots)
+      {
+         auto& slot = GetSlot(handle._slot);
+         slot._pClient = nullptr;
+         slot._generation++;
+         freeSlots.push_back(handle._slot);
+      }
+      //drops emptied buckets and grows the table if it is too full
+      void Finish()
+      {
+         for (auto& pair : _copiedBuckets)
+         {
+            if (pair.second->empty())
+               (*_copiedPages[pair.first / SubscriptionTable::BUCKETS_PER_PAGE])[pair.first % SubscriptionTable::BUCKETS_PER_PAGE] = nullptr;
+         }
+         for (auto& pair : _copiedPages)
+         {
+            if (std::all_of(pair.second->begin(), pair.second->end(), [](const std::shared_ptr<const SubscriptionTable::Bucket>& pBucket) { return pBucket == nullptr; }))
+               _table._pages[pair.first] = nullptr;
+         }
+         _copiedBuckets.clear();
+         _copiedPages.clear();
+         _copiedSlotPages.clear();
+         if (_table._size > _table._numBuckets * MAX_KEYS_PER_BUCKET)
+            Rehash(_table._numBuckets * 2);
+      }
+   private:
+      SubscriptionTable::Page& GetPage(size_t pageIndex)
+      {
+         auto& pCopy = _copiedPages[pageIndex];
+         if (pCopy == nullptr)
+         {
+            auto& pPage = _table._pages[pageIndex];
+            pCopy = (pPage == nullptr) ? std::make_shared<SubscriptionTable::Page>(SubscriptionTable::BUCKETS_PER_PAGE) : std::make_shared<SubscriptionTable::Page>(*pPage);
+            pPage = pCopy;
+         }
+         return *pCopy;
+      }
+      SubscriptionTable::ClientSlot& GetSlot(uint32_t index)
+      {
+         auto pageIndex = index / SubscriptionTable::SLOTS_PER_PAGE;
+         auto& pCopy = _copiedSlotPages[pageIndex];
+         if (pCopy == nullptr)
+         {
+            auto& pPage = _table._slotPages[pageIndex];
+            pCopy = (pPage == nullptr) ? std::make_shared<SubscriptionTable::SlotPage>(SubscriptionTable::SLOTS_PER_PAGE) : std::make_shared<SubscriptionTable::SlotPage>(*pPage);
+            pPage = pCopy;
+         }
+         return (*pCopy)[index % SubscriptionTable::SLOTS_PER_PAGE];
+      }
+      SubscriptionTable::Bucket& GetBucket(const CommonMessages::SubscriptionParams& key)
+      {
+         auto index = GetBucketIndex(key, _table._numBuckets);
+         auto& pCopy = _copiedBuckets[index];
+         if (pCopy == nullptr)
+         {
+            auto& pBucket = GetPage(index / SubscriptionTable::BUCKETS_PER_PAGE)[index % SubscriptionTable::BUCKETS_PER_PAGE];
+            pCopy = (pBucket == nullptr) ? std::make_shared<SubscriptionTable::Bucket>() : std::make_shared<SubscriptionTable::Bucket>(*pBucket);
+            pBucket = pCopy;
+         }
+         return *pCopy;
+      }
+      void Rehash(size_t numBuckets)
+      {
+         std::vector<std::shared_ptr<SubscriptionTable::Page>> newPages(numBuckets / SubscriptionTable::BUCKETS_PER_PAGE);
+         std::vector<std::shared_ptr<SubscriptionTable::Bucket>> newBuckets(numBuckets);
+         for (auto& pPage : _table._pages)
+         {
+            if (pPage == nullptr)
+               continue;
+            for (auto& pBucket : *pPage)
+            {
+               if (pBucket == nullptr)
+                  continue;
+               for (auto& pair : *pBucket)
+               {
+                  auto index = GetBucketIndex(pair.first, numBuckets);
+                  auto& pNewBucket = newBuckets[index];
+                  if (pNewBucket == nullptr)
+                  {
+                     pNewBucket = std::make_shared<SubscriptionTable::Bucket>();
+                     auto& pNewPage = newPages[index / SubscriptionTable::BUCKETS_PER_PAGE];
+                     if (pNewPage == nullptr)
+                        pNewPage = std::make_shared<SubscriptionTable::Page>(SubscriptionTable::BUCKETS_PER_PAGE);
+                     (*pNewPage)[index % SubscriptionTable::BUCKETS_PER_PAGE] = pNewBucket;
+                  }
+                  pNewBucket->insert(pair);
+               }
+            }
+         }
+         _table._pages.assign(newPages.begin(), newPages.end());
+         _table._numBuckets = numBuckets;
+      }
+   };
+}
+
+const size_t SubscriptionTable::BUCKETS_PER_PAGE;
+const size_t SubscriptionTable::SLOTS_PER_PAGE;
+
+const SubscriptionTable::SubscriberList* SubscriptionTable::Find(const CommonMessages::SubscriptionParams& key) const
+{
+   if (_size == 0)
+      return nullptr;
+   auto index = GetBucketIndex(key, _numBuckets);
+   auto& pPage = _pages[index / BUCKETS_PER_PAGE];
+   if (pPage == nullptr)
+      return nullptr;
+   auto& pBucket = (*pPage)[index % BUCKETS_PER_PAGE];
+   if (pBucket == nullptr)
+      return nullptr;
+   auto find = pBucket->find(key);
+   return (find == pBucket->end()) ? nullptr : find->second.get();
+}
+
 void SubscriptionHandler::AddSubscription(std::shared_ptr<IClientMsgHandler> pClient, CommonMessages::Subscribe& subscribeMsg)
 {
    if (pClient != nullptr)
    {
       CommonMessages::SubscriptionParams index(subscribeMsg.clienttype(), subscribeMsg.clientid(), subscribeMsg.topic());
       std::lock_guard<std::mutex> lock(_lock);
-      auto find = _msgLookup.find(index);
-      if (find == _msgLookup.end())
-      {
-         std::vector <std::shared_ptr<IClientMsgHandler>> newVector;
-         newVector.push_back(pClient);
-         _msgLookup.insert(std::make_pair(index, newVector));
-      }
-      else
+      auto findClient = _clients.find(pClient.get());
+      if (findClient != _clients.end() && findClient->second._positions.find(index) != findClient->second._positions.end())
+         return;
+      auto pCurrent = std::atomic_load(&_pTable);
+      auto pNext = std::make_shared<SubscriptionTable>(*pCurrent);
+      TableBuilder builder(*pNext);
+      if (findClient == _clients.end())
       {
-         if (std::find(find->second.begin(), find->second.end(), pClient) == find->second.end())
-            find->second.push_back(pClient);
+         findClient = _clients.insert(std::make_pair(pClient.get(), ClientSubscriptions())).first;
+         findClient->second._handle = builder.AddClient(pClient, _freeSlots);
       }
+      auto pList = pCurrent->Find(index);
+      auto pNewList = (pList == nullptr) ? std::make_shared<SubscriptionTable::SubscriberList>() : std::make_shared<SubscriptionTable::SubscriberList>(*pList);
+      findClient->second._positions[index] = pNewList->size();
+      pNewList->push_back(findClient->second._handle);
+      builder.SetList(index, pNewList);
+      builder.Finish();
+      Publish(pNext);
    }
 }
 void SubscriptionHandler::RemoveSubscription(IClientMsgHandler* pClient, CommonMessages::Subscribe& unsubscribeMsg)
 {
    CommonMessages::SubscriptionParams index(unsubscribeMsg.clienttype(), unsubscribeMsg.clientid(), unsubscribeMsg.topic());
    std::lock_guard<std::mutex> lock(_lock);
-   auto find = _msgLookup.find(index);
-   if (find != _msgLookup.end())
+   auto findClient = _clients.find(pClient);
+   if (findClient == _clients.end())
+      return;
+   auto& positions = findClient->second._positions;
+   auto findPosition = positions.find(index);
+   if (findPosition == positions.end())
+      return;
+   auto position = findPosition->second;
+   positions.erase(findPosition);
+
+   auto pCurrent = std::atomic_load(&_pTable);
+   auto pNext = std::make_shared<SubscriptionTable>(*pCurrent);
+   TableBuilder builder(*pNext);
+   //drop empty entries so they are not probed for every message
+   builder.SetList(index, RemoveAt(*pCurrent, index, position));
+   if (positions.empty())
    {
-      auto& list = find->second;
-      list.erase(std::remove_if(list.begin(), list.end(),
-         [pClient](std::shared_ptr<IClientMsgHandler> pMyClient) { return pClient == pMyClient.get(); }), list.end());
+      builder.RemoveClient(findClient->second._handle, _freeSlots);
+      _clients.erase(findClient);
    }
+   builder.Finish();
+   Publish(pNext);
 }
 void SubscriptionHandler::RemoveSubscriptionsFor(IClientMsgHandler* pClient)
 {
-   int numRemoved = 0;
+   size_t numRemoved = 0;
    std::unique_lock<std::mutex> lock(_lock);
-   for (auto iter = _msgLookup.begin(); iter != _msgLookup.end(); ++iter)
+   auto findClient = _clients.find(pClient);
+   if (findClient != _clients.end())
    {
-      auto& list = iter->second;
-      list.erase(std::remove_if(list.begin(), list.end(),
-               [pClient, &numRemoved](std::shared_ptr<IClientMsgHandler> pMyClient)
-               {
-                  if (pClient == pMyClient.get())
-                  {
-                     numRemoved++;
-                     return true;
-                  }
-                  return false;
-               }),
-               list.end());
-
+      //only the entries the client is in are touched
+      PositionLookup positions;
+      positions.swap(findClient->second._positions);
+      auto handle = findClient->second._handle;
+      _clients.erase(findClient);
+      numRemoved = positions.size();
+      auto pCurrent = std::atomic_load(&_pTable);
+      auto pNext = std::make_shared<SubscriptionTable>(*pCurrent);
+      TableBuilder builder(*pNext);
+      for (auto& pair : positions)
+         builder.SetList(pair.first, RemoveAt(*pCurrent, pair.first, pair.second));
+      builder.RemoveClient(handle, _freeSlots);
+      builder.Finish();
+      Publish(pNext);
    }
    lock.unlock();
    LOG_MESSAGE(Logging::LogLevels::DEBUG_LVL) << "Removed " << numRemoved << " subscriptions for client " << pClient->GetName();
 }
+std::shared_ptr<const SubscriptionTable::SubscriberList> SubscriptionHandler::RemoveAt(const SubscriptionTable& table, const CommonMessages::SubscriptionParams& key, size_t position)
+{
+   auto& list = *table.Find(key);
+   if (list.size() == 1)
+      return nullptr;
+   auto pNewList = std::make_shared<SubscriptionTable::SubscriberList>(list);
+   auto lastPosition = pNewList->size() - 1;
+   if (position != lastPosition)
+   {
+      auto moved = (*pNewList)[lastPosition];
+      _clients[table.GetClient(moved)]._positions[key] = position;
+      (*pNewList)[position] = moved;
+   }
+   pNewList->pop_back();
+   return pNewList;
+}
 
 void SubscriptionHandler::ClearAll()
 {
    std::lock_guard<std::mutex> lock(_lock);
-   _msgLookup.clear();
+   _clients.clear();
+   _freeSlots.clear();
+   _lastValues.Clear();
+   auto pCurrent = std::atomic_load(&_pTable);
+   if (pCurrent->_size == 0)
+      return;
+   auto pNext = std::make_shared<SubscriptionTable>();
+   pNext->_version = pCurrent->_version;
+   Publish(pNext);
 }
-void SubscriptionHandler::SendToSubscribers(IClientMsgHandler* pSentFrom, CommonMessages::Header& msg)
+void SubscriptionHandler::Publish(std::shared_ptr<SubscriptionTable> pTable)
 {
-   std::unordered_set<std::shared_ptr<IClientMsgHandler>> sendList;
-   CommonMessages::SubscriptionParams index;
-   auto clientType = pSentFrom->GetClientType();
-   auto clientID = pSentFrom->GetClientID();
-
-   //find all the clients that are subscribed to this type of message
-   //scope for lock_guard
+   auto version = ++pTable->_version;
+   //publishers holding the old version keep it alive until they finish with it
+   std::atomic_store(&_pTable, SubscriptionTablePtr(std::move(pTable)));
+   _version = version;
+}
+void SubscriptionTable::FindSubscribers(int clientType, int clientID, int topic, SendList& sendList) const
+{
+   if (_size == 0)
+      return;
+   //a subscription matches on each field if it is equal or 0, so only these keys can match;
+   //a field that is already 0 has just the one key
+   const int clientTypes[] = { clientType, 0 };
+   const int clientIDs[] = { clientID, 0 };
+   const int topics[] = { topic, 0 };
+   const int numClientTypes = (clientType == 0) ? 1 : 2;
+   const int numClientIDs = (clientID == 0) ? 1 : 2;
+   const int numTopics = (topic == 0) ? 1 : 2;
+   const SubscriberList* listsFound[8];
+   int numListsFound = 0;
+   size_t numFound = 0;
+   for (int typeIndex = 0; typeIndex < numClientTypes; typeIndex++)
    {
-      std::lock_guard<std::mutex> lock(_lock);
-      for (auto pair : _msgLookup)
+      for (int idIndex = 0; idIndex < numClientIDs; idIndex++)
       {
-         if (pair.first._clientType == clientType || pair.first._clientType == 0)
+         for (int topicIndex = 0; topicIndex < numTopics; topicIndex++)
          {
-            if (pair.first._clientID == clientID || pair.first._clientID == 0)
+            auto pList = Find(CommonMessages::SubscriptionParams(clientTypes[typeIndex], clientIDs[idIndex], topics[topicIndex]));
+            if (pList != nullptr && !pList->empty())
             {
-               if (pair.first._topic == 0 || pair.first._topic == (int)msg.topic())
-               {
-                  for (auto pClient : pair.second)
-                  {
-                     sendList.insert(pClient);
-                  }
-               }
+               listsFound[numListsFound++] = pList;
+               numFound += pList->size();
             }
          }
       }
    }
+   if (numListsFound == 0)
+      return;
+   sendList.reserve(sendList.size() + numFound);
+   //a client is only in a list once
+   if (numListsFound == 1)
+   {
+      for (auto handle : *listsFound[0])
+      {
+         auto pClient = GetClient(handle);
+         if (pClient != nullptr)
+            sendList.push_back(pClient);
+      }
+      return;
+   }
+   //but may be subscribed through more than one key
+   auto& marks = threadDedupMarks;
+   marks.Start(_numSlots);
+   for (int listIndex = 0; listIndex < numListsFound; listIndex++)
+   {
+      for (auto handle : *listsFound[listIndex])
+      {
+         if (marks.Mark(handle._slot))
+         {
+            auto pClient = GetClient(handle);
+            if (pClient != nullptr)
+               sendList.push_back(pClient);
+         }
+      }
+   }
+}
+void SubscriptionHandler::SendFrame(IClientMsgHandler* pSentFrom, const SubscriptionTable::SendList& sendList, const CommonMessages::EncodedFramePtr& pFrame
+      , const CommonMessages::SubscriptionParams* pSource)
+{
+   for (auto pClient : sendList)
+   {
+      if (pClient != pSentFrom)
+      {
+         if (pSource != nullptr)
+            pClient->SendPublishedFrame(pFrame, *pSource);
+         else
+            pClient->SendFrame(pFrame);
+      }
+   }
+}
+void SubscriptionHandler::SendToSubscribers(IClientMsgHandler* pSentFrom, CommonMessages::Header& msg)
+{
+   SendToSubscribers(GetSnapshot(), pSentFrom, msg);
+}
+void SubscriptionHandler::SendToSubscribers(const SubscriptionTablePtr& pSnapshot, IClientMsgHandler* pSentFrom, CommonMessages::Header& msg)
+{
+   SubscriptionTable::SendList sendList;
+   auto clientType = pSentFrom->GetClientType();
+   auto clientID = pSentFrom->GetClientID();
+   //only application messages are cached or can replace one another; every LOGON/LOGOFF has to arrive
+   bool isPublished = msg.msgtypeid() == CommonMessages::MsgType::CUSTOM;
+   bool cache = isPublished && _lastValues.IsEnabled();
+   //a message that is cached is encoded first, as its subscribers are found after caching it
+   if (!cache)
+      pSnapshot->FindSubscribers(clientType, clientID, (int)msg.topic(), sendList);
 
    if (msg.origclienttype() == 0)
    {
       msg.set_origclienttype(clientType);
       msg.set_origclientid(clientID);
    }
-   //now send the msg to the clients we found
-   if (sendList.size() > 0)
+   //now send the msg to the clients we found - it is encoded once and the same frame is queued on every client
+   if (sendList.size() > 0 || cache)
    {
-      LOG_MESSAGE(Logging::LogLevels::TRACE_LVL) << "Sending msg " << CommonMessages::MessageUtils::ToString(msg.msgtypeid()) << " to subscibers";
-      for (auto pClient : sendList)
+      auto pFrame = CommonMessages::EncodedFrame::Create(msg);
+      if (pFrame == nullptr)
       {
-         if (pClient.get() != pSentFrom)
-         {
-            pClient->SendMsg(msg);
-         }
+         LOG_MESSAGE(Logging::LogLevels::WARNING_LVL) << "Unable to encode " << CommonMessages::MessageUtils::ToString(msg.msgtypeid()) << " msg (key " << msg.msgkey() << ") for subscribers";
+         return;
+      }
+      //the originating client, as a relayed message keeps the client that first published it
+      CommonMessages::SubscriptionParams source(msg.origclienttype(), msg.origclientid(), (int)msg.topic());
+      //held until the frame is queued, as the send list points at its clients
+      SubscriptionTablePtr pCurrent;
+      if (cache)
+      {
+         _lastValues.Update(source, pFrame);
+         GetTableAfterCaching(pSnapshot, pCurrent).FindSubscribers(clientType, clientID, (int)msg.topic(), sendList);
       }
+      LOG_MESSAGE(Logging::LogLevels::TRACE_LVL) << "Sending msg " << CommonMessages::MessageUtils::ToString(msg.msgtypeid()) << " to " << sendList.size() << " subscibers";
+      SendFrame(pSentFrom, sendList, pFrame, isPublished ? &source : nullptr);
    }
 }
+void SubscriptionHandler::SendToSubscribers(IClientMsgHandler* pSentFrom, int topic, const CommonMessages::EncodedFramePtr& pFrame)
+{
+   SendToSubscribers(GetSnapshot(), pSentFrom, topic, pFrame);
+}
+void SubscriptionHandler::SendToSubscribers(const SubscriptionTablePtr& pSnapshot, IClientMsgHandler* pSentFrom, int topic, const CommonMessages::EncodedFramePtr& pFrame, bool isPublished
+      , int origClientType, int origClientID)
+{
+   SubscriptionTable::SendList sendList;
+   auto clientType = pSentFrom->GetClientType();
+   auto clientID = pSentFrom->GetClientID();
+   if (origClientType == 0)
+   {
+      origClientType = clientType;
+      origClientID = clientID;
+   }
+   CommonMessages::SubscriptionParams source(origClientType, origClientID, topic);
+   SubscriptionTablePtr pCurrent;
+   if (isPublished && _lastValues.IsEnabled())
+   {
+      _lastValues.Update(source, pFrame);
+      GetTableAfterCaching(pSnapshot, pCurrent).FindSubscribers(clientType, clientID, topic, sendList);
+   }
+   else
+   {
+      pSnapshot->FindSubscribers(clientType, clientID, topic, sendList);
+   }
+   if (sendList.size() > 0)
+   {
+      LOG_MESSAGE(Logging::LogLevels::TRACE_LVL) << "Sending frame to " << sendList.size() << " subscibers";
+      SendFrame(pSentFrom, sendList, pFrame, isPublished ? &source : nullptr);
+   }
+}
+const SubscriptionTable& SubscriptionHandler::GetTableAfterCaching(const SubscriptionTablePtr& pSnapshot, SubscriptionTablePtr& pCurrent) const
+{
+   //AddSubscription publishes the new version before SendLastValues reads the cache, and the cache's shard lock
+   //orders that read against the Update just made: either the read sees the new value, or this sees the version
+   if (_version.load() == pSnapshot->_version)
+      return *pSnapshot;
+   pCurrent = GetSnapshot();
+   return *pCurrent;
+}
+size_t SubscriptionHandler::SendLastValues(IClientMsgHandler* pClient, const CommonMessages::Subscribe& subscribeMsg)
+{
+   auto clientType = pClient->GetClientType();
+   auto clientID = pClient->GetClientID();
+   size_t numSent = 0;
+   //queued while the cache holds the frame's lock: a newer frame published meanwhile waits in Update, so it is
+   //queued after the cached one rather than being overtaken (or, on a conflated topic, replaced) by it
+   _lastValues.ForEach(CommonMessages::SubscriptionParams(subscribeMsg.clienttype(), subscribeMsg.clientid(), subscribeMsg.topic())
+         , [pClient, clientType, clientID, &numSent](const CommonMessages::SubscriptionParams& source, const CommonMessages::EncodedFramePtr& pFrame)
+   {
+      //not its own messages, as with SendToSubscribers
+      if (source._clientType == clientType && source._clientID == clientID)
+         return;
+      if (pClient->SendPublishedFrame(pFrame, source))
+         numSent++;
+   });
+   return numSent;
+}
 std::vector<CommonMessages::SubscriptionParams> SubscriptionHandler::GetSubscribersTo(int clientType, int clientID)
 {
-   std::lock_guard<std::mutex> lock(_lock);
+   auto pSnapshot = GetSnapshot();
    std::vector<CommonMessages::SubscriptionParams> paramsList;
-   for (auto pair : _msgLookup)
+   for (auto& pPage : pSnapshot->_pages)
    {
-      if (pair.first._clientType == clientType && pair.first._clientID == clientID)
+      if (pPage == nullptr)
+         continue;
+      for (auto& pBucket : *pPage)
       {
-         for (auto pSubscriber : pair.second)
+         if (pBucket == nullptr)
+            continue;
+         for (auto& pair : *pBucket)
          {
-            CommonMessages::SubscriptionParams param(pSubscriber->GetClientType(), pSubscriber->GetClientID(), pair.first._topic);
-            paramsList.push_back(param);
+            if (pair.first._clientType == clientType && pair.first._clientID == clientID)
+            {
+               for (auto handle : *pair.second)
+               {
+                  auto pSubscriber = pSnapshot->GetClient(handle);
+                  CommonMessages::SubscriptionParams param(pSubscriber->GetClientType(), pSubscriber->GetClientID(), pair.first._topic);
+                  paramsList.push_back(param);
+               }
+            }
          }
       }
    }
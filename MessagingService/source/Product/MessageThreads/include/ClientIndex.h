@@ -0,0 +1,130 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "../stdafx.h"
+
+namespace Matrix
+{
+namespace MsgService
+{
+namespace MessageThreads
+{
+   class ClientMsgHandler;
+
+   /// <summary>
+   /// Finds logged on clients by (clientType, clientID) and by clientType.
+   ///
+   /// Lookups do not take the index lock.  Each index is split into shards that are immutable once published
+   /// and read with std::atomic_load (a short spinlock in libstdc++, so lookups are read-mostly rather than
+   /// lock-free).  Adding or removing a client copies the shard it is in and swaps the copy in.  The clients
+   /// of a type are held in fixed size chunks, so a change copies the chunk pointers and at most two chunks
+   /// rather than every client of the type.
+   /// </summary>
+   class ClientIndex
+   {
+   public:
+      typedef std::vector<std::shared_ptr<ClientMsgHandler>> ClientList;
+      typedef std::shared_ptr<const ClientList> ClientListPtr;
+      /// <summary>
+      /// The clients of one type, in no particular order
+      /// </summary>
+      struct ClientSet
+      {
+         ClientSet() : _size(0) {}
+         //at most CHUNK_SIZE clients each; every chunk but the last is full
+         std::vector<ClientListPtr> _chunks;
+         size_t _size;
+
+         size_t size() const { return _size; }
+         template<class Function>
+         void ForEach(const Function& function) const
+         {
+            for (auto& pChunk : _chunks)
+            {
+               for (auto& pClient : *pChunk)
+                  function(pClient);
+            }
+         }
+      };
+      typedef std::shared_ptr<const ClientSet> ClientSetPtr;
+
+      //****************************************
+      // Constructors/Destructors
+      //****************************************
+   public:
+      /// <summary>
+      /// Initializes a new instance of the <see cref="ClientIndex"/> class.
+      /// </summary>
+      MESSAGETHREADS_API ClientIndex();
+   private:
+      ClientIndex(const ClientIndex&);
+      ClientIndex& operator=(const ClientIndex&);
+
+      //****************************************
+      // Fields
+      //****************************************
+   public:
+      /// <summary>
+      /// Number of shards each index is split into
+      /// </summary>
+      static const size_t NUM_SHARDS = 64;
+      /// <summary>
+      /// Number of clients in each chunk of a <see cref="ClientSet"/>
+      /// </summary>
+      static const size_t CHUNK_SIZE = 64;
+   private:
+      //clients by (clientType, clientID) packed into 64 bits
+      typedef std::unordered_map<uint64_t, ClientListPtr> IDLookup;
+      typedef std::unordered_map<int, ClientSetPtr> TypeLookup;
+      //only accessed with std::atomic_load/atomic_store; null for a shard with no clients
+      std::shared_ptr<const IDLookup> _idShards[NUM_SHARDS];
+      std::shared_ptr<const TypeLookup> _typeShards[NUM_SHARDS];
+      //each client's index in the set of its type, so a change finds it without searching; guarded by _lock
+      std::unordered_map<int, std::unordered_map<ClientMsgHandler*, size_t>> _typePositions;
+      //serializes changes; lookups never take it
+      std::mutex _lock;
+      std::atomic<size_t> _count;
+
+      //****************************************
+      // Methods
+      //****************************************
+   public:
+      /// <summary>
+      /// Adds a client under the type and ID it logged on with; does nothing if it is already there
+      /// </summary>
+      MESSAGETHREADS_API void Add(const std::shared_ptr<ClientMsgHandler>& pClient, int clientType, int clientID);
+      /// <summary>
+      /// Removes a client from under the type and ID it was added with; does nothing if it is not there
+      /// </summary>
+      MESSAGETHREADS_API void Remove(ClientMsgHandler* pClient, int clientType, int clientID);
+      /// <summary>
+      /// Removes every client
+      /// </summary>
+      MESSAGETHREADS_API void Clear();
+      /// <summary>
+      /// Finds a client logged on as (clientType, clientID).  If more than one is, the first to log on is returned.
+      /// </summary>
+      /// <returns>The client; nullptr if there is none</returns>
+      MESSAGETHREADS_API std::shared_ptr<ClientMsgHandler> Find(int clientType, int clientID) const;
+      /// <summary>
+      /// Finds every client logged on with clientType
+      /// </summary>
+      /// <returns>The clients; nullptr if there are none</returns>
+      MESSAGETHREADS_API ClientSetPtr FindAll(int clientType) const;
+      /// <summary>
+      /// Gets the number of clients in the index
+      /// </summary>
+      size_t GetCount() const { return _count.load(); }
+   private:
+      //adds pClient to the set of clientType and removes it again.  _lock must be held.
+      void AddToType(const std::shared_ptr<ClientMsgHandler>& pClient, int clientType);
+      void RemoveFromType(ClientMsgHandler* pClient, int clientType);
+   };
+}
+}
+}
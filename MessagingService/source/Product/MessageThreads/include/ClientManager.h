@@ -1,9 +1,14 @@
 #pragma once
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
 
 #include "../stdafx.h"
-#include "TimedThread.h"
 #include "ClientMsgHandler.h"
+#include "ClientMsgHandlerPool.h"
+#include "ClientIndex.h"
+#include "CountdownLatch.h"
 
 namespace CommunicationUtils = Matrix::MsgService::CommunicationUtils;
 
@@ -15,7 +20,11 @@ namespace MessageThreads
 {
    class SubscriptionHandler;
 
-   class ClientManager : public Matrix::Common::TimedThread
+   /// <summary>
+   /// Keeps the connected clients.  A client is removed, and handed back to the client pool, as soon as
+   /// its disconnect completes: the manager observes each client's socket state rather than polling.
+   /// </summary>
+   class ClientManager : public std::enable_shared_from_this<ClientManager>
    {
       //****************************************
       // Constructors/Destructors
@@ -24,56 +33,156 @@ namespace MessageThreads
       /// <summary>
       /// Initializes a new instance of the <see cref="ClientManager"/> class.
       /// </summary>
-      /// <param name="freqMS">Frequency to check for removing dead clients.</param>
-      MESSAGETHREADS_API ClientManager(int freqMS = 1000);
+      MESSAGETHREADS_API ClientManager();
 
       MESSAGETHREADS_API ~ClientManager();
+   private:
+      ClientManager(const ClientManager&);
+      ClientManager& operator=(const ClientManager&);
 
       //****************************************
       // Fields
       //****************************************
    private:
-      std::vector<std::shared_ptr<ClientMsgHandler>> _clients;
+      struct ClientEntry
+      {
+         std::shared_ptr<ClientMsgHandler> _pClient;
+         CommunicationUtils::SocketStateChangeConnection _stateConnection;
+         //when the client started disconnecting; 0 until it does
+         std::atomic<int64_t> _disconnectingUS;
+         //counted down when the client is removed, if ClearAll is waiting for it; guarded by _lock
+         std::shared_ptr<Common::CountdownLatch> _pRemovedLatch;
+         ClientEntry() : _disconnectingUS(0) {}
+      };
+      std::unordered_map<ClientMsgHandler*, std::shared_ptr<ClientEntry>> _clients;
       std::mutex _lock;
+      std::atomic<bool> _shuttingDown;
       std::shared_ptr<SubscriptionHandler> _pSubscriptionHandler;
+      std::shared_ptr<ClientMsgHandlerPool> _pClientPool;
+      //the logged on clients, for finding the destination of directed messages
+      ClientIndex _clientIndex;
+      //clean-up statistics: from a client starting to disconnect until it has been removed
+      std::atomic<int64_t> _removedCount;
+      std::atomic<int64_t> _totalCleanupUS;
+      std::atomic<int64_t> _maxCleanupUS;
+      //how long _lock is held each time it is taken
+      std::atomic<int64_t> _lockCount;
+      std::atomic<int64_t> _totalLockHoldNS;
+      std::atomic<int64_t> _maxLockHoldNS;
+      //clients force closed by ClearAll
+      std::atomic<int64_t> _forceClosedCount;
+      //the send queue limits for clients that have not logged on or whose type has none of its own
+      CommunicationUtils::SendQueueLimits _defaultSendQueueLimits;
+      std::unordered_map<int, CommunicationUtils::SendQueueLimits> _sendQueueLimitsByType;
+      std::mutex _sendQueueLimitsLock;
       //****************************************
       // Methods
       //****************************************
    public:
+      /// <summary>
+      /// The default time ClearAll waits for the clients to disconnect
+      /// </summary>
+      static const uint32_t DEFAULT_CLEAR_TIMEOUT_MS = 5000;
       /// <summary>
       /// Returns the subscription handler.
       /// </summary>
       /// <returns>the subscription handler <see cref="SubscriptionHandler"/></returns>
       std::shared_ptr<SubscriptionHandler> GetSubscriptionHandler() { return _pSubscriptionHandler; }
       /// <summary>
-      /// Adds a client to the list.
+      /// Returns the pool finished clients are returned to for reuse.
+      /// </summary>
+      /// <returns>the client pool <see cref="ClientMsgHandlerPool"/></returns>
+      std::shared_ptr<ClientMsgHandlerPool> GetClientPool() { return _pClientPool; }
+      /// <summary>
+      /// Adds a client to the list.  It is removed when its disconnect completes, so it must be added
+      /// before it is Run.
       /// </summary>
       /// <param name="pClient">The client to add <see cref="ClientMsgHandler"/></param>
-      void AddClient(std::shared_ptr<ClientMsgHandler> pClient);
+      MESSAGETHREADS_API void AddClient(std::shared_ptr<ClientMsgHandler> pClient);
       /// <summary>
-      /// Clears out all the clients from the list.
+      /// Shuts down all the clients in the list.  Every client starts disconnecting at once and they are
+      /// waited for together; any still connected after timeoutMS are force closed and removed.
       /// </summary>
-      void ClearAll();
+      /// <param name="timeoutMS">How long to wait for all the clients to disconnect</param>
+      /// <returns>The number of clients that had to be force closed</returns>
+      MESSAGETHREADS_API size_t ClearAll(uint32_t timeoutMS = DEFAULT_CLEAR_TIMEOUT_MS);
       /// <summary>
       /// Prints out diagnostic information.
       /// </summary>
       MESSAGETHREADS_API void Diagnostics(CommunicationUtils::DiagnosticTypes type);
       /// <summary>
-      /// Shuts down the thread that checks for and removes disconnected clients
+      /// Shuts down the clients; they are no longer returned to the client pool
       /// </summary>
-      void ShutDown() override;
+      MESSAGETHREADS_API void ShutDown();
       /// <summary>
-      /// Finds and returns the specified client if it is in the list
+      /// Returns true once ShutDown has been called
       /// </summary>
-      /// <returns>the the specified client if it is in the list, nullptr otherwise <see cref="ClientMsgHandler"/></returns>
-      std::shared_ptr<ClientMsgHandler> GetClient(int clientTypeID, int clientID);
-
-   protected:
-      virtual bool ExecuteLoopActions() override;
+      bool IsShuttingDown() { return _shuttingDown; }
+      /// <summary>
+      /// Gets the number of clients in the list
+      /// </summary>
+      MESSAGETHREADS_API size_t GetClientCount();
+      /// <summary>
+      /// Gets the number of clients that have been removed after disconnecting
+      /// </summary>
+      int64_t GetRemovedCount() { return _removedCount.load(); }
+      /// <summary>
+      /// Gets the longest time from a client starting to disconnect until it was removed
+      /// </summary>
+      int64_t GetMaxCleanupUS() { return _maxCleanupUS.load(); }
+      /// <summary>
+      /// Gets the longest time the client list lock has been held
+      /// </summary>
+      int64_t GetMaxLockHoldNS() { return _maxLockHoldNS.load(); }
+      /// <summary>
+      /// Gets the number of clients ClearAll has had to force close
+      /// </summary>
+      int64_t GetForceClosedCount() { return _forceClosedCount.load(); }
+      /// <summary>
+      /// Sets the send queue limits of clients that have not logged on, and of logged on clients whose
+      /// type has no limits of its own (see CommHandler::SetSendQueueLimits).  Applies to clients that connect afterwards.
+      /// </summary>
+      MESSAGETHREADS_API void SetDefaultSendQueueLimits(const CommunicationUtils::SendQueueLimits& limits);
+      /// <summary>
+      /// Sets the send queue limits of clients of clientTypeID; they apply when such a client logs on
+      /// </summary>
+      MESSAGETHREADS_API void SetSendQueueLimits(int clientTypeID, const CommunicationUtils::SendQueueLimits& limits);
+      /// <summary>
+      /// Gets the send queue limits for clients that have not logged on
+      /// </summary>
+      MESSAGETHREADS_API CommunicationUtils::SendQueueLimits GetDefaultSendQueueLimits();
+      /// <summary>
+      /// Gets the send queue limits for clients of clientTypeID: its own if set, otherwise the default
+      /// </summary>
+      MESSAGETHREADS_API CommunicationUtils::SendQueueLimits GetSendQueueLimits(int clientTypeID);
+      /// <summary>
+      /// Finds and returns the specified client if it is logged on.  Does not lock.
+      /// </summary>
+      /// <returns>the the specified client if it is logged on, nullptr otherwise <see cref="ClientMsgHandler"/></returns>
+      std::shared_ptr<ClientMsgHandler> GetClient(int clientTypeID, int clientID) { return _clientIndex.Find(clientTypeID, clientID); }
+      /// <summary>
+      /// Finds and returns every client logged on with the specified type.  Does not take the client manager lock.
+      /// </summary>
+      /// <returns>the clients, nullptr if there are none</returns>
+      ClientIndex::ClientSetPtr GetClients(int clientTypeID) { return _clientIndex.FindAll(clientTypeID); }
+      /// <summary>
+      /// Makes a client findable by the type and ID it logged on with.
+      /// </summary>
+      void AddLoggedOnClient(const std::shared_ptr<ClientMsgHandler>& pClient, int clientTypeID, int clientID) { _clientIndex.Add(pClient, clientTypeID, clientID); }
+      /// <summary>
+      /// Removes a client that has logged off or disconnected from under the type and ID it logged on with.
+      /// </summary>
+      void RemoveLoggedOnClient(ClientMsgHandler* pClient, int clientTypeID, int clientID) { _clientIndex.Remove(pClient, clientTypeID, clientID); }
 
    private:
+      //called from the client's strand when its socket state changes
+      void HandleSocketStateChange(ClientMsgHandler* pClient, CommunicationUtils::SocketState newState);
+      //removes a client whose disconnect has completed and returns it to the pool
+      void RemoveClient(ClientMsgHandler* pClient);
+      //holds _lock and records how long it was held
+      class ListLock;
    };
 
 }
 }
-}
\ No newline at end of file
+}
@@ -23,6 +23,7 @@ namespace MsgService
 namespace MessageThreads
 {
    class ClientManager;
+   struct SubscriptionTable;
 
    /// <summary>
    /// Interface to allow unit test mocking
@@ -54,6 +55,7 @@ namespace MessageThreads
    public:
       using CommunicationUtils::CommHandler::GetName;
       using CommunicationUtils::CommHandler::SendMsg;
+      using CommunicationUtils::CommHandler::SendFrame;
       /// <summary>
       /// Initializes a new instance of the <see cref="ClientMsgHandler"/> class.
       /// </summary>
@@ -72,6 +74,8 @@ namespace MessageThreads
    private:
       bool _isAuthenticated;
       std::shared_ptr<ClientManager> _pClientManager;
+      //the subscriptions used to route every frame of the current read; loaded by GetSubscriptions
+      std::shared_ptr<const SubscriptionTable> _pSubscriptions;
 
       //****************************************
       // Methods
@@ -99,13 +103,34 @@ namespace MessageThreads
       MESSAGETHREADS_API bool IsAuthenticated() { return _isAuthenticated; }
 
       MESSAGETHREADS_API virtual std::string GetDiagnosticsInfo() override;
+      /// <summary>
+      /// Returns the handler to the unauthenticated state it was constructed in (see CommHandler::Reset)
+      /// </summary>
+      MESSAGETHREADS_API virtual void Reset() override;
+      /// <summary>
+      /// Sets the ClientManager for the next connection; handlers are created without one when pre-warmed
+      /// </summary>
+      /// <param name="pClientManager">ClientManager and subscription manager</param>
+      void SetClientManager(std::shared_ptr<ClientManager> pClientManager) { _pClientManager = pClientManager; }
 
    protected:
       /// <summary>
       /// Override to handle messages that are received.
       /// </summary>
       /// <param name="pMsg">The message that was received</param>
-      MESSAGETHREADS_API virtual void HandleMessageReceived(std::unique_ptr<CommonMessages::Header> pMsg) override;
+      MESSAGETHREADS_API virtual void HandleMessageReceived(CommonMessages::HeaderPtr pMsg) override;
+      /// <summary>
+      /// Override to forward messages the broker only routes (e.g. CUSTOM) as the bytes that were
+      /// received, reading just the routing fields rather than parsing the whole Header.
+      /// Everything else is passed to CommHandler::HandleFrameReceived.
+      /// </summary>
+      /// <param name="pData">The frame payload (without the size prefix); only valid during this call</param>
+      /// <param name="size">The size of the payload; 0 indicates a heartbeat</param>
+      MESSAGETHREADS_API virtual void HandleFrameReceived(const char* pData, uint32_t size) override;
+      /// <summary>
+      /// Override to let go of the subscriptions used to route the frames of the read
+      /// </summary>
+      MESSAGETHREADS_API virtual void HandleFramesComplete() override;
       /// <summary>
       /// Override to perform additional steps when disconnect has completed.
       /// </summary>
@@ -116,8 +141,19 @@ namespace MessageThreads
       /// </summary>
       /// <param name="pMsg">The message to send</param>
       MESSAGETHREADS_API void SendMessageToSubscribers(CommonMessages::Header* pMsg);
+      /// <summary>
+      /// Sends an encoded frame to the dest client
+      /// </summary>
+      /// <param name="destClientType">The type of the client to send to</param>
+      /// <param name="destClientID">The ID of the client to send to; 0 sends to every client of destClientType</param>
+      /// <param name="pFrame">The frame to send</param>
+      MESSAGETHREADS_API void SendFrameToClient(int destClientType, int destClientID, const CommonMessages::EncodedFramePtr& pFrame);
 
    private:
+      //sends this client a LOGON from the (clientType, clientID) client
+      void SendLogonFrom(int clientType, int clientID);
+      //gets the subscriptions to route with, taking a snapshot on the first call of a read
+      const std::shared_ptr<const SubscriptionTable>& GetSubscriptions();
       //needed to to have shared_from_this work for derived classes 
       std::shared_ptr<ClientMsgHandler> shared_from_this() { return shared_from(this); }
       std::shared_ptr<const ClientMsgHandler> shared_from_this() const { return shared_from(this); }
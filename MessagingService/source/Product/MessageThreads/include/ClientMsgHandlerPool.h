@@ -0,0 +1,102 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <map>
+#include <deque>
+#include <atomic>
+
+#include "../stdafx.h"
+#include "ClientMsgHandler.h"
+
+namespace CommunicationUtils = Matrix::MsgService::CommunicationUtils;
+
+namespace Matrix
+{
+namespace MsgService
+{
+namespace MessageThreads
+{
+   class ClientManager;
+
+   /// <summary>
+   /// Keeps disconnected ClientMsgHandlers so they can be reset and used for new connections instead of
+   /// constructing a new strand, socket and buffers on every accept.  A handler is bound to the io_context
+   /// it was created on, so idle handlers are kept per context.
+   /// </summary>
+   class ClientMsgHandlerPool
+   {
+      //****************************************
+      // Constructors/Destructors
+      //****************************************
+   public:
+      /// <summary>
+      /// Initializes a new instance of the <see cref="ClientMsgHandlerPool"/> class.
+      /// </summary>
+      MESSAGETHREADS_API ClientMsgHandlerPool();
+      MESSAGETHREADS_API ~ClientMsgHandlerPool();
+   private:
+      ClientMsgHandlerPool(const ClientMsgHandlerPool&);
+      ClientMsgHandlerPool& operator=(const ClientMsgHandlerPool&);
+
+      //****************************************
+      // Fields
+      //****************************************
+   public:
+      /// <summary>
+      /// Number of released handlers kept per context when it has not been warmed to more
+      /// </summary>
+      static const size_t DEFAULT_MAX_IDLE = 64;
+   private:
+      struct IdleHandlers
+      {
+         IdleHandlers() : _maxIdle(DEFAULT_MAX_IDLE) {}
+         std::deque<std::shared_ptr<ClientMsgHandler>> _handlers;
+         size_t _maxIdle;
+      };
+      std::map<CommunicationUtils::IContextHandler*, IdleHandlers> _idleHandlers;
+      std::mutex _lock;
+      std::atomic<int64_t> _createdCount;
+      std::atomic<int64_t> _reusedCount;
+
+      //****************************************
+      // Methods
+      //****************************************
+   public:
+      /// <summary>
+      /// Creates handlers on pContextHandler until count are idle, and keeps at least that many when they are released
+      /// </summary>
+      /// <param name="pContextHandler">The context the handlers will run on</param>
+      /// <param name="count">The number of handlers to have ready</param>
+      MESSAGETHREADS_API void Warm(std::shared_ptr<CommunicationUtils::IContextHandler> pContextHandler, size_t count);
+      /// <summary>
+      /// Gets a handler ready for a new connection on pContextHandler, reusing an idle one if there is one
+      /// </summary>
+      /// <param name="pContextHandler">The context the connection will run on</param>
+      /// <param name="pClientManager">ClientManager and subscription manager</param>
+      MESSAGETHREADS_API std::shared_ptr<ClientMsgHandler> Acquire(std::shared_ptr<CommunicationUtils::IContextHandler> pContextHandler
+            , std::shared_ptr<ClientManager> pClientManager);
+      /// <summary>
+      /// Returns the handler of a finished connection to the pool.  It is only reused once nothing else holds it.
+      /// </summary>
+      /// <param name="pClient">The handler; its shutdown must be complete</param>
+      MESSAGETHREADS_API void Release(std::shared_ptr<ClientMsgHandler> pClient);
+      /// <summary>
+      /// Discards every idle handler
+      /// </summary>
+      MESSAGETHREADS_API void Clear();
+      /// <summary>
+      /// Gets the number of idle handlers for pContextHandler
+      /// </summary>
+      MESSAGETHREADS_API size_t GetIdleCount(const std::shared_ptr<CommunicationUtils::IContextHandler>& pContextHandler);
+      /// <summary>
+      /// Gets the number of handlers that have been constructed
+      /// </summary>
+      int64_t GetCreatedCount() const { return _createdCount.load(); }
+      /// <summary>
+      /// Gets the number of times an idle handler was used for a new connection
+      /// </summary>
+      int64_t GetReusedCount() const { return _reusedCount.load(); }
+   };
+}
+}
+}
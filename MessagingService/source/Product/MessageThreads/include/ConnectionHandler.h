@@ -2,12 +2,15 @@
 
 #include "IncludeBoostASIO.h"
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "../stdafx.h"
 #include "WorkerThread.h"
 #include "ClientMsgHandler.h"
 #include "ClientManager.h"
 #include "IContextHandler.h"
+#include "ContextPool.h"
 
 namespace asio = boost::asio;
 namespace CommunicationUtils = Matrix::MsgService::CommunicationUtils;
@@ -34,6 +37,19 @@ namespace MessageThreads
       /// <param name="port">port on which to listen.</param>
       /// <param name="pClientManager">Connections will be handed off to this client manager.</param>
       MESSAGETHREADS_API ConnectionHandler(std::shared_ptr<CommunicationUtils::IContextHandler> pContextHandler, unsigned short port, std::shared_ptr<ClientManager> pClientManager);
+      /// <summary>
+      /// Initializes a new instance of the <see cref="ConnectionHandler"/> class that spreads connections across a pool.
+      /// By default connections are accepted on the first context and each is run on the least loaded one.  With
+      /// reusePort every context gets its own SO_REUSEPORT acceptor so the kernel spreads new connections, and
+      /// each runs on the context that accepted it.  The pool's threads drive all IO so Run does not run a context itself.
+      /// </summary>
+      /// <param name="pContextPool">The contexts for the connections; its threads must be started</param>
+      /// <param name="port">port on which to listen (0 for any free port).</param>
+      /// <param name="pClientManager">Connections will be handed off to this client manager.</param>
+      /// <param name="reusePort">true for an acceptor per context; ignored where SO_REUSEPORT is not supported</param>
+      /// <param name="dualStack">true to accept IPv4 and IPv6 connections; falls back to IPv4 if IPv6 is not available</param>
+      MESSAGETHREADS_API ConnectionHandler(std::shared_ptr<CommunicationUtils::ContextPool> pContextPool, unsigned short port, std::shared_ptr<ClientManager> pClientManager
+            , bool reusePort = false, bool dualStack = false);
       MESSAGETHREADS_API ~ConnectionHandler()
       {
          ShutDown();
@@ -47,10 +63,21 @@ namespace MessageThreads
       //****************************************
    private:
       std::shared_ptr<CommunicationUtils::IContextHandler> _pContextHandler;
+      std::shared_ptr<CommunicationUtils::ContextPool> _pContextPool;
       unsigned short _port;
-      asio::ip::tcp::acceptor _acceptor;
-      std::shared_ptr<ClientMsgHandler> _pClientConnection;
+      /// <summary>
+      /// The listening sockets; with SO_REUSEPORT there is one per context of the pool
+      /// </summary>
+      std::vector<std::unique_ptr<asio::ip::tcp::acceptor>> _acceptors;
+      /// <summary>
+      /// The connection waiting to be accepted by the acceptor at the same index
+      /// </summary>
+      std::vector<std::shared_ptr<ClientMsgHandler>> _pendingConnections;
+      std::mutex _acceptLock;
+      bool _reusePort;
       std::shared_ptr<ClientManager> _pClientManager;
+      uint32_t _heartbeatIntervalMS;
+      uint32_t _idleTimeoutMS;
 
       //****************************************
       // Methods
@@ -60,14 +87,49 @@ namespace MessageThreads
       /// Signify to the thread to stop accepting connections
       /// </summary>
       MESSAGETHREADS_API virtual void ShutDown() override;
+      /// <summary>
+      /// Gets the port being listened on
+      /// </summary>
+      MESSAGETHREADS_API unsigned short GetPort();
+      /// <summary>
+      /// Gets the number of acceptors listening on the port
+      /// </summary>
+      size_t GetAcceptorCount() const { return _acceptors.size(); }
+      /// <summary>
+      /// Creates idle client handlers ahead of time so accepting does not construct them (see ClientMsgHandlerPool)
+      /// </summary>
+      /// <param name="countPerContext">The number of handlers to have ready on each context</param>
+      MESSAGETHREADS_API void WarmClientPool(size_t countPerContext);
+      /// <summary>
+      /// Sets the liveness detection used for each client connection (see CommHandler::SetLiveness)
+      /// </summary>
+      /// <param name="heartbeatIntervalMS">Idle time before a heartbeat is sent to a client; 0 to not send heartbeats</param>
+      /// <param name="idleTimeoutMS">Time without hearing from a client before disconnecting it; 0 to not check</param>
+      MESSAGETHREADS_API void SetLiveness(uint32_t heartbeatIntervalMS, uint32_t idleTimeoutMS)
+      {
+         _heartbeatIntervalMS = heartbeatIntervalMS;
+         _idleTimeoutMS = idleTimeoutMS;
+      }
    protected:
       /// <summary>
       /// The thread Run function - starts accepting connections
       /// </summary>
       MESSAGETHREADS_API virtual void Run() override;
    private:
-      void StartAccept();
-      void HandleAccept(
+      /// <summary>
+      /// Opens, binds and starts listening on an acceptor for each context (one unless reusePort)
+      /// </summary>
+      void OpenAcceptors(bool dualStack);
+      /// <summary>
+      /// Creates an acceptor on ioContext listening on _port
+      /// </summary>
+      std::unique_ptr<asio::ip::tcp::acceptor> OpenAcceptor(asio::io_context& ioContext, bool dualStack);
+      /// <summary>
+      /// Gets the context with the fewest established connections
+      /// </summary>
+      std::shared_ptr<CommunicationUtils::IContextHandler> GetLeastLoadedContext();
+      void StartAccept(size_t index);
+      void HandleAccept(size_t index,
          std::shared_ptr<ClientMsgHandler> pClientConnection,
          const boost::system::error_code& error);
 
@@ -0,0 +1,174 @@
+#pragma once
+#include <list>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "../stdafx.h"
+#include "EncodedFrame.h"
+#include "SubscriptionParams.h"
+
+namespace Matrix
+{
+namespace MsgService
+{
+namespace MessageThreads
+{
+   /// <summary>
+   /// Keeps the latest frame published by each (origClientType, origClientID, topic) so a new subscriber can be
+   /// sent the current values straight away rather than asking every publisher for them.
+   ///
+   /// The cache is split into shards, each with its own lock, least recently used list and a share of
+   /// the memory cap; a shard evicts its least recently used frames when it goes over its share.  A frame
+   /// bigger than a shard's share is not kept.  A lookup with no wildcards touches one shard; a wildcard
+   /// lookup visits every shard.
+   /// </summary>
+   class LastValueCache
+   {
+   public:
+      typedef std::vector<std::pair<CommonMessages::SubscriptionParams, CommonMessages::EncodedFramePtr>> FrameList;
+      typedef std::function<void(const CommonMessages::SubscriptionParams& source, const CommonMessages::EncodedFramePtr& pFrame)> FrameCallback;
+
+      //****************************************
+      // Constructors/Destructors
+      //****************************************
+   public:
+      /// <summary>
+      /// Initializes a new instance of the <see cref="LastValueCache"/> class.
+      /// </summary>
+      /// <param name="maxBytes">The most frame bytes to keep; 0 disables the cache</param>
+      MESSAGETHREADS_API LastValueCache(uint64_t maxBytes = 0);
+   private:
+      LastValueCache(const LastValueCache&);
+      LastValueCache& operator=(const LastValueCache&);
+
+      //****************************************
+      // Fields
+      //****************************************
+   public:
+      /// <summary>
+      /// Number of shards the cache is split into
+      /// </summary>
+      static const size_t NUM_SHARDS = 16;
+   private:
+      struct Entry
+      {
+         CommonMessages::SubscriptionParams _source;
+         CommonMessages::EncodedFramePtr _pFrame;
+         size_t _bytes;
+      };
+      typedef std::list<Entry> EntryList;
+      struct Shard
+      {
+         std::mutex _lock;
+         //most recently used first
+         EntryList _entries;
+         std::unordered_map<CommonMessages::SubscriptionParams, EntryList::iterator, CommonMessages::SubscriptionParamsHasher> _lookup;
+         uint64_t _bytes;
+         Shard() : _bytes(0) {}
+      };
+      Shard _shards[NUM_SHARDS];
+      std::atomic<uint64_t> _maxBytes;
+      std::atomic<int64_t> _entryCount;
+      std::atomic<int64_t> _byteCount;
+      std::atomic<int64_t> _updateCount;
+      std::atomic<int64_t> _evictionCount;
+      std::atomic<int64_t> _oversizedCount;
+      std::atomic<int64_t> _lookupCount;
+      std::atomic<int64_t> _hitCount;
+
+      //****************************************
+      // Methods
+      //****************************************
+   public:
+      /// <summary>
+      /// Sets the most frame bytes to keep; 0 disables the cache and discards what it holds
+      /// </summary>
+      MESSAGETHREADS_API void SetMaxBytes(uint64_t maxBytes);
+      /// <summary>
+      /// Gets the most frame bytes kept
+      /// </summary>
+      uint64_t GetMaxBytes() const { return _maxBytes.load(); }
+      /// <summary>
+      /// Returns true if frames are being kept
+      /// </summary>
+      bool IsEnabled() const { return _maxBytes.load() > 0; }
+      /// <summary>
+      /// Keeps pFrame as the latest from source, replacing the previous one
+      /// </summary>
+      /// <param name="source">The originating client's type and ID, and the topic</param>
+      /// <param name="pFrame">The frame, as it is sent to subscribers</param>
+      MESSAGETHREADS_API void Update(const CommonMessages::SubscriptionParams& source, const CommonMessages::EncodedFramePtr& pFrame);
+      /// <summary>
+      /// Gets the latest frames matching a subscription; a field that is 0 matches any value
+      /// </summary>
+      /// <param name="subscription">The type, ID and topic subscribed to</param>
+      /// <param name="pFrames">The frames found and their sources are added to this</param>
+      /// <returns>The number of frames found</returns>
+      MESSAGETHREADS_API size_t Find(const CommonMessages::SubscriptionParams& subscription, FrameList* pFrames);
+      /// <summary>
+      /// Calls func with each of the latest frames matching a subscription while holding the lock of the frame's
+      /// shard, so an Update from the same source waits until func returns.  func must not use the cache.
+      /// </summary>
+      /// <param name="subscription">The type, ID and topic subscribed to; a field that is 0 matches any value</param>
+      /// <param name="func">Called with each frame found and its source</param>
+      /// <returns>The number of frames found</returns>
+      MESSAGETHREADS_API size_t ForEach(const CommonMessages::SubscriptionParams& subscription, const FrameCallback& func);
+      /// <summary>
+      /// Discards every frame published by a client, when it logs off or disconnects
+      /// </summary>
+      /// <returns>The number of frames discarded</returns>
+      MESSAGETHREADS_API size_t RemoveClient(int clientType, int clientID);
+      /// <summary>
+      /// Discards every frame
+      /// </summary>
+      MESSAGETHREADS_API void Clear();
+      /// <summary>
+      /// Gets the number of frames kept
+      /// </summary>
+      int64_t GetEntryCount() const { return _entryCount.load(); }
+      /// <summary>
+      /// Gets the number of frame bytes kept
+      /// </summary>
+      int64_t GetByteCount() const { return _byteCount.load(); }
+      /// <summary>
+      /// Gets the number of frames that have been kept
+      /// </summary>
+      int64_t GetUpdateCount() const { return _updateCount.load(); }
+      /// <summary>
+      /// Gets the number of frames evicted to stay within the memory cap
+      /// </summary>
+      int64_t GetEvictionCount() const { return _evictionCount.load(); }
+      /// <summary>
+      /// Gets the number of frames not kept because they were bigger than a shard's share of the memory cap
+      /// </summary>
+      int64_t GetOversizedCount() const { return _oversizedCount.load(); }
+      /// <summary>
+      /// Gets the number of lookups
+      /// </summary>
+      int64_t GetLookupCount() const { return _lookupCount.load(); }
+      /// <summary>
+      /// Gets the number of lookups that found at least one frame
+      /// </summary>
+      int64_t GetHitCount() const { return _hitCount.load(); }
+      /// <summary>
+      /// Gets a one line summary of the metrics
+      /// </summary>
+      MESSAGETHREADS_API std::string GetDiagnosticsInfo() const;
+   private:
+      Shard& GetShard(const CommonMessages::SubscriptionParams& source);
+      //removes the least recently used entries until the shard is within maxBytes; the shard's lock must be held
+      void Evict(Shard& shard, uint64_t maxBytes);
+      //removes every entry of the shard; the shard's lock must be held
+      void ClearShard(Shard& shard);
+      //removes the entry at position; the shard's lock must be held
+      void RemoveEntry(Shard& shard, EntryList::iterator position);
+   };
+}
+}
+}
@@ -1,11 +1,15 @@
 #pragma once
 #include <memory>
 #include <unordered_map>
+#include <vector>
 #include <mutex>
+#include <atomic>
 #include <algorithm>
 
 #include "../stdafx.h"
 #include "SubscriptionParams.h"
+#include "EncodedFrame.h"
+#include "LastValueCache.h"
 
 namespace CommonMessages = Matrix::MsgService::CommonMessages;
 
@@ -23,6 +27,85 @@ namespace MessageThreads
 {
    class IClientMsgHandler;
 
+   /// <summary>
+   /// Refers to a subscribed client by its slot in the table's client array.  The generation changes each
+   /// time the slot is given to another client, so a handle to a client that has gone does not resolve.
+   /// </summary>
+   struct SubscriberHandle
+   {
+      uint32_t _slot;
+      uint32_t _generation;
+   };
+
+   /// <summary>
+   /// One immutable version of the subscription table.  Publishers read whichever version is current
+   /// without locking; changes build a new version and swap it in, and a version is freed once the
+   /// last publisher using it lets go.
+   ///
+   /// The keys are spread over buckets by hash, and the buckets are held in fixed size pages.  Pages,
+   /// buckets and lists are shared between versions, so a new version only copies the page array and
+   /// the page, bucket and list that changed.
+   ///
+   /// Each subscribed client has a dense slot in the client array, which is paged the same way, and the
+   /// lists hold handles to slots.  A client in several matching lists is sent to once by marking its
+   /// slot, rather than by sorting the recipients.
+   /// </summary>
+   struct SubscriptionTable
+   {
+      typedef std::vector<SubscriberHandle> SubscriberList;
+      //the clients a message is sent to; the table they were found in keeps them alive
+      typedef std::vector<IClientMsgHandler*> SendList;
+      //keyed by what was subscribed to; 0 in a field of the key is a wildcard
+      typedef std::unordered_map<CommonMessages::SubscriptionParams, std::shared_ptr<const SubscriberList>, CommonMessages::SubscriptionParamsHasher> Bucket;
+
+      static const size_t BUCKETS_PER_PAGE = 64;
+      //BUCKETS_PER_PAGE buckets; null for a bucket with no keys
+      typedef std::vector<std::shared_ptr<const Bucket>> Page;
+
+      struct ClientSlot
+      {
+         //null if the slot is free
+         std::shared_ptr<IClientMsgHandler> _pClient;
+         uint32_t _generation;
+         ClientSlot() : _generation(0) {}
+      };
+      static const size_t SLOTS_PER_PAGE = 256;
+      //SLOTS_PER_PAGE slots
+      typedef std::vector<ClientSlot> SlotPage;
+
+      SubscriptionTable() : _numBuckets(0), _size(0), _version(0), _numSlots(0) {}
+      //null for a page with no keys
+      std::vector<std::shared_ptr<const Page>> _pages;
+      //a power of 2, and a multiple of BUCKETS_PER_PAGE
+      size_t _numBuckets;
+      //the number of keys
+      size_t _size;
+      uint64_t _version;
+      std::vector<std::shared_ptr<const SlotPage>> _slotPages;
+      //the number of slots that have been given out; every handle's slot is below it
+      uint32_t _numSlots;
+
+      /// <summary>
+      /// Gets the subscribers to key; null if there are none
+      /// </summary>
+      MESSAGETHREADS_API const SubscriberList* Find(const CommonMessages::SubscriptionParams& key) const;
+      /// <summary>
+      /// Gets the client handle refers to; null if its slot has since been given to another client
+      /// </summary>
+      IClientMsgHandler* GetClient(SubscriberHandle handle) const
+      {
+         auto& slot = (*_slotPages[handle._slot / SLOTS_PER_PAGE])[handle._slot % SLOTS_PER_PAGE];
+         return (slot._generation == handle._generation) ? slot._pClient.get() : nullptr;
+      }
+
+      /// <summary>
+      /// Looks up the exact (clientType, clientID, topic) entry and each wildcard that matches it - at most
+      /// 8 probes - and adds their subscribers to sendList once each
+      /// </summary>
+      MESSAGETHREADS_API void FindSubscribers(int clientType, int clientID, int topic, SendList& sendList) const;
+   };
+   typedef std::shared_ptr<const SubscriptionTable> SubscriptionTablePtr;
+
    class SubscriptionHandler
    {
       //****************************************
@@ -30,6 +113,8 @@ namespace MessageThreads
       //****************************************
    public:
       MESSAGETHREADS_API SubscriptionHandler()
+            : _pTable(std::make_shared<SubscriptionTable>())
+            , _version(0)
       {}
       MESSAGETHREADS_API ~SubscriptionHandler();
 
@@ -37,8 +122,26 @@ namespace MessageThreads
       // Fields
       //****************************************
    private:
+      //serializes changes; publishers never take it
       std::mutex _lock;
-      std::unordered_map<CommonMessages::SubscriptionParams, std::vector<std::shared_ptr<MessageThreads::IClientMsgHandler>>, CommonMessages::SubscriptionParamsHasher> _msgLookup;
+      //the current version; only accessed with std::atomic_load/atomic_store
+      SubscriptionTablePtr _pTable;
+      //_pTable's version, read without loading the table to tell whether a publisher's snapshot is current
+      std::atomic<uint64_t> _version;
+      typedef std::unordered_map<CommonMessages::SubscriptionParams, size_t, CommonMessages::SubscriptionParamsHasher> PositionLookup;
+      struct ClientSubscriptions
+      {
+         SubscriberHandle _handle;
+         //the keys the client is subscribed to and its index in each key's list
+         PositionLookup _positions;
+      };
+      //each subscribed client's slot and subscriptions, so a client's subscriptions are found without
+      //searching the table; only used by changes so guarded by _lock
+      std::unordered_map<IClientMsgHandler*, ClientSubscriptions> _clients;
+      //slots given up by clients with no subscriptions left, for reuse; guarded by _lock
+      std::vector<uint32_t> _freeSlots;
+      //the latest application message from each publisher and topic, sent to new subscribers
+      LastValueCache _lastValues;
 
       //****************************************
       // Methods
@@ -48,8 +151,50 @@ namespace MessageThreads
       MESSAGETHREADS_API void RemoveSubscription(IClientMsgHandler* pClient, CommonMessages::Subscribe& unsubscribeMsg);
       MESSAGETHREADS_API void RemoveSubscriptionsFor(MessageThreads::IClientMsgHandler* pClient);
       MESSAGETHREADS_API void ClearAll();
+      /// <summary>
+      /// Gets the current version of the table.  Routing several messages with one snapshot saves
+      /// loading it for each; changes made after it was taken are not in it.
+      /// </summary>
+      SubscriptionTablePtr GetSnapshot() const { return std::atomic_load(&_pTable); }
+      /// <summary>
+      /// Gets the version of the current table; it goes up by one for each change
+      /// </summary>
+      uint64_t GetVersion() const { return _version.load(); }
       MESSAGETHREADS_API void SendToSubscribers(IClientMsgHandler* pSentFrom, CommonMessages::Header& msg);
+      MESSAGETHREADS_API void SendToSubscribers(const SubscriptionTablePtr& pSnapshot, IClientMsgHandler* pSentFrom, CommonMessages::Header& msg);
+      //sends an already encoded frame with the given topic to the subscribers of pSentFrom; isPublished marks an
+      //application message, which is cached and which subscribers may conflate with the previous one from its
+      //originating client on the topic (see ICommHandler::SendPublishedFrame); an origClientType of 0 means pSentFrom
+      MESSAGETHREADS_API void SendToSubscribers(IClientMsgHandler* pSentFrom, int topic, const CommonMessages::EncodedFramePtr& pFrame);
+      MESSAGETHREADS_API void SendToSubscribers(const SubscriptionTablePtr& pSnapshot, IClientMsgHandler* pSentFrom, int topic, const CommonMessages::EncodedFramePtr& pFrame, bool isPublished = false
+            , int origClientType = 0, int origClientID = 0);
       MESSAGETHREADS_API std::vector<CommonMessages::SubscriptionParams> GetSubscribersTo(int clientType, int clientID);
+      /// <summary>
+      /// Gets the cache of the latest message from each originating client and topic; it is disabled until given a
+      /// memory cap with LastValueCache::SetMaxBytes
+      /// </summary>
+      LastValueCache& GetLastValueCache() { return _lastValues; }
+      /// <summary>
+      /// Sends pClient the cached latest message of each publisher and topic matching a subscription it has
+      /// made, so it does not have to ask the publishers for their current values.  A message being published
+      /// at the same moment may arrive twice, but never ahead of an older cached one.
+      /// </summary>
+      /// <returns>The number of messages sent</returns>
+      MESSAGETHREADS_API size_t SendLastValues(IClientMsgHandler* pClient, const CommonMessages::Subscribe& subscribeMsg);
+   private:
+      //makes pTable the current version; _lock must be held
+      void Publish(std::shared_ptr<SubscriptionTable> pTable);
+      //copies the list of key in table without the subscriber at position by moving the last subscriber into
+      //its place; _lock must be held
+      //returns null if the list is then empty
+      std::shared_ptr<const SubscriptionTable::SubscriberList> RemoveAt(const SubscriptionTable& table, const CommonMessages::SubscriptionParams& key, size_t position);
+      //gets the table to route a frame that has just been put in the last value cache.  A subscriber added since
+      //pSnapshot was taken may have been sent the older cached value, so it is routed with the current table,
+      //loaded into pCurrent; a subscriber added after that is sent the newer value from the cache
+      const SubscriptionTable& GetTableAfterCaching(const SubscriptionTablePtr& pSnapshot, SubscriptionTablePtr& pCurrent) const;
+      //pSource is who published the frame, null if it must not be conflated
+      void SendFrame(IClientMsgHandler* pSentFrom, const SubscriptionTable::SendList& sendList, const CommonMessages::EncodedFramePtr& pFrame
+            , const CommonMessages::SubscriptionParams* pSource = nullptr);
    };
 
 }
@@ -6,13 +6,18 @@
 #include <iostream>
 #include <memory>
 #include <vector>
+#include <utility>
+#include <map>
+#include <unordered_set>
 
 #include "ArgumentParser.h"
 #include "Logger.h"
+#include "StringUtils.h"
 #include "HandleSignals.h"
 #include "ConnectionHandler.h"
 #include "ClientManager.h"
-#include "ContextHandler.h"
+#include "SubscriptionHandler.h"
+#include "ContextPool.h"
 
 /**
 Main application loop
@@ -42,7 +47,19 @@ int main(
    parseValues.ParseArgumentValues(argc, argv, (int)Logging::LogLevels::DEFAULT_LOG_LEVEL);
    bool quit = false;
    uint16_t port = 8888;
-   int freq = 500;
+   int heartbeatMS = 0;
+   int idleTimeoutMS = 0;
+   int ioThreads = 0;
+   bool reusePort = false;
+   bool dualStack = false;
+   int warmClients = 0;
+   int lastValueCacheBytes = 0;
+   CommunicationUtils::SendQueueLimits sendQueueLimits;
+   //client types with a policy of their own
+   std::vector<std::pair<int, CommunicationUtils::SlowConsumerPolicy>> typePolicies;
+   //client types that conflate every topic, and the topics every client conflates
+   std::vector<int> conflatedTypes;
+   auto pConflatedTopics = std::make_shared<std::unordered_set<int>>();
    if (parseValues.mDisplayVersion)
    {
       std::cout << "Version: 1.0";
@@ -54,7 +71,20 @@ int main(
          parseValues.GetHelpString() <<
          "--console          : enter interactive console mode." << std::endl <<
          "--port=n           : Sets the port for listening. (default = " << port << ")." << std::endl <<
-         "--freq=n           : Sets the requency of checking for client disconnects in ms. (default = " << freq << ")." << std::endl;
+         "--heartbeat=n      : Sends a heartbeat to a client after n ms without traffic; 0 to not send. (default = " << heartbeatMS << ")." << std::endl <<
+         "--idletimeout=n    : Disconnects a client after n ms without receiving anything; 0 to not check. (default = " << idleTimeoutMS << ")." << std::endl <<
+         "--io-threads=n     : Sets the number of threads handling client connections; 0 for one per core. (default = " << ioThreads << ")." << std::endl <<
+         "--reuseport        : Accepts connections on every io thread with SO_REUSEPORT so the kernel spreads them." << std::endl <<
+         "--dualstack        : Accepts IPv6 as well as IPv4 connections." << std::endl <<
+         "--warm-clients=n   : Creates n client handlers per io thread at startup so accepting does not. (default = " << warmClients << ")." << std::endl <<
+         "--queue-frames=n   : Limits the frames queued for a client; 0 for no limit. (default = " << sendQueueLimits._maxFrames << ")." << std::endl <<
+         "--queue-bytes=n    : Limits the bytes queued for a client; 0 for no limit. (default = " << sendQueueLimits._maxBytes << ")." << std::endl <<
+         "--slow-policy=[t:]p: What to do when a client's queue is full: disconnect, dropoldest, dropnewest or conflate." << std::endl <<
+         "                     With t: only for clients of type t; may be repeated. (default = " << CommunicationUtils::ToString(sendQueueLimits._policy) << ")." << std::endl <<
+         "--write-stall=n    : Flags a client as a slow consumer when a write takes over n ms; 0 to not check. (default = " << sendQueueLimits._writeStallMS << ")." << std::endl <<
+         "--conflate-topics=n,n: Sends clients only the latest unsent message of each publisher on these topics." << std::endl <<
+         "--conflate-type=t  : Sends clients of type t only the latest unsent message of each publisher and topic; may be repeated." << std::endl <<
+         "--lvc-bytes=n      : Keeps the latest message of each publisher and topic, up to n bytes, for new subscribers; 0 to not keep them. (default = " << lastValueCacheBytes << ")." << std::endl;
       quit = true;
    }
    if (quit)
@@ -66,14 +96,81 @@ int main(
       for (int index = 0; index < argc; index++)
       {
          int val;
+         std::string text;
          if (ArgumentParser::ParseInt32Flag(argv[index], "port", &val))
          {
             if (val > 0)
                port = (uint16_t)val;
          }
-         else if (ArgumentParser::ParseInt32Flag(argv[index], "freq", &val))
+         else if (ArgumentParser::ParseInt32Flag(argv[index], "heartbeat", &val))
          {
-            freq = val;
+            if (val >= 0)
+               heartbeatMS = val;
+         }
+         else if (ArgumentParser::ParseInt32Flag(argv[index], "idletimeout", &val))
+         {
+            if (val >= 0)
+               idleTimeoutMS = val;
+         }
+         else if (ArgumentParser::ParseInt32Flag(argv[index], "io-threads", &val))
+         {
+            if (val >= 0)
+               ioThreads = val;
+         }
+         else if (ArgumentParser::ParseInt32Flag(argv[index], "warm-clients", &val))
+         {
+            if (val >= 0)
+               warmClients = val;
+         }
+         else if (ArgumentParser::ParseInt32Flag(argv[index], "queue-frames", &val))
+         {
+            if (val >= 0)
+               sendQueueLimits._maxFrames = (uint32_t)val;
+         }
+         else if (ArgumentParser::ParseInt32Flag(argv[index], "queue-bytes", &val))
+         {
+            if (val >= 0)
+               sendQueueLimits._maxBytes = (uint64_t)val;
+         }
+         else if (ArgumentParser::ParseInt32Flag(argv[index], "write-stall", &val))
+         {
+            if (val >= 0)
+               sendQueueLimits._writeStallMS = (uint32_t)val;
+         }
+         else if (ArgumentParser::ParseStringFlag(argv[index], "conflate-topics", &text))
+         {
+            for (auto& topicText : StringUtils::Split(text, ','))
+            {
+               if (StringUtils::ParseInt32(topicText.c_str(), &val))
+                  pConflatedTopics->insert(val);
+            }
+         }
+         else if (ArgumentParser::ParseInt32Flag(argv[index], "conflate-type", &val))
+         {
+            conflatedTypes.push_back(val);
+         }
+         else if (ArgumentParser::ParseInt32Flag(argv[index], "lvc-bytes", &val))
+         {
+            if (val >= 0)
+               lastValueCacheBytes = val;
+         }
+         else if (ArgumentParser::ParseStringFlag(argv[index], "slow-policy", &text))
+         {
+            CommunicationUtils::SlowConsumerPolicy policy;
+            auto separator = text.find(':');
+            if (separator == std::string::npos)
+            {
+               if (CommunicationUtils::TryParse(text, &policy))
+                  sendQueueLimits._policy = policy;
+            }
+            else if (CommunicationUtils::TryParse(text.substr(separator + 1), &policy))
+            {
+               typePolicies.push_back(std::make_pair(atoi(text.substr(0, separator).c_str()), policy));
+            }
+         }
+         else if (!ArgumentParser::ParseBoolFlag(argv[index], "reuseport", &reusePort))
+         {
+            ArgumentParser::ParseBoolFlag(argv[index], "dualstack", &dualStack);
          }
       }
    }
@@ -90,17 +187,30 @@ int main(
 //   sslContext.use_certificate_chain_file("server.pem");
 //   sslContext.use_private_key_file("server.pem", boost::asio::ssl::context::pem);
 //   sslContext.use_tmp_dh_file("dh2048.pem");
-   auto pContextHandler = std::make_shared<CommunicationUtils::ContextHandler>(sslContext);
+   auto pContextPool = std::make_shared<CommunicationUtils::ContextPool>((size_t)ioThreads, sslContext);
 #else
-   auto pContextHandler = std::make_shared<CommunicationUtils::ContextHandler>();
+   auto pContextPool = std::make_shared<CommunicationUtils::ContextPool>((size_t)ioThreads);
 #endif
    std::shared_ptr<MessageThreads::ConnectionHandler> pConnectionHandler = nullptr;
-   auto pClientManager = std::make_shared<MessageThreads::ClientManager>(freq);
+   auto pClientManager = std::make_shared<MessageThreads::ClientManager>();
+   if (!pConflatedTopics->empty())
+      sendQueueLimits._pConflatedTopics = pConflatedTopics;
+   pClientManager->SetDefaultSendQueueLimits(sendQueueLimits);
+   std::map<int, CommunicationUtils::SendQueueLimits> typeLimits;
+   for (auto& typePolicy : typePolicies)
+      typeLimits.insert(std::make_pair(typePolicy.first, sendQueueLimits)).first->second._policy = typePolicy.second;
+   for (auto clientType : conflatedTypes)
+      typeLimits.insert(std::make_pair(clientType, sendQueueLimits)).first->second._conflateAllTopics = true;
+   for (auto& limits : typeLimits)
+      pClientManager->SetSendQueueLimits(limits.first, limits.second);
+   pClientManager->GetSubscriptionHandler()->GetLastValueCache().SetMaxBytes((uint64_t)lastValueCacheBytes);
    //initialize everything
    try
    {
-      pClientManager->StartThread();
-      pConnectionHandler = std::make_shared<MessageThreads::ConnectionHandler>(pContextHandler, port, pClientManager);
+      pContextPool->StartThreads();
+      pConnectionHandler = std::make_shared<MessageThreads::ConnectionHandler>(pContextPool, port, pClientManager, reusePort, dualStack);
+      pConnectionHandler->SetLiveness((uint32_t)heartbeatMS, (uint32_t)idleTimeoutMS);
+      pConnectionHandler->WarmClientPool((size_t)warmClients);
       pConnectionHandler->StartThread();
 
       int nInput;
@@ -190,14 +300,12 @@ int main(
    if (pClientManager != nullptr)
    {
       pClientManager->ShutDown();
-      pClientManager->WaitForShutdown(5);
       pClientManager = nullptr;
    }
-   if (pContextHandler != nullptr)
+   if (pContextPool != nullptr)
    {
-      pContextHandler->ShutDown();
-      pContextHandler->WaitForShutdown(5);
-      pContextHandler = nullptr;
+      pContextPool->ShutDown();
+      pContextPool = nullptr;
    }
    Logging::Logger::ClearGlobalLogger();
 
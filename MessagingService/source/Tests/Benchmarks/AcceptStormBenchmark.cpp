@@ -0,0 +1,157 @@
+#include "IncludeBoostASIO.h"
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ContextPool.h"
+#include "ClientManager.h"
+#include "ConnectionHandler.h"
+#include "Benchmarks.h"
+#include "BenchmarkClient.h"
+
+using namespace Matrix::MsgService;
+
+namespace
+{
+   const int STORM_CLIENT_TYPE = 3;
+   const int NUM_CONNECTORS = 8;
+   const int CONNECTIONS_PER_THREAD = 250;
+
+   struct StormResult
+   {
+      size_t acceptors;
+      int connected;
+      double seconds;
+      //connect and logon time of each client
+      double p50MS;
+      double p99MS;
+      double maxMS;
+      int64_t reused;
+   };
+
+   /// <summary>
+   /// Has NUM_CONNECTORS threads each connect and log on CONNECTIONS_PER_THREAD clients as fast as
+   /// they can, as happens when every client reconnects after a broker restart
+   /// </summary>
+   void Storm(unsigned short port, std::vector<std::unique_ptr<Benchmarks::BenchmarkClient>>* pClients, StormResult* pResult)
+   {
+      pClients->clear();
+      for (int index = 0; index < NUM_CONNECTORS * CONNECTIONS_PER_THREAD; index++)
+         pClients->push_back(std::unique_ptr<Benchmarks::BenchmarkClient>(new Benchmarks::BenchmarkClient()));
+      std::vector<double> latenciesMS(pClients->size(), 0.0);
+      std::atomic<int> connected(0);
+      std::vector<std::thread> threads;
+      Benchmarks::Stopwatch stopwatch;
+      for (int thread = 0; thread < NUM_CONNECTORS; thread++)
+      {
+         threads.push_back(std::thread([&, thread]()
+         {
+            for (int index = 0; index < CONNECTIONS_PER_THREAD; index++)
+            {
+               auto clientIndex = thread * CONNECTIONS_PER_THREAD + index;
+               Benchmarks::Stopwatch connectTime;
+               if ((*pClients)[clientIndex]->Connect(port, STORM_CLIENT_TYPE, clientIndex + 1))
+                  connected++;
+               latenciesMS[clientIndex] = connectTime.ElapsedSeconds() * 1000.0;
+            }
+         }));
+      }
+      for (auto& thread : threads)
+         thread.join();
+      pResult->seconds = stopwatch.ElapsedSeconds();
+      pResult->connected = connected;
+      std::sort(latenciesMS.begin(), latenciesMS.end());
+      pResult->p50MS = latenciesMS[latenciesMS.size() / 2];
+      pResult->p99MS = latenciesMS[latenciesMS.size() * 99 / 100];
+      pResult->maxMS = latenciesMS.back();
+   }
+
+   /// <summary>
+   /// Starts a broker and runs a storm against it.  With reconnect every client disconnects after the
+   /// first storm and the second, which reuses the finished client handlers, is the one measured.
+   /// </summary>
+   StormResult RunStorm(size_t ioThreads, bool reusePort, size_t warmPerContext, bool reconnect)
+   {
+      StormResult result = { 0, 0, 0.0, 0.0, 0.0, 0.0, 0 };
+      auto pContextPool = std::make_shared<CommunicationUtils::ContextPool>(ioThreads);
+      pContextPool->StartThreads();
+      auto pClientManager = std::make_shared<MessageThreads::ClientManager>();
+      auto pConnectionHandler = std::make_shared<MessageThreads::ConnectionHandler>(pContextPool, 0, pClientManager, reusePort);
+      pConnectionHandler->WarmClientPool(warmPerContext);
+      pConnectionHandler->StartThread();
+      auto port = pConnectionHandler->GetPort();
+      result.acceptors = pConnectionHandler->GetAcceptorCount();
+      auto pClientPool = pClientManager->GetClientPool();
+
+      std::vector<std::unique_ptr<Benchmarks::BenchmarkClient>> clients;
+      Storm(port, &clients, &result);
+      if (reconnect)
+      {
+         for (auto& pClient : clients)
+            pClient->Close();
+         //wait for the ClientManager to hand every finished handler back to the pool
+         auto isRecycled = [&]() -> bool
+         {
+            size_t idle = 0;
+            for (size_t index = 0; index < pContextPool->GetSize(); index++)
+               idle += pClientPool->GetIdleCount(pContextPool->GetContextHandler(index));
+            return idle >= clients.size();
+         };
+         for (int waited = 0; waited < 10000 && !isRecycled(); waited += 10)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+         auto reusedBefore = pClientPool->GetReusedCount();
+         Storm(port, &clients, &result);
+         result.reused = pClientPool->GetReusedCount() - reusedBefore;
+      }
+      else
+      {
+         result.reused = pClientPool->GetReusedCount();
+      }
+
+      for (auto& pClient : clients)
+         pClient->Close();
+      pConnectionHandler->ShutDown();
+      pConnectionHandler->WaitForShutdown(5);
+      pClientManager->ShutDown();
+      pContextPool->ShutDown();
+      return result;
+   }
+}
+
+void Benchmarks::RunAcceptStormBenchmark()
+{
+   //one io thread per core, but at least a few so there are several acceptors to spread over
+   size_t ioThreads = std::thread::hardware_concurrency();
+   if (ioThreads < 4)
+      ioThreads = 4;
+   //enough handlers on every context for the whole storm
+   size_t warmPerContext = (NUM_CONNECTORS * CONNECTIONS_PER_THREAD) / ioThreads + 1;
+
+   struct StormCase
+   {
+      const char* name;
+      bool reusePort;
+      size_t warmPerContext;
+      bool reconnect;
+   };
+   StormCase cases[] =
+   {
+      { "single acceptor", false, 0, false },
+      { "SO_REUSEPORT", true, 0, false },
+      { "warm pool", true, warmPerContext, false },
+      { "reconnect", true, warmPerContext, true },
+   };
+
+   std::cout << "listener          acceptors   connected    seconds   conns/sec   p50 ms   p99 ms   max ms    reused" << std::endl;
+   for (auto& stormCase : cases)
+   {
+      auto result = RunStorm(ioThreads, stormCase.reusePort, stormCase.warmPerContext, stormCase.reconnect);
+      printf("%-17s %9zu %11d %10.3f %11.0f %8.2f %8.2f %8.2f %9lld\n", stormCase.name, result.acceptors, result.connected
+            , result.seconds, result.seconds > 0 ? result.connected / result.seconds : 0.0
+            , result.p50MS, result.p99MS, result.maxMS, (long long)result.reused);
+   }
+}
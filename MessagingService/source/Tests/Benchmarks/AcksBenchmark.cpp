@@ -0,0 +1,164 @@
+#include "IncludeBoostASIO.h"
+#include <stdio.h>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+#include "ContextHandler.h"
+#include "ClientComm.h"
+#include "PendingAcks.h"
+#include "Message.h"
+#include "EncodedFrame.h"
+#include "FrameDecoder.h"
+#include "Benchmarks.h"
+
+//disable Inherits Via Dominance warning
+#ifdef _WIN32
+#pragma warning( push )
+#pragma warning( disable: 4250)
+#endif
+
+using namespace Matrix::MsgService;
+using boost::asio::ip::tcp;
+
+namespace
+{
+   const int NUM_MESSAGES = 20000;
+   //the peer sends this many messages, then pauses for a millisecond
+   const int BURST_SIZE = 50;
+   //the client replies to one in this many of the messages it receives
+   const int REPLY_EVERY = 10;
+   const int PEER_TYPE = 2;
+   const int PEER_ID = 7;
+
+   /// <summary>
+   /// A client that replies to some of the messages sent to it, like one side of a request/reply conversation
+   /// </summary>
+   class ChattyClient : public CommunicationUtils::ClientComm
+   {
+   private:
+      int _receivedCount;
+   public:
+      ChattyClient(std::shared_ptr<CommunicationUtils::IContextHandler> pContextHandler, const std::string port)
+         : ClientComm(pContextHandler, "127.0.0.1", port, 1, 3, 0, "Acks"), _receivedCount(0)
+      {
+      }
+   protected:
+      virtual void HandleMessageReceived(CommonMessages::HeaderPtr pMsg) override
+      {
+         ClientComm::HandleMessageReceived(std::move(pMsg));
+         if (++_receivedCount % REPLY_EVERY == 0)
+            SendCommonMsg(CommonMessages::MsgType::CUSTOM, nullptr, 0, PEER_TYPE, PEER_ID);
+      }
+   };
+
+   struct AckResults
+   {
+      int64_t _ackMsgs;
+      int64_t _totalMsgs;
+      int64_t _bytes;
+      int64_t _ackedKeys;
+      double _seconds;
+   };
+
+   /// <summary>
+   /// Sends NUM_MESSAGES directed CUSTOM messages to a ChattyClient and counts what it sends back until every
+   /// message has been acked
+   /// </summary>
+   AckResults RunAcks(uint32_t ackDelayMS, size_t maxPendingAcks)
+   {
+      auto pContextHandler = std::make_shared<CommunicationUtils::ContextHandler>();
+      pContextHandler->StartThread();
+      boost::asio::io_context peerContext;
+      tcp::acceptor acceptor(peerContext, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+      auto pClient = std::make_shared<ChattyClient>(pContextHandler, std::to_string(acceptor.local_endpoint().port()));
+      pClient->SetDelayedAcks(ackDelayMS, maxPendingAcks);
+      pClient->Connect();
+      tcp::socket peerSocket(peerContext);
+      acceptor.accept(peerSocket);
+      peerSocket.set_option(tcp::no_delay(true));
+
+      AckResults results = {};
+      std::atomic<int64_t> ackedKeys(0);
+      Benchmarks::Stopwatch stopwatch;
+      std::thread reader([&]()
+      {
+         CommonMessages::FrameDecoder decoder;
+         boost::system::error_code ec;
+         google::protobuf::RepeatedField<int> keys;
+         while (ackedKeys < NUM_MESSAGES && !ec)
+         {
+            auto bytes = peerSocket.read_some(boost::asio::buffer(decoder.GetWriteBuffer(), decoder.GetWriteSpace()), ec);
+            decoder.Commit(bytes);
+            const char* pData;
+            uint32_t size;
+            while (decoder.NextFrame(&pData, &size) == CommonMessages::FrameDecoder::FrameStatus::Complete)
+            {
+               CommonMessages::Header msg;
+               msg.ParseFromArray(pData, (int)size);
+               if (msg.msgtypeid() == CommonMessages::MsgType::LOGON)
+                  continue;
+               results._totalMsgs++;
+               results._bytes += size + CommonMessages::HDR_SIZE;
+               CommunicationUtils::PendingAcks::GetAckedKeys(msg, &keys);
+               auto acked = keys.size();
+               if (msg.msgtypeid() == CommonMessages::MsgType::ACK)
+               {
+                  results._ackMsgs++;
+                  if (msg.msgkey() > 0)
+                     acked++;
+               }
+               ackedKeys += acked;
+            }
+         }
+      });
+
+      CommonMessages::Header msg;
+      msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+      msg.set_origclienttype(PEER_TYPE);
+      msg.set_origclientid(PEER_ID);
+      msg.set_destclienttype(1);
+      msg.set_destclientid(3);
+      msg.set_msg(std::string(64, 'x'));
+      for (int key = 1; key <= NUM_MESSAGES; key++)
+      {
+         msg.set_msgkey(key);
+         auto pFrame = CommonMessages::EncodedFrame::Create(msg);
+         boost::asio::write(peerSocket, boost::asio::buffer(pFrame->GetData(), pFrame->GetSize()));
+         if (key % BURST_SIZE == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      reader.join();
+      results._seconds = stopwatch.ElapsedSeconds();
+      results._ackedKeys = ackedKeys;
+
+      pClient->ShutDown();
+      pClient = nullptr;
+      pContextHandler->ShutDown();
+      pContextHandler->WaitForShutdown(10, 10);
+      return results;
+   }
+}
+
+void Benchmarks::RunAcksBenchmark()
+{
+   std::cout << NUM_MESSAGES << " directed CUSTOM messages in bursts of " << BURST_SIZE << ", one in " << REPLY_EVERY
+         << " answered by the client" << std::endl;
+   std::cout << "acks                ACK msgs  msgs sent    bytes  keys acked  seconds" << std::endl;
+   struct { const char* name; uint32_t delayMS; size_t maxPending; } runs[] =
+   {
+      { "immediate", 0, 0 },
+      { "delayed 5ms/64", 5, 64 },
+      { "delayed 20ms/256", 20, 256 },
+   };
+   for (auto& run : runs)
+   {
+      auto results = RunAcks(run.delayMS, run.maxPending);
+      printf("%-18s %9lld %10lld %8lld %11lld %8.2f\n", run.name, (long long)results._ackMsgs, (long long)results._totalMsgs
+            , (long long)results._bytes, (long long)results._ackedKeys, results._seconds);
+   }
+}
+#ifdef _WIN32
+#pragma warning( pop )
+#endif
@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "Message.h"
+#include "MessageArena.h"
+#include "Benchmarks.h"
+
+using namespace Matrix::MsgService::CommonMessages;
+
+namespace
+{
+   std::atomic<int64_t> g_allocationCount(0);
+}
+
+//count every heap allocation made by the benchmarks
+void* operator new(size_t size)
+{
+   g_allocationCount++;
+   void* pMemory = malloc(size == 0 ? 1 : size);
+   if (pMemory == nullptr)
+      throw std::bad_alloc();
+   return pMemory;
+}
+void operator delete(void* pMemory) noexcept
+{
+   free(pMemory);
+}
+void operator delete(void* pMemory, size_t) noexcept
+{
+   free(pMemory);
+}
+
+namespace
+{
+   struct AllocationResult
+   {
+      int64_t allocations;
+      double seconds;
+   };
+
+   /// <summary>
+   /// Encodes a typical received message: a CUSTOM message with a payload and a couple of ack keys
+   /// </summary>
+   std::string CreateEncodedMsg(size_t payloadSize)
+   {
+      Header msg;
+      msg.set_msgtypeid(MsgType::CUSTOM);
+      msg.set_msgkey(1234);
+      msg.set_topic(1);
+      msg.set_origclienttype(1);
+      msg.set_origclientid(1);
+      msg.add_ackkeys(10);
+      msg.add_ackkeys(11);
+      msg.set_msg(std::string(payloadSize, 'x'));
+      return msg.SerializeAsString();
+   }
+
+   /// <summary>
+   /// Parses each message into a new heap Header, as received messages were before arenas
+   /// </summary>
+   AllocationResult ParseOnHeap(const std::string& data, int totalMsgs)
+   {
+      int64_t checksum = 0;
+      auto startCount = g_allocationCount.load();
+      Benchmarks::Stopwatch stopwatch;
+      for (int index = 0; index < totalMsgs; index++)
+      {
+         auto pMsg = std::unique_ptr<Header>(new Header());
+         pMsg->ParseFromArray(data.data(), (int)data.size());
+         checksum += pMsg->msgkey();
+      }
+      AllocationResult result = { g_allocationCount.load() - startCount, stopwatch.ElapsedSeconds() };
+      if (checksum == 0)
+         std::cout << "unexpected checksum" << std::endl;
+      return result;
+   }
+
+   /// <summary>
+   /// Parses each message onto a MessageArena that is reset after every msgsPerRead messages,
+   /// as CommHandler does after each socket read
+   /// </summary>
+   AllocationResult ParseOnArena(const std::string& data, int totalMsgs, int msgsPerRead)
+   {
+      int64_t checksum = 0;
+      MessageArena arena;
+      auto startCount = g_allocationCount.load();
+      Benchmarks::Stopwatch stopwatch;
+      for (int index = 0; index < totalMsgs; index++)
+      {
+         auto pMsg = arena.CreateHeader();
+         pMsg->ParseFromArray(data.data(), (int)data.size());
+         checksum += pMsg->msgkey();
+         if ((index + 1) % msgsPerRead == 0)
+            arena.Reset();
+      }
+      AllocationResult result = { g_allocationCount.load() - startCount, stopwatch.ElapsedSeconds() };
+      if (checksum == 0)
+         std::cout << "unexpected checksum" << std::endl;
+      return result;
+   }
+
+   void PrintResult(const char* name, size_t payloadSize, int totalMsgs, const AllocationResult& result)
+   {
+      printf("%-16s %8zu %12.2f %10.1f\n", name, payloadSize, (double)result.allocations / (double)totalMsgs
+            , result.seconds > 0 ? (result.seconds * 1e9) / totalMsgs : 0.0);
+   }
+}
+
+void Benchmarks::RunAllocationsBenchmark()
+{
+   const int totalMsgs = 500000;
+   const size_t payloadSizes[] = { 16, 64, 1024, 16 * 1024 };
+   const int msgsPerRead[] = { 1, 16 };
+   std::cout << "parse            payload   allocs/msg    ns/msg" << std::endl;
+   for (auto payloadSize : payloadSizes)
+   {
+      auto data = CreateEncodedMsg(payloadSize);
+      PrintResult("heap", payloadSize, totalMsgs, ParseOnHeap(data, totalMsgs));
+      for (auto perRead : msgsPerRead)
+      {
+         char name[32];
+         snprintf(name, sizeof(name), "arena (%d/read)", perRead);
+         PrintResult(name, payloadSize, totalMsgs, ParseOnArena(data, totalMsgs, perRead));
+      }
+   }
+}
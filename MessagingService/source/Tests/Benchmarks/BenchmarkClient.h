@@ -0,0 +1,89 @@
+#pragma once
+
+#include "IncludeBoostASIO.h"
+
+#include "Message.h"
+#include "EncodedFrame.h"
+#include "FrameDecoder.h"
+#include "HeaderScanner.h"
+
+namespace Benchmarks
+{
+   /// <summary>
+   /// A client of an in process broker using a blocking socket
+   /// </summary>
+   class BenchmarkClient
+   {
+   private:
+      boost::asio::io_context _ioContext;
+      boost::asio::ip::tcp::socket _socket;
+      Matrix::MsgService::CommonMessages::FrameDecoder _decoder;
+   public:
+      BenchmarkClient() : _socket(_ioContext) {}
+
+      boost::asio::ip::tcp::socket& GetSocket() { return _socket; }
+      /// <summary>
+      /// Connects to the broker on loopback and logs on, waiting for the ACK so the broker knows
+      /// who we are before anything is routed to us
+      /// </summary>
+      bool Connect(unsigned short port, int clientType, int clientID)
+      {
+         using namespace Matrix::MsgService::CommonMessages;
+         boost::system::error_code ec;
+         _socket.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), port), ec);
+         if (ec)
+            return false;
+         _socket.set_option(boost::asio::ip::tcp::no_delay(true));
+         Header logonMsg;
+         logonMsg.set_msgtypeid(MsgType::LOGON);
+         logonMsg.set_msgkey(1);
+         Logon logon;
+         logon.set_clienttype(clientType);
+         logon.set_clientid(clientID);
+         logonMsg.set_msg(logon.SerializeAsString());
+         auto pFrame = EncodedFrame::Create(logonMsg);
+         boost::asio::write(_socket, boost::asio::buffer(pFrame->GetData(), pFrame->GetSize()), ec);
+         while (!ec)
+         {
+            auto bytes = _socket.read_some(boost::asio::buffer(_decoder.GetWriteBuffer(), _decoder.GetWriteSpace()), ec);
+            _decoder.Commit(bytes);
+            const char* pData;
+            uint32_t size;
+            while (_decoder.NextFrame(&pData, &size) == FrameDecoder::FrameStatus::Complete)
+            {
+               Header rxMsg;
+               if (rxMsg.ParseFromArray(pData, (int)size) && rxMsg.msgtypeid() == MsgType::ACK && rxMsg.msgkey() == 1)
+                  return true;
+            }
+         }
+         return false;
+      }
+      /// <summary>
+      /// Reads until numMsgs CUSTOM messages have been received or the socket is closed
+      /// </summary>
+      int64_t ReceiveCustomMsgs(int64_t numMsgs)
+      {
+         using namespace Matrix::MsgService::CommonMessages;
+         int64_t received = 0;
+         boost::system::error_code ec;
+         while (received < numMsgs && !ec)
+         {
+            auto bytes = _socket.read_some(boost::asio::buffer(_decoder.GetWriteBuffer(), _decoder.GetWriteSpace()), ec);
+            _decoder.Commit(bytes);
+            const char* pData;
+            uint32_t size;
+            while (_decoder.NextFrame(&pData, &size) == FrameDecoder::FrameStatus::Complete)
+            {
+               if (size > 0 && HeaderScanner::ScanMsgTypeID(pData, (int)size) == MsgType::CUSTOM)
+                  received++;
+            }
+         }
+         return received;
+      }
+      void Close()
+      {
+         boost::system::error_code ec;
+         _socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+      }
+   };
+}
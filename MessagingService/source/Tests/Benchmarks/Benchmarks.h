@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <string>
+
+/**
+Benchmarks that measure the messaging hot paths.  Each benchmark prints its own results.
+
+@Author JLitton
+*/
+namespace Benchmarks
+{
+   /// <summary>
+   /// Simple stopwatch for measuring elapsed time
+   /// </summary>
+   class Stopwatch
+   {
+   private:
+      std::chrono::steady_clock::time_point _start;
+   public:
+      Stopwatch() : _start(std::chrono::steady_clock::now()) {}
+      void Restart() { _start = std::chrono::steady_clock::now(); }
+      double ElapsedSeconds() const
+      {
+         return std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+      }
+   };
+
+   /// <summary>
+   /// Measures how many frames are decoded per socket read when a publisher pipelines
+   /// frames over a loopback connection.
+   /// </summary>
+   void RunFramingBenchmark();
+
+   /// <summary>
+   /// Measures the heap allocations per received message when Headers are parsed onto the
+   /// heap and onto a recycled MessageArena.
+   /// </summary>
+   void RunAllocationsBenchmark();
+
+   /// <summary>
+   /// Measures the cost in threads and memory of arming 100k CountdownTimers on the shared
+   /// TimerWheel against a thread per timer.
+   /// </summary>
+   void RunTimersBenchmark();
+
+   /// <summary>
+   /// Measures broker throughput for directed messages between pairs of clients as the number of
+   /// io threads in its ContextPool goes from 1 to one per core.
+   /// </summary>
+   void RunScalingBenchmark();
+
+   /// <summary>
+   /// Measures how many clients per second the broker accepts and logs on when they all connect
+   /// at once: with a single acceptor, with an SO_REUSEPORT acceptor per io thread, with pre-warmed
+   /// client handlers, and reconnecting onto handlers recycled from the previous connections.
+   /// </summary>
+   void RunAcceptStormBenchmark();
+
+   /// <summary>
+   /// Measures the cost of finding and queuing to the subscribers of a published message, and of
+   /// removing the subscriptions of a disconnecting client, as the number of unrelated subscriptions grows.
+   /// </summary>
+   void RunSubscriptionsBenchmark();
+
+   /// <summary>
+   /// Measures the cost per recipient of sending a published message to many subscribers, when each is
+   /// found through one key and when each is found through two and must be sent to only once.
+   /// </summary>
+   void RunFanoutBenchmark();
+
+   /// <summary>
+   /// Measures publish throughput as more threads publish at once through one SubscriptionHandler
+   /// while its subscriptions keep changing.
+   /// </summary>
+   void RunPublishScalingBenchmark();
+
+   /// <summary>
+   /// Measures how long the ClientManager takes to shut down a few thousand connected clients,
+   /// including when one io thread is too busy for its clients to finish disconnecting.
+   /// </summary>
+   void RunShutdownBenchmark();
+
+   /// <summary>
+   /// Measures what is queued for and sent to a subscriber that reads slower than a publisher updates its
+   /// topics, with and without conflation.
+   /// </summary>
+   void RunConflationBenchmark();
+
+   /// <summary>
+   /// Measures how long an ACK waits behind a backlog of bulk CUSTOM frames, compared with a CUSTOM message
+   /// </summary>
+   void RunPriorityBenchmark();
+
+   /// <summary>
+   /// Measures the ACK messages and bytes a client sends for a stream of directed messages with immediate
+   /// and with delayed, cumulative acks
+   /// </summary>
+   void RunAcksBenchmark();
+
+   /// <summary>
+   /// Measures the cost of tracking sent messages until they are acked, and of finding the ones to resend,
+   /// with SubscriberMessageLists against a map of maps under one lock
+   /// </summary>
+   void RunTrackingBenchmark();
+}
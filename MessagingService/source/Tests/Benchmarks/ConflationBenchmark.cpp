@@ -0,0 +1,127 @@
+#include "IncludeBoostASIO.h"
+#include <stdio.h>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+#include "ContextHandler.h"
+#include "CommHandler.h"
+#include "Message.h"
+#include "FrameDecoder.h"
+#include "Benchmarks.h"
+
+using namespace Matrix::MsgService;
+using boost::asio::ip::tcp;
+
+namespace
+{
+   const int NUM_UPDATES = 100000;
+   const int NUM_TOPICS = 100;
+   const size_t UPDATE_SIZE = 256;
+   //the subscriber reads this much each millisecond
+   const size_t READ_BYTES_PER_MS = 64 * 1024;
+   //sent last, not published, so the subscriber knows it has everything
+   const int END_KEY = -1;
+
+   struct ConflationResult
+   {
+      int64_t published;
+      int64_t conflated;
+      int64_t delivered;
+      int64_t deliveredBytes;
+      int64_t peakQueueBytes;
+      double publishSeconds;
+      double drainSeconds;
+   };
+
+   /// <summary>
+   /// Publishes NUM_UPDATES updates round robin over NUM_TOPICS topics, as fast as they can be queued, to a
+   /// subscriber that reads at a fixed rate, and measures what is queued for it and what it is sent.
+   /// </summary>
+   ConflationResult RunConflation(bool conflate)
+   {
+      ConflationResult result = { 0, 0, 0, 0, 0, 0.0, 0.0 };
+      auto pContextHandler = std::make_shared<CommunicationUtils::ContextHandler>();
+      pContextHandler->StartThread();
+      boost::asio::io_context peerContext;
+      tcp::acceptor acceptor(peerContext, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+      auto pCommHandler = std::make_shared<CommunicationUtils::CommHandler>(pContextHandler, "Subscriber");
+      pCommHandler->GetSocket()->lowest_layer().connect(acceptor.local_endpoint());
+      tcp::socket peerSocket(peerContext);
+      acceptor.accept(peerSocket);
+      CommunicationUtils::SendQueueLimits limits;
+      limits._conflateAllTopics = conflate;
+      pCommHandler->SetSendQueueLimits(limits);
+      pCommHandler->Run();
+
+      std::thread subscriber([&]()
+      {
+         CommonMessages::FrameDecoder decoder;
+         boost::system::error_code ec;
+         bool done = false;
+         while (!done && !ec)
+         {
+            auto space = decoder.GetWriteSpace() < READ_BYTES_PER_MS ? decoder.GetWriteSpace() : READ_BYTES_PER_MS;
+            auto bytes = peerSocket.read_some(boost::asio::buffer(decoder.GetWriteBuffer(), space), ec);
+            decoder.Commit(bytes);
+            result.deliveredBytes += (int64_t)bytes;
+            const char* pData;
+            uint32_t size;
+            while (decoder.NextFrame(&pData, &size) == CommonMessages::FrameDecoder::FrameStatus::Complete)
+            {
+               CommonMessages::Header msg;
+               msg.ParseFromArray(pData, (int)size);
+               if (msg.msgkey() == END_KEY)
+                  done = true;
+               else
+                  result.delivered++;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         }
+      });
+
+      CommonMessages::Header msg;
+      msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+      msg.set_origclienttype(1);
+      msg.set_origclientid(1);
+      msg.set_msg(std::string(UPDATE_SIZE, 'x'));
+      Benchmarks::Stopwatch stopwatch;
+      for (int index = 0; index < NUM_UPDATES; index++)
+      {
+         auto topic = index % NUM_TOPICS + 1;
+         msg.set_topic(topic);
+         msg.set_msgkey(index);
+         pCommHandler->SendPublishedFrame(CommonMessages::EncodedFrame::Create(msg), CommonMessages::SubscriptionParams(1, 1, topic));
+         if (index % 100 == 0 && pCommHandler->GetSendQueueBytes() > result.peakQueueBytes)
+            result.peakQueueBytes = pCommHandler->GetSendQueueBytes();
+      }
+      result.publishSeconds = stopwatch.ElapsedSeconds();
+      msg.set_msgkey(END_KEY);
+      pCommHandler->SendMsg(msg);
+      subscriber.join();
+      result.drainSeconds = stopwatch.ElapsedSeconds() - result.publishSeconds;
+      result.published = pCommHandler->GetPublishedFrameCount();
+      result.conflated = pCommHandler->GetConflatedFrameCount();
+
+      pCommHandler->ShutDown();
+      pCommHandler = nullptr;
+      pContextHandler->ShutDown();
+      pContextHandler->WaitForShutdown(10, 10);
+      return result;
+   }
+}
+
+void Benchmarks::RunConflationBenchmark()
+{
+   std::cout << NUM_UPDATES << " updates of " << UPDATE_SIZE << " bytes over " << NUM_TOPICS << " topics to a subscriber reading "
+         << READ_BYTES_PER_MS / 1024 << "KB/ms" << std::endl;
+   std::cout << "conflate  published  conflated  delivered  delivered MB  peak queue KB  publish s  drain s" << std::endl;
+   for (auto conflate : { false, true })
+   {
+      auto result = RunConflation(conflate);
+      printf("%8s %10lld %10lld %10lld %13.1f %14.0f %10.2f %8.2f\n", conflate ? "yes" : "no", (long long)result.published
+            , (long long)result.conflated, (long long)result.delivered, result.deliveredBytes / (1024.0 * 1024.0)
+            , result.peakQueueBytes / 1024.0, result.publishSeconds, result.drainSeconds);
+   }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "ClientMsgHandler.h"
+
+namespace Benchmarks
+{
+   /// <summary>
+   /// A client for driving the routing code without sockets; it only counts the frames sent to it
+   /// </summary>
+   class CountingClient : public Matrix::MsgService::MessageThreads::IClientMsgHandler
+   {
+   private:
+      int _clientType;
+      int _clientID;
+      std::atomic<int64_t> _frameCount;
+   public:
+      CountingClient(int clientType, int clientID) : _clientType(clientType), _clientID(clientID), _frameCount(0) {}
+
+      int64_t GetFrameCount() const { return _frameCount.load(); }
+
+      //IWorkerThread
+      virtual std::string GetName() override { return "CountingClient"; }
+      virtual void StartThread() override {}
+      virtual void ShutDown() override {}
+      virtual bool IsShuttingDown() override { return false; }
+      virtual bool WaitForShutdown(int, int) override { return true; }
+
+      //ICommHandler
+      virtual bool SendMsg(Matrix::MsgService::CommonMessages::Header&) override { _frameCount++; return true; }
+      virtual bool SendFrame(const Matrix::MsgService::CommonMessages::EncodedFramePtr&) override { _frameCount++; return true; }
+      virtual bool IsConnected() override { return true; }
+      virtual void Disconnect() override {}
+      virtual void Diagnostics(Matrix::MsgService::CommunicationUtils::DiagnosticTypes) override {}
+      virtual std::string GetDiagnosticsInfo() override { return ""; }
+      virtual Matrix::MsgService::CommunicationUtils::ConnectionChangeConnection AddConnectionChangeObserver(
+            const Matrix::MsgService::CommunicationUtils::ConnectionChangeCallback&) override
+      {
+         return Matrix::MsgService::CommunicationUtils::ConnectionChangeConnection();
+      }
+      virtual Matrix::MsgService::CommunicationUtils::SocketStateChangeConnection AddSocketStateChangeObserver(
+            const Matrix::MsgService::CommunicationUtils::SocketStateChangeCallback&) override
+      {
+         return Matrix::MsgService::CommunicationUtils::SocketStateChangeConnection();
+      }
+      virtual Matrix::MsgService::CommunicationUtils::MessageRxConnection AddMessageRxObserver(
+            const Matrix::MsgService::CommunicationUtils::MessageRxCallback&) override
+      {
+         return Matrix::MsgService::CommunicationUtils::MessageRxConnection();
+      }
+
+      //IClientMsgHandler
+      virtual int GetClientType() override { return _clientType; }
+      virtual int GetClientID() override { return _clientID; }
+   };
+}
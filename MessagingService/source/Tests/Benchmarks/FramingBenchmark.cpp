@@ -0,0 +1,98 @@
+#include "IncludeBoostASIO.h"
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "Message.h"
+#include "FrameDecoder.h"
+#include "Benchmarks.h"
+
+namespace asio = boost::asio;
+using asio::ip::tcp;
+using namespace Matrix::MsgService::CommonMessages;
+
+namespace
+{
+   struct FramingResult
+   {
+      int64_t frames;
+      int64_t reads;
+      double seconds;
+   };
+
+   /// <summary>
+   /// Sends totalFrames frames over a loopback connection, writing framesPerWrite frames
+   /// with each write, and decodes them with a FrameDecoder on the receiving side.
+   /// </summary>
+   FramingResult RunFraming(int totalFrames, int framesPerWrite)
+   {
+      asio::io_context ioContext;
+      tcp::acceptor acceptor(ioContext, tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+      auto endpoint = acceptor.local_endpoint();
+
+      Header msg;
+      msg.set_msgtypeid(MsgType::CUSTOM);
+      msg.set_topic(1);
+      msg.set_origclienttype(1);
+      msg.set_origclientid(1);
+      msg.set_msg(std::string(64, 'x'));
+      Message packer;
+      auto frameSize = packer.PackMsg(msg);
+      std::vector<char> batch;
+      for (int index = 0; index < framesPerWrite; index++)
+         batch.insert(batch.end(), packer.GetBuffer(), packer.GetBuffer() + frameSize);
+
+      std::thread writer([&]()
+      {
+         asio::io_context writerContext;
+         tcp::socket socket(writerContext);
+         socket.connect(endpoint);
+         socket.set_option(tcp::no_delay(true));
+         for (int sent = 0; sent < totalFrames; sent += framesPerWrite)
+            asio::write(socket, asio::buffer(batch));
+         boost::system::error_code ec;
+         socket.shutdown(tcp::socket::shutdown_send, ec);
+      });
+
+      tcp::socket socket(ioContext);
+      acceptor.accept(socket);
+      FrameDecoder decoder;
+      FramingResult result = { 0, 0, 0.0 };
+      Benchmarks::Stopwatch stopwatch;
+      boost::system::error_code ec;
+      while (!ec)
+      {
+         auto pBuffer = decoder.GetWriteBuffer();
+         auto bytes = socket.read_some(asio::buffer(pBuffer, decoder.GetWriteSpace()), ec);
+         if (bytes == 0)
+            continue;
+         result.reads++;
+         decoder.Commit(bytes);
+         const char* pData;
+         uint32_t size;
+         while (decoder.NextFrame(&pData, &size) == FrameDecoder::FrameStatus::Complete)
+         {
+            Header rxMsg;
+            rxMsg.ParseFromArray(pData, (int)size);
+            result.frames++;
+         }
+      }
+      result.seconds = stopwatch.ElapsedSeconds();
+      writer.join();
+      return result;
+   }
+}
+
+void Benchmarks::RunFramingBenchmark()
+{
+   const int totalFrames = 200000;
+   const int framesPerWrite[] = { 1, 8, 64, 512 };
+   std::cout << "frames/write   frames     reads   frames/read   msgs/sec" << std::endl;
+   for (auto perWrite : framesPerWrite)
+   {
+      auto result = RunFraming(totalFrames, perWrite);
+      double framesPerRead = result.reads == 0 ? 0.0 : (double)result.frames / (double)result.reads;
+      printf("%12d %8lld %9lld %13.1f %10.0f\n", perWrite, (long long)result.frames, (long long)result.reads
+            , framesPerRead, result.seconds > 0 ? result.frames / result.seconds : 0.0);
+   }
+}
@@ -0,0 +1,127 @@
+#include "IncludeBoostASIO.h"
+#include <stdio.h>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+#include "ContextHandler.h"
+#include "CommHandler.h"
+#include "Message.h"
+#include "FrameDecoder.h"
+#include "Benchmarks.h"
+
+using namespace Matrix::MsgService;
+using boost::asio::ip::tcp;
+
+namespace
+{
+   const int NUM_PROBES = 50;
+   const int PROBE_INTERVAL_MS = 20;
+   //bulk frames are kept queued up to this many bytes
+   const int64_t BACKLOG_BYTES = 1024 * 1024;
+   const size_t BULK_SIZE = 16 * 1024;
+   //the peer reads this much each millisecond
+   const size_t READ_BYTES_PER_MS = 16 * 1024;
+   //bulk frames have keys from this up, probes from 0
+   const int BULK_KEY = 1000000;
+   //caps what the kernel holds on each side, so the probes mostly wait in the send queue being measured
+   const int SOCKET_BUFFER_SIZE = 64 * 1024;
+
+   /// <summary>
+   /// Keeps BACKLOG_BYTES of bulk CUSTOM frames queued to a peer that reads at a fixed rate, and sends
+   /// NUM_PROBES probe messages of probeType through it.
+   /// </summary>
+   /// <returns>The time each probe took from being sent to being read by the peer, in milliseconds</returns>
+   std::vector<double> RunProbes(CommonMessages::MsgType probeType)
+   {
+      auto pContextHandler = std::make_shared<CommunicationUtils::ContextHandler>();
+      pContextHandler->StartThread();
+      boost::asio::io_context peerContext;
+      tcp::acceptor acceptor(peerContext, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+      auto pCommHandler = std::make_shared<CommunicationUtils::CommHandler>(pContextHandler, "Peer");
+      pCommHandler->GetSocket()->lowest_layer().connect(acceptor.local_endpoint());
+      tcp::socket peerSocket(peerContext);
+      acceptor.accept(peerSocket);
+      peerSocket.set_option(boost::asio::socket_base::receive_buffer_size(SOCKET_BUFFER_SIZE));
+      pCommHandler->GetSocket()->lowest_layer().set_option(boost::asio::socket_base::send_buffer_size(SOCKET_BUFFER_SIZE));
+      pCommHandler->Run();
+
+      std::vector<std::chrono::steady_clock::time_point> sentTimes(NUM_PROBES);
+      std::vector<double> latencies(NUM_PROBES, 0.0);
+      std::atomic<int> probesRead(0);
+      std::thread peer([&]()
+      {
+         CommonMessages::FrameDecoder decoder;
+         boost::system::error_code ec;
+         while (probesRead < NUM_PROBES && !ec)
+         {
+            auto space = decoder.GetWriteSpace() < READ_BYTES_PER_MS ? decoder.GetWriteSpace() : READ_BYTES_PER_MS;
+            auto bytes = peerSocket.read_some(boost::asio::buffer(decoder.GetWriteBuffer(), space), ec);
+            decoder.Commit(bytes);
+            const char* pData;
+            uint32_t size;
+            while (decoder.NextFrame(&pData, &size) == CommonMessages::FrameDecoder::FrameStatus::Complete)
+            {
+               CommonMessages::Header msg;
+               msg.ParseFromArray(pData, (int)size);
+               if (msg.msgkey() < BULK_KEY)
+               {
+                  latencies[msg.msgkey()] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sentTimes[msg.msgkey()]).count();
+                  probesRead++;
+               }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         }
+      });
+
+      CommonMessages::Header bulkMsg;
+      bulkMsg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+      bulkMsg.set_msg(std::string(BULK_SIZE, 'x'));
+      CommonMessages::Header probeMsg;
+      probeMsg.set_msgtypeid(probeType);
+      int bulkKey = BULK_KEY;
+      auto nextProbe = std::chrono::steady_clock::now();
+      for (int probe = 0; probe < NUM_PROBES; )
+      {
+         while (pCommHandler->GetSendQueueBytes() < BACKLOG_BYTES)
+         {
+            bulkMsg.set_msgkey(bulkKey++);
+            pCommHandler->SendMsg(bulkMsg);
+         }
+         if (std::chrono::steady_clock::now() >= nextProbe)
+         {
+            probeMsg.set_msgkey(probe);
+            sentTimes[probe] = std::chrono::steady_clock::now();
+            pCommHandler->SendMsg(probeMsg);
+            probe++;
+            nextProbe += std::chrono::milliseconds(PROBE_INTERVAL_MS);
+         }
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      peer.join();
+
+      pCommHandler->ShutDown();
+      pCommHandler = nullptr;
+      pContextHandler->ShutDown();
+      pContextHandler->WaitForShutdown(10, 10);
+      return latencies;
+   }
+}
+
+void Benchmarks::RunPriorityBenchmark()
+{
+   std::cout << NUM_PROBES << " probes behind a " << BACKLOG_BYTES / 1024 << "KB backlog of " << BULK_SIZE / 1024
+         << "KB CUSTOM frames to a peer reading " << READ_BYTES_PER_MS / 1024 << "KB/ms, " << SOCKET_BUFFER_SIZE / 1024
+         << "KB socket buffers" << std::endl;
+   std::cout << "probe      p50 ms   p99 ms   max ms" << std::endl;
+   for (auto probeType : { CommonMessages::MsgType::CUSTOM, CommonMessages::MsgType::ACK })
+   {
+      auto latencies = RunProbes(probeType);
+      std::sort(latencies.begin(), latencies.end());
+      printf("%-8s %8.1f %8.1f %8.1f\n", probeType == CommonMessages::MsgType::ACK ? "ACK" : "CUSTOM"
+            , latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100], latencies.back());
+   }
+}
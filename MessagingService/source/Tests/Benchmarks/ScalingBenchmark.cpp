@@ -0,0 +1,134 @@
+#include "IncludeBoostASIO.h"
+#include <stdio.h>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Message.h"
+#include "ContextPool.h"
+#include "ClientManager.h"
+#include "ConnectionHandler.h"
+#include "Benchmarks.h"
+#include "BenchmarkClient.h"
+
+namespace asio = boost::asio;
+using asio::ip::tcp;
+using namespace Matrix::MsgService;
+using namespace Matrix::MsgService::CommonMessages;
+
+namespace
+{
+   const int PUBLISHER_TYPE = 1;
+   const int SUBSCRIBER_TYPE = 2;
+
+   struct ScalingResult
+   {
+      int64_t delivered;
+      double seconds;
+   };
+
+   /// <summary>
+   /// Runs a broker with ioThreads io_contexts and has numPairs publishers each send msgsPerPair
+   /// messages directed to their own subscriber
+   /// </summary>
+   ScalingResult RunScaling(size_t ioThreads, int numPairs, int msgsPerPair)
+   {
+      ScalingResult result = { 0, 0.0 };
+      auto pContextPool = std::make_shared<CommunicationUtils::ContextPool>(ioThreads);
+      pContextPool->StartThreads();
+      auto pClientManager = std::make_shared<MessageThreads::ClientManager>();
+      auto pConnectionHandler = std::make_shared<MessageThreads::ConnectionHandler>(pContextPool, 0, pClientManager);
+      pConnectionHandler->StartThread();
+      auto port = pConnectionHandler->GetPort();
+
+      std::vector<std::unique_ptr<Benchmarks::BenchmarkClient>> publishers;
+      std::vector<std::unique_ptr<Benchmarks::BenchmarkClient>> subscribers;
+      bool connected = true;
+      for (int index = 0; index < numPairs && connected; index++)
+      {
+         subscribers.push_back(std::unique_ptr<Benchmarks::BenchmarkClient>(new Benchmarks::BenchmarkClient()));
+         publishers.push_back(std::unique_ptr<Benchmarks::BenchmarkClient>(new Benchmarks::BenchmarkClient()));
+         connected = subscribers.back()->Connect(port, SUBSCRIBER_TYPE, index + 1)
+               && publishers.back()->Connect(port, PUBLISHER_TYPE, index + 1);
+      }
+      if (connected)
+      {
+         std::atomic<int64_t> delivered(0);
+         std::atomic<int> subscribersDone(0);
+         std::vector<std::thread> threads;
+         Benchmarks::Stopwatch stopwatch;
+         for (int index = 0; index < numPairs; index++)
+         {
+            threads.push_back(std::thread([&, index]()
+            {
+               delivered += subscribers[index]->ReceiveCustomMsgs(msgsPerPair);
+               subscribersDone++;
+            }));
+            threads.push_back(std::thread([&, index]()
+            {
+               Header msg;
+               msg.set_msgtypeid(MsgType::CUSTOM);
+               msg.set_destclienttype(SUBSCRIBER_TYPE);
+               msg.set_destclientid(index + 1);
+               msg.set_msg(std::string(64, 'x'));
+               auto pFrame = EncodedFrame::Create(msg);
+               const int framesPerWrite = 64;
+               std::vector<char> batch;
+               for (int frame = 0; frame < framesPerWrite; frame++)
+                  batch.insert(batch.end(), pFrame->GetData(), pFrame->GetData() + pFrame->GetSize());
+               boost::system::error_code ec;
+               for (int sent = 0; sent < msgsPerPair && !ec; sent += framesPerWrite)
+               {
+                  auto numFrames = (msgsPerPair - sent < framesPerWrite) ? msgsPerPair - sent : framesPerWrite;
+                  asio::write(publishers[index]->GetSocket(), asio::buffer(batch.data(), numFrames * pFrame->GetSize()), ec);
+               }
+            }));
+         }
+         //anything not delivered within the deadline was lost; closing the sockets ends the reads
+         for (int waited = 0; waited < 30000 && subscribersDone < numPairs; waited += 10)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+         result.seconds = stopwatch.ElapsedSeconds();
+         for (auto& pSubscriber : subscribers)
+            pSubscriber->Close();
+         for (auto& thread : threads)
+            thread.join();
+         result.delivered = delivered;
+      }
+      else
+      {
+         std::cout << "could not connect to the broker" << std::endl;
+      }
+      for (auto& pClient : publishers)
+         pClient->Close();
+      for (auto& pClient : subscribers)
+         pClient->Close();
+      pConnectionHandler->ShutDown();
+      pConnectionHandler->WaitForShutdown(5);
+      pClientManager->ShutDown();
+      pContextPool->ShutDown();
+      return result;
+   }
+}
+
+void Benchmarks::RunScalingBenchmark()
+{
+   const int numPairs = 8;
+   const int msgsPerPair = 50000;
+   size_t maxThreads = std::thread::hardware_concurrency();
+   if (maxThreads == 0)
+      maxThreads = 1;
+   std::vector<size_t> threadCounts;
+   for (size_t threads = 1; threads < maxThreads; threads *= 2)
+      threadCounts.push_back(threads);
+   threadCounts.push_back(maxThreads);
+
+   std::cout << "io threads   delivered      msgs/sec" << std::endl;
+   for (auto threads : threadCounts)
+   {
+      auto result = RunScaling(threads, numPairs, msgsPerPair);
+      printf("%10zu %11lld %13.0f\n", threads, (long long)result.delivered
+            , result.seconds > 0 ? result.delivered / result.seconds : 0.0);
+   }
+}
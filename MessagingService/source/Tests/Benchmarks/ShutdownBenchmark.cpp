@@ -0,0 +1,95 @@
+#include "IncludeBoostASIO.h"
+#include <stdio.h>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ContextPool.h"
+#include "ClientManager.h"
+#include "ConnectionHandler.h"
+#include "Benchmarks.h"
+#include "BenchmarkClient.h"
+
+using namespace Matrix::MsgService;
+
+namespace
+{
+   const int SHUTDOWN_CLIENT_TYPE = 4;
+   const size_t IO_THREADS = 4;
+   const int STALL_MS = 8000;
+
+   struct ShutdownResult
+   {
+      int connected;
+      double seconds;
+      int64_t removed;
+      int64_t forceClosed;
+   };
+
+   /// <summary>
+   /// Connects numClients clients to a broker and times shutting its ClientManager down.  With stall,
+   /// one io thread is kept busy for STALL_MS first, so the clients on it cannot complete their disconnect.
+   /// </summary>
+   ShutdownResult RunShutdown(int numClients, bool stall)
+   {
+      ShutdownResult result = { 0, 0.0, 0, 0 };
+      auto pContextPool = std::make_shared<CommunicationUtils::ContextPool>(IO_THREADS);
+      pContextPool->StartThreads();
+      auto pClientManager = std::make_shared<MessageThreads::ClientManager>();
+      auto pConnectionHandler = std::make_shared<MessageThreads::ConnectionHandler>(pContextPool, 0, pClientManager);
+      pConnectionHandler->StartThread();
+      auto port = pConnectionHandler->GetPort();
+
+      std::vector<std::unique_ptr<Benchmarks::BenchmarkClient>> clients;
+      for (int index = 0; index < numClients; index++)
+      {
+         clients.push_back(std::unique_ptr<Benchmarks::BenchmarkClient>(new Benchmarks::BenchmarkClient()));
+         if (clients.back()->Connect(port, SHUTDOWN_CLIENT_TYPE, index + 1))
+            result.connected++;
+      }
+      pConnectionHandler->ShutDown();
+      pConnectionHandler->WaitForShutdown(5);
+      if (stall)
+      {
+         boost::asio::post(pContextPool->GetContextHandler(0)->GetIOContext(),
+               []() { std::this_thread::sleep_for(std::chrono::milliseconds(STALL_MS)); });
+      }
+
+      Benchmarks::Stopwatch stopwatch;
+      pClientManager->ShutDown();
+      result.seconds = stopwatch.ElapsedSeconds();
+      result.removed = pClientManager->GetRemovedCount();
+      result.forceClosed = pClientManager->GetForceClosedCount();
+
+      for (auto& pClient : clients)
+         pClient->Close();
+      pContextPool->ShutDown();
+      return result;
+   }
+}
+
+void Benchmarks::RunShutdownBenchmark()
+{
+   struct ShutdownCase
+   {
+      const char* name;
+      int numClients;
+      bool stall;
+   };
+   ShutdownCase cases[] =
+   {
+      { "500 clients", 500, false },
+      { "2000 clients", 2000, false },
+      { "2000, io stalled", 2000, true },
+   };
+
+   std::cout << "case               connected    seconds   clients/sec    removed   force closed" << std::endl;
+   for (auto& shutdownCase : cases)
+   {
+      auto result = RunShutdown(shutdownCase.numClients, shutdownCase.stall);
+      printf("%-18s %9d %10.3f %13.0f %10lld %14lld\n", shutdownCase.name, result.connected, result.seconds
+            , result.seconds > 0 ? result.connected / result.seconds : 0.0
+            , (long long)result.removed, (long long)result.forceClosed);
+   }
+}
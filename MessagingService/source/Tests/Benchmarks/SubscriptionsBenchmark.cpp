@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "Message.h"
+#include "EncodedFrame.h"
+#include "SubscriptionHandler.h"
+#include "Benchmarks.h"
+#include "CountingClient.h"
+
+using namespace Matrix::MsgService;
+
+namespace
+{
+   const int PUBLISHER_TYPE = 1;
+   const int SUBSCRIBER_TYPE = 2;
+   //each subscriber subscribes to one of this many topics of one publisher
+   const int NUM_TOPICS = 10;
+
+   struct PublishResult
+   {
+      double nsPerPublish;
+      int64_t delivered;
+   };
+
+   /// <summary>
+   /// Adds numSubscriptions subscriptions spread over the topics of numSubscriptions / NUM_TOPICS publishers,
+   /// plus a wildcard subscriber to everything, then publishes numPublishes messages from one publisher
+   /// </summary>
+   PublishResult RunPublish(int numSubscriptions, int numPublishes)
+   {
+      MessageThreads::SubscriptionHandler subscriptionHandler;
+      std::vector<std::shared_ptr<Benchmarks::CountingClient>> subscribers;
+      for (int index = 0; index < numSubscriptions; index++)
+      {
+         auto pSubscriber = std::make_shared<Benchmarks::CountingClient>(SUBSCRIBER_TYPE, index + 1);
+         CommonMessages::Subscribe subscribe;
+         subscribe.set_clienttype(PUBLISHER_TYPE);
+         subscribe.set_clientid(index / NUM_TOPICS + 1);
+         subscribe.set_topic(index % NUM_TOPICS + 1);
+         subscriptionHandler.AddSubscription(pSubscriber, subscribe);
+         subscribers.push_back(pSubscriber);
+      }
+      auto pWildcard = std::make_shared<Benchmarks::CountingClient>(SUBSCRIBER_TYPE, numSubscriptions + 1);
+      CommonMessages::Subscribe subscribeAll;
+      subscriptionHandler.AddSubscription(pWildcard, subscribeAll);
+
+      Benchmarks::CountingClient publisher(PUBLISHER_TYPE, 1);
+      CommonMessages::Header msg;
+      msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+      msg.set_topic(1);
+      msg.set_msg(std::string(64, 'x'));
+      auto pFrame = CommonMessages::EncodedFrame::Create(msg);
+
+      Benchmarks::Stopwatch stopwatch;
+      for (int index = 0; index < numPublishes; index++)
+         subscriptionHandler.SendToSubscribers(&publisher, 1, pFrame);
+      auto seconds = stopwatch.ElapsedSeconds();
+
+      PublishResult result;
+      result.nsPerPublish = seconds * 1e9 / numPublishes;
+      result.delivered = pWildcard->GetFrameCount();
+      for (auto& pSubscriber : subscribers)
+         result.delivered += pSubscriber->GetFrameCount();
+      return result;
+   }
+
+   /// <summary>
+   /// Adds numSubscriptions subscriptions as in RunPublish, then times removing all the subscriptions of
+   /// numDisconnects of the subscribers as their clients disconnect
+   /// </summary>
+   /// <returns>The average microseconds per disconnect</returns>
+   double RunDisconnects(int numSubscriptions, int numDisconnects)
+   {
+      MessageThreads::SubscriptionHandler subscriptionHandler;
+      std::vector<std::shared_ptr<Benchmarks::CountingClient>> subscribers;
+      for (int index = 0; index < numSubscriptions; index++)
+      {
+         auto pSubscriber = std::make_shared<Benchmarks::CountingClient>(SUBSCRIBER_TYPE, index + 1);
+         CommonMessages::Subscribe subscribe;
+         subscribe.set_clienttype(PUBLISHER_TYPE);
+         subscribe.set_clientid(index / NUM_TOPICS + 1);
+         subscribe.set_topic(index % NUM_TOPICS + 1);
+         subscriptionHandler.AddSubscription(pSubscriber, subscribe);
+         subscribers.push_back(pSubscriber);
+      }
+
+      Benchmarks::Stopwatch stopwatch;
+      for (int index = 0; index < numDisconnects; index++)
+         subscriptionHandler.RemoveSubscriptionsFor(subscribers[index * (numSubscriptions / numDisconnects)].get());
+      return stopwatch.ElapsedSeconds() * 1e6 / numDisconnects;
+   }
+
+   /// <summary>
+   /// Subscribes numSubscribers clients to topic 1 of one publisher and, if overlapping, to everything
+   /// that publisher sends as well, so each is found through two keys and must only be sent to once
+   /// </summary>
+   /// <returns>The average nanoseconds per publish</returns>
+   double RunFanout(int numSubscribers, bool overlapping, int numPublishes, int64_t* pDelivered)
+   {
+      MessageThreads::SubscriptionHandler subscriptionHandler;
+      std::vector<std::shared_ptr<Benchmarks::CountingClient>> subscribers;
+      for (int index = 0; index < numSubscribers; index++)
+      {
+         auto pSubscriber = std::make_shared<Benchmarks::CountingClient>(SUBSCRIBER_TYPE, index + 1);
+         CommonMessages::Subscribe subscribe;
+         subscribe.set_clienttype(PUBLISHER_TYPE);
+         subscribe.set_clientid(1);
+         subscribe.set_topic(1);
+         subscriptionHandler.AddSubscription(pSubscriber, subscribe);
+         if (overlapping)
+         {
+            subscribe.set_topic(0);
+            subscriptionHandler.AddSubscription(pSubscriber, subscribe);
+         }
+         subscribers.push_back(pSubscriber);
+      }
+      Benchmarks::CountingClient publisher(PUBLISHER_TYPE, 1);
+      CommonMessages::Header msg;
+      msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+      msg.set_topic(1);
+      msg.set_msg(std::string(64, 'x'));
+      auto pFrame = CommonMessages::EncodedFrame::Create(msg);
+
+      Benchmarks::Stopwatch stopwatch;
+      for (int index = 0; index < numPublishes; index++)
+         subscriptionHandler.SendToSubscribers(&publisher, 1, pFrame);
+      auto seconds = stopwatch.ElapsedSeconds();
+
+      *pDelivered = 0;
+      for (auto& pSubscriber : subscribers)
+         *pDelivered += pSubscriber->GetFrameCount();
+      return seconds * 1e9 / numPublishes;
+   }
+
+   /// <summary>
+   /// Publishes from numThreads threads at once for durationMS, each as its own publisher with NUM_TOPICS
+   /// subscribers, while another thread keeps subscribing and unsubscribing so new tables are published
+   /// </summary>
+   /// <returns>The total number of publishes per second</returns>
+   double RunConcurrentPublish(int numThreads, int numSubscriptions, int durationMS, uint64_t* pVersions)
+   {
+      MessageThreads::SubscriptionHandler subscriptionHandler;
+      std::vector<std::shared_ptr<Benchmarks::CountingClient>> subscribers;
+      for (int index = 0; index < numSubscriptions; index++)
+      {
+         auto pSubscriber = std::make_shared<Benchmarks::CountingClient>(SUBSCRIBER_TYPE, index + 1);
+         CommonMessages::Subscribe subscribe;
+         subscribe.set_clienttype(PUBLISHER_TYPE);
+         subscribe.set_clientid(index / NUM_TOPICS + 1);
+         subscribe.set_topic(index % NUM_TOPICS + 1);
+         subscriptionHandler.AddSubscription(pSubscriber, subscribe);
+         subscribers.push_back(pSubscriber);
+      }
+      CommonMessages::Header msg;
+      msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+      msg.set_msg(std::string(64, 'x'));
+      auto pFrame = CommonMessages::EncodedFrame::Create(msg);
+      auto startVersion = subscriptionHandler.GetVersion();
+
+      std::atomic<bool> stop(false);
+      std::vector<int64_t> publishCounts(numThreads, 0);
+      std::vector<std::thread> threads;
+      for (int thread = 0; thread < numThreads; thread++)
+      {
+         threads.push_back(std::thread([&, thread]()
+         {
+            Benchmarks::CountingClient publisher(PUBLISHER_TYPE, thread + 1);
+            int64_t count = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+               //route a batch with one snapshot as a read of several frames does
+               auto pSnapshot = subscriptionHandler.GetSnapshot();
+               for (int topic = 1; topic <= NUM_TOPICS; topic++)
+                  subscriptionHandler.SendToSubscribers(pSnapshot, &publisher, topic, pFrame);
+               count += NUM_TOPICS;
+            }
+            publishCounts[thread] = count;
+         }));
+      }
+      threads.push_back(std::thread([&]()
+      {
+         //subscriptions to a publisher nobody is publishing as
+         auto pChurner = std::make_shared<Benchmarks::CountingClient>(SUBSCRIBER_TYPE, numSubscriptions + 1);
+         CommonMessages::Subscribe subscribe;
+         subscribe.set_clienttype(PUBLISHER_TYPE);
+         subscribe.set_clientid(numSubscriptions + 1);
+         while (!stop.load(std::memory_order_relaxed))
+         {
+            subscriptionHandler.AddSubscription(pChurner, subscribe);
+            subscriptionHandler.RemoveSubscription(pChurner.get(), subscribe);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         }
+      }));
+
+      Benchmarks::Stopwatch stopwatch;
+      std::this_thread::sleep_for(std::chrono::milliseconds(durationMS));
+      stop = true;
+      for (auto& thread : threads)
+         thread.join();
+      auto seconds = stopwatch.ElapsedSeconds();
+
+      int64_t total = 0;
+      for (auto count : publishCounts)
+         total += count;
+      *pVersions = subscriptionHandler.GetVersion() - startVersion;
+      return total / seconds;
+   }
+}
+
+void Benchmarks::RunSubscriptionsBenchmark()
+{
+   const int subscriptionCounts[] = { 100, 1000, 10000, 100000 };
+   std::cout << "subscriptions   ns/publish   delivered/publish" << std::endl;
+   for (auto numSubscriptions : subscriptionCounts)
+   {
+      //fewer publishes for the larger tables so a full scan per publish still finishes
+      auto numPublishes = 10000000 / numSubscriptions;
+      if (numPublishes > 100000)
+         numPublishes = 100000;
+      auto result = RunPublish(numSubscriptions, numPublishes);
+      printf("%13d %12.0f %19.1f\n", numSubscriptions, result.nsPerPublish, (double)result.delivered / numPublishes);
+   }
+
+   const int numDisconnects = 5000;
+   std::cout << std::endl << "subscriptions   us/disconnect (" << numDisconnects << " clients disconnecting)" << std::endl;
+   for (auto numSubscriptions : subscriptionCounts)
+   {
+      if (numSubscriptions < numDisconnects)
+         continue;
+      printf("%13d %15.1f\n", numSubscriptions, RunDisconnects(numSubscriptions, numDisconnects));
+   }
+}
+
+void Benchmarks::RunFanoutBenchmark()
+{
+   const int subscriberCounts[] = { 10, 100, 1000, 10000 };
+   std::cout << "subscribers   keys each   ns/publish   ns/recipient   delivered/publish" << std::endl;
+   for (auto numSubscribers : subscriberCounts)
+   {
+      for (int keys = 1; keys <= 2; keys++)
+      {
+         auto numPublishes = 2000000 / numSubscribers;
+         int64_t delivered = 0;
+         auto nsPerPublish = RunFanout(numSubscribers, keys == 2, numPublishes, &delivered);
+         printf("%11d %11d %12.0f %14.1f %19.1f\n", numSubscribers, keys, nsPerPublish, nsPerPublish / numSubscribers, (double)delivered / numPublishes);
+      }
+   }
+}
+
+void Benchmarks::RunPublishScalingBenchmark()
+{
+   int maxThreads = (int)std::thread::hardware_concurrency();
+   if (maxThreads < 4)
+      maxThreads = 4;
+   std::cout << "cores: " << std::thread::hardware_concurrency() << std::endl;
+   std::cout << "threads   publishes/sec   per thread   tables swapped" << std::endl;
+   for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+   {
+      uint64_t versions = 0;
+      auto publishesPerSecond = RunConcurrentPublish(numThreads, 10000, 1000, &versions);
+      printf("%7d %15.0f %12.0f %16llu\n", numThreads, publishesPerSecond, publishesPerSecond / numThreads, (unsigned long long)versions);
+   }
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "CountdownTimer.h"
+#include "TimerWheel.h"
+#include "Benchmarks.h"
+
+using namespace Matrix::Common;
+
+namespace
+{
+   /// <summary>
+   /// Reads a "Name:   value kB" line from /proc/self/status; -1 where it is not available
+   /// </summary>
+   int64_t ReadProcStatus(const char* pName)
+   {
+      int64_t value = -1;
+      FILE* pFile = fopen("/proc/self/status", "r");
+      if (pFile == nullptr)
+         return value;
+      char line[256];
+      auto nameLength = strlen(pName);
+      while (fgets(line, sizeof(line), pFile) != nullptr)
+      {
+         if (strncmp(line, pName, nameLength) == 0 && line[nameLength] == ':')
+         {
+            value = atoll(line + nameLength + 1);
+            break;
+         }
+      }
+      fclose(pFile);
+      return value;
+   }
+
+   struct TimersResult
+   {
+      int timers;
+      double armSeconds;
+      int64_t peakThreads;
+      int64_t rssDeltaKB;
+      double fireSeconds;
+      int fired;
+   };
+
+   /// <summary>
+   /// Arms numTimers once only timers the way CountdownTimer used to: a thread per timer
+   /// sleeping until it expires
+   /// </summary>
+   TimersResult RunThreadPerTimer(int numTimers, int delayMS)
+   {
+      std::atomic<int> fired(0);
+      auto startRss = ReadProcStatus("VmRSS");
+      Benchmarks::Stopwatch stopwatch;
+      std::vector<std::thread> threads;
+      threads.reserve(numTimers);
+      for (int index = 0; index < numTimers; index++)
+      {
+         threads.push_back(std::thread([&fired, delayMS]()
+         {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delayMS));
+            fired++;
+         }));
+      }
+      TimersResult result;
+      result.timers = numTimers;
+      result.armSeconds = stopwatch.ElapsedSeconds();
+      result.peakThreads = ReadProcStatus("Threads");
+      result.rssDeltaKB = ReadProcStatus("VmRSS") - startRss;
+      for (auto& thread : threads)
+         thread.join();
+      result.fireSeconds = stopwatch.ElapsedSeconds();
+      result.fired = fired;
+      return result;
+   }
+
+   /// <summary>
+   /// Arms numTimers once only CountdownTimers, which all share the TimerWheel thread
+   /// </summary>
+   TimersResult RunTimerWheel(int numTimers, int delayMS)
+   {
+      std::atomic<int> fired(0);
+      //make sure the wheel thread exists before counting threads
+      TimerWheel::Instance();
+      auto startRss = ReadProcStatus("VmRSS");
+      Benchmarks::Stopwatch stopwatch;
+      std::unique_ptr<CountdownTimer[]> timers(new CountdownTimer[numTimers]);
+      for (int index = 0; index < numTimers; index++)
+         timers[index].StartTimer(delayMS, [&fired]() { fired++; }, true);
+      TimersResult result;
+      result.timers = numTimers;
+      result.armSeconds = stopwatch.ElapsedSeconds();
+      result.peakThreads = ReadProcStatus("Threads");
+      result.rssDeltaKB = ReadProcStatus("VmRSS") - startRss;
+      for (int retry = 0; retry < 1000 && fired < numTimers; retry++)
+         std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      result.fireSeconds = stopwatch.ElapsedSeconds();
+      result.fired = fired;
+      return result;
+   }
+
+   void PrintResult(const char* name, const TimersResult& result)
+   {
+      printf("%-16s %8d %10.1f %9lld %12lld %10.1f %8d\n", name, result.timers, result.armSeconds * 1000.0
+            , (long long)result.peakThreads, (long long)result.rssDeltaKB, result.fireSeconds * 1000.0, result.fired);
+   }
+}
+
+void Benchmarks::RunTimersBenchmark()
+{
+   const int delayMS = 1000;
+   std::cout << "timers             count     arm ms   threads  rss delta kB    fire ms    fired" << std::endl;
+   //a thread per timer cannot be run at 100k in most environments so it is measured at 1k
+   PrintResult("thread/timer", RunThreadPerTimer(1000, delayMS));
+   PrintResult("timer wheel", RunTimerWheel(1000, delayMS));
+   PrintResult("timer wheel", RunTimerWheel(100000, delayMS));
+}
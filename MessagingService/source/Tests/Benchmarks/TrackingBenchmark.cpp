@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+
+#include "SubscriberMessageLists.h"
+#include "Benchmarks.h"
+
+using namespace Matrix::MsgService;
+
+namespace
+{
+   const int NUM_CLIENTS = 100;
+   //messages waiting for an ack per client
+   const int OUTSTANDING = 1000;
+   const int NUM_OPS = 200000;
+   //messages per client left older than the cutoff for the GetMessages that finds some
+   const int DUE = OUTSTANDING / 10;
+   const int NUM_QUERIES = 10;
+
+   /// <summary>
+   /// What tracking looks like with a map of maps under one lock and a scan for the old messages
+   /// </summary>
+   class MapLists
+   {
+   private:
+      struct SentMessage
+      {
+         int64_t _sentMS;
+         CommonMessages::Header _msg;
+      };
+      std::mutex _lock;
+      std::unordered_map<CommonMessages::SubscriptionParams, std::unordered_map<int, SentMessage>, CommonMessages::SubscriptionParamsHasher> _clients;
+      static int64_t GetSteadyMS()
+      {
+         return (int64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+      }
+   public:
+      void AddSentMessage(const CommonMessages::Header& msg)
+      {
+         std::lock_guard<std::mutex> lock(_lock);
+         auto& sentMsg = _clients[CommonMessages::SubscriptionParams(msg.destclienttype(), msg.destclientid())][msg.msgkey()];
+         sentMsg._sentMS = GetSteadyMS();
+         sentMsg._msg = msg;
+      }
+      void RemoveSentMessage(int clientType, int clientID, int msgKey)
+      {
+         std::lock_guard<std::mutex> lock(_lock);
+         _clients[CommonMessages::SubscriptionParams(clientType, clientID)].erase(msgKey);
+      }
+      std::vector<CommonMessages::Header> GetMessages(int clientType, int clientID, int numSeconds)
+      {
+         std::vector<CommonMessages::Header> list;
+         auto cutoffMS = GetSteadyMS() - (int64_t)numSeconds * 1000;
+         std::lock_guard<std::mutex> lock(_lock);
+         for (auto& entry : _clients[CommonMessages::SubscriptionParams(clientType, clientID)])
+         {
+            if (entry.second._sentMS <= cutoffMS)
+               list.push_back(entry.second._msg);
+         }
+         return list;
+      }
+   };
+
+   /// <summary>
+   /// Sends a message to the next client and acks the oldest message waiting, keeping OUTSTANDING waiting for each
+   /// </summary>
+   template <typename Lists>
+   void SendAndAck(Lists& lists, CommonMessages::Header& msg, int* pNextKey, int count)
+   {
+      for (int index = 0; index < count; index++)
+      {
+         auto key = (*pNextKey)++;
+         auto clientID = (key - 1) % NUM_CLIENTS + 1;
+         msg.set_destclientid(clientID);
+         msg.set_msgkey(key);
+         lists.AddSentMessage(msg);
+         lists.RemoveSentMessage(2, clientID, key - NUM_CLIENTS * OUTSTANDING);
+      }
+   }
+
+   /// <summary>
+   /// Times GetMessages for every client
+   /// </summary>
+   /// <returns>microseconds per call</returns>
+   template <typename Lists>
+   double TimeGetMessages(Lists& lists, int numSeconds, size_t* pFound)
+   {
+      *pFound = 0;
+      Benchmarks::Stopwatch stopwatch;
+      for (int query = 0; query < NUM_QUERIES; query++)
+      {
+         for (int clientID = 1; clientID <= NUM_CLIENTS; clientID++)
+            *pFound += lists.GetMessages(2, clientID, numSeconds).size();
+      }
+      auto seconds = stopwatch.ElapsedSeconds();
+      *pFound /= NUM_QUERIES * NUM_CLIENTS;
+      return seconds * 1e6 / (NUM_QUERIES * NUM_CLIENTS);
+   }
+
+   template <typename Lists>
+   void RunTracking(const char* name, Lists& lists)
+   {
+      CommonMessages::Header msg;
+      msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+      msg.set_destclienttype(2);
+      msg.set_msg(std::string(64, 'x'));
+      int nextKey = 1;
+      for (int index = 0; index < NUM_CLIENTS * OUTSTANDING; index++)
+      {
+         msg.set_destclientid(index % NUM_CLIENTS + 1);
+         msg.set_msgkey(nextKey++);
+         lists.AddSentMessage(msg);
+      }
+
+      Benchmarks::Stopwatch stopwatch;
+      SendAndAck(lists, msg, &nextKey, NUM_OPS);
+      auto opSeconds = stopwatch.ElapsedSeconds();
+
+      //age every waiting message past a 1 second cutoff, then replace all but DUE of them per client
+      size_t noneFound, someFound, allFound;
+      auto noneMicros = TimeGetMessages(lists, 60, &noneFound);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+      SendAndAck(lists, msg, &nextKey, NUM_CLIENTS * (OUTSTANDING - DUE));
+      auto someMicros = TimeGetMessages(lists, 1, &someFound);
+      auto allMicros = TimeGetMessages(lists, 0, &allFound);
+      printf("%-24s %11.0f %9.1f (%4zu) %9.1f (%4zu) %9.1f (%4zu)\n", name, opSeconds * 1e9 / NUM_OPS
+            , noneMicros, noneFound, someMicros, someFound, allMicros, allFound);
+   }
+}
+
+void Benchmarks::RunTrackingBenchmark()
+{
+   std::cout << NUM_CLIENTS << " clients with " << OUTSTANDING << " messages each waiting for an ack; "
+         << NUM_OPS << " sends each acking the oldest, then GetMessages when none, " << DUE << " and all of each client's are due" << std::endl;
+   std::cout << "us per GetMessages, with the messages returned per call in brackets" << std::endl;
+   std::cout << "lists                    ns/send+ack   none due         some due          all due" << std::endl;
+   {
+      MapLists lists;
+      RunTracking("map, one lock, scan", lists);
+   }
+   {
+      CommunicationUtils::SubscriberMessageLists lists;
+      RunTracking("SubscriberMessageLists", lists);
+   }
+}
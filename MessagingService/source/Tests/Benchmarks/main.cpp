@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+#include "ArgumentParser.h"
+#include "Logger.h"
+#include "Benchmarks.h"
+
+/**
+Runs the benchmarks.  Use --benchmark=name to run a single benchmark.
+
+@Author JLitton
+*/
+
+using namespace Matrix::Common;
+
+namespace
+{
+   struct BenchmarkEntry
+   {
+      const char* name;
+      const char* description;
+      void(*run)();
+   };
+
+   const BenchmarkEntry g_benchmarks[] =
+   {
+      { "framing", "Frames decoded per socket read", Benchmarks::RunFramingBenchmark },
+      { "allocations", "Heap allocations per received message", Benchmarks::RunAllocationsBenchmark },
+      { "timers", "Threads and memory used by 100k armed timers", Benchmarks::RunTimersBenchmark },
+      { "scaling", "Broker throughput from 1 io thread to one per core", Benchmarks::RunScalingBenchmark },
+      { "acceptstorm", "Connections accepted per second during a reconnect storm", Benchmarks::RunAcceptStormBenchmark },
+      { "subscriptions", "Publish cost as the number of subscriptions grows", Benchmarks::RunSubscriptionsBenchmark },
+      { "fanout", "Cost per recipient of sending to many subscribers", Benchmarks::RunFanoutBenchmark },
+      { "publishthreads", "Publish throughput from several threads while subscriptions change", Benchmarks::RunPublishScalingBenchmark },
+      { "shutdown", "Time to shut down thousands of connected clients", Benchmarks::RunShutdownBenchmark },
+      { "conflation", "Queue size and bandwidth for a lagging subscriber with and without conflation", Benchmarks::RunConflationBenchmark },
+      { "priority", "Latency of an ACK behind a bulk backlog", Benchmarks::RunPriorityBenchmark },
+      { "acks", "ACK traffic for a stream of directed messages with immediate and delayed acks", Benchmarks::RunAcksBenchmark },
+      { "tracking", "Cost of tracking sent messages until they are acked", Benchmarks::RunTrackingBenchmark },
+   };
+}
+
+//******************************************************************
+int main(
+   int      argc,    ///< The number of command line parameters
+   char *   argv[]   ///< The command line parameters - the array will have argc entries
+)
+{
+   ParseValues parseValues;
+   parseValues.ParseArgumentValues(argc, argv, (int)Logging::LogLevels::WARNING_LVL);
+   std::string benchmark = "";
+   if (parseValues.mDisplayHelp)
+   {
+      std::cout <<
+         parseValues.GetHelpString() <<
+         "--benchmark=name   : Runs only the named benchmark. (default = all)." << std::endl <<
+         "Benchmarks:" << std::endl;
+      for (auto& entry : g_benchmarks)
+         std::cout << "   " << entry.name << " - " << entry.description << std::endl;
+      return 0;
+   }
+   for (int index = 0; index < argc; index++)
+   {
+      std::string value;
+      if (ArgumentParser::ParseStringFlag(argv[index], "benchmark", &value))
+         benchmark = value;
+   }
+
+   //always log to the console; with no sink boost logs every level, which swamps the timings
+   Logging::Logger::SetGlobalLogger(std::unique_ptr<Logging::Logger>(
+      new Logging::Logger("BENCHMARKS", Logging::IntToLogLevel(parseValues.mLogLevel), true, false)));
+
+   bool found = false;
+   for (auto& entry : g_benchmarks)
+   {
+      if (benchmark == "" || benchmark == entry.name)
+      {
+         found = true;
+         std::cout << "=== " << entry.name << ": " << entry.description << " ===" << std::endl;
+         entry.run();
+         std::cout << std::endl;
+      }
+   }
+   if (!found)
+      std::cout << "Unknown benchmark " << benchmark << std::endl;
+
+   Logging::Logger::ClearGlobalLogger();
+   return found ? 0 : 1;
+}
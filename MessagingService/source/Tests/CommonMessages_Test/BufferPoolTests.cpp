@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include "Message.h"
+#include "BufferPool.h"
+
+using namespace Matrix::MsgService;
+using namespace Matrix::MsgService::CommonMessages;
+
+// Tests that Acquire rounds up to the size class
+TEST(BufferPoolTest, Acquire_RoundsUpToSizeClass) {
+   //Setup
+   auto& pool = BufferPool::Instance();
+
+   //Test
+   auto buffer = pool.Acquire(300);
+
+   //Expectations
+   ASSERT_NE(nullptr, buffer.GetData());
+   EXPECT_EQ(pool.GetClassSize(buffer.GetSizeClass()), buffer.GetCapacity());
+   EXPECT_GE(buffer.GetCapacity(), 300u);
+   EXPECT_LT(buffer.GetCapacity(), 4 * 300u);
+}
+
+// Tests that the largest size class holds a full size frame
+TEST(BufferPoolTest, Acquire_MaxFrame_UsesLastSizeClass) {
+   //Setup
+   auto& pool = BufferPool::Instance();
+
+   //Test
+   auto buffer = pool.Acquire(HDR_SIZE + MAX_MESSAGE_SIZE);
+
+   //Expectations
+   EXPECT_EQ(BufferPool::NUM_SIZE_CLASSES - 1, buffer.GetSizeClass());
+   EXPECT_EQ((size_t)(HDR_SIZE + MAX_MESSAGE_SIZE), buffer.GetCapacity());
+}
+
+// Tests that a released buffer is reused
+TEST(BufferPoolTest, Release_BufferIsReused) {
+   //Setup
+   auto& pool = BufferPool::Instance();
+   char* pFirst;
+   {
+      auto buffer = pool.Acquire(1000);
+      pFirst = buffer.GetData();
+   }
+
+   //Test
+   auto buffer = pool.Acquire(1000);
+
+   //Expectations
+   EXPECT_EQ(pFirst, buffer.GetData());
+}
+
+// Tests that bytes in use are tracked
+TEST(BufferPoolTest, GetBytesInUse_TracksAcquiredBuffers) {
+   //Setup
+   auto& pool = BufferPool::Instance();
+   auto before = pool.GetBytesInUse();
+
+   //Test
+   auto buffer = pool.Acquire(5000);
+   auto capacity = (int64_t)buffer.GetCapacity();
+   auto during = pool.GetBytesInUse();
+   buffer.Release();
+   auto after = pool.GetBytesInUse();
+
+   //Expectations
+   EXPECT_EQ(before + capacity, during);
+   EXPECT_EQ(before, after);
+}
+
+// Tests that moving a buffer transfers ownership
+TEST(BufferPoolTest, Move_TransfersOwnership) {
+   //Setup
+   auto buffer = BufferPool::Instance().Acquire(100);
+   auto pData = buffer.GetData();
+
+   //Test
+   PooledBuffer other(std::move(buffer));
+
+   //Expectations
+   EXPECT_EQ(nullptr, buffer.GetData());
+   EXPECT_EQ(pData, other.GetData());
+}
+
+// Tests that a packed message only uses a buffer sized to the frame
+TEST(BufferPoolTest, PackMsg_BufferSizedToFrame) {
+   //Setup
+   Header myMsg;
+   myMsg.set_msgkey(5);
+   Message msg;
+
+   //Test
+   auto totalSize = msg.PackMsg(myMsg);
+
+   //Expectations
+   ASSERT_GT(totalSize, 0);
+   EXPECT_EQ((size_t)BufferPool::MIN_BUFFER_SIZE, msg.GetBufferCapacity());
+}
+
+// Tests that a message larger than MAX_MESSAGE_SIZE is not packed
+TEST(BufferPoolTest, PackMsg_TooLarge_ReturnsError) {
+   //Setup
+   Header myMsg;
+   myMsg.set_msg(std::string(MAX_MESSAGE_SIZE + 1, 'z'));
+   Message msg;
+
+   //Test
+   auto totalSize = msg.PackMsg(myMsg);
+
+   //Expectations
+   EXPECT_EQ(-1, totalSize);
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include "Message.h"
+#include "EncodedFrame.h"
+
+using namespace Matrix::MsgService;
+using namespace Matrix::MsgService::CommonMessages;
+
+// Tests that Create produces a size prefixed frame that decodes to the same message
+TEST(EncodedFrameTest, Create_DecodesToSameMessage) {
+   //Setup
+   Header myMsg;
+   myMsg.set_msgkey(12);
+   myMsg.set_topic(3);
+   myMsg.set_msg("payload");
+
+   //Test
+   auto pFrame = EncodedFrame::Create(myMsg);
+
+   //Expectations
+   ASSERT_NE(nullptr, pFrame);
+   EXPECT_EQ(HDR_SIZE + myMsg.ByteSizeLong(), pFrame->GetSize());
+   Header decodedMsg;
+   ASSERT_TRUE(decodedMsg.ParseFromArray(pFrame->GetData() + HDR_SIZE, (int)(pFrame->GetSize() - HDR_SIZE)));
+   EXPECT_EQ(12, decodedMsg.msgkey());
+   EXPECT_EQ(3, decodedMsg.topic());
+   EXPECT_EQ("payload", decodedMsg.msg());
+}
+
+// Tests that a message larger than MAX_MESSAGE_SIZE is not encoded
+TEST(EncodedFrameTest, Create_TooLarge_ReturnsNull) {
+   //Setup
+   Header myMsg;
+   myMsg.set_msg(std::string(MAX_MESSAGE_SIZE + 1, 'z'));
+
+   //Test
+   auto pFrame = EncodedFrame::Create(myMsg);
+
+   //Expectations
+   EXPECT_EQ(nullptr, pFrame);
+}
+
+// Tests that a frame is a priority or control frame only if its message is
+TEST(EncodedFrameTest, Create_PriorityFromMessage) {
+   //Setup
+   Header ackMsg;
+   ackMsg.set_msgtypeid(MsgType::ACK);
+   Header customMsg;
+   customMsg.set_msgtypeid(MsgType::CUSTOM);
+   Header urgentMsg;
+   urgentMsg.set_msgtypeid(MsgType::CUSTOM);
+   urgentMsg.set_priority(1);
+
+   //Test
+   auto pAckFrame = EncodedFrame::Create(ackMsg);
+   auto pCustomFrame = EncodedFrame::Create(customMsg);
+   auto pUrgentFrame = EncodedFrame::Create(urgentMsg);
+
+   //Expectations
+   EXPECT_TRUE(pAckFrame->IsPriority());
+   EXPECT_FALSE(pCustomFrame->IsPriority());
+   EXPECT_TRUE(pUrgentFrame->IsPriority());
+   EXPECT_TRUE(EncodedFrame::GetHeartbeat()->IsPriority());
+   EXPECT_TRUE(pAckFrame->IsControl());
+   EXPECT_FALSE(pCustomFrame->IsControl());
+   EXPECT_FALSE(pUrgentFrame->IsControl());
+   EXPECT_TRUE(EncodedFrame::GetHeartbeat()->IsControl());
+}
+
+// Tests that the heartbeat frame is a 0 size prefix
+TEST(EncodedFrameTest, GetHeartbeat_IsZeroSizePrefix) {
+   //Test
+   auto pFrame = EncodedFrame::GetHeartbeat();
+
+   //Expectations
+   ASSERT_EQ((size_t)HDR_SIZE, pFrame->GetSize());
+   for (int index = 0; index < HDR_SIZE; index++)
+      EXPECT_EQ(0, pFrame->GetData()[index]);
+}
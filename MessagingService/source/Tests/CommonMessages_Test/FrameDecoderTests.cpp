@@ -0,0 +1,246 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <algorithm>
+
+#include "Message.h"
+#include "FrameDecoder.h"
+
+using namespace Matrix::MsgService;
+using namespace Matrix::MsgService::CommonMessages;
+
+namespace
+{
+   //Packs msg and appends the size prefixed frame to stream
+   void AppendFrame(std::vector<char>& stream, const Header& msg)
+   {
+      Message packer;
+      auto totalSize = packer.PackMsg(msg);
+      stream.insert(stream.end(), packer.GetBuffer(), packer.GetBuffer() + totalSize);
+   }
+   //Appends a heartbeat (0 size) frame to stream
+   void AppendHeartbeat(std::vector<char>& stream)
+   {
+      Message packer;
+      auto totalSize = packer.CreateEmptyMsg();
+      stream.insert(stream.end(), packer.GetBuffer(), packer.GetBuffer() + totalSize);
+   }
+   //Copies up to count bytes of stream starting at pos into the decoder
+   size_t Feed(FrameDecoder& decoder, const std::vector<char>& stream, size_t pos, size_t count)
+   {
+      auto pBuffer = decoder.GetWriteBuffer();
+      auto toCopy = std::min(std::min(count, stream.size() - pos), decoder.GetWriteSpace());
+      memcpy(pBuffer, &stream[pos], toCopy);
+      decoder.Commit(toCopy);
+      return toCopy;
+   }
+   //Pulls all of the complete frames out of the decoder
+   std::vector<Header> DrainFrames(FrameDecoder& decoder, int* pHeartbeats = nullptr)
+   {
+      std::vector<Header> msgs;
+      const char* pData;
+      uint32_t size;
+      while (decoder.NextFrame(&pData, &size) == FrameDecoder::FrameStatus::Complete)
+      {
+         if (size == 0)
+         {
+            if (pHeartbeats != nullptr)
+               (*pHeartbeats)++;
+         }
+         else
+         {
+            Header msg;
+            EXPECT_TRUE(msg.ParseFromArray(pData, (int)size));
+            msgs.push_back(msg);
+         }
+      }
+      return msgs;
+   }
+}
+
+// Tests NextFrame with no data
+TEST(FrameDecoderTest, NextFrame_Empty_ReturnsIncomplete) {
+   //Setup
+   FrameDecoder decoder;
+   const char* pData;
+   uint32_t size;
+
+   //Test
+   auto status = decoder.NextFrame(&pData, &size);
+
+   //Expectations
+   EXPECT_EQ(FrameDecoder::FrameStatus::Incomplete, status);
+}
+
+// Tests that every frame in a single read is returned
+TEST(FrameDecoderTest, NextFrame_SeveralFramesInOneRead_ReturnsAll) {
+   //Setup
+   std::vector<char> stream;
+   for (int key = 1; key <= 5; key++)
+   {
+      Header msg;
+      msg.set_msgkey(key);
+      AppendFrame(stream, msg);
+   }
+   AppendHeartbeat(stream);
+   FrameDecoder decoder;
+
+   //Test
+   Feed(decoder, stream, 0, stream.size());
+   int heartbeats = 0;
+   auto msgs = DrainFrames(decoder, &heartbeats);
+
+   //Expectations
+   ASSERT_EQ(5u, msgs.size());
+   for (int index = 0; index < 5; index++)
+      EXPECT_EQ(index + 1, msgs[index].msgkey());
+   EXPECT_EQ(1, heartbeats);
+   EXPECT_EQ(0u, decoder.GetBufferedBytes());
+}
+
+// Tests that a frame split across reads is kept until it is complete
+TEST(FrameDecoderTest, NextFrame_PartialFrame_CompletedByNextRead) {
+   //Setup
+   Header msg;
+   msg.set_msgkey(7);
+   msg.set_msg(std::string(100, 'x'));
+   std::vector<char> stream;
+   AppendFrame(stream, msg);
+   FrameDecoder decoder;
+
+   //Test
+   Feed(decoder, stream, 0, 2);
+   auto first = DrainFrames(decoder);
+   Feed(decoder, stream, 2, 50);
+   auto second = DrainFrames(decoder);
+   Feed(decoder, stream, 52, stream.size());
+   auto third = DrainFrames(decoder);
+
+   //Expectations
+   EXPECT_EQ(0u, first.size());
+   EXPECT_EQ(0u, second.size());
+   ASSERT_EQ(1u, third.size());
+   EXPECT_EQ(7, third[0].msgkey());
+   EXPECT_EQ(msg.msg(), third[0].msg());
+}
+
+// Tests feeding a stream one byte at a time
+TEST(FrameDecoderTest, NextFrame_ByteAtATime_ReturnsAll) {
+   //Setup
+   std::vector<char> stream;
+   for (int key = 1; key <= 3; key++)
+   {
+      Header msg;
+      msg.set_msgkey(key);
+      msg.set_topic(key * 10);
+      AppendFrame(stream, msg);
+   }
+   FrameDecoder decoder(8);
+
+   //Test
+   std::vector<Header> msgs;
+   for (size_t pos = 0; pos < stream.size(); pos++)
+   {
+      Feed(decoder, stream, pos, 1);
+      auto frames = DrainFrames(decoder);
+      msgs.insert(msgs.end(), frames.begin(), frames.end());
+   }
+
+   //Expectations
+   ASSERT_EQ(3u, msgs.size());
+   EXPECT_EQ(3, msgs[2].msgkey());
+   EXPECT_EQ(30, msgs[2].topic());
+}
+
+// Tests that the buffer grows to hold a frame larger than its capacity
+TEST(FrameDecoderTest, GetWriteBuffer_FrameLargerThanCapacity_Grows) {
+   //Setup
+   Header msg;
+   msg.set_msgkey(9);
+   msg.set_msg(std::string(5000, 'y'));
+   std::vector<char> stream;
+   AppendFrame(stream, msg);
+   FrameDecoder decoder(256);
+
+   //Test
+   size_t pos = 0;
+   std::vector<Header> msgs;
+   while (pos < stream.size())
+   {
+      pos += Feed(decoder, stream, pos, stream.size());
+      auto frames = DrainFrames(decoder);
+      msgs.insert(msgs.end(), frames.begin(), frames.end());
+   }
+
+   //Expectations
+   EXPECT_GE(decoder.GetCapacity(), stream.size());
+   ASSERT_EQ(1u, msgs.size());
+   EXPECT_EQ(msg.msg(), msgs[0].msg());
+}
+
+// Tests that a size prefix larger than MAX_MESSAGE_SIZE is rejected
+TEST(FrameDecoderTest, NextFrame_SizeTooLarge_ReturnsInvalid) {
+   //Setup
+   uint32_t badSize = MAX_MESSAGE_SIZE + 1;
+   std::vector<char> stream;
+   for (int index = 0; index < 4; index++)
+      stream.push_back((char)((badSize >> (8 * index)) & 0xFF));
+   FrameDecoder decoder;
+   Feed(decoder, stream, 0, stream.size());
+   const char* pData;
+   uint32_t size;
+
+   //Test
+   auto status = decoder.NextFrame(&pData, &size);
+
+   //Expectations
+   EXPECT_EQ(FrameDecoder::FrameStatus::Invalid, status);
+}
+
+// Tests that Reset discards a partial frame
+TEST(FrameDecoderTest, Reset_DiscardsPartialFrame) {
+   //Setup
+   Header msg;
+   msg.set_msgkey(3);
+   std::vector<char> stream;
+   AppendFrame(stream, msg);
+   FrameDecoder decoder;
+   Feed(decoder, stream, 0, stream.size() - 1);
+
+   //Test
+   decoder.Reset();
+
+   //Expectations
+   EXPECT_EQ(0u, decoder.GetBufferedBytes());
+}
+
+// Tests that a grown buffer shrinks back once reads are small again
+TEST(FrameDecoderTest, GetWriteBuffer_AfterSmallReads_Shrinks) {
+   //Setup
+   Header largeMsg;
+   largeMsg.set_msg(std::string(20000, 'z'));
+   std::vector<char> largeStream;
+   AppendFrame(largeStream, largeMsg);
+   Header smallMsg;
+   smallMsg.set_msgkey(1);
+   std::vector<char> smallStream;
+   AppendFrame(smallStream, smallMsg);
+   FrameDecoder decoder;
+   auto initialCapacity = decoder.GetCapacity();
+   size_t pos = 0;
+   while (pos < largeStream.size())
+      pos += Feed(decoder, largeStream, pos, largeStream.size());
+   auto grownCapacity = decoder.GetCapacity();
+   DrainFrames(decoder);
+
+   //Test
+   for (int index = 0; index < FrameDecoder::SHRINK_AFTER_READS; index++)
+   {
+      Feed(decoder, smallStream, 0, smallStream.size());
+      DrainFrames(decoder);
+   }
+   decoder.GetWriteBuffer();
+
+   //Expectations
+   EXPECT_GT(grownCapacity, initialCapacity);
+   EXPECT_EQ(initialCapacity, decoder.GetCapacity());
+}
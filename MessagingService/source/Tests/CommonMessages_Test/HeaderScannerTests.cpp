@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include "HeaderScanner.h"
+#include "EncodedFrame.h"
+#include "Message.h"
+
+using namespace Matrix::MsgService;
+using namespace Matrix::MsgService::CommonMessages;
+
+// Tests that Scan reads every routing field
+TEST(HeaderScannerTest, Scan_ReadsRoutingFields) {
+   //Setup
+   Header hdr;
+   hdr.set_msgtypeid(MsgType::CUSTOM);
+   hdr.set_msgkey(12);
+   hdr.set_origclienttype(3);
+   hdr.set_origclientid(4);
+   hdr.set_destclienttype(5);
+   hdr.set_destclientid(-6);
+   hdr.add_ackkeys(7);
+   hdr.add_ackkeys(8);
+   hdr.set_topic(9);
+   hdr.set_isarchived(true);
+   hdr.set_replymsgkey(10);
+   hdr.set_priority(11);
+   hdr.set_msg(std::string(1000, 'x'));
+   auto data = hdr.SerializeAsString();
+
+   //Test
+   RoutingHeader routing;
+   auto success = HeaderScanner::Scan(data.data(), (int)data.size(), &routing);
+
+   //Expectations
+   EXPECT_TRUE(success);
+   EXPECT_EQ(MsgType::CUSTOM, routing._msgTypeID);
+   EXPECT_EQ(12, routing._msgKey);
+   EXPECT_EQ(3, routing._origClientType);
+   EXPECT_EQ(4, routing._origClientID);
+   EXPECT_EQ(5, routing._destClientType);
+   EXPECT_EQ(-6, routing._destClientID);
+   ASSERT_EQ(2u, routing._ackKeys.size());
+   EXPECT_EQ(7, routing._ackKeys[0]);
+   EXPECT_EQ(8, routing._ackKeys[1]);
+   EXPECT_EQ(9, routing._topic);
+   EXPECT_EQ(10, routing._replyMsgKey);
+   EXPECT_EQ(11, routing._priority);
+}
+
+// Tests that unpacked ackKeys are read as well as packed ones
+TEST(HeaderScannerTest, Scan_UnpackedAckKeys) {
+   //Setup - field 7, varint wire type, values 1 and 300
+   const char data[] = { 0x38, 0x01, 0x38, (char)0xAC, 0x02 };
+
+   //Test
+   RoutingHeader routing;
+   auto success = HeaderScanner::Scan(data, sizeof(data), &routing);
+
+   //Expectations
+   EXPECT_TRUE(success);
+   ASSERT_EQ(2u, routing._ackKeys.size());
+   EXPECT_EQ(1, routing._ackKeys[0]);
+   EXPECT_EQ(300, routing._ackKeys[1]);
+}
+
+// Tests that a truncated message is rejected
+TEST(HeaderScannerTest, Scan_Truncated_ReturnsFalse) {
+   //Setup
+   Header hdr;
+   hdr.set_msgtypeid(MsgType::CUSTOM);
+   hdr.set_msg("payload");
+   auto data = hdr.SerializeAsString();
+
+   //Test
+   RoutingHeader routing;
+   auto success = HeaderScanner::Scan(data.data(), (int)data.size() - 1, &routing);
+
+   //Expectations
+   EXPECT_FALSE(success);
+}
+
+// Tests that ScanMsgTypeID finds the MsgTypeID
+TEST(HeaderScannerTest, ScanMsgTypeID_ReturnsMsgType) {
+   //Setup
+   Header hdr;
+   hdr.set_msgkey(5);
+   hdr.set_msg("payload");
+   hdr.set_msgtypeid(MsgType::UNSUBSCRIBE);
+   auto data = hdr.SerializeAsString();
+
+   //Test
+   auto msgType = HeaderScanner::ScanMsgTypeID(data.data(), (int)data.size());
+
+   //Expectations
+   EXPECT_EQ(MsgType::UNSUBSCRIBE, msgType);
+}
+
+// Tests that appending the orig client fields to an encoded Header sets them without changing anything else
+TEST(HeaderScannerTest, AppendOrigClient_OverridesOrigClient) {
+   //Setup
+   Header hdr;
+   hdr.set_msgtypeid(MsgType::CUSTOM);
+   hdr.set_msgkey(21);
+   hdr.set_topic(2);
+   hdr.set_msg("payload");
+   auto data = hdr.SerializeAsString();
+   char origClient[HeaderScanner::MAX_ORIG_CLIENT_SIZE];
+
+   //Test
+   auto origClientSize = HeaderScanner::AppendOrigClient(origClient, 7, -1);
+   auto pFrame = EncodedFrame::Create(data.data(), data.size(), origClient, origClientSize);
+
+   //Expectations
+   ASSERT_NE(nullptr, pFrame);
+   EXPECT_EQ(HDR_SIZE + data.size() + origClientSize, pFrame->GetSize());
+   Header decodedMsg;
+   ASSERT_TRUE(decodedMsg.ParseFromArray(pFrame->GetData() + HDR_SIZE, (int)(pFrame->GetSize() - HDR_SIZE)));
+   EXPECT_EQ(7, decodedMsg.origclienttype());
+   EXPECT_EQ(-1, decodedMsg.origclientid());
+   EXPECT_EQ(21, decodedMsg.msgkey());
+   EXPECT_EQ(2, decodedMsg.topic());
+   EXPECT_EQ("payload", decodedMsg.msg());
+}
@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include "MessageArena.h"
+
+using namespace Matrix::MsgService;
+using namespace Matrix::MsgService::CommonMessages;
+
+// Tests that a Header created by the arena is on the arena
+TEST(MessageArenaTest, CreateHeader_IsOnArena) {
+   //Setup
+   MessageArena arena;
+   Header msg;
+   msg.set_msgkey(3);
+   msg.add_ackkeys(4);
+   msg.set_msg(std::string(500, 'a'));
+   auto data = msg.SerializeAsString();
+
+   //Test
+   auto pMsg = arena.CreateHeader();
+   auto success = pMsg->ParseFromString(data);
+
+   //Expectations
+   EXPECT_TRUE(success);
+   EXPECT_NE(nullptr, pMsg->GetArena());
+   EXPECT_EQ(3, pMsg->msgkey());
+   EXPECT_EQ(std::string(500, 'a'), pMsg->msg());
+}
+
+// Tests that Reset frees what was created back down to the initial block
+TEST(MessageArenaTest, Reset_KeepsInitialBlock) {
+   //Setup
+   MessageArena arena;
+   auto initialSpace = arena.GetSpaceAllocated();
+   for (int index = 0; index < 1000; index++)
+   {
+      auto pMsg = arena.CreateHeader();
+      for (int key = 0; key < 10; key++)
+         pMsg->add_ackkeys(key);
+   }
+   auto usedSpace = arena.GetSpaceAllocated();
+
+   //Test
+   arena.Reset();
+
+   //Expectations
+   EXPECT_GT(usedSpace, initialSpace);
+   EXPECT_EQ(initialSpace, arena.GetSpaceAllocated());
+   EXPECT_EQ(1, arena.GetResetCount());
+}
+
+// Tests that ToHeap copies a message off of the arena
+TEST(MessageArenaTest, ToHeap_ArenaMsg_Copies) {
+   //Setup
+   MessageArena arena;
+   auto pMsg = arena.CreateHeader();
+   pMsg->set_msgkey(7);
+   pMsg->set_msg("payload");
+
+   //Test
+   auto pHeapMsg = MessageArena::ToHeap(std::move(pMsg));
+   arena.Reset();
+
+   //Expectations
+   ASSERT_NE(nullptr, pHeapMsg);
+   EXPECT_EQ(nullptr, pHeapMsg->GetArena());
+   EXPECT_EQ(7, pHeapMsg->msgkey());
+   EXPECT_EQ("payload", pHeapMsg->msg());
+}
+
+// Tests that ToHeap keeps a heap message without copying it
+TEST(MessageArenaTest, ToHeap_HeapMsg_DoesNotCopy) {
+   //Setup
+   HeaderPtr pMsg(new Header());
+   auto pRawMsg = pMsg.get();
+
+   //Test
+   auto pHeapMsg = MessageArena::ToHeap(std::move(pMsg));
+
+   //Expectations
+   EXPECT_EQ(pRawMsg, pHeapMsg.get());
+}
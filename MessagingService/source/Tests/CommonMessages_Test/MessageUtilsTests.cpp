@@ -55,3 +55,26 @@ TEST(MessageUtilsTest, ParseHeader) {
    free(buffer);
 }
 
+// Tests that control messages, replies and messages marked with a priority are priority messages
+TEST(MessageUtilsTest, IsPriority) {
+   EXPECT_TRUE(MessageUtils::IsPriority(MsgType::ACK, 0, 0));
+   EXPECT_TRUE(MessageUtils::IsPriority(MsgType::NACK, 0, 0));
+   EXPECT_TRUE(MessageUtils::IsPriority(MsgType::LOGON, 0, 0));
+   EXPECT_TRUE(MessageUtils::IsPriority(MsgType::SUBSCRIBE, 0, 0));
+   EXPECT_TRUE(MessageUtils::IsPriority(MsgType::CUSTOM, 5, 0));
+   EXPECT_TRUE(MessageUtils::IsPriority(MsgType::CUSTOM, 0, 1));
+   EXPECT_FALSE(MessageUtils::IsPriority(MsgType::CUSTOM, 0, 0));
+   EXPECT_FALSE(MessageUtils::IsPriority(MsgType::INVALID_MSG_TYPE, 0, 0));
+}
+
+// Tests that only the control message types are control messages
+TEST(MessageUtilsTest, IsControl) {
+   EXPECT_TRUE(MessageUtils::IsControl(MsgType::ACK));
+   EXPECT_TRUE(MessageUtils::IsControl(MsgType::NACK));
+   EXPECT_TRUE(MessageUtils::IsControl(MsgType::LOGON));
+   EXPECT_TRUE(MessageUtils::IsControl(MsgType::LOGOFF));
+   EXPECT_TRUE(MessageUtils::IsControl(MsgType::SUBSCRIBE));
+   EXPECT_TRUE(MessageUtils::IsControl(MsgType::UNSUBSCRIBE));
+   EXPECT_FALSE(MessageUtils::IsControl(MsgType::CUSTOM));
+   EXPECT_FALSE(MessageUtils::IsControl(MsgType::INVALID_MSG_TYPE));
+}
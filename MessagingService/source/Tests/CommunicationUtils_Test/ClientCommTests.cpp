@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <future>
 
 #include "SafeQueue.h"
 
@@ -8,6 +9,7 @@
 #include "ClientComm.h"
 #include "Message.h"
 #include "MessageUtils.h"
+#include "FrameDecoder.h"
 #include "SubscriberMessageListsMock.h"
 
 //disable Inherits Via Dominance warning
@@ -25,6 +27,8 @@ class ClientCommDerived : public ClientComm
 {
 public:
    int _lastMsgKey = 0;
+   //set to false to have SendMsg fail, as when the send queue is full
+   bool _sendSucceeds = true;
    std::vector<CommonMessages::Header> _messagesSent;
    ClientCommDerived(std::shared_ptr<ContextHandler> pContextHandler, std::shared_ptr<ISubscriberMessageLists> pSubscriberMsgListsMock
          , bool trackSentMessages, std::string ipAddress = "localhost", int retryTime = 0)
@@ -37,17 +41,39 @@ public:
    //override to not actually try to send it on the wire
    virtual bool SendMsg(CommonMessages::Header& msg) override
    {
+      if (!_sendSucceeds)
+         return false;
       _lastMsgKey = msg.msgkey();
       _messagesSent.push_back(msg);
       return true;
    }
+   //make it public so we can test it
+   using ClientComm::GetReconnectDelay;
    //override to make it public so we can test it
-   void HandleMessageReceived(std::unique_ptr<CommonMessages::Header> pMsg) override
+   void HandleMessageReceived(CommonMessages::HeaderPtr pMsg) override
    {
       ClientComm::HandleMessageReceived(std::move(pMsg));
    }
 };
 
+//Class that sends on the wire, with received messages injected by the test
+class ClientCommReceiver : public ClientComm
+{
+public:
+   ClientCommReceiver(std::shared_ptr<ContextHandler> pContextHandler, std::string ipAddress, std::string port)
+      : ClientComm(pContextHandler, ipAddress, port, 1, 3, 10000)
+   {
+   }
+   //make them public so we can test them
+   using ClientComm::HandleMessageReceived;
+   using ClientComm::Disconnect;
+   //runs func on the strand, so the test can hold off the handlers queued behind it
+   void PostToStrand(std::function<void()> func)
+   {
+      _strand.post(func);
+   }
+};
+
 //Test Fixture - use TEST_F when using a test fixture
 class ClientCommTest : public testing::Test {
 protected:
@@ -202,7 +228,6 @@ TEST_F(ClientCommTest, SendCommonMsg_WithClientType_CallsAddSentMessage) {
 
    //Mock Expectations
    EXPECT_CALL(*_pSubscriberMessageLists, AddSentMessage(_)).Times(1);
-   EXPECT_CALL(*_pSubscriberMessageLists, GetNeedToAckList(1, 5)).Times(1);
 
    //Test
    pClientComm->SendCommonMsg(Matrix::MsgService::CommonMessages::MsgType::CUSTOM, &msgToSend, 0, 1, 5);
@@ -220,41 +245,6 @@ TEST_F(ClientCommTest, SendCommonMsg_WithoutClientType_DoesNotCallsAddSentMessag
 
    //Mock Expectations
    EXPECT_CALL(*_pSubscriberMessageLists, AddSentMessage(_)).Times(0);
-   EXPECT_CALL(*_pSubscriberMessageLists, GetNeedToAckList(_, _)).Times(0);
-
-   //Test
-   pClientComm->SendCommonMsg(Matrix::MsgService::CommonMessages::MsgType::CUSTOM, &msgToSend, 0, 0, 0);
-
-   //Expectations
-
-   //Cleanup
-   pClientComm = nullptr;
-}
-//Tests SendCommonMsg
-TEST_F(ClientCommTest, SendCommonMsg_WithClientType_CallsRemoveFromNeedsToAckList) {
-   //Setup
-   auto pClientComm = CreateClientComm(true);
-   Matrix::MsgService::CommonMessages::Logon msgToSend;
-
-   //Mock Expectations
-   EXPECT_CALL(*_pSubscriberMessageLists, RemoveFromNeedToAckList(1, 5, _)).Times(1);
-
-   //Test
-   pClientComm->SendCommonMsg(Matrix::MsgService::CommonMessages::MsgType::CUSTOM, &msgToSend, 0, 1, 5);
-
-   //Expectations
-
-   //Cleanup
-   pClientComm = nullptr;
-}
-//Tests SendCommonMsg
-TEST_F(ClientCommTest, SendCommonMsg_WithoutClientType_DoesNotCallRemoveFromNeedsToAckList) {
-   //Setup
-   auto pClientComm = CreateClientComm(true);
-   Matrix::MsgService::CommonMessages::Logon msgToSend;
-
-   //Mock Expectations
-   EXPECT_CALL(*_pSubscriberMessageLists, RemoveFromNeedToAckList(_, _, _)).Times(0);
 
    //Test
    pClientComm->SendCommonMsg(Matrix::MsgService::CommonMessages::MsgType::CUSTOM, &msgToSend, 0, 0, 0);
@@ -475,6 +465,375 @@ TEST_F(ClientCommTest, SendCommonMsgAndWait_InAckKeys_ReturnsMessage) {
    //Cleanup
    pClientComm = nullptr;
 }
+TEST_F(ClientCommTest, SendCommonMsgAndWait_InAckKeyRanges_ReturnsMessage) {
+   //Setup
+   auto pClientComm = CreateClientComm();
+
+   Matrix::Common::CountdownTimer rxCaller;
+   rxCaller.StartTimer(500, [&pClientComm] {
+      auto pMsg = std::unique_ptr<CommonMessages::Header>(new CommonMessages::Header());
+      pMsg->set_msgtypeid(CommonMessages::MsgType::ACK);
+      pMsg->set_origclienttype(1);
+      pMsg->add_ackkeyranges(pClientComm->_lastMsgKey - 5);
+      pMsg->add_ackkeyranges(pClientComm->_lastMsgKey + 5);
+      pClientComm->HandleMessageReceived(std::move(pMsg)); }, true);
+
+   //Test
+   auto pRxMsg = pClientComm->SendCommonMsgAndWait(Matrix::MsgService::CommonMessages::MsgType::CUSTOM, nullptr, 0, 1, 1, 1500);
+
+   //Expectations
+   EXPECT_NE(pRxMsg, nullptr);
+
+   //Cleanup
+   pClientComm = nullptr;
+}
+CommonMessages::HeaderPtr CreateDirectedMsg(int msgKey)
+{
+   auto pMsg = std::unique_ptr<CommonMessages::Header>(new CommonMessages::Header());
+   pMsg->set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+   pMsg->set_origclienttype(2);
+   pMsg->set_origclientid(7);
+   pMsg->set_destclienttype(1);
+   pMsg->set_destclientid(3);
+   pMsg->set_msgkey(msgKey);
+   return pMsg;
+}
+// Tests that by default a message sent to this client is acked as it arrives
+TEST_F(ClientCommTest, HandleMessageReceived_DirectedMsg_AckedImmediately) {
+   //Setup
+   auto pClientComm = CreateClientComm();
+
+   //Test
+   pClientComm->HandleMessageReceived(CreateDirectedMsg(5));
+
+   //Expectations
+   ASSERT_EQ((size_t)1, pClientComm->_messagesSent.size());
+   auto& ackMsg = pClientComm->_messagesSent[0];
+   EXPECT_EQ(CommonMessages::MsgType::ACK, ackMsg.msgtypeid());
+   EXPECT_EQ(5, ackMsg.msgkey());
+   EXPECT_EQ(2, ackMsg.destclienttype());
+   EXPECT_EQ(7, ackMsg.destclientid());
+}
+// Tests that delayed acks go out with the next message sent to the client
+TEST_F(ClientCommTest, HandleMessageReceived_DelayedAcks_PiggybackedOnNextMsg) {
+   //Setup
+   auto pClientComm = CreateClientComm();
+   pClientComm->SetDelayedAcks(10000);
+
+   //Test
+   for (int key = 5; key <= 8; key++)
+      pClientComm->HandleMessageReceived(CreateDirectedMsg(key));
+   EXPECT_EQ((size_t)0, pClientComm->_messagesSent.size());
+   EXPECT_EQ((size_t)4, pClientComm->GetPendingAckCount());
+   pClientComm->SendCommonMsg(CommonMessages::MsgType::CUSTOM, nullptr, 0, 2, 7);
+
+   //Expectations
+   ASSERT_EQ((size_t)1, pClientComm->_messagesSent.size());
+   auto& sentMsg = pClientComm->_messagesSent[0];
+   EXPECT_EQ(CommonMessages::MsgType::CUSTOM, sentMsg.msgtypeid());
+   ASSERT_EQ(2, sentMsg.ackkeyranges_size());
+   EXPECT_EQ(5, sentMsg.ackkeyranges(0));
+   EXPECT_EQ(8, sentMsg.ackkeyranges(1));
+   EXPECT_EQ((size_t)0, pClientComm->GetPendingAckCount());
+}
+// Tests that delayed acks are sent in one ACK message when the max are pending
+TEST_F(ClientCommTest, HandleMessageReceived_DelayedAcks_MaxPending_OneAckMsg) {
+   //Setup
+   auto pClientComm = CreateClientComm();
+   pClientComm->SetDelayedAcks(10000, 3);
+
+   //Test
+   pClientComm->HandleMessageReceived(CreateDirectedMsg(5));
+   pClientComm->HandleMessageReceived(CreateDirectedMsg(9));
+   pClientComm->HandleMessageReceived(CreateDirectedMsg(6));
+
+   //Expectations
+   ASSERT_EQ((size_t)1, pClientComm->_messagesSent.size());
+   auto& ackMsg = pClientComm->_messagesSent[0];
+   EXPECT_EQ(CommonMessages::MsgType::ACK, ackMsg.msgtypeid());
+   EXPECT_EQ(2, ackMsg.destclienttype());
+   EXPECT_EQ(7, ackMsg.destclientid());
+   ASSERT_EQ(3, ackMsg.ackkeys_size());
+   EXPECT_EQ(5, ackMsg.ackkeys(0));
+   EXPECT_EQ(6, ackMsg.ackkeys(1));
+   EXPECT_EQ(9, ackMsg.ackkeys(2));
+}
+// Tests that delayed acks taken for a message that could not be sent are kept for the next one
+TEST_F(ClientCommTest, HandleMessageReceived_DelayedAcks_SendFails_KeptForNextMsg) {
+   //Setup
+   auto pClientComm = CreateClientComm();
+   pClientComm->SetDelayedAcks(10000, 3);
+   pClientComm->_sendSucceeds = false;
+
+   //Test
+   for (int key = 5; key <= 7; key++)
+      pClientComm->HandleMessageReceived(CreateDirectedMsg(key));
+   pClientComm->SendCommonMsg(CommonMessages::MsgType::CUSTOM, nullptr, 0, 2, 7);
+   EXPECT_EQ((size_t)3, pClientComm->GetPendingAckCount());
+   pClientComm->_sendSucceeds = true;
+   pClientComm->SendCommonMsg(CommonMessages::MsgType::CUSTOM, nullptr, 0, 2, 7);
+
+   //Expectations
+   ASSERT_EQ((size_t)1, pClientComm->_messagesSent.size());
+   auto& sentMsg = pClientComm->_messagesSent[0];
+   ASSERT_EQ(2, sentMsg.ackkeyranges_size());
+   EXPECT_EQ(5, sentMsg.ackkeyranges(0));
+   EXPECT_EQ(7, sentMsg.ackkeyranges(1));
+   EXPECT_EQ((size_t)0, pClientComm->GetPendingAckCount());
+}
+// Tests that delayed acks are sent in one ACK message after the delay
+TEST_F(ClientCommTest, HandleMessageReceived_DelayedAcks_FlushedAfterDelay) {
+   //Setup
+   auto pClientComm = CreateClientComm();
+   pClientComm->SetDelayedAcks(50);
+
+   //Test
+   pClientComm->HandleMessageReceived(CreateDirectedMsg(5));
+   pClientComm->HandleMessageReceived(CreateDirectedMsg(6));
+   for (int wait = 0; wait < 100 && pClientComm->GetPendingAckCount() > 0; wait++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+   //Expectations
+   ASSERT_EQ((size_t)1, pClientComm->_messagesSent.size());
+   auto& ackMsg = pClientComm->_messagesSent[0];
+   EXPECT_EQ(CommonMessages::MsgType::ACK, ackMsg.msgtypeid());
+   ASSERT_EQ(2, ackMsg.ackkeys_size());
+   EXPECT_EQ(5, ackMsg.ackkeys(0));
+   EXPECT_EQ(6, ackMsg.ackkeys(1));
+}
+// Tests that the reconnect delay doubles for each failure, with the upper half randomized
+TEST_F(ClientCommTest, GetReconnectDelay_DoublesWithJitter) {
+   //Setup
+   auto pClientComm = CreateClientComm(false, "localhost", 100);
+
+   //Test/Expectations
+   for (int numFailures = 0; numFailures < 4; numFailures++)
+   {
+      uint32_t fullDelayMS = 100u << numFailures;
+      for (int index = 0; index < 50; index++)
+      {
+         auto delayMS = pClientComm->GetReconnectDelay(numFailures);
+         EXPECT_GE(delayMS, fullDelayMS / 2);
+         EXPECT_LE(delayMS, fullDelayMS);
+      }
+   }
+
+   //Cleanup
+   pClientComm = nullptr;
+}
+// Tests that the reconnect delay does not go past the max reconnect retry time
+TEST_F(ClientCommTest, GetReconnectDelay_LimitedToMax) {
+   //Setup
+   auto pClientComm = CreateClientComm(false, "localhost", 100);
+   pClientComm->SetMaxReconnectRetryTime(1000);
+
+   //Test
+   auto delayMS = pClientComm->GetReconnectDelay(40);
+
+   //Expectations
+   EXPECT_GE(delayMS, 500u);
+   EXPECT_LE(delayMS, 1000u);
+
+   //Cleanup
+   pClientComm = nullptr;
+}
+// Tests that connecting to a port nobody is listening on reports CouldNotConnect
+TEST_F(ClientCommTest, Connect_NothingListening_CouldNotConnect) {
+   //Setup
+   boost::asio::io_context ioContext;
+   std::string port;
+   {
+      tcp::acceptor acceptor(ioContext, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+      port = std::to_string(acceptor.local_endpoint().port());
+   }
+   auto pClientComm = std::make_shared<ClientComm>(_pContextHandler, "127.0.0.1", port, 1, 3);
+   CallbackClass callback;
+   auto connection = pClientComm->AddSocketStateChangeObserver(std::bind(&CallbackClass::HandleStatusChange, &callback
+         , std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+
+   //Test
+   pClientComm->Connect();
+
+   //Expectations
+   CallbackClass::Info info;
+   bool disconnected = false;
+   while (!disconnected && callback._statusChangeList.Dequeue(info, 2000))
+      disconnected = (info.newState == SocketState::Disconnected);
+   EXPECT_TRUE(disconnected);
+   EXPECT_EQ(DisconnectReason::CouldNotConnect, info.reason);
+
+   //Cleanup
+   pClientComm->ShutDown();
+   pClientComm = nullptr;
+}
+// Tests that the connect completes asynchronously when the server is listening
+TEST_F(ClientCommTest, Connect_ServerListening_Connects) {
+   //Setup
+   boost::asio::io_context ioContext;
+   tcp::acceptor acceptor(ioContext, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+   auto port = std::to_string(acceptor.local_endpoint().port());
+   auto pClientComm = std::make_shared<ClientComm>(_pContextHandler, "127.0.0.1", port, 1, 3);
+   CallbackClass callback;
+   auto connection = pClientComm->AddSocketStateChangeObserver(std::bind(&CallbackClass::HandleStatusChange, &callback
+         , std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+
+   //Test
+   pClientComm->Connect();
+
+   //Expectations
+   CallbackClass::Info info;
+   bool connected = false;
+   while (!connected && callback._statusChangeList.Dequeue(info, 2000))
+      connected = (info.newState == SocketState::Connected);
+   EXPECT_TRUE(connected);
+
+   //Cleanup
+   pClientComm->ShutDown();
+   pClientComm = nullptr;
+}
+// Tests that a connected client with liveness set heartbeats an idle server and drops it once nothing has been received
+TEST_F(ClientCommTest, Connect_Liveness_HeartbeatsThenServerNotResponding) {
+   //Setup
+   boost::asio::io_context ioContext;
+   tcp::acceptor acceptor(ioContext, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+   auto port = std::to_string(acceptor.local_endpoint().port());
+   auto pClientComm = std::make_shared<ClientComm>(_pContextHandler, "127.0.0.1", port, 1, 3, 10000);
+   pClientComm->SetLiveness(50, 300);
+   CallbackClass callback;
+   auto connection = pClientComm->AddSocketStateChangeObserver(std::bind(&CallbackClass::HandleStatusChange, &callback
+         , std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+
+   //Test
+   pClientComm->Connect();
+   tcp::socket peerSocket(ioContext);
+   acceptor.accept(peerSocket);
+
+   //Expectations
+   CallbackClass::Info info;
+   bool disconnected = false;
+   while (!disconnected && callback._statusChangeList.Dequeue(info, 2000))
+      disconnected = (info.newState == SocketState::Disconnected);
+   ASSERT_TRUE(disconnected);
+   EXPECT_EQ(DisconnectReason::ServerNotResponding, info.reason);
+   //the server never answered, so everything after the logon should be heartbeats (0 size frames)
+   CommonMessages::FrameDecoder decoder;
+   boost::system::error_code ec;
+   int heartbeats = 0;
+   while (!ec)
+   {
+      auto bytes = peerSocket.read_some(boost::asio::buffer(decoder.GetWriteBuffer(), decoder.GetWriteSpace()), ec);
+      decoder.Commit(bytes);
+      const char* pData;
+      uint32_t size;
+      while (decoder.NextFrame(&pData, &size) == CommonMessages::FrameDecoder::FrameStatus::Complete)
+      {
+         if (size == 0)
+            heartbeats++;
+      }
+   }
+   EXPECT_GE(heartbeats, 2);
+
+   //Cleanup
+   pClientComm->ShutDown();
+   pClientComm = nullptr;
+}
+// Tests that delayed acks owed on a connection the peer drops are not carried over to the next connection
+TEST_F(ClientCommTest, Connect_PeerDisconnects_ClearsDelayedAcks) {
+   //Setup
+   boost::asio::io_context ioContext;
+   tcp::acceptor acceptor(ioContext, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+   auto port = std::to_string(acceptor.local_endpoint().port());
+   auto pClientComm = std::make_shared<ClientCommReceiver>(_pContextHandler, "127.0.0.1", port);
+   pClientComm->SetDelayedAcks(10000);
+   CallbackClass callback;
+   auto connection = pClientComm->AddSocketStateChangeObserver(std::bind(&CallbackClass::HandleStatusChange, &callback
+         , std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+   pClientComm->Connect();
+   tcp::socket peerSocket(ioContext);
+   acceptor.accept(peerSocket);
+   CallbackClass::Info info;
+   bool connected = false;
+   while (!connected && callback._statusChangeList.Dequeue(info, 2000))
+      connected = (info.newState == SocketState::Connected);
+   ASSERT_TRUE(connected);
+   pClientComm->HandleMessageReceived(CreateDirectedMsg(5));
+   ASSERT_EQ((size_t)1, pClientComm->GetPendingAckCount());
+
+   //Test
+   peerSocket.close();
+
+   //Expectations
+   bool disconnected = false;
+   while (!disconnected && callback._statusChangeList.Dequeue(info, 2000))
+      disconnected = (info.newState == SocketState::Disconnected);
+   ASSERT_TRUE(disconnected);
+   EXPECT_EQ((size_t)0, pClientComm->GetPendingAckCount());
+
+   //Cleanup
+   pClientComm->ShutDown();
+   pClientComm = nullptr;
+}
+// Tests that delayed acks flushed while the connection is dropping are kept rather than queued to be thrown away
+TEST_F(ClientCommTest, FlushAcks_ConnectionDropping_KeysNotQueued) {
+   //Setup
+   boost::asio::io_context ioContext;
+   tcp::acceptor acceptor(ioContext, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+   auto port = std::to_string(acceptor.local_endpoint().port());
+   auto pClientComm = std::make_shared<ClientCommReceiver>(_pContextHandler, "127.0.0.1", port);
+   pClientComm->SetDelayedAcks(10000);
+   CallbackClass callback;
+   auto connection = pClientComm->AddSocketStateChangeObserver(std::bind(&CallbackClass::HandleStatusChange, &callback
+         , std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+   pClientComm->Connect();
+   tcp::socket peerSocket(ioContext);
+   acceptor.accept(peerSocket);
+   CallbackClass::Info info;
+   bool connected = false;
+   while (!connected && callback._statusChangeList.Dequeue(info, 2000))
+      connected = (info.newState == SocketState::Connected);
+   ASSERT_TRUE(connected);
+   pClientComm->HandleMessageReceived(CreateDirectedMsg(5));
+   //hold the strand so the disconnect has started but not finished when the acks are flushed
+   std::promise<void> release;
+   std::shared_future<void> released = release.get_future().share();
+   pClientComm->PostToStrand([released]() { released.wait(); });
+   pClientComm->Disconnect(DisconnectReason::ServerNotResponding);
+
+   //Test
+   pClientComm->FlushAcks();
+
+   //Expectations
+   EXPECT_EQ((size_t)1, pClientComm->GetPendingAckCount());
+   release.set_value();
+   bool disconnected = false;
+   while (!disconnected && callback._statusChangeList.Dequeue(info, 2000))
+      disconnected = (info.newState == SocketState::Disconnected);
+   ASSERT_TRUE(disconnected);
+   EXPECT_EQ((size_t)0, pClientComm->GetPendingAckCount());
+   //only the logon was sent
+   CommonMessages::FrameDecoder decoder;
+   boost::system::error_code ec;
+   int acks = 0;
+   while (!ec)
+   {
+      auto bytes = peerSocket.read_some(boost::asio::buffer(decoder.GetWriteBuffer(), decoder.GetWriteSpace()), ec);
+      decoder.Commit(bytes);
+      const char* pData;
+      uint32_t size;
+      while (decoder.NextFrame(&pData, &size) == CommonMessages::FrameDecoder::FrameStatus::Complete)
+      {
+         CommonMessages::Header msg;
+         if (size > 0 && msg.ParseFromArray(pData, (int)size) && msg.msgtypeid() == CommonMessages::MsgType::ACK)
+            acks++;
+      }
+   }
+   EXPECT_EQ(0, acks);
+
+   //Cleanup
+   pClientComm->ShutDown();
+   pClientComm = nullptr;
+}
 #ifdef _WIN32
 #pragma warning( pop )
 #endif
@@ -0,0 +1,639 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <set>
+#include <atomic>
+
+#include "ContextHandler.h"
+#include "CommHandler.h"
+#include "Message.h"
+#include "FrameDecoder.h"
+
+//disable Inherits Via Dominance warning
+#ifdef _WIN32
+#pragma warning( push )
+#pragma warning( disable: 4250)
+#endif
+
+using namespace Matrix::Common;
+using namespace Matrix::MsgService::CommunicationUtils;
+using namespace Matrix::MsgService;
+
+//Test Fixture - connects a CommHandler to a raw socket over loopback
+class CommHandlerTest : public testing::Test {
+protected:
+   std::shared_ptr<ContextHandler> _pContextHandler = nullptr;
+   std::shared_ptr<CommHandler> _pCommHandler = nullptr;
+   std::unique_ptr<boost::asio::io_context> _pPeerContext;
+   std::unique_ptr<tcp::socket> _pPeerSocket;
+   uint32_t _heartbeatIntervalMS = 0;
+   uint32_t _idleTimeoutMS = 0;
+
+   virtual void SetUp()
+   {
+#ifdef USING_SSL
+      boost::asio::ssl::context sslContext(boost::asio::ssl::context::sslv23);
+      _pContextHandler = std::make_shared<ContextHandler>(sslContext);
+#else
+      _pContextHandler = std::make_shared<ContextHandler>();
+#endif
+      _pContextHandler->StartThread();
+      _pPeerContext.reset(new boost::asio::io_context());
+      tcp::acceptor acceptor(*_pPeerContext, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+      _pCommHandler = std::make_shared<CommHandler>(_pContextHandler, "CommHandlerTest");
+      _pCommHandler->GetSocket()->lowest_layer().connect(acceptor.local_endpoint());
+      _pPeerSocket.reset(new tcp::socket(*_pPeerContext));
+      acceptor.accept(*_pPeerSocket);
+      _pCommHandler->SetLiveness(_heartbeatIntervalMS, _idleTimeoutMS);
+      _pCommHandler->Run();
+   }
+   virtual void TearDown()
+   {
+      _pCommHandler->ShutDown();
+      _pCommHandler = nullptr;
+      _pPeerSocket = nullptr;
+      _pContextHandler->ShutDown();
+      _pContextHandler->WaitForShutdown(10, 10);
+      _pContextHandler = nullptr;
+   }
+public:
+   //Reads frames from the peer socket until count messages have been received
+   std::vector<CommonMessages::Header> ReadMessages(size_t count)
+   {
+      std::vector<CommonMessages::Header> msgs;
+      CommonMessages::FrameDecoder decoder;
+      boost::system::error_code ec;
+      while (msgs.size() < count && !ec)
+      {
+         auto pBuffer = decoder.GetWriteBuffer();
+         auto bytes = _pPeerSocket->read_some(boost::asio::buffer(pBuffer, decoder.GetWriteSpace()), ec);
+         decoder.Commit(bytes);
+         const char* pData;
+         uint32_t size;
+         while (decoder.NextFrame(&pData, &size) == CommonMessages::FrameDecoder::FrameStatus::Complete)
+         {
+            CommonMessages::Header msg;
+            EXPECT_TRUE(msg.ParseFromArray(pData, (int)size));
+            msgs.push_back(msg);
+         }
+      }
+      return msgs;
+   }
+   //Writes a heartbeat (0 size frame) from the peer
+   void SendPeerHeartbeat()
+   {
+      char heartbeat[CommonMessages::HDR_SIZE] = { 0 };
+      boost::asio::write(*_pPeerSocket, boost::asio::buffer(heartbeat, sizeof(heartbeat)));
+   }
+   //Sends a message large enough that the socket buffers cannot hold it
+   bool SendLargeMsg(int key, const CommonMessages::SubscriptionParams* pSource = nullptr)
+   {
+      return SendSizedMsg(key, LARGE_MSG_SIZE, pSource);
+   }
+   //Sends a message to queue behind the blocked write; only message 0 needs to be large
+   bool SendSmallMsg(int key, const CommonMessages::SubscriptionParams* pSource = nullptr)
+   {
+      return SendSizedMsg(key, SMALL_MSG_SIZE, pSource);
+   }
+   bool SendSizedMsg(int key, size_t size, const CommonMessages::SubscriptionParams* pSource)
+   {
+      CommonMessages::Header msg;
+      msg.set_msgkey(key);
+      msg.set_msg(std::string(size, 'x'));
+      auto pFrame = CommonMessages::EncodedFrame::Create(msg);
+      return (pSource == nullptr) ? _pCommHandler->SendFrame(pFrame) : _pCommHandler->SendPublishedFrame(pFrame, *pSource);
+   }
+   //Limits the socket buffers and sends message 0, which stays being written until the peer reads
+   void StartBlockedWrite()
+   {
+      _pPeerSocket->set_option(asio::socket_base::receive_buffer_size(PEER_RECEIVE_BUFFER_SIZE));
+      _pCommHandler->GetSocket()->lowest_layer().set_option(asio::socket_base::send_buffer_size(SEND_BUFFER_SIZE));
+      SendLargeMsg(0);
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      //still being written
+      EXPECT_EQ(1, _pCommHandler->GetSendQueueDepth());
+   }
+   //a message is several times what the limited socket buffers hold, so writing one blocks.  The peer's receive
+   //buffer is kept above a loopback segment: with less, it only reopens its window to the 200 ms zero window
+   //probes and draining a few messages takes seconds
+   static const size_t LARGE_MSG_SIZE = 256 * 1024;
+   static const size_t SMALL_MSG_SIZE = 1024;
+   static const int PEER_RECEIVE_BUFFER_SIZE = 64 * 1024;
+   static const int SEND_BUFFER_SIZE = 4096;
+   //Waits up to timeoutMS for condition to become true
+   template<class Condition>
+   bool WaitFor(Condition condition, int timeoutMS)
+   {
+      for (int waited = 0; waited < timeoutMS && !condition(); waited += 5)
+         std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      return condition();
+   }
+};
+
+//Test Fixture - as CommHandlerTest with liveness detection enabled
+class CommHandlerLivenessTest : public CommHandlerTest {
+protected:
+   CommHandlerLivenessTest()
+   {
+      _heartbeatIntervalMS = 50;
+      _idleTimeoutMS = 250;
+   }
+};
+
+//Test Fixture - as CommHandlerTest with a heartbeat interval longer than the tests, so the
+//only heartbeats sent are replies
+class CommHandlerHeartbeatTest : public CommHandlerTest {
+protected:
+   CommHandlerHeartbeatTest()
+   {
+      _heartbeatIntervalMS = 5000;
+   }
+};
+
+//Test Fixture - two CommHandlers connected to each other over loopback
+class CommHandlerPairTest : public testing::Test {
+protected:
+   std::shared_ptr<ContextHandler> _pContextHandler = nullptr;
+   std::shared_ptr<CommHandler> _pConnecting = nullptr;
+   std::shared_ptr<CommHandler> _pAccepted = nullptr;
+
+   virtual void SetUp()
+   {
+#ifdef USING_SSL
+      boost::asio::ssl::context sslContext(boost::asio::ssl::context::sslv23);
+      _pContextHandler = std::make_shared<ContextHandler>(sslContext);
+#else
+      _pContextHandler = std::make_shared<ContextHandler>();
+#endif
+      _pContextHandler->StartThread();
+      boost::asio::io_context acceptContext;
+      tcp::acceptor acceptor(acceptContext, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+      _pConnecting = std::make_shared<CommHandler>(_pContextHandler, "Connecting");
+      _pAccepted = std::make_shared<CommHandler>(_pContextHandler, "Accepted");
+      _pConnecting->GetSocket()->lowest_layer().connect(acceptor.local_endpoint());
+      acceptor.accept(_pAccepted->GetSocket()->lowest_layer());
+   }
+   virtual void TearDown()
+   {
+      _pConnecting->ShutDown();
+      _pAccepted->ShutDown();
+      _pConnecting = nullptr;
+      _pAccepted = nullptr;
+      _pContextHandler->ShutDown();
+      _pContextHandler->WaitForShutdown(10, 10);
+      _pContextHandler = nullptr;
+   }
+public:
+   //Runs both sides with the given heartbeat intervals and no idle timeout, leaves the link idle for
+   //durationMS, and returns the number of heartbeats sent by both sides
+   int64_t RunIdle(uint32_t connectingIntervalMS, uint32_t acceptedIntervalMS, int durationMS)
+   {
+      _pConnecting->SetLiveness(connectingIntervalMS, 0);
+      _pAccepted->SetLiveness(acceptedIntervalMS, 0);
+      _pAccepted->Run();
+      _pConnecting->Run();
+      std::this_thread::sleep_for(std::chrono::milliseconds(durationMS));
+      return _pConnecting->GetHeartbeatSendCount() + _pAccepted->GetHeartbeatSendCount();
+   }
+};
+
+// Tests that messages sent from several threads at once all arrive intact
+TEST_F(CommHandlerTest, SendMsg_ConcurrentSenders_AllFramesIntact) {
+   //Setup
+   const int numThreads = 4;
+   const int msgsPerThread = 250;
+
+   //Test
+   std::vector<std::thread> senders;
+   for (int thread = 0; thread < numThreads; thread++)
+   {
+      senders.push_back(std::thread([this, thread, msgsPerThread]()
+      {
+         for (int index = 0; index < msgsPerThread; index++)
+         {
+            CommonMessages::Header msg;
+            msg.set_msgkey(thread * msgsPerThread + index);
+            msg.set_msg(std::string(100 + index, (char)('a' + thread)));
+            _pCommHandler->SendMsg(msg);
+         }
+      }));
+   }
+   for (auto& sender : senders)
+      sender.join();
+   auto msgs = ReadMessages(numThreads * msgsPerThread);
+
+   //Expectations
+   ASSERT_EQ((size_t)(numThreads * msgsPerThread), msgs.size());
+   std::set<int> keys;
+   for (auto& msg : msgs)
+   {
+      auto thread = msg.msgkey() / msgsPerThread;
+      auto index = msg.msgkey() % msgsPerThread;
+      EXPECT_EQ(std::string(100 + index, (char)('a' + thread)), msg.msg());
+      keys.insert(msg.msgkey());
+   }
+   EXPECT_EQ((size_t)(numThreads * msgsPerThread), keys.size());
+}
+
+// Tests that messages from a single sender arrive in order
+TEST_F(CommHandlerTest, SendMsg_SingleSender_KeepsOrder) {
+   //Setup
+   const int numMsgs = 500;
+
+   //Test
+   for (int index = 0; index < numMsgs; index++)
+   {
+      CommonMessages::Header msg;
+      msg.set_msgkey(index);
+      _pCommHandler->SendMsg(msg);
+   }
+   auto msgs = ReadMessages(numMsgs);
+
+   //Expectations
+   ASSERT_EQ((size_t)numMsgs, msgs.size());
+   for (int index = 0; index < numMsgs; index++)
+      EXPECT_EQ(index, msgs[index].msgkey());
+}
+
+// Tests that the send queue is empty once everything has been written
+TEST_F(CommHandlerTest, GetSendQueueDepth_AfterWritesComplete_IsZero) {
+   //Setup
+   CommonMessages::Header msg;
+   msg.set_msgkey(1);
+
+   //Test
+   _pCommHandler->SendMsg(msg);
+   _pCommHandler->SendHeartbeat();
+   ReadMessages(2);
+   for (int retry = 0; retry < 100 && _pCommHandler->GetSendQueueDepth() > 0; retry++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+   //Expectations
+   EXPECT_EQ(0, _pCommHandler->GetSendQueueDepth());
+   EXPECT_EQ(0, _pCommHandler->GetSendQueueBytes());
+}
+
+// Tests that without a heartbeat interval every heartbeat received is echoed
+TEST_F(CommHandlerTest, HandleHeartbeatReceived_NoInterval_Echoes) {
+   //Setup
+   CommonMessages::Header msg;
+   msg.set_msgkey(1);
+
+   //Test
+   SendPeerHeartbeat();
+   ASSERT_TRUE(WaitFor([this]() { return _pCommHandler->GetHeartbeatSendCount() == 1; }, 1000));
+   _pCommHandler->SendMsg(msg);
+   SendPeerHeartbeat();
+
+   //Expectations
+   EXPECT_TRUE(WaitFor([this]() { return _pCommHandler->GetHeartbeatSendCount() == 2; }, 1000));
+   EXPECT_EQ(2, _pCommHandler->GetHeartbeatRxCount());
+   EXPECT_EQ((size_t)3, ReadMessages(3).size());
+}
+
+// Tests that a heartbeat is not answered when something was sent within the heartbeat interval
+TEST_F(CommHandlerHeartbeatTest, HandleHeartbeatReceived_AfterSending_DoesNotReply) {
+   //Setup
+   CommonMessages::Header msg;
+   msg.set_msgkey(1);
+   _pCommHandler->SendMsg(msg);
+
+   //Test
+   SendPeerHeartbeat();
+
+   //Expectations
+   ASSERT_TRUE(WaitFor([this]() { return _pCommHandler->GetHeartbeatRxCount() == 1; }, 1000));
+   EXPECT_EQ(0, _pCommHandler->GetHeartbeatSendCount());
+}
+
+// Tests that a peer that sends nothing is disconnected as not responding
+TEST_F(CommHandlerLivenessTest, IdlePeer_DisconnectsNotResponding) {
+   //Setup
+   std::atomic<int> reason(-1);
+   auto connection = _pCommHandler->AddSocketStateChangeObserver([&reason](SocketState, SocketState newState, DisconnectReason disconnectReason)
+   {
+      if (newState == SocketState::Disconnected)
+         reason = (int)disconnectReason;
+   });
+
+   //Test
+   auto disconnected = WaitFor([&reason]() { return reason >= 0; }, 2000);
+
+   //Expectations
+   ASSERT_TRUE(disconnected);
+   EXPECT_EQ((int)DisconnectReason::ServerNotResponding, reason);
+   EXPECT_LE(1, _pCommHandler->GetHeartbeatSendCount());
+   connection.disconnect();
+}
+
+// Tests that a peer that keeps sending heartbeats stays connected
+TEST_F(CommHandlerLivenessTest, HeartbeatingPeer_StaysConnected) {
+   //Test
+   for (int index = 0; index < 20; index++)
+   {
+      SendPeerHeartbeat();
+      std::this_thread::sleep_for(std::chrono::milliseconds(30));
+   }
+
+   //Expectations
+   EXPECT_TRUE(_pCommHandler->IsConnected());
+}
+
+// Tests that no heartbeats are sent while messages are flowing both ways
+TEST_F(CommHandlerLivenessTest, BusyLink_SuppressesHeartbeats) {
+   //Setup
+   CommonMessages::Header msg;
+   msg.set_msgkey(1);
+   auto peerMsg = msg.SerializeAsString();
+   char prefix[CommonMessages::HDR_SIZE] = { (char)peerMsg.size(), 0, 0, 0 };
+
+   //Test
+   for (int index = 0; index < 30; index++)
+   {
+      _pCommHandler->SendMsg(msg);
+      boost::asio::write(*_pPeerSocket, std::vector<boost::asio::const_buffer>({ boost::asio::buffer(prefix, sizeof(prefix)), boost::asio::buffer(peerMsg) }));
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   }
+
+   //Expectations
+   EXPECT_TRUE(_pCommHandler->IsConnected());
+   EXPECT_EQ(0, _pCommHandler->GetHeartbeatSendCount());
+}
+
+// Tests that on an idle link where only one side heartbeats, the other side's echoes are not answered
+TEST_F(CommHandlerPairTest, IdleLink_OneSideHeartbeats_OneExchangePerInterval) {
+   //Test
+   auto heartbeats = RunIdle(50, 0, 1000);
+
+   //Expectations - a heartbeat and its echo every 50 ms
+   EXPECT_LE(heartbeats, 2 * (1000 / 50) + 4);
+   EXPECT_LE(_pAccepted->GetHeartbeatSendCount(), _pConnecting->GetHeartbeatSendCount());
+   EXPECT_TRUE(_pConnecting->IsConnected());
+}
+
+// Tests that on an idle link where both sides heartbeat, replies are not answered
+TEST_F(CommHandlerPairTest, IdleLink_BothSidesHeartbeat_OneExchangePerInterval) {
+   //Test
+   auto heartbeats = RunIdle(50, 50, 1000);
+
+   //Expectations - at most a heartbeat from each side every 50 ms
+   EXPECT_LE(heartbeats, 2 * (1000 / 50) + 4);
+   EXPECT_LE(1000 / 50 / 2, heartbeats);
+   EXPECT_TRUE(_pConnecting->IsConnected());
+}
+
+// Tests that with DropNewest the frames over the limit are discarded and the earlier ones delivered
+TEST_F(CommHandlerTest, SendFrame_DropNewestOverLimit_DiscardsNewFrames) {
+   //Setup
+   _pCommHandler->SetSendQueueLimits(SendQueueLimits(4, 0, SlowConsumerPolicy::DropNewest));
+   StartBlockedWrite();
+
+   //Test
+   int numQueued = 1;
+   for (int index = 1; index < 10; index++)
+      numQueued += SendSmallMsg(index) ? 1 : 0;
+
+   //Expectations
+   EXPECT_EQ(4, numQueued);
+   EXPECT_EQ(4, _pCommHandler->GetSendQueueDepth());
+   EXPECT_EQ(6, _pCommHandler->GetDroppedFrameCount());
+   auto msgs = ReadMessages(4);
+   ASSERT_EQ((size_t)4, msgs.size());
+   for (int index = 0; index < 4; index++)
+      EXPECT_EQ(index, msgs[index].msgkey());
+}
+
+// Tests that with DropOldest the oldest queued frames are discarded, never the one being written
+TEST_F(CommHandlerTest, SendFrame_DropOldestOverLimit_DiscardsOldestQueued) {
+   //Setup
+   _pCommHandler->SetSendQueueLimits(SendQueueLimits(4, 0, SlowConsumerPolicy::DropOldest));
+   StartBlockedWrite();
+
+   //Test
+   for (int index = 1; index < 10; index++)
+      EXPECT_TRUE(SendSmallMsg(index));
+
+   //Expectations
+   EXPECT_EQ(4, _pCommHandler->GetSendQueueDepth());
+   EXPECT_EQ(6, _pCommHandler->GetDroppedFrameCount());
+   auto msgs = ReadMessages(4);
+   ASSERT_EQ((size_t)4, msgs.size());
+   EXPECT_EQ(0, msgs[0].msgkey());
+   EXPECT_EQ(7, msgs[1].msgkey());
+   EXPECT_EQ(8, msgs[2].msgkey());
+   EXPECT_EQ(9, msgs[3].msgkey());
+}
+
+// Tests that with Conflate a frame over the limit replaces the queued frame from the same source in place
+TEST_F(CommHandlerTest, SendPublishedFrame_ConflateOverLimit_ReplacesSameSource) {
+   //Setup
+   _pCommHandler->SetSendQueueLimits(SendQueueLimits(3, 0, SlowConsumerPolicy::Conflate));
+   CommonMessages::SubscriptionParams source1(1, 1, 5);
+   CommonMessages::SubscriptionParams source2(1, 2, 5);
+   StartBlockedWrite();
+   SendSmallMsg(1, &source1);
+   SendSmallMsg(2, &source2);
+
+   //Test
+   EXPECT_TRUE(SendSmallMsg(3, &source1));
+   EXPECT_TRUE(SendSmallMsg(4, &source1));
+
+   //Expectations
+   EXPECT_EQ(3, _pCommHandler->GetSendQueueDepth());
+   EXPECT_EQ(2, _pCommHandler->GetConflatedFrameCount());
+   EXPECT_EQ(0, _pCommHandler->GetDroppedFrameCount());
+   auto msgs = ReadMessages(3);
+   ASSERT_EQ((size_t)3, msgs.size());
+   EXPECT_EQ(0, msgs[0].msgkey());
+   EXPECT_EQ(4, msgs[1].msgkey());
+   EXPECT_EQ(2, msgs[2].msgkey());
+}
+
+// Tests that a published frame on a conflated topic replaces the unsent frame from the same source, within the limits
+TEST_F(CommHandlerTest, SendPublishedFrame_ConflatedTopic_ReplacesUnsentFrame) {
+   //Setup
+   SendQueueLimits limits;
+   limits._pConflatedTopics = std::make_shared<std::unordered_set<int>>(std::unordered_set<int>({ 5 }));
+   _pCommHandler->SetSendQueueLimits(limits);
+   CommonMessages::SubscriptionParams conflated(1, 1, 5);
+   CommonMessages::SubscriptionParams notConflated(1, 1, 6);
+   StartBlockedWrite();
+
+   //Test
+   SendSmallMsg(1, &conflated);
+   SendSmallMsg(2, &notConflated);
+   SendSmallMsg(3, &conflated);
+   SendSmallMsg(4, &notConflated);
+   SendSmallMsg(5, &conflated);
+
+   //Expectations
+   EXPECT_EQ(4, _pCommHandler->GetSendQueueDepth());
+   EXPECT_EQ(5, _pCommHandler->GetPublishedFrameCount());
+   EXPECT_EQ(2, _pCommHandler->GetConflatedFrameCount());
+   auto msgs = ReadMessages(4);
+   ASSERT_EQ((size_t)4, msgs.size());
+   EXPECT_EQ(0, msgs[0].msgkey());
+   EXPECT_EQ(5, msgs[1].msgkey());
+   EXPECT_EQ(2, msgs[2].msgkey());
+   EXPECT_EQ(4, msgs[3].msgkey());
+}
+
+// Tests that priority frames are written ahead of bulk frames queued before them
+TEST_F(CommHandlerTest, SendMsg_PriorityBehindBulkBacklog_WrittenFirst) {
+   //Setup
+   StartBlockedWrite();
+   SendSmallMsg(1);
+   SendSmallMsg(2);
+   CommonMessages::Header ackMsg;
+   ackMsg.set_msgtypeid(CommonMessages::MsgType::ACK);
+   ackMsg.set_msgkey(100);
+   CommonMessages::Header urgentMsg;
+   urgentMsg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+   urgentMsg.set_msgkey(101);
+   urgentMsg.set_priority(1);
+
+   //Test
+   EXPECT_TRUE(_pCommHandler->SendMsg(ackMsg));
+   EXPECT_TRUE(_pCommHandler->SendMsg(urgentMsg));
+
+   //Expectations
+   EXPECT_EQ(2, _pCommHandler->GetPriorityFrameCount());
+   auto msgs = ReadMessages(5);
+   ASSERT_EQ((size_t)5, msgs.size());
+   EXPECT_EQ(0, msgs[0].msgkey());
+   EXPECT_EQ(100, msgs[1].msgkey());
+   EXPECT_EQ(101, msgs[2].msgkey());
+   EXPECT_EQ(1, msgs[3].msgkey());
+   EXPECT_EQ(2, msgs[4].msgkey());
+}
+
+// Tests that control frames are queued even when bulk frames are being dropped to keep within the limits
+TEST_F(CommHandlerTest, SendMsg_ControlOverLimit_StillQueued) {
+   //Setup
+   _pCommHandler->SetSendQueueLimits(SendQueueLimits(2, 0, SlowConsumerPolicy::DropNewest));
+   StartBlockedWrite();
+   SendSmallMsg(1);
+   CommonMessages::Header ackMsg;
+   ackMsg.set_msgtypeid(CommonMessages::MsgType::ACK);
+   ackMsg.set_msgkey(100);
+
+   //Test
+   EXPECT_FALSE(SendSmallMsg(2));
+   EXPECT_TRUE(_pCommHandler->SendMsg(ackMsg));
+
+   //Expectations
+   EXPECT_EQ(3, _pCommHandler->GetSendQueueDepth());
+   EXPECT_EQ(1, _pCommHandler->GetDroppedFrameCount());
+   auto msgs = ReadMessages(3);
+   ASSERT_EQ((size_t)3, msgs.size());
+   EXPECT_EQ(0, msgs[0].msgkey());
+   EXPECT_EQ(100, msgs[1].msgkey());
+   EXPECT_EQ(1, msgs[2].msgkey());
+}
+
+// Tests that application priority frames count toward the limits, so flooding a stalled peer with them
+// disconnects it as a slow consumer
+TEST_F(CommHandlerTest, SendMsg_PriorityFloodOverLimit_DisconnectsSlowConsumer) {
+   //Setup
+   std::atomic<int> reason(-1);
+   auto connection = _pCommHandler->AddSocketStateChangeObserver([&reason](SocketState, SocketState newState, DisconnectReason disconnectReason)
+   {
+      if (newState == SocketState::Disconnected)
+         reason = (int)disconnectReason;
+   });
+   _pCommHandler->SetSendQueueLimits(SendQueueLimits(10, 0, SlowConsumerPolicy::Disconnect));
+   StartBlockedWrite();
+   CommonMessages::Header urgentMsg;
+   urgentMsg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+   urgentMsg.set_priority(1);
+   urgentMsg.set_msg(std::string(1000, 'x'));
+
+   //Test
+   int queued = 0;
+   for (int index = 0; index < 100; index++)
+   {
+      urgentMsg.set_msgkey(index + 1);
+      if (_pCommHandler->SendMsg(urgentMsg))
+         queued++;
+   }
+
+   //Expectations
+   EXPECT_GT(100, queued);
+   ASSERT_TRUE(WaitFor([&reason]() { return reason >= 0; }, 2000));
+   EXPECT_EQ((int)DisconnectReason::SlowConsumer, reason);
+   connection.disconnect();
+}
+
+// Tests that with DropNewest application priority frames over the limit are discarded
+TEST_F(CommHandlerTest, SendMsg_PriorityFloodOverLimit_DropsNewest) {
+   //Setup
+   _pCommHandler->SetSendQueueLimits(SendQueueLimits(10, 0, SlowConsumerPolicy::DropNewest));
+   StartBlockedWrite();
+   CommonMessages::Header urgentMsg;
+   urgentMsg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+   urgentMsg.set_priority(1);
+   urgentMsg.set_msg(std::string(1000, 'x'));
+
+   //Test
+   for (int index = 0; index < 100; index++)
+   {
+      urgentMsg.set_msgkey(index + 1);
+      _pCommHandler->SendMsg(urgentMsg);
+   }
+
+   //Expectations - message 0 is being written and 9 urgent messages fill the queue
+   EXPECT_EQ(10, _pCommHandler->GetSendQueueDepth());
+   EXPECT_EQ(91, _pCommHandler->GetDroppedFrameCount());
+}
+
+// Tests that with Disconnect a peer that lets the queue fill up is disconnected as a slow consumer
+TEST_F(CommHandlerTest, SendFrame_DisconnectOverLimit_DisconnectsSlowConsumer) {
+   //Setup
+   std::atomic<int> reason(-1);
+   auto connection = _pCommHandler->AddSocketStateChangeObserver([&reason](SocketState, SocketState newState, DisconnectReason disconnectReason)
+   {
+      if (newState == SocketState::Disconnected)
+         reason = (int)disconnectReason;
+   });
+   _pCommHandler->SetSendQueueLimits(SendQueueLimits(0, 3 * LARGE_MSG_SIZE, SlowConsumerPolicy::Disconnect));
+   StartBlockedWrite();
+
+   //Test
+   EXPECT_TRUE(SendLargeMsg(1));
+   //takes the frames being written and queued over the limit
+   EXPECT_FALSE(SendLargeMsg(2));
+
+   //Expectations
+   ASSERT_TRUE(WaitFor([&reason]() { return reason >= 0; }, 2000));
+   EXPECT_EQ((int)DisconnectReason::SlowConsumer, reason);
+   connection.disconnect();
+}
+
+// Tests that a write that does not complete within the write stall timeout flags a slow consumer until it completes
+TEST_F(CommHandlerTest, SendFrame_WriteStalls_FlagsSlowConsumer) {
+   //Setup
+   std::atomic<int> stalledCount(0);
+   auto connection = _pCommHandler->AddSocketStateChangeObserver([&stalledCount](SocketState oldState, SocketState newState, DisconnectReason disconnectReason)
+   {
+      if (disconnectReason == DisconnectReason::WriteStalled && oldState == SocketState::Connected && newState == SocketState::Connected)
+         stalledCount++;
+   });
+   _pCommHandler->SetSendQueueLimits(SendQueueLimits(0, 0, SlowConsumerPolicy::Disconnect, 50));
+
+   //Test
+   StartBlockedWrite();
+   auto stalled = WaitFor([&stalledCount]() { return stalledCount > 0; }, 2000);
+
+   //Expectations
+   ASSERT_TRUE(stalled);
+   EXPECT_TRUE(_pCommHandler->IsSlowConsumer());
+   EXPECT_EQ(1, _pCommHandler->GetWriteStallCount());
+   EXPECT_TRUE(_pCommHandler->IsConnected());
+   ReadMessages(1);
+   EXPECT_TRUE(WaitFor([this]() { return !_pCommHandler->IsSlowConsumer(); }, 2000));
+   EXPECT_EQ(1, stalledCount);
+   connection.disconnect();
+}
+
+#ifdef _WIN32
+#pragma warning( pop )
+#endif
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "ContextPool.h"
+#include "CommHandler.h"
+
+using namespace Matrix::MsgService::CommunicationUtils;
+using boost::asio::ip::tcp;
+
+// Tests that 0 creates one io_context per core
+TEST(ContextPoolTest, Constructor_Zero_OnePerCore) {
+   //Setup
+   size_t expected = std::thread::hardware_concurrency();
+   if (expected == 0)
+      expected = 1;
+
+   //Test
+   ContextPool pool(0);
+
+   //Expectations
+   EXPECT_EQ(expected, pool.GetSize());
+}
+
+// Tests that connections are spread evenly over the io_contexts and only counted while connected
+TEST(ContextPoolTest, GetLeastLoaded_SpreadsConnections) {
+   //Setup
+   ContextPool pool(3);
+   pool.StartThreads();
+   boost::asio::io_context peerContext;
+   tcp::acceptor acceptor(peerContext, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+   std::vector<std::shared_ptr<CommHandler>> handlers;
+   std::vector<std::unique_ptr<tcp::socket>> peerSockets;
+
+   //Test
+   for (int index = 0; index < 6; index++)
+   {
+      auto pHandler = std::make_shared<CommHandler>(pool.GetLeastLoaded(), "ContextPoolTest");
+      pHandler->GetSocket()->lowest_layer().connect(acceptor.local_endpoint());
+      peerSockets.emplace_back(new tcp::socket(peerContext));
+      acceptor.accept(*peerSockets.back());
+      pHandler->Run();
+      handlers.push_back(pHandler);
+   }
+   //holding a context without a connection does not count
+   auto pUnconnected = std::make_shared<CommHandler>(pool.GetContextHandler(0), "ContextPoolTest");
+
+   //Expectations
+   for (size_t index = 0; index < pool.GetSize(); index++)
+      EXPECT_EQ((size_t)2, pool.GetLoad(index));
+   for (auto& pHandler : handlers)
+      pHandler->ShutDown();
+   for (size_t index = 0; index < pool.GetSize(); index++)
+      EXPECT_EQ((size_t)0, pool.GetLoad(index));
+   handlers.clear();
+   pool.ShutDown();
+}
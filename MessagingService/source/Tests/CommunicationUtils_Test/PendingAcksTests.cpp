@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+
+#include "PendingAcks.h"
+
+using namespace Matrix::MsgService::CommunicationUtils;
+namespace CommonMessages = Matrix::MsgService::CommonMessages;
+
+// Tests that keys are counted per sending client
+TEST(PendingAcksTest, Add_CountsPerClient) {
+   //Setup
+   PendingAcks pendingAcks;
+
+   //Test
+   auto count1 = pendingAcks.Add(2, 7, 10);
+   auto count2 = pendingAcks.Add(2, 7, 11);
+   auto count3 = pendingAcks.Add(2, 8, 10);
+
+   //Expectations
+   EXPECT_EQ((size_t)1, count1);
+   EXPECT_EQ((size_t)2, count2);
+   EXPECT_EQ((size_t)1, count3);
+   EXPECT_EQ((size_t)3, pendingAcks.GetCount());
+   EXPECT_EQ((size_t)2, pendingAcks.GetClients().size());
+}
+
+// Tests that Take moves only the keys of that client into the message
+TEST(PendingAcksTest, Take_MovesKeysOfClient) {
+   //Setup
+   PendingAcks pendingAcks;
+   pendingAcks.Add(2, 7, 10);
+   pendingAcks.Add(2, 8, 20);
+   CommonMessages::Header msg;
+
+   //Test
+   auto count = pendingAcks.Take(2, 7, &msg);
+
+   //Expectations
+   EXPECT_EQ((size_t)1, count);
+   ASSERT_EQ(1, msg.ackkeys_size());
+   EXPECT_EQ(10, msg.ackkeys(0));
+   EXPECT_EQ((size_t)1, pendingAcks.GetCount());
+   EXPECT_EQ((size_t)0, pendingAcks.Take(2, 7, &msg));
+}
+
+// Tests that keys taken for a message that was not sent can be put back
+TEST(PendingAcksTest, Restore_PutsBackTakenKeys) {
+   //Setup
+   PendingAcks pendingAcks;
+   pendingAcks.Add(2, 7, 10);
+   pendingAcks.Add(2, 7, 11);
+   CommonMessages::Header notSent;
+   std::vector<int> keys;
+   pendingAcks.Take(2, 7, &notSent, &keys);
+   pendingAcks.Add(2, 7, 12);
+
+   //Test
+   pendingAcks.Restore(2, 7, keys);
+
+   //Expectations
+   EXPECT_EQ((std::vector<int>{ 10, 11 }), keys);
+   EXPECT_EQ((size_t)3, pendingAcks.GetCount());
+   CommonMessages::Header msg;
+   EXPECT_EQ((size_t)3, pendingAcks.Take(2, 7, &msg));
+   ASSERT_EQ(2, msg.ackkeyranges_size());
+   EXPECT_EQ(10, msg.ackkeyranges(0));
+   EXPECT_EQ(12, msg.ackkeyranges(1));
+}
+
+// Tests that runs of consecutive keys are sent as ranges and the rest as keys
+TEST(PendingAcksTest, AddAckKeys_RunsAsRanges) {
+   //Setup
+   std::vector<int> keys = { 9, 1, 2, 3, 4, 7, 10 };
+   CommonMessages::Header msg;
+
+   //Test
+   PendingAcks::AddAckKeys(keys, &msg);
+
+   //Expectations
+   ASSERT_EQ(2, msg.ackkeyranges_size());
+   EXPECT_EQ(1, msg.ackkeyranges(0));
+   EXPECT_EQ(4, msg.ackkeyranges(1));
+   ASSERT_EQ(3, msg.ackkeys_size());
+   EXPECT_EQ(7, msg.ackkeys(0));
+   EXPECT_EQ(9, msg.ackkeys(1));
+   EXPECT_EQ(10, msg.ackkeys(2));
+}
+
+// Tests that GetAckedKeys returns the ackKeys and the expanded ranges
+TEST(PendingAcksTest, GetAckedKeys_ExpandsRanges) {
+   //Setup
+   std::vector<int> keys;
+   for (int key = 100; key < 200; key++)
+      keys.push_back(key);
+   keys.push_back(5);
+   CommonMessages::Header msg;
+   PendingAcks::AddAckKeys(keys, &msg);
+   google::protobuf::RepeatedField<int> ackedKeys;
+
+   //Test
+   PendingAcks::GetAckedKeys(msg, &ackedKeys);
+
+   //Expectations
+   EXPECT_EQ(2, msg.ackkeyranges_size());
+   ASSERT_EQ(101, ackedKeys.size());
+   EXPECT_EQ(5, ackedKeys.Get(0));
+   for (int index = 1; index < ackedKeys.size(); index++)
+      EXPECT_EQ(99 + index, ackedKeys.Get(index));
+}
+
+// Tests that a run longer than MAX_RANGE_SIZE is split into ranges the receiver accepts
+TEST(PendingAcksTest, AddAckKeys_RunOverMaxRangeSize_RoundTrips) {
+   //Setup
+   const int numKeys = 70000;
+   std::vector<int> keys;
+   for (int key = 1; key <= numKeys; key++)
+      keys.push_back(key);
+   CommonMessages::Header msg;
+   google::protobuf::RepeatedField<int> ackedKeys;
+
+   //Test
+   PendingAcks::AddAckKeys(keys, &msg);
+   PendingAcks::GetAckedKeys(msg, &ackedKeys);
+
+   //Expectations
+   EXPECT_EQ(4, msg.ackkeyranges_size());
+   EXPECT_EQ(0, msg.ackkeys_size());
+   ASSERT_EQ(numKeys, ackedKeys.size());
+   for (int index = 0; index < numKeys; index++)
+      ASSERT_EQ(index + 1, ackedKeys.Get(index));
+}
+
+// Tests that inverted, oversized and unpaired ranges are ignored
+TEST(PendingAcksTest, GetAckedKeys_BadRanges_Ignored) {
+   //Setup
+   CommonMessages::Header msg;
+   msg.add_ackkeyranges(10);
+   msg.add_ackkeyranges(5);
+   msg.add_ackkeyranges(1);
+   msg.add_ackkeyranges(1 + PendingAcks::MAX_RANGE_SIZE);
+   msg.add_ackkeyranges(20);
+   msg.add_ackkeyranges(21);
+   msg.add_ackkeyranges(30);
+   google::protobuf::RepeatedField<int> ackedKeys;
+
+   //Test
+   PendingAcks::GetAckedKeys(msg, &ackedKeys);
+
+   //Expectations
+   ASSERT_EQ(2, ackedKeys.size());
+   EXPECT_EQ(20, ackedKeys.Get(0));
+   EXPECT_EQ(21, ackedKeys.Get(1));
+}
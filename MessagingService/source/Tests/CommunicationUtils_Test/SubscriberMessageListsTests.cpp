@@ -0,0 +1,269 @@
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "SubscriberMessageLists.h"
+
+using namespace Matrix::MsgService::CommunicationUtils;
+namespace CommonMessages = Matrix::MsgService::CommonMessages;
+
+namespace
+{
+   CommonMessages::Header CreateSentMsg(int msgKey, int destClientType = 2, int destClientID = 7)
+   {
+      CommonMessages::Header msg;
+      msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+      msg.set_msgkey(msgKey);
+      msg.set_destclienttype(destClientType);
+      msg.set_destclientid(destClientID);
+      return msg;
+   }
+}
+
+// Tests that only messages for a specific client type are tracked
+TEST(SubscriberMessageListsTest, AddSentMessage_NoDestClientType_NotAdded) {
+   //Setup
+   SubscriberMessageLists lists;
+
+   //Test
+   auto added = lists.AddSentMessage(CreateSentMsg(1, 0, 0));
+
+   //Expectations
+   EXPECT_FALSE(added);
+   EXPECT_EQ((size_t)0, lists.GetSentMessageCount(0, 0));
+}
+
+// Tests that adding a key again replaces the message
+TEST(SubscriberMessageListsTest, AddSentMessage_SameKey_Replaces) {
+   //Setup
+   SubscriberMessageLists lists;
+
+   //Test
+   auto added1 = lists.AddSentMessage(CreateSentMsg(1));
+   auto added2 = lists.AddSentMessage(CreateSentMsg(1));
+
+   //Expectations
+   EXPECT_TRUE(added1);
+   EXPECT_FALSE(added2);
+   EXPECT_EQ((size_t)1, lists.GetSentMessageCount(2, 7));
+   EXPECT_EQ((size_t)1, lists.GetMessages(2, 7, 0).size());
+}
+
+// Tests that an acked message is removed only from its client
+TEST(SubscriberMessageListsTest, RemoveSentMessage_Removes) {
+   //Setup
+   SubscriberMessageLists lists;
+   lists.AddSentMessage(CreateSentMsg(1));
+   lists.AddSentMessage(CreateSentMsg(1, 2, 8));
+
+   //Test
+   auto removed = lists.RemoveSentMessage(2, 7, 1);
+   auto removedAgain = lists.RemoveSentMessage(2, 7, 1);
+
+   //Expectations
+   EXPECT_TRUE(removed);
+   EXPECT_FALSE(removedAgain);
+   EXPECT_EQ((size_t)0, lists.GetSentMessageCount(2, 7));
+   EXPECT_EQ((size_t)1, lists.GetSentMessageCount(2, 8));
+}
+
+// Tests that removing a message releases it rather than keeping it until its entry is reused
+TEST(SubscriberMessageListsTest, RemoveSentMessage_ReleasesMessage) {
+   //Setup
+   SubscriberMessageLists lists;
+   for (int key = 1; key <= 3; key++)
+   {
+      auto msg = CreateSentMsg(key);
+      msg.set_msg(std::string(1000, 'x'));
+      lists.AddSentMessage(msg);
+   }
+   EXPECT_LT((size_t)3000, lists.GetSentMessageBytes(2, 7));
+
+   //Test
+   for (int key = 1; key <= 3; key++)
+      lists.RemoveSentMessage(2, 7, key);
+
+   //Expectations
+   EXPECT_EQ((size_t)0, lists.GetSentMessageCount(2, 7));
+   EXPECT_EQ((size_t)0, lists.GetSentMessageBytes(2, 7));
+}
+
+// Tests that a message sent to every client of a type is removed when one of them acks it
+TEST(SubscriberMessageListsTest, RemoveSentMessage_SentToType_RemovedByClient) {
+   //Setup
+   SubscriberMessageLists lists;
+   lists.AddSentMessage(CreateSentMsg(1, 2, 0));
+
+   //Test
+   auto removed = lists.RemoveSentMessage(2, 7, 1);
+
+   //Expectations
+   EXPECT_TRUE(removed);
+   EXPECT_EQ((size_t)0, lists.GetSentMessageCount(2, 0));
+}
+
+// Tests that removing from a table that has grown leaves every other message findable
+TEST(SubscriberMessageListsTest, RemoveSentMessages_ManyKeys_OthersRemain) {
+   //Setup
+   SubscriberMessageLists lists;
+   google::protobuf::RepeatedField<int> ackKeys;
+   for (int key = 1; key <= 1000; key++)
+   {
+      lists.AddSentMessage(CreateSentMsg(key));
+      if (key % 2 == 1)
+         ackKeys.Add(key);
+   }
+
+   //Test
+   auto removed = lists.RemoveSentMessages(2, 7, ackKeys);
+
+   //Expectations
+   EXPECT_TRUE(removed);
+   EXPECT_EQ((size_t)500, lists.GetSentMessageCount(2, 7));
+   auto msgs = lists.GetMessages(2, 7, 0);
+   ASSERT_EQ((size_t)500, msgs.size());
+   for (size_t index = 0; index < msgs.size(); index++)
+      EXPECT_EQ((int)(index + 1) * 2, msgs[index].msgkey());
+   for (int key = 2; key <= 1000; key += 2)
+      EXPECT_TRUE(lists.RemoveSentMessage(2, 7, key));
+   EXPECT_EQ((size_t)0, lists.GetSentMessageCount(2, 7));
+}
+
+// Tests that GetMessages returns messages oldest first, with a message sent again moved to the end
+TEST(SubscriberMessageListsTest, GetMessages_Resent_OrderedBySentTime) {
+   //Setup
+   SubscriberMessageLists lists;
+   lists.AddSentMessage(CreateSentMsg(1));
+   lists.AddSentMessage(CreateSentMsg(2));
+   lists.AddSentMessage(CreateSentMsg(3));
+
+   //Test
+   lists.AddSentMessage(CreateSentMsg(1));
+   auto msgs = lists.GetMessages(2, 7, 0);
+
+   //Expectations
+   ASSERT_EQ((size_t)3, msgs.size());
+   EXPECT_EQ(2, msgs[0].msgkey());
+   EXPECT_EQ(3, msgs[1].msgkey());
+   EXPECT_EQ(1, msgs[2].msgkey());
+}
+
+// Tests that messages added after others were acked and resent many times come back in order with their own contents
+TEST(SubscriberMessageListsTest, GetMessages_AfterAcksAndResends_ReturnsCurrentMessages) {
+   //Setup
+   SubscriberMessageLists lists;
+   for (int key = 1; key <= 100; key++)
+      lists.AddSentMessage(CreateSentMsg(key));
+   for (int key = 1; key <= 100; key += 2)
+      lists.RemoveSentMessage(2, 7, key);
+   for (int resend = 0; resend < 50; resend++)
+   {
+      for (int key = 2; key <= 10; key += 2)
+         lists.AddSentMessage(CreateSentMsg(key));
+   }
+
+   //Test
+   for (int key = 101; key <= 150; key++)
+   {
+      auto msg = CreateSentMsg(key);
+      msg.set_msg(std::to_string(key));
+      lists.AddSentMessage(msg);
+   }
+   auto msgs = lists.GetMessages(2, 7, 0);
+
+   //Expectations
+   EXPECT_EQ((size_t)100, lists.GetSentMessageCount(2, 7));
+   ASSERT_EQ((size_t)100, msgs.size());
+   for (int index = 0; index < 45; index++)
+      EXPECT_EQ(index * 2 + 12, msgs[index].msgkey());
+   for (int index = 0; index < 5; index++)
+      EXPECT_EQ(index * 2 + 2, msgs[45 + index].msgkey());
+   for (int index = 0; index < 50; index++)
+   {
+      EXPECT_EQ(index + 101, msgs[50 + index].msgkey());
+      EXPECT_EQ(std::to_string(index + 101), msgs[50 + index].msg());
+   }
+}
+
+// Tests that GetMessages only returns messages sent more than numSeconds ago
+TEST(SubscriberMessageListsTest, GetMessages_Recent_NotReturned) {
+   //Setup
+   SubscriberMessageLists lists;
+   lists.AddSentMessage(CreateSentMsg(1));
+
+   //Test
+   auto msgs = lists.GetMessages(2, 7, 60);
+
+   //Expectations
+   EXPECT_EQ((size_t)0, msgs.size());
+   EXPECT_EQ((size_t)0, lists.GetMessages(3, 1, 0).size());
+}
+
+// Tests that presence is tracked for any client
+TEST(SubscriberMessageListsTest, SetClientOnLine_SetsPresence) {
+   //Setup
+   SubscriberMessageLists lists;
+
+   //Test
+   for (int clientID = 1; clientID <= 100; clientID++)
+      lists.SetClientOnLine(2, clientID, clientID % 3 != 0);
+
+   //Expectations
+   EXPECT_FALSE(lists.IsClientOnline(3, 1));
+   EXPECT_FALSE(lists.IsClientOnline(2, 101));
+   for (int clientID = 1; clientID <= 100; clientID++)
+      EXPECT_EQ(clientID % 3 != 0, lists.IsClientOnline(2, clientID));
+   lists.SetClientOnLine(2, 1, false);
+   EXPECT_FALSE(lists.IsClientOnline(2, 1));
+}
+
+// Tests that removing a subscription drops its messages
+TEST(SubscriberMessageListsTest, RemoveSubscription_DropsMessages) {
+   //Setup
+   SubscriberMessageLists lists;
+   auto added = lists.AddSubscription(2, 7);
+   auto addedAgain = lists.AddSubscription(2, 7);
+   lists.AddSentMessage(CreateSentMsg(1));
+
+   //Test
+   auto removed = lists.RemoveSubscription(2, 7);
+
+   //Expectations
+   EXPECT_TRUE(added);
+   EXPECT_FALSE(addedAgain);
+   EXPECT_TRUE(removed);
+   EXPECT_FALSE(lists.RemoveSubscription(2, 7));
+   EXPECT_EQ((size_t)0, lists.GetSentMessageCount(2, 7));
+}
+
+// Tests that threads tracking different clients at once do not interfere
+TEST(SubscriberMessageListsTest, ConcurrentClients_AllAcked) {
+   //Setup
+   SubscriberMessageLists lists;
+   const int NUM_THREADS = 4;
+   const int NUM_MESSAGES = 2000;
+
+   //Test
+   std::vector<std::thread> threads;
+   for (int thread = 0; thread < NUM_THREADS; thread++)
+   {
+      threads.push_back(std::thread([&lists, thread]()
+      {
+         for (int key = 1; key <= NUM_MESSAGES; key++)
+         {
+            lists.AddSentMessage(CreateSentMsg(key, 2, thread + 1));
+            lists.SetClientOnLine(2, thread + 1, true);
+            if (key > 10)
+               lists.RemoveSentMessage(2, thread + 1, key - 10);
+         }
+      }));
+   }
+   for (auto& thread : threads)
+      thread.join();
+
+   //Expectations
+   for (int thread = 0; thread < NUM_THREADS; thread++)
+   {
+      EXPECT_EQ((size_t)10, lists.GetSentMessageCount(2, thread + 1));
+      EXPECT_TRUE(lists.IsClientOnline(2, thread + 1));
+   }
+}
@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <atomic>
+#include <set>
+#include <algorithm>
+
+#include "ClientIndex.h"
+#include "ClientMsgHandler.h"
+#include "ContextHandler.h"
+
+namespace CommunicationUtils = Matrix::MsgService::CommunicationUtils;
+using namespace Matrix::MsgService::MessageThreads;
+
+//Test Fixture - an index and handlers to put in it
+class ClientIndexTest : public testing::Test {
+protected:
+   std::shared_ptr<CommunicationUtils::ContextHandler> _pContextHandler;
+   std::shared_ptr<ClientIndex> _pUnderTest;
+
+   virtual void SetUp()
+   {
+#ifdef USING_SSL
+      boost::asio::ssl::context sslContext(boost::asio::ssl::context::sslv23);
+      _pContextHandler = std::make_shared<CommunicationUtils::ContextHandler>(sslContext);
+#else
+      _pContextHandler = std::make_shared<CommunicationUtils::ContextHandler>();
+#endif
+      _pUnderTest = std::make_shared<ClientIndex>();
+   }
+   virtual void TearDown()
+   {
+      _pUnderTest = nullptr;
+   }
+   std::shared_ptr<ClientMsgHandler> CreateClient()
+   {
+      return std::make_shared<ClientMsgHandler>(_pContextHandler, nullptr);
+   }
+   static std::set<std::shared_ptr<ClientMsgHandler>> GetClients(const ClientIndex::ClientSetPtr& pClients)
+   {
+      std::set<std::shared_ptr<ClientMsgHandler>> clients;
+      pClients->ForEach([&clients](const std::shared_ptr<ClientMsgHandler>& pClient) { clients.insert(pClient); });
+      return clients;
+   }
+};
+
+/////////////////////////////////////////////
+// TESTS
+/////////////////////////////////////////////
+
+// Tests that a client is found by the type and ID it was added with only
+TEST_F(ClientIndexTest, Find_Added_ReturnsClient) {
+   //Setup
+   auto pClient = CreateClient();
+   auto pOther = CreateClient();
+
+   //Test
+   _pUnderTest->Add(pClient, 1, 100);
+   _pUnderTest->Add(pOther, 1, 101);
+
+   //Expectations
+   EXPECT_EQ(pClient, _pUnderTest->Find(1, 100));
+   EXPECT_EQ(pOther, _pUnderTest->Find(1, 101));
+   EXPECT_EQ(nullptr, _pUnderTest->Find(2, 100));
+   EXPECT_EQ(nullptr, _pUnderTest->Find(1, 0));
+   EXPECT_EQ((size_t)2, _pUnderTest->GetCount());
+}
+
+// Tests that adding the same client twice only adds it once
+TEST_F(ClientIndexTest, Add_Twice_AddsOnce) {
+   //Setup
+   auto pClient = CreateClient();
+
+   //Test
+   _pUnderTest->Add(pClient, 1, 100);
+   _pUnderTest->Add(pClient, 1, 100);
+
+   //Expectations
+   EXPECT_EQ((size_t)1, _pUnderTest->GetCount());
+   ASSERT_NE(nullptr, _pUnderTest->FindAll(1));
+   EXPECT_EQ((size_t)1, _pUnderTest->FindAll(1)->size());
+}
+
+// Tests that FindAll returns every client of the type and no others
+TEST_F(ClientIndexTest, FindAll_ReturnsClientsOfType) {
+   //Setup
+   auto pFirst = CreateClient();
+   auto pSecond = CreateClient();
+   auto pOtherType = CreateClient();
+   _pUnderTest->Add(pFirst, 1, 100);
+   _pUnderTest->Add(pSecond, 1, 200);
+   _pUnderTest->Add(pOtherType, 2, 100);
+
+   //Test
+   auto pClients = _pUnderTest->FindAll(1);
+
+   //Expectations
+   ASSERT_NE(nullptr, pClients);
+   ASSERT_EQ((size_t)2, pClients->size());
+   EXPECT_EQ(std::set<std::shared_ptr<ClientMsgHandler>>({ pFirst, pSecond }), GetClients(pClients));
+   EXPECT_EQ(nullptr, _pUnderTest->FindAll(3));
+}
+
+// Tests that a client logged on under two IDs of a type is listed once for the type
+TEST_F(ClientIndexTest, FindAll_TwoIDsOfType_ListsClientOnce) {
+   //Setup
+   auto pClient = CreateClient();
+
+   //Test
+   _pUnderTest->Add(pClient, 1, 100);
+   _pUnderTest->Add(pClient, 1, 200);
+
+   //Expectations
+   EXPECT_EQ(pClient, _pUnderTest->Find(1, 200));
+   ASSERT_NE(nullptr, _pUnderTest->FindAll(1));
+   EXPECT_EQ((size_t)1, _pUnderTest->FindAll(1)->size());
+}
+
+// Tests that removing clients from a type spanning several chunks keeps every other client, and sets taken before are unchanged
+TEST_F(ClientIndexTest, Remove_ManyOfType_KeepsOthers) {
+   //Setup
+   std::vector<std::shared_ptr<ClientMsgHandler>> clients;
+   for (int index = 0; index < (int)(3 * ClientIndex::CHUNK_SIZE + 5); index++)
+   {
+      clients.push_back(CreateClient());
+      _pUnderTest->Add(clients.back(), 1, index + 1);
+   }
+   auto pBefore = _pUnderTest->FindAll(1);
+
+   //Test - every third client, starting at the front so the last client fills the gaps
+   std::set<std::shared_ptr<ClientMsgHandler>> expected;
+   for (size_t index = 0; index < clients.size(); index++)
+   {
+      if (index % 3 == 0)
+         _pUnderTest->Remove(clients[index].get(), 1, (int)index + 1);
+      else
+         expected.insert(clients[index]);
+   }
+
+   //Expectations
+   auto pAfter = _pUnderTest->FindAll(1);
+   ASSERT_NE(nullptr, pAfter);
+   EXPECT_EQ(expected.size(), pAfter->size());
+   EXPECT_EQ(expected, GetClients(pAfter));
+   EXPECT_EQ(clients.size(), pBefore->size());
+   EXPECT_EQ(std::set<std::shared_ptr<ClientMsgHandler>>(clients.begin(), clients.end()), GetClients(pBefore));
+   for (auto& pClient : expected)
+      _pUnderTest->Remove(pClient.get(), 1, (int)(std::find(clients.begin(), clients.end(), pClient) - clients.begin()) + 1);
+   EXPECT_EQ(nullptr, _pUnderTest->FindAll(1));
+   EXPECT_EQ((size_t)0, _pUnderTest->GetCount());
+}
+
+// Tests that a removed client is no longer found by ID or type, and a list taken before is unchanged
+TEST_F(ClientIndexTest, Remove_NoLongerFound) {
+   //Setup
+   auto pFirst = CreateClient();
+   auto pSecond = CreateClient();
+   _pUnderTest->Add(pFirst, 1, 100);
+   _pUnderTest->Add(pSecond, 1, 200);
+   auto pBefore = _pUnderTest->FindAll(1);
+
+   //Test
+   _pUnderTest->Remove(pFirst.get(), 1, 100);
+   _pUnderTest->Remove(pSecond.get(), 1, 100);
+
+   //Expectations
+   EXPECT_EQ(nullptr, _pUnderTest->Find(1, 100));
+   EXPECT_EQ(pSecond, _pUnderTest->Find(1, 200));
+   ASSERT_NE(nullptr, _pUnderTest->FindAll(1));
+   EXPECT_EQ((size_t)1, _pUnderTest->FindAll(1)->size());
+   EXPECT_EQ((size_t)2, pBefore->size());
+   EXPECT_EQ((size_t)1, _pUnderTest->GetCount());
+}
+
+// Tests that lookups while clients are added and removed always see a consistent client
+TEST_F(ClientIndexTest, Find_WhileChanging_FindsStableClient) {
+   //Setup
+   auto pStable = CreateClient();
+   _pUnderTest->Add(pStable, 1, 1);
+   std::vector<std::shared_ptr<ClientMsgHandler>> others;
+   for (int index = 0; index < 50; index++)
+      others.push_back(CreateClient());
+   std::atomic<bool> stop(false);
+   std::thread changer([this, &others, &stop]()
+   {
+      while (!stop)
+      {
+         for (size_t index = 0; index < others.size(); index++)
+            _pUnderTest->Add(others[index], 1, (int)index + 2);
+         for (size_t index = 0; index < others.size(); index++)
+            _pUnderTest->Remove(others[index].get(), 1, (int)index + 2);
+      }
+   });
+
+   //Test
+   int notFound = 0;
+   for (int index = 0; index < 20000; index++)
+   {
+      if (_pUnderTest->Find(1, 1) != pStable)
+         notFound++;
+   }
+   stop = true;
+   changer.join();
+
+   //Expectations
+   EXPECT_EQ(0, notFound);
+   EXPECT_EQ((size_t)1, _pUnderTest->GetCount());
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include "ClientMsgHandlerPool.h"
+#include "ClientManager.h"
+#include "ContextHandler.h"
+
+namespace CommunicationUtils = Matrix::MsgService::CommunicationUtils;
+using namespace Matrix::MsgService::MessageThreads;
+
+//Test Fixture - a pool of handlers on one context
+class ClientMsgHandlerPoolTest : public testing::Test {
+protected:
+   std::shared_ptr<CommunicationUtils::ContextHandler> _pContextHandler;
+   std::shared_ptr<ClientManager> _pClientManager;
+   std::shared_ptr<ClientMsgHandlerPool> _pUnderTest;
+
+   virtual void SetUp()
+   {
+#ifdef USING_SSL
+      boost::asio::ssl::context sslContext(boost::asio::ssl::context::sslv23);
+      _pContextHandler = std::make_shared<CommunicationUtils::ContextHandler>(sslContext);
+#else
+      _pContextHandler = std::make_shared<CommunicationUtils::ContextHandler>();
+#endif
+      _pClientManager = std::make_shared<ClientManager>();
+      _pUnderTest = std::make_shared<ClientMsgHandlerPool>();
+   }
+   virtual void TearDown()
+   {
+      _pUnderTest->Clear();
+      _pClientManager->ShutDown();
+   }
+};
+
+/////////////////////////////////////////////
+// TESTS
+/////////////////////////////////////////////
+
+// Tests that warming creates idle handlers that Acquire then hands out
+TEST_F(ClientMsgHandlerPoolTest, Acquire_AfterWarm_ReusesWarmHandler) {
+   //Setup
+   _pUnderTest->Warm(_pContextHandler, 2);
+   ASSERT_EQ((size_t)2, _pUnderTest->GetIdleCount(_pContextHandler));
+
+   //Test
+   auto pClient = _pUnderTest->Acquire(_pContextHandler, _pClientManager);
+
+   //Expectations
+   ASSERT_NE(nullptr, pClient);
+   EXPECT_EQ((size_t)1, _pUnderTest->GetIdleCount(_pContextHandler));
+   EXPECT_EQ(2, _pUnderTest->GetCreatedCount());
+   EXPECT_EQ(1, _pUnderTest->GetReusedCount());
+   EXPECT_EQ(_pContextHandler, pClient->GetContextHandler());
+}
+
+// Tests that a released handler is reset and used again
+TEST_F(ClientMsgHandlerPoolTest, Acquire_AfterRelease_ReusesReleasedHandler) {
+   //Setup
+   auto pClient = _pUnderTest->Acquire(_pContextHandler, _pClientManager);
+   auto pRawClient = pClient.get();
+   pClient->ShutDown();
+   _pUnderTest->Release(std::move(pClient));
+
+   //Test
+   auto pReused = _pUnderTest->Acquire(_pContextHandler, _pClientManager);
+
+   //Expectations
+   EXPECT_EQ(pRawClient, pReused.get());
+   EXPECT_EQ(1, _pUnderTest->GetCreatedCount());
+   EXPECT_EQ(1, _pUnderTest->GetReusedCount());
+   EXPECT_FALSE(pReused->IsShuttingDown());
+   EXPECT_FALSE(pReused->IsAuthenticated());
+   EXPECT_EQ(0, pReused->GetClientType());
+   EXPECT_EQ(0, pReused->GetClientID());
+}
+
+// Tests that a released handler something else still holds is not handed out
+TEST_F(ClientMsgHandlerPoolTest, Acquire_ReleasedHandlerStillHeld_CreatesNew) {
+   //Setup
+   auto pClient = _pUnderTest->Acquire(_pContextHandler, _pClientManager);
+   auto pStillHeld = pClient;
+   pClient->ShutDown();
+   _pUnderTest->Release(std::move(pClient));
+
+   //Test
+   auto pNewClient = _pUnderTest->Acquire(_pContextHandler, _pClientManager);
+
+   //Expectations
+   EXPECT_NE(pStillHeld, pNewClient);
+   EXPECT_EQ(2, _pUnderTest->GetCreatedCount());
+   EXPECT_EQ(0, _pUnderTest->GetReusedCount());
+   EXPECT_EQ((size_t)1, _pUnderTest->GetIdleCount(_pContextHandler));
+}
+
+// Tests that no more than the warm size of released handlers are kept
+TEST_F(ClientMsgHandlerPoolTest, Release_BeyondMaxIdle_Discards) {
+   //Setup
+   std::vector<std::shared_ptr<ClientMsgHandler>> clients;
+   for (size_t index = 0; index < ClientMsgHandlerPool::DEFAULT_MAX_IDLE + 5; index++)
+      clients.push_back(_pUnderTest->Acquire(_pContextHandler, _pClientManager));
+
+   //Test
+   for (auto& pClient : clients)
+   {
+      pClient->ShutDown();
+      _pUnderTest->Release(std::move(pClient));
+   }
+
+   //Expectations
+   EXPECT_EQ(ClientMsgHandlerPool::DEFAULT_MAX_IDLE, _pUnderTest->GetIdleCount(_pContextHandler));
+}
@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "ConnectionHandler.h"
+#include "ClientManager.h"
+#include "ContextPool.h"
+#include "Message.h"
+#include "EncodedFrame.h"
+#include "FrameDecoder.h"
+
+namespace CommonMessages = Matrix::MsgService::CommonMessages;
+namespace CommunicationUtils = Matrix::MsgService::CommunicationUtils;
+using namespace Matrix::MsgService::MessageThreads;
+using boost::asio::ip::tcp;
+
+//Test Fixture - runs a ConnectionHandler on a pool of contexts
+class ConnectionHandlerTest : public testing::Test {
+protected:
+   const size_t POOL_SIZE = 3;
+   std::shared_ptr<CommunicationUtils::ContextPool> _pContextPool;
+   std::shared_ptr<ClientManager> _pClientManager;
+   std::shared_ptr<ConnectionHandler> _pConnectionHandler;
+   boost::asio::io_context _peerContext;
+
+   virtual void SetUp()
+   {
+#ifdef USING_SSL
+      boost::asio::ssl::context sslContext(boost::asio::ssl::context::sslv23);
+      _pContextPool = std::make_shared<CommunicationUtils::ContextPool>(POOL_SIZE, sslContext);
+#else
+      _pContextPool = std::make_shared<CommunicationUtils::ContextPool>(POOL_SIZE);
+#endif
+      _pContextPool->StartThreads();
+      _pClientManager = std::make_shared<ClientManager>();
+   }
+   virtual void TearDown()
+   {
+      if (_pConnectionHandler)
+      {
+         _pConnectionHandler->ShutDown();
+         _pConnectionHandler->WaitForShutdown(5);
+      }
+      _pClientManager->ShutDown();
+      _pContextPool->ShutDown();
+   }
+   void StartConnectionHandler(bool reusePort, bool dualStack)
+   {
+      _pConnectionHandler = std::make_shared<ConnectionHandler>(_pContextPool, 0, _pClientManager, reusePort, dualStack);
+      _pConnectionHandler->StartThread();
+   }
+public:
+   //Connects to address and logs on, returning true once the broker has acknowledged the logon
+   bool ConnectAndLogon(const boost::asio::ip::address& address, int clientID)
+   {
+      tcp::socket socket(_peerContext);
+      boost::system::error_code ec;
+      socket.connect(tcp::endpoint(address, _pConnectionHandler->GetPort()), ec);
+      if (ec)
+         return false;
+      CommonMessages::Header msg;
+      msg.set_msgtypeid(CommonMessages::MsgType::LOGON);
+      msg.set_msgkey(1);
+      CommonMessages::Logon logon;
+      logon.set_clienttype(1);
+      logon.set_clientid(clientID);
+      msg.set_msg(logon.SerializeAsString());
+      auto pFrame = CommonMessages::EncodedFrame::Create(msg);
+      boost::asio::write(socket, boost::asio::buffer(pFrame->GetData(), pFrame->GetSize()), ec);
+      CommonMessages::FrameDecoder decoder;
+      while (!ec)
+      {
+         auto bytes = socket.read_some(boost::asio::buffer(decoder.GetWriteBuffer(), decoder.GetWriteSpace()), ec);
+         decoder.Commit(bytes);
+         const char* pData;
+         uint32_t size;
+         while (decoder.NextFrame(&pData, &size) == CommonMessages::FrameDecoder::FrameStatus::Complete)
+         {
+            CommonMessages::Header rxMsg;
+            if (rxMsg.ParseFromArray(pData, (int)size) && rxMsg.msgtypeid() == CommonMessages::MsgType::ACK)
+               return true;
+         }
+      }
+      return false;
+   }
+};
+
+/////////////////////////////////////////////
+// TESTS
+/////////////////////////////////////////////
+
+// Tests that by default there is a single acceptor
+TEST_F(ConnectionHandlerTest, Constructor_Default_OneAcceptor) {
+   //Test
+   StartConnectionHandler(false, false);
+
+   //Expectations
+   EXPECT_EQ((size_t)1, _pConnectionHandler->GetAcceptorCount());
+   EXPECT_NE(0, _pConnectionHandler->GetPort());
+   EXPECT_TRUE(ConnectAndLogon(boost::asio::ip::address_v4::loopback(), 1));
+}
+
+#ifdef SO_REUSEPORT
+// Tests that with SO_REUSEPORT every context gets an acceptor on the same port and all of them accept
+TEST_F(ConnectionHandlerTest, Constructor_ReusePort_AcceptorPerContext) {
+   //Test
+   StartConnectionHandler(true, false);
+
+   //Expectations
+   ASSERT_EQ(POOL_SIZE, _pConnectionHandler->GetAcceptorCount());
+   for (int clientID = 1; clientID <= 10; clientID++)
+      EXPECT_TRUE(ConnectAndLogon(boost::asio::ip::address_v4::loopback(), clientID));
+}
+#endif
+
+// Tests that a dual stack listener still accepts IPv4 connections
+TEST_F(ConnectionHandlerTest, Constructor_DualStack_AcceptsIPv4) {
+   //Test
+   StartConnectionHandler(false, true);
+
+   //Expectations
+   EXPECT_TRUE(ConnectAndLogon(boost::asio::ip::address_v4::loopback(), 1));
+}
+
+// Tests that a dual stack listener accepts IPv6 and IPv4 connections on the same port
+TEST_F(ConnectionHandlerTest, Constructor_DualStack_AcceptsIPv6AndIPv4) {
+   //Setup
+   {
+      tcp::acceptor probe(_peerContext);
+      boost::system::error_code ec;
+      probe.open(tcp::v6(), ec);
+      if (!ec)
+         probe.bind(tcp::endpoint(boost::asio::ip::address_v6::loopback(), 0), ec);
+      if (ec)
+         GTEST_SKIP() << "IPv6 loopback is not available: " << ec.message();
+   }
+
+   //Test
+   StartConnectionHandler(false, true);
+
+   //Expectations
+   EXPECT_TRUE(ConnectAndLogon(boost::asio::ip::address_v6::loopback(), 1));
+   EXPECT_TRUE(ConnectAndLogon(boost::asio::ip::address_v4::loopback(), 2));
+}
+
+// Tests that a client is removed as soon as it disconnects, without waiting for a poll
+TEST_F(ConnectionHandlerTest, Disconnect_RemovesClientPromptly) {
+   //Setup
+   StartConnectionHandler(false, false);
+
+   //Test
+   ASSERT_TRUE(ConnectAndLogon(boost::asio::ip::address_v4::loopback(), 1));
+   for (int waited = 0; waited < 3000 && _pClientManager->GetRemovedCount() == 0; waited += 5)
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+   //Expectations
+   EXPECT_EQ(1, _pClientManager->GetRemovedCount());
+   EXPECT_EQ((size_t)0, _pClientManager->GetClientCount());
+   EXPECT_EQ(nullptr, _pClientManager->GetClient(1, 1));
+   //generous for a loaded machine; it is well under a millisecond
+   EXPECT_GT(250000, _pClientManager->GetMaxCleanupUS());
+}
+
+// Tests that ClearAll disconnects every connected client together, well within its deadline
+TEST_F(ConnectionHandlerTest, ClearAll_ConnectedClients_AllRemovedBeforeDeadline) {
+   //Setup
+   const size_t numClients = 20;
+   StartConnectionHandler(false, false);
+   std::vector<std::unique_ptr<tcp::socket>> sockets;
+   for (size_t index = 0; index < numClients; index++)
+   {
+      sockets.emplace_back(new tcp::socket(_peerContext));
+      sockets.back()->connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), _pConnectionHandler->GetPort()));
+   }
+   for (int waited = 0; waited < 3000 && _pClientManager->GetClientCount() < numClients; waited += 5)
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+   ASSERT_EQ(numClients, _pClientManager->GetClientCount());
+
+   //Test
+   auto start = std::chrono::steady_clock::now();
+   auto forceClosed = _pClientManager->ClearAll(2000);
+   auto elapsedMS = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+   //Expectations
+   EXPECT_EQ((size_t)0, forceClosed);
+   EXPECT_EQ((size_t)0, _pClientManager->GetClientCount());
+   EXPECT_EQ((int64_t)numClients, _pClientManager->GetRemovedCount());
+   EXPECT_GT(2000, elapsedMS);
+   for (auto& pSocket : sockets)
+   {
+      char data[16];
+      boost::system::error_code ec;
+      while (!ec)
+         pSocket->read_some(boost::asio::buffer(data), ec);
+      EXPECT_EQ(boost::asio::error::eof, ec);
+   }
+}
+
+// Tests that a client reconnecting is given the handler of its finished connection
+TEST_F(ConnectionHandlerTest, Accept_AfterDisconnect_ReusesHandler) {
+   //Setup
+   StartConnectionHandler(false, false);
+   auto pClientPool = _pClientManager->GetClientPool();
+   ASSERT_TRUE(ConnectAndLogon(boost::asio::ip::address_v4::loopback(), 1));
+   //wait for the ClientManager to release the finished handler to the pool
+   auto getIdleCount = [&]() -> size_t
+   {
+      size_t idle = 0;
+      for (size_t index = 0; index < POOL_SIZE; index++)
+         idle += pClientPool->GetIdleCount(_pContextPool->GetContextHandler(index));
+      return idle;
+   };
+   for (int waited = 0; waited < 3000 && getIdleCount() == 0; waited += 10)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   ASSERT_EQ((size_t)1, getIdleCount());
+
+   //Test
+   //the handler for the next accept was acquired before the release, so it is the one after that reuses it
+   ASSERT_TRUE(ConnectAndLogon(boost::asio::ip::address_v4::loopback(), 1));
+   ASSERT_TRUE(ConnectAndLogon(boost::asio::ip::address_v4::loopback(), 1));
+
+   //Expectations
+   EXPECT_LE(1, pClientPool->GetReusedCount());
+}
@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+
+#include "LastValueCache.h"
+#include "Message.h"
+
+namespace CommonMessages = Matrix::MsgService::CommonMessages;
+using namespace Matrix::MsgService::MessageThreads;
+
+//Test Fixture - a cache with room for a few frames per shard
+class LastValueCacheTest : public testing::Test {
+protected:
+   std::shared_ptr<LastValueCache> _pUnderTest;
+   size_t _frameBytes = 0;
+
+   virtual void SetUp()
+   {
+      _frameBytes = CreateFrame(0)->GetCapacity();
+      _pUnderTest = std::make_shared<LastValueCache>(LastValueCache::NUM_SHARDS * _frameBytes * 2);
+   }
+   virtual void TearDown()
+   {
+      _pUnderTest = nullptr;
+   }
+   CommonMessages::EncodedFramePtr CreateFrame(int key)
+   {
+      CommonMessages::Header msg;
+      msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+      msg.set_msgkey(key);
+      return CommonMessages::EncodedFrame::Create(msg);
+   }
+   CommonMessages::EncodedFramePtr FindExact(const CommonMessages::SubscriptionParams& source)
+   {
+      LastValueCache::FrameList frames;
+      _pUnderTest->Find(source, &frames);
+      return frames.empty() ? nullptr : frames[0].second;
+   }
+};
+
+/////////////////////////////////////////////
+// TESTS
+/////////////////////////////////////////////
+
+// Tests that the latest frame from a source replaces the previous one
+TEST_F(LastValueCacheTest, Update_SameSource_KeepsLatest) {
+   //Setup
+   CommonMessages::SubscriptionParams source(1, 100, 5);
+   auto pFirst = CreateFrame(1);
+   auto pSecond = CreateFrame(2);
+
+   //Test
+   _pUnderTest->Update(source, pFirst);
+   _pUnderTest->Update(source, pSecond);
+
+   //Expectations
+   EXPECT_EQ(pSecond, FindExact(source));
+   EXPECT_EQ(nullptr, FindExact(CommonMessages::SubscriptionParams(1, 100, 6)));
+   EXPECT_EQ(1, _pUnderTest->GetEntryCount());
+   EXPECT_EQ((int64_t)_frameBytes, _pUnderTest->GetByteCount());
+   EXPECT_EQ(2, _pUnderTest->GetLookupCount());
+   EXPECT_EQ(1, _pUnderTest->GetHitCount());
+}
+
+// Tests that a wildcard field matches any value
+TEST_F(LastValueCacheTest, Find_Wildcards_FindsEachMatch) {
+   //Setup
+   _pUnderTest->Update(CommonMessages::SubscriptionParams(1, 100, 5), CreateFrame(1));
+   _pUnderTest->Update(CommonMessages::SubscriptionParams(1, 100, 6), CreateFrame(2));
+   _pUnderTest->Update(CommonMessages::SubscriptionParams(1, 101, 5), CreateFrame(3));
+   _pUnderTest->Update(CommonMessages::SubscriptionParams(2, 100, 5), CreateFrame(4));
+   LastValueCache::FrameList anyTopic, anyID, anyType;
+
+   //Test
+   _pUnderTest->Find(CommonMessages::SubscriptionParams(1, 100, 0), &anyTopic);
+   _pUnderTest->Find(CommonMessages::SubscriptionParams(1, 0, 5), &anyID);
+   _pUnderTest->Find(CommonMessages::SubscriptionParams(0, 0, 0), &anyType);
+
+   //Expectations
+   EXPECT_EQ((size_t)2, anyTopic.size());
+   EXPECT_EQ((size_t)2, anyID.size());
+   EXPECT_EQ((size_t)4, anyType.size());
+   for (auto& frame : anyID)
+      EXPECT_EQ(5, frame.first._topic);
+}
+
+// Tests that going over the memory cap evicts the least recently used frames
+TEST_F(LastValueCacheTest, Update_OverCap_EvictsLeastRecentlyUsed) {
+   //Setup
+   CommonMessages::SubscriptionParams kept(1, 1, 1);
+   CommonMessages::SubscriptionParams notUsed(1, 2, 1);
+   _pUnderTest->Update(kept, CreateFrame(0));
+   _pUnderTest->Update(notUsed, CreateFrame(0));
+
+   //Test
+   for (int topic = 2; topic < 200; topic++)
+   {
+      _pUnderTest->Update(CommonMessages::SubscriptionParams(1, 1, topic), CreateFrame(topic));
+      //looking it up keeps it recently used
+      FindExact(kept);
+   }
+
+   //Expectations
+   EXPECT_NE(nullptr, FindExact(kept));
+   EXPECT_EQ(nullptr, FindExact(notUsed));
+   EXPECT_LE(_pUnderTest->GetByteCount(), (int64_t)_pUnderTest->GetMaxBytes());
+   EXPECT_EQ(200 - _pUnderTest->GetEntryCount(), _pUnderTest->GetEvictionCount());
+}
+
+// Tests that a cache with no memory cap keeps nothing
+TEST_F(LastValueCacheTest, Update_Disabled_KeepsNothing) {
+   //Setup
+   CommonMessages::SubscriptionParams source(1, 100, 5);
+   _pUnderTest->Update(source, CreateFrame(1));
+
+   //Test
+   _pUnderTest->SetMaxBytes(0);
+   _pUnderTest->Update(source, CreateFrame(2));
+
+   //Expectations
+   EXPECT_FALSE(_pUnderTest->IsEnabled());
+   EXPECT_EQ(nullptr, FindExact(source));
+   EXPECT_EQ(0, _pUnderTest->GetEntryCount());
+   EXPECT_EQ(0, _pUnderTest->GetByteCount());
+}
+
+// Tests that removing a client discards only the frames it published
+TEST_F(LastValueCacheTest, RemoveClient_RemovesOnlyThatClient) {
+   //Setup
+   _pUnderTest->SetMaxBytes(1024 * 1024);
+   for (int topic = 1; topic <= 20; topic++)
+   {
+      _pUnderTest->Update(CommonMessages::SubscriptionParams(1, 100, topic), CreateFrame(topic));
+      _pUnderTest->Update(CommonMessages::SubscriptionParams(1, 101, topic), CreateFrame(topic));
+   }
+
+   //Test
+   auto numRemoved = _pUnderTest->RemoveClient(1, 100);
+
+   //Expectations
+   EXPECT_EQ((size_t)20, numRemoved);
+   EXPECT_EQ(20, _pUnderTest->GetEntryCount());
+   EXPECT_EQ(20 * (int64_t)_frameBytes, _pUnderTest->GetByteCount());
+   LastValueCache::FrameList frames;
+   EXPECT_EQ((size_t)0, _pUnderTest->Find(CommonMessages::SubscriptionParams(1, 100, 0), &frames));
+   EXPECT_EQ((size_t)20, _pUnderTest->Find(CommonMessages::SubscriptionParams(1, 101, 0), &frames));
+}
+
+// Tests that a frame bigger than a shard's share of the cap is not kept and does not evict the others
+TEST_F(LastValueCacheTest, Update_BiggerThanShare_NotKept) {
+   //Setup
+   CommonMessages::SubscriptionParams source(1, 100, 5);
+   CommonMessages::SubscriptionParams other(1, 100, 6);
+   _pUnderTest->Update(source, CreateFrame(1));
+   _pUnderTest->Update(other, CreateFrame(2));
+   CommonMessages::Header msg;
+   msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+   msg.set_msg(std::string(_frameBytes * 4, 'x'));
+   auto pLarge = CommonMessages::EncodedFrame::Create(msg);
+
+   //Test
+   _pUnderTest->Update(source, pLarge);
+
+   //Expectations
+   EXPECT_EQ(nullptr, FindExact(source));
+   EXPECT_NE(nullptr, FindExact(other));
+   EXPECT_EQ(1, _pUnderTest->GetOversizedCount());
+   EXPECT_EQ(0, _pUnderTest->GetEvictionCount());
+   EXPECT_EQ((int64_t)_frameBytes, _pUnderTest->GetByteCount());
+}
@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <future>
+#include <mutex>
+#include <thread>
 
 #include "SubscriptionHandler.h"
 #include "ClientMsgHandlerMock.h"
@@ -25,7 +28,7 @@ protected:
    std::shared_ptr<NiceMock<ClientMsgHandlerMock>> CreateMockClientMsgHandler(int clientType = 1, int clientID = 100)
    {
       auto pClient = std::make_shared<NiceMock<ClientMsgHandlerMock>>();
-      ON_CALL(*pClient, SendMsg(_)).WillByDefault(Return(true));
+      ON_CALL(*pClient, SendFrame(_)).WillByDefault(Return(true));
       ON_CALL(*pClient, GetClientType()).WillByDefault(Return(clientType));
       ON_CALL(*pClient, GetClientID()).WillByDefault(Return(clientID));
       return pClient;
@@ -74,7 +77,10 @@ TEST_F(SubscriptionHandlerTest, AddSubscription_SecondMsgAdded) {
    pUnderTest->AddSubscription(pClient, subscribeMsg);
 
    //Expectations
-   EXPECT_EQ(3, pClient.use_count());
+   //the table holds a client once however many subscriptions it has
+   EXPECT_EQ(2, pClient.use_count());
+   EXPECT_EQ((size_t)1, pUnderTest->GetSubscribersTo(0, 0).size());
+   EXPECT_EQ((size_t)1, pUnderTest->GetSubscribersTo(1, 0).size());
    pClient = nullptr;
 }
 
@@ -118,7 +124,7 @@ TEST_F(SubscriptionHandlerTest, RemoveSubscriptionFor_Removes) {
    pUnderTest->AddSubscription(pClient, subscribeMsg);
    subscribeMsg.set_clienttype(1);
    pUnderTest->AddSubscription(pClient, subscribeMsg);
-   EXPECT_EQ(3, pClient.use_count());
+   EXPECT_EQ(2, pClient.use_count());
    auto pClient2 = CreateMockClientMsgHandler();
    pUnderTest->AddSubscription(pClient2, subscribeMsg);
 
@@ -128,6 +134,8 @@ TEST_F(SubscriptionHandlerTest, RemoveSubscriptionFor_Removes) {
    //Expectations
    EXPECT_EQ(1, pClient.use_count());
    EXPECT_EQ(2, pClient2.use_count());
+   EXPECT_EQ((size_t)0, pUnderTest->GetSubscribersTo(0, 0).size());
+   EXPECT_EQ((size_t)1, pUnderTest->GetSubscribersTo(1, 0).size());
    pClient = nullptr;
 }
 TEST_F(SubscriptionHandlerTest, RemoveSubscriptionFor_NotThere) {
@@ -190,7 +198,7 @@ TEST_F(SubscriptionHandlerTest, SendToSubscribers_WrongClient_DoesNotSend) {
    auto pSender = CreateMockClientMsgHandler(clientType + 1);
 
    //Mock Expectations
-   EXPECT_CALL(*pSender, SendMsg(_)).Times(0);
+   EXPECT_CALL(*pSender, SendFrame(_)).Times(0);
 
    //Test
    pUnderTest->SendToSubscribers(pSender.get(), msg);
@@ -215,7 +223,7 @@ TEST_F(SubscriptionHandlerTest, SendToSubscribers_WrongTopic_DoesNotSend) {
 
    //Mock Expectations
    EXPECT_CALL(*pSender, GetClientType()).Times(1);
-   EXPECT_CALL(*pClient, SendMsg(_)).Times(0);
+   EXPECT_CALL(*pClient, SendFrame(_)).Times(0);
 
    //Test
    pUnderTest->SendToSubscribers(pSender.get(), msg);
@@ -243,7 +251,7 @@ TEST_F(SubscriptionHandlerTest, SendToSubscribers_WrongClientID_DoesNotSend) {
 
    //Mock Expectations
    EXPECT_CALL(*pSender, GetClientType()).Times(1);
-   EXPECT_CALL(*pSender, SendMsg(_)).Times(0);
+   EXPECT_CALL(*pSender, SendFrame(_)).Times(0);
 
    //Test
    pUnderTest->SendToSubscribers(pSender.get(), msg);
@@ -268,7 +276,7 @@ TEST_F(SubscriptionHandlerTest, SendToSubscribers_DoesNotSendToSelf) {
 
    //Mock Expectations
    EXPECT_CALL(*pSender, GetClientType()).Times(1);
-   EXPECT_CALL(*pSender, SendMsg(_)).Times(0);
+   EXPECT_CALL(*pSender, SendFrame(_)).Times(0);
 
    //Test
    pUnderTest->SendToSubscribers(pSender.get(), msg);
@@ -294,7 +302,265 @@ TEST_F(SubscriptionHandlerTest, SendToSubscribers_Sends) {
 
    //Mock Expectations
    EXPECT_CALL(*pSender, GetClientType()).Times(1);
-   EXPECT_CALL(*pClient, SendMsg(_)).Times(1);
+   EXPECT_CALL(*pClient, SendFrame(_)).Times(1);
+
+   //Test
+   pUnderTest->SendToSubscribers(pSender.get(), msg);
+
+   //Cleanup
+   pUnderTest = nullptr;
+   pClient = nullptr;
+   pSender = nullptr;
+}
+// Tests that a new subscriber is sent the latest message of each publisher and topic it subscribes to
+TEST_F(SubscriptionHandlerTest, SendLastValues_AfterPublish_SendsLatestPerTopic) {
+   //Setup
+   pUnderTest->GetLastValueCache().SetMaxBytes(1024 * 1024);
+   auto pSender = CreateMockClientMsgHandler(1, 100);
+   CommonMessages::Header msg;
+   msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+   for (int topic = 1; topic <= 2; topic++)
+   {
+      for (int key = 0; key < 3; key++)
+      {
+         msg.set_topic(topic);
+         msg.set_msgkey(topic * 10 + key);
+         pUnderTest->SendToSubscribers(pSender.get(), msg);
+      }
+   }
+   //not cached
+   msg.set_msgtypeid(CommonMessages::MsgType::LOGON);
+   pUnderTest->SendToSubscribers(pSender.get(), msg);
+   auto pClient = CreateMockClientMsgHandler(2, 200);
+   CommonMessages::Subscribe subscribeMsg;
+   subscribeMsg.set_clienttype(1);
+   subscribeMsg.set_clientid(100);
+   std::vector<int> keys;
+   ON_CALL(*pClient, SendFrame(_)).WillByDefault(Invoke([&keys](const CommonMessages::EncodedFramePtr& pFrame)
+   {
+      CommonMessages::Header sent;
+      sent.ParseFromArray(pFrame->GetData() + CommonMessages::HDR_SIZE, (int)(pFrame->GetSize() - CommonMessages::HDR_SIZE));
+      keys.push_back(sent.msgkey());
+      return true;
+   }));
+
+   //Test
+   pUnderTest->AddSubscription(pClient, subscribeMsg);
+   auto numSent = pUnderTest->SendLastValues(pClient.get(), subscribeMsg);
+
+   //Expectations
+   EXPECT_EQ((size_t)2, numSent);
+   std::sort(keys.begin(), keys.end());
+   ASSERT_EQ((size_t)2, keys.size());
+   EXPECT_EQ(12, keys[0]);
+   EXPECT_EQ(22, keys[1]);
+}
+// Tests that a message published while a new subscriber is being sent the cached one arrives after it
+TEST_F(SubscriptionHandlerTest, SendLastValues_PublishedMeanwhile_NewerArrivesLast) {
+   //Setup
+   pUnderTest->GetLastValueCache().SetMaxBytes(1024 * 1024);
+   auto pSender = CreateMockClientMsgHandler(1, 100);
+   CommonMessages::Header msg;
+   msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+   msg.set_topic(1);
+   msg.set_msgkey(1);
+   auto newerMsg = msg;
+   newerMsg.set_msgkey(2);
+   pUnderTest->SendToSubscribers(pSender.get(), msg);
+   auto pClient = CreateMockClientMsgHandler(2, 200);
+   CommonMessages::Subscribe subscribeMsg;
+   subscribeMsg.set_clienttype(1);
+   subscribeMsg.set_clientid(100);
+   subscribeMsg.set_topic(1);
+   std::mutex keysLock;
+   std::vector<int> keys;
+   std::promise<void> sendingCached;
+   ON_CALL(*pClient, SendFrame(_)).WillByDefault(Invoke([&](const CommonMessages::EncodedFramePtr& pFrame)
+   {
+      CommonMessages::Header sent;
+      sent.ParseFromArray(pFrame->GetData() + CommonMessages::HDR_SIZE, (int)(pFrame->GetSize() - CommonMessages::HDR_SIZE));
+      if (sent.msgkey() == 1)
+      {
+         //give the publish a chance to overtake the cached message
+         sendingCached.set_value();
+         std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      }
+      std::lock_guard<std::mutex> lock(keysLock);
+      keys.push_back(sent.msgkey());
+      return true;
+   }));
+   pUnderTest->AddSubscription(pClient, subscribeMsg);
+   auto cachedSending = sendingCached.get_future();
+   std::thread publisher([&]()
+   {
+      cachedSending.wait();
+      pUnderTest->SendToSubscribers(pSender.get(), newerMsg);
+   });
+
+   //Test
+   pUnderTest->SendLastValues(pClient.get(), subscribeMsg);
+   publisher.join();
+
+   //Expectations
+   ASSERT_EQ((size_t)2, keys.size());
+   EXPECT_EQ(1, keys[0]);
+   EXPECT_EQ(2, keys[1]);
+}
+// Tests that a subscriber added after a publisher took its snapshot, and sent the cached value, is sent the
+// value the publisher then publishes with that snapshot
+TEST_F(SubscriptionHandlerTest, SendToSubscribers_SubscribedAfterSnapshot_SendsNewerValue) {
+   //Setup
+   pUnderTest->GetLastValueCache().SetMaxBytes(1024 * 1024);
+   auto pSender = CreateMockClientMsgHandler(1, 100);
+   CommonMessages::Header msg;
+   msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+   msg.set_topic(1);
+   msg.set_msgkey(1);
+   pUnderTest->SendToSubscribers(pSender.get(), msg);
+   auto pSnapshot = pUnderTest->GetSnapshot();
+   auto pClient = CreateMockClientMsgHandler(2, 200);
+   CommonMessages::Subscribe subscribeMsg;
+   subscribeMsg.set_clienttype(1);
+   subscribeMsg.set_clientid(100);
+   subscribeMsg.set_topic(1);
+   std::vector<int> keys;
+   ON_CALL(*pClient, SendFrame(_)).WillByDefault(Invoke([&keys](const CommonMessages::EncodedFramePtr& pFrame)
+   {
+      CommonMessages::Header sent;
+      sent.ParseFromArray(pFrame->GetData() + CommonMessages::HDR_SIZE, (int)(pFrame->GetSize() - CommonMessages::HDR_SIZE));
+      keys.push_back(sent.msgkey());
+      return true;
+   }));
+   pUnderTest->AddSubscription(pClient, subscribeMsg);
+   pUnderTest->SendLastValues(pClient.get(), subscribeMsg);
+   msg.set_msgkey(2);
+
+   //Test
+   pUnderTest->SendToSubscribers(pSnapshot, pSender.get(), msg);
+
+   //Expectations
+   ASSERT_EQ((size_t)2, keys.size());
+   EXPECT_EQ(1, keys[0]);
+   EXPECT_EQ(2, keys[1]);
+}
+// As SendToSubscribers_SubscribedAfterSnapshot_SendsNewerValue, for a frame forwarded without parsing it
+TEST_F(SubscriptionHandlerTest, SendToSubscribers_FrameSubscribedAfterSnapshot_SendsNewerValue) {
+   //Setup
+   pUnderTest->GetLastValueCache().SetMaxBytes(1024 * 1024);
+   auto pSender = CreateMockClientMsgHandler(1, 100);
+   CommonMessages::Header msg;
+   msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+   msg.set_topic(1);
+   msg.set_msgkey(1);
+   auto pOlderFrame = CommonMessages::EncodedFrame::Create(msg);
+   msg.set_msgkey(2);
+   auto pNewerFrame = CommonMessages::EncodedFrame::Create(msg);
+   pUnderTest->SendToSubscribers(pUnderTest->GetSnapshot(), pSender.get(), 1, pOlderFrame, true);
+   auto pSnapshot = pUnderTest->GetSnapshot();
+   auto pClient = CreateMockClientMsgHandler(2, 200);
+   CommonMessages::Subscribe subscribeMsg;
+   subscribeMsg.set_clienttype(1);
+   subscribeMsg.set_clientid(100);
+   subscribeMsg.set_topic(1);
+   std::vector<CommonMessages::EncodedFramePtr> frames;
+   ON_CALL(*pClient, SendFrame(_)).WillByDefault(Invoke([&frames](const CommonMessages::EncodedFramePtr& pFrame)
+   {
+      frames.push_back(pFrame);
+      return true;
+   }));
+   pUnderTest->AddSubscription(pClient, subscribeMsg);
+   pUnderTest->SendLastValues(pClient.get(), subscribeMsg);
+
+   //Test
+   pUnderTest->SendToSubscribers(pSnapshot, pSender.get(), 1, pNewerFrame, true);
+
+   //Expectations
+   ASSERT_EQ((size_t)2, frames.size());
+   EXPECT_EQ(pOlderFrame, frames[0]);
+   EXPECT_EQ(pNewerFrame, frames[1]);
+}
+// Tests that a relayed message is cached under the client that first published it
+TEST_F(SubscriptionHandlerTest, SendToSubscribers_Relayed_CachedByOrigClient) {
+   //Setup
+   pUnderTest->GetLastValueCache().SetMaxBytes(1024 * 1024);
+   auto pSender = CreateMockClientMsgHandler(1, 100);
+   CommonMessages::Header msg;
+   msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+   msg.set_origclienttype(3);
+   msg.set_origclientid(300);
+   msg.set_topic(1);
+
+   //Test
+   pUnderTest->SendToSubscribers(pSender.get(), msg);
+
+   //Expectations
+   LastValueCache::FrameList frames;
+   EXPECT_EQ((size_t)1, pUnderTest->GetLastValueCache().Find(CommonMessages::SubscriptionParams(3, 300, 1), &frames));
+   EXPECT_EQ((size_t)0, pUnderTest->GetLastValueCache().Find(CommonMessages::SubscriptionParams(1, 100, 1), &frames));
+   EXPECT_EQ((size_t)1, pUnderTest->GetLastValueCache().RemoveClient(3, 300));
+}
+// Tests that the msg is encoded once and the same frame is sent to every subscriber
+TEST_F(SubscriptionHandlerTest, SendToSubscribers_SendsSameFrameToAll) {
+   //Setup
+   CommonMessages::Subscribe subscribeMsg;
+   int clientType = 1;
+   auto topic = 2;
+   subscribeMsg.set_clienttype(clientType);
+   subscribeMsg.set_topic(topic);
+   auto pClient1 = CreateMockClientMsgHandler(clientType, 101);
+   auto pClient2 = CreateMockClientMsgHandler(clientType, 102);
+   pUnderTest->AddSubscription(pClient1, subscribeMsg);
+   pUnderTest->AddSubscription(pClient2, subscribeMsg);
+
+   CommonMessages::Header msg;
+   msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+   msg.set_topic(topic);
+   auto pSender = CreateMockClientMsgHandler(clientType);
+   CommonMessages::EncodedFramePtr pFrame1;
+   CommonMessages::EncodedFramePtr pFrame2;
+
+   //Mock Expectations
+   EXPECT_CALL(*pClient1, SendFrame(_)).WillOnce(DoAll(SaveArg<0>(&pFrame1), Return(true)));
+   EXPECT_CALL(*pClient2, SendFrame(_)).WillOnce(DoAll(SaveArg<0>(&pFrame2), Return(true)));
+
+   //Test
+   pUnderTest->SendToSubscribers(pSender.get(), msg);
+
+   //Expectations
+   ASSERT_NE(nullptr, pFrame1);
+   EXPECT_EQ(pFrame1, pFrame2);
+   CommonMessages::Header decodedMsg;
+   ASSERT_TRUE(decodedMsg.ParseFromArray(pFrame1->GetData() + CommonMessages::HDR_SIZE, (int)(pFrame1->GetSize() - CommonMessages::HDR_SIZE)));
+   EXPECT_EQ(clientType, decodedMsg.origclienttype());
+   EXPECT_EQ(100, decodedMsg.origclientid());
+
+   //Cleanup
+   pUnderTest = nullptr;
+   pClient1 = nullptr;
+   pClient2 = nullptr;
+   pSender = nullptr;
+}
+// Tests that a client subscribed through an exact and a wildcard subscription gets the msg once
+TEST_F(SubscriptionHandlerTest, SendToSubscribers_ExactAndWildcard_SendsOnce) {
+   //Setup
+   int clientType = 1;
+   auto topic = 2;
+   auto pClient = CreateMockClientMsgHandler(clientType + 1);
+   CommonMessages::Subscribe exactMsg;
+   exactMsg.set_clienttype(clientType);
+   exactMsg.set_clientid(100);
+   exactMsg.set_topic(topic);
+   pUnderTest->AddSubscription(pClient, exactMsg);
+   CommonMessages::Subscribe wildcardMsg;
+   pUnderTest->AddSubscription(pClient, wildcardMsg);
+
+   CommonMessages::Header msg;
+   msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+   msg.set_topic(topic);
+   auto pSender = CreateMockClientMsgHandler(clientType, 100);
+
+   //Mock Expectations
+   EXPECT_CALL(*pClient, SendFrame(_)).Times(1);
 
    //Test
    pUnderTest->SendToSubscribers(pSender.get(), msg);
@@ -304,6 +570,46 @@ TEST_F(SubscriptionHandlerTest, SendToSubscribers_Sends) {
    pClient = nullptr;
    pSender = nullptr;
 }
+// Tests that each field of a subscription matches as a wildcard when it is 0
+TEST_F(SubscriptionHandlerTest, SendToSubscribers_Wildcards_SendToEachMatch) {
+   //Setup
+   int clientType = 1;
+   int clientID = 100;
+   auto topic = 2;
+   auto pAnyType = CreateMockClientMsgHandler(2, 1);
+   auto pAnyID = CreateMockClientMsgHandler(2, 2);
+   auto pAnyTopic = CreateMockClientMsgHandler(2, 3);
+   auto pOtherTopic = CreateMockClientMsgHandler(2, 4);
+   CommonMessages::Subscribe subscribeMsg;
+   subscribeMsg.set_clientid(clientID);
+   subscribeMsg.set_topic(topic);
+   pUnderTest->AddSubscription(pAnyType, subscribeMsg);
+   subscribeMsg.set_clienttype(clientType);
+   subscribeMsg.set_clientid(0);
+   pUnderTest->AddSubscription(pAnyID, subscribeMsg);
+   subscribeMsg.set_clientid(clientID);
+   subscribeMsg.set_topic(0);
+   pUnderTest->AddSubscription(pAnyTopic, subscribeMsg);
+   subscribeMsg.set_topic(topic + 1);
+   pUnderTest->AddSubscription(pOtherTopic, subscribeMsg);
+
+   CommonMessages::Header msg;
+   msg.set_msgtypeid(CommonMessages::MsgType::CUSTOM);
+   msg.set_topic(topic);
+   auto pSender = CreateMockClientMsgHandler(clientType, clientID);
+
+   //Mock Expectations
+   EXPECT_CALL(*pAnyType, SendFrame(_)).Times(1);
+   EXPECT_CALL(*pAnyID, SendFrame(_)).Times(1);
+   EXPECT_CALL(*pAnyTopic, SendFrame(_)).Times(1);
+   EXPECT_CALL(*pOtherTopic, SendFrame(_)).Times(0);
+
+   //Test
+   pUnderTest->SendToSubscribers(pSender.get(), msg);
+
+   //Cleanup
+   pUnderTest = nullptr;
+}
 TEST_F(SubscriptionHandlerTest, GetSubscribers_ReturnsList) {
    //Setup
    CommonMessages::Subscribe subscribeMsg;
@@ -326,3 +632,113 @@ TEST_F(SubscriptionHandlerTest, GetSubscribers_ReturnsList) {
    pUnderTest = nullptr;
    pClient = nullptr;
 }
+TEST_F(SubscriptionHandlerTest, AddSubscription_NewVersionOnlyWhenChanged) {
+   //Setup
+   CommonMessages::Subscribe subscribeMsg;
+   subscribeMsg.set_clienttype(1);
+   auto pClient = CreateMockClientMsgHandler(2);
+   auto startVersion = pUnderTest->GetVersion();
+
+   //Test
+   pUnderTest->AddSubscription(pClient, subscribeMsg);
+   pUnderTest->AddSubscription(pClient, subscribeMsg);
+
+   //Expectations
+   EXPECT_EQ(startVersion + 1, pUnderTest->GetVersion());
+
+   //Cleanup
+   pUnderTest = nullptr;
+   pClient = nullptr;
+}
+TEST_F(SubscriptionHandlerTest, SendToSubscribers_Snapshot_UnaffectedByLaterRemove) {
+   //Setup
+   CommonMessages::Subscribe subscribeMsg;
+   int clientType = 1;
+   auto pClient = CreateMockClientMsgHandler(clientType + 1);
+   subscribeMsg.set_clienttype(clientType);
+   pUnderTest->AddSubscription(pClient, subscribeMsg);
+   auto pSnapshot = pUnderTest->GetSnapshot();
+   pUnderTest->RemoveSubscriptionsFor(pClient.get());
+   auto pSender = CreateMockClientMsgHandler(clientType);
+   auto pFrame = CommonMessages::EncodedFrame::GetHeartbeat();
+
+   //Mock Expectations
+   EXPECT_CALL(*pClient, SendFrame(_)).Times(1);
+
+   //Test
+   pUnderTest->SendToSubscribers(pSnapshot, pSender.get(), 0, pFrame);
+   pUnderTest->SendToSubscribers(pSender.get(), 0, pFrame);
+
+   //Expectations
+   EXPECT_EQ((size_t)0, pUnderTest->GetSubscribersTo(clientType, 0).size());
+
+   //Cleanup
+   pSnapshot = nullptr;
+   pUnderTest = nullptr;
+   pClient = nullptr;
+}
+TEST_F(SubscriptionHandlerTest, RemoveSubscriptionFor_MiddleOfList_OthersStillSubscribed) {
+   //Setup
+   CommonMessages::Subscribe subscribeMsg;
+   int clientType = 1;
+   subscribeMsg.set_clienttype(clientType);
+   auto pFirst = CreateMockClientMsgHandler(clientType + 1, 1);
+   auto pMiddle = CreateMockClientMsgHandler(clientType + 1, 2);
+   auto pLast = CreateMockClientMsgHandler(clientType + 1, 3);
+   pUnderTest->AddSubscription(pFirst, subscribeMsg);
+   pUnderTest->AddSubscription(pMiddle, subscribeMsg);
+   pUnderTest->AddSubscription(pLast, subscribeMsg);
+   auto pSender = CreateMockClientMsgHandler(clientType);
+   auto pFrame = CommonMessages::EncodedFrame::GetHeartbeat();
+
+   //Mock Expectations
+   EXPECT_CALL(*pFirst, SendFrame(_)).Times(2);
+   EXPECT_CALL(*pMiddle, SendFrame(_)).Times(0);
+   EXPECT_CALL(*pLast, SendFrame(_)).Times(1);
+
+   //Test
+   pUnderTest->RemoveSubscriptionsFor(pMiddle.get());
+   pUnderTest->SendToSubscribers(pSender.get(), 0, pFrame);
+   //the last client was moved into the middle's place
+   pUnderTest->RemoveSubscription(pLast.get(), subscribeMsg);
+   pUnderTest->SendToSubscribers(pSender.get(), 0, pFrame);
+
+   //Expectations
+   EXPECT_EQ((size_t)1, pUnderTest->GetSubscribersTo(clientType, 0).size());
+
+   //Cleanup
+   pUnderTest = nullptr;
+}
+TEST_F(SubscriptionHandlerTest, AddSubscription_ReusesSlotOfRemovedClient_SendsOnlyToNewClient) {
+   //Setup
+   int clientType = 1;
+   CommonMessages::Subscribe exactMsg;
+   exactMsg.set_clienttype(clientType);
+   exactMsg.set_clientid(100);
+   CommonMessages::Subscribe wildcardMsg;
+   auto pRemoved = CreateMockClientMsgHandler(clientType + 1, 1);
+   pUnderTest->AddSubscription(pRemoved, exactMsg);
+   pUnderTest->AddSubscription(pRemoved, wildcardMsg);
+   auto pOldSnapshot = pUnderTest->GetSnapshot();
+   pUnderTest->RemoveSubscriptionsFor(pRemoved.get());
+   auto pNew = CreateMockClientMsgHandler(clientType + 1, 2);
+   auto pSender = CreateMockClientMsgHandler(clientType, 100);
+   auto pFrame = CommonMessages::EncodedFrame::GetHeartbeat();
+
+   //Mock Expectations
+   EXPECT_CALL(*pRemoved, SendFrame(_)).Times(1);
+   EXPECT_CALL(*pNew, SendFrame(_)).Times(1);
+
+   //Test
+   pUnderTest->AddSubscription(pNew, exactMsg);
+   pUnderTest->AddSubscription(pNew, wildcardMsg);
+   pUnderTest->SendToSubscribers(pSender.get(), 0, pFrame);
+   pUnderTest->SendToSubscribers(pOldSnapshot, pSender.get(), 0, pFrame);
+
+   //Expectations
+   EXPECT_EQ(pOldSnapshot->_numSlots, pUnderTest->GetSnapshot()->_numSlots);
+
+   //Cleanup
+   pOldSnapshot = nullptr;
+   pUnderTest = nullptr;
+}
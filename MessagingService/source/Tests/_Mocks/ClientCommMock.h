@@ -22,6 +22,7 @@ public:
    
    //ICommHandler
    MOCK_METHOD1(SendMsg, bool(Matrix::MsgService::CommonMessages::Header&));
+   MOCK_METHOD1(SendFrame, bool(const Matrix::MsgService::CommonMessages::EncodedFramePtr&));
    MOCK_METHOD0(IsConnected, bool());
    MOCK_METHOD0(Disconnect, void());
    MOCK_METHOD1(AddConnectionChangeObserver, CommunicationUtils::ConnectionChangeConnection(const CommunicationUtils::ConnectionChangeCallback& ));
@@ -35,4 +36,4 @@ public:
    MOCK_METHOD6(SendCommonMsg, int(Matrix::MsgService::CommonMessages::MsgType, const google::protobuf::MessageLite* , int, int, int, bool));
    MOCK_METHOD3(Subscribe, bool(Matrix::MsgService::CommonMessages::ClientTypes, int, bool));
 };
-}
\ No newline at end of file
+}
\ No newline at end of file
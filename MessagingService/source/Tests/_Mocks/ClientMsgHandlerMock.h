@@ -24,6 +24,7 @@ namespace testing
 
       //ICommHandler
       MOCK_METHOD1(SendMsg, bool(Matrix::MsgService::CommonMessages::Header&));
+      MOCK_METHOD1(SendFrame, bool(const Matrix::MsgService::CommonMessages::EncodedFramePtr&));
       MOCK_METHOD0(IsConnected, bool());
       MOCK_METHOD0(Disconnect, void());
       MOCK_METHOD1(AddConnectionChangeObserver, CommunicationUtils::ConnectionChangeConnection(const CommunicationUtils::ConnectionChangeCallback&));
@@ -37,4 +38,4 @@ namespace testing
       MOCK_METHOD0(GetClientID, int());
    };
 
-};
\ No newline at end of file
+};
\ No newline at end of file
@@ -18,6 +18,9 @@ public:
 
    //IContextHandler
    MOCK_METHOD0(GetIOContext, boost::asio::io_context&());
+   MOCK_METHOD0(AddConnection, void());
+   MOCK_METHOD0(RemoveConnection, void());
+   MOCK_METHOD0(GetConnectionCount, int64_t());
 #ifdef USING_SSL
    MOCK_METHOD0(GetSSLContext, boost::asio::ssl::context&());
 #endif
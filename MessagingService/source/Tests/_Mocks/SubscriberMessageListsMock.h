@@ -18,9 +18,6 @@ public:
    MOCK_METHOD3(RemoveSentMessages, bool(int, int, const google::protobuf::RepeatedField<int>&));
    MOCK_METHOD3(RemoveSentMessage, bool(int, int, int));
    MOCK_METHOD3(GetMessages, std::vector<Matrix::MsgService::CommonMessages::Header>(int, int, int));
-   MOCK_METHOD1(AddToNeedToAckList, void(const Matrix::MsgService::CommonMessages::Header* ));
-   MOCK_METHOD3(RemoveFromNeedToAckList, void(int, int, std::vector<int>));
-   MOCK_METHOD2(GetNeedToAckList, std::vector<int>(int, int));
    MOCK_METHOD2(IsClientOnline, bool(int, int));
    MOCK_METHOD3(SetClientOnLine, void(int, int, bool));
 